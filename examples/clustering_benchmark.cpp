@@ -1,10 +1,23 @@
 /**
  * @file clustering_benchmark.cpp
  * @brief Performance comparison between different clustering algorithms
+ * 
+ * With the --perf option, hardware counters per event are reported for the execution phase.
+ *
+ * K-means is also compared with different distance policies: besides the times, the quality
+ * of the clustering is reported as the mean squared Euclidean error of the test surfaces
+ * and the fraction of surfaces assigned to the same cluster as with the Euclidean distance.
+ *
+ * Finally, k-means is run with the label cache, with and without verification of the cached labels,
+ * reporting the hit rate, the fraction of distances computed with respect to a full search
+ * and the fraction of surfaces assigned to the same cluster as without cache.
  */
 #include <iostream>
 #include <chrono>
 #include <iomanip>
+#include <tuple>
+#include <string>
+#include <vector>
 
 #include <cpphots/time_surface.h>
 #include <cpphots/layer.h>
@@ -16,9 +29,10 @@
 #include <cpphots/run.h>
 
 #include "commons.h"
+#include "perf_counters.h"
 
 
-std::pair<double, double> measure_times(cpphots::Layer& layer, size_t n_training, size_t n_events) {
+std::tuple<double, double, PerfSample> measure_times(cpphots::Layer& layer, size_t n_training, size_t n_events, PerfCounters& perf) {
 
     auto event_gen = getRandomEventGenerator(100, 100, 0);
 
@@ -39,29 +53,156 @@ std::pair<double, double> measure_times(cpphots::Layer& layer, size_t n_training
     std::chrono::duration<double> time_training = end - start;
 
     // process
+    perf.start();
     start = std::chrono::system_clock::now();
     for (size_t i = 0; i < n_events; i++) {
         layer.process(event_gen(), true);
     }
     end = std::chrono::system_clock::now();
+    PerfSample counters = perf.stop();
     std::chrono::duration<double> time_processing = end - start;
 
-    return {time_training.count(), time_processing.count()};
+    return {time_training.count(), time_processing.count(), counters};
 
 }
 
-int main() {
+template <typename Distance>
+std::vector<uint16_t> compare_distance(const std::string& label, const std::vector<cpphots::TimeSurfaceType>& seeds,
+                                       const std::vector<cpphots::TimeSurfaceType>& training, const std::vector<cpphots::TimeSurfaceType>& test,
+                                       const std::vector<uint16_t>& reference) {
+
+    cpphots::BasicKMeansClusterer<Distance> clusterer(seeds.size(), 20);
+    for (const auto& s : seeds) {
+        clusterer.addCentroid(s);
+    }
+
+    auto start = std::chrono::system_clock::now();
+    clusterer.train(training);
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> time_training = end - start;
+
+    std::vector<uint16_t> labels(test.size());
+    start = std::chrono::system_clock::now();
+    for (size_t i = 0; i < test.size(); i++) {
+        labels[i] = clusterer.cluster(test[i]);
+    }
+    end = std::chrono::system_clock::now();
+    std::chrono::duration<double> time_processing = end - start;
+
+    double error = 0.0;
+    size_t agree = 0;
+    for (size_t i = 0; i < test.size(); i++) {
+        error += cpphots::distance::SquaredEuclidean::compute(test[i], clusterer.getCentroids()[labels[i]]);
+        agree += (!reference.empty() && labels[i] == reference[i]);
+    }
+
+    std::cout << std::setw(11) << label << " | "
+              << std::setw(9) << std::setprecision(5) << time_training.count() << " | "
+              << std::setw(9) << std::setprecision(5) << time_processing.count() << " | "
+              << std::setw(9) << std::setprecision(5) << error / test.size() << " | "
+              << std::setw(9) << std::setprecision(3) << (reference.empty() ? 1.0 : double(agree) / test.size()) << std::endl;
+
+    return labels;
+
+}
+
+void compare_label_cache(const std::string& label, cpphots::KMeansClusterer clusterer, const std::vector<cpphots::TimeSurfaceType>& test,
+                         const std::vector<uint16_t>& reference, bool cache, bool verify) {
+
+    if (cache) {
+        clusterer.enableLabelCache(2, 1 << 16, verify);
+    }
+
+    std::vector<uint16_t> labels(test.size());
+    auto start = std::chrono::system_clock::now();
+    for (size_t i = 0; i < test.size(); i++) {
+        labels[i] = clusterer.cluster(test[i]);
+    }
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> time_processing = end - start;
+
+    size_t agree = 0;
+    for (size_t i = 0; i < test.size(); i++) {
+        agree += (labels[i] == reference[i]);
+    }
+
+    const auto& stats = clusterer.getLabelCacheStats();
+    double hit_rate = stats.lookups > 0 ? double(stats.hits) / stats.lookups : 0.0;
+    double distances = stats.lookups > 0 ? double(stats.distances) / (stats.lookups * clusterer.getNumClusters()) : 1.0;
+
+    std::cout << std::setw(11) << label << " | "
+              << std::setw(9) << std::setprecision(5) << time_processing.count() << " | "
+              << std::setw(9) << std::setprecision(3) << hit_rate << " | "
+              << std::setw(9) << std::setprecision(3) << distances << " | "
+              << std::setw(9) << std::setprecision(3) << double(agree) / test.size() << std::endl;
+
+}
+
+std::vector<uint16_t> reference_labels(cpphots::KMeansClusterer clusterer, const std::vector<cpphots::TimeSurfaceType>& test) {
+
+    std::vector<uint16_t> labels(test.size());
+    for (size_t i = 0; i < test.size(); i++) {
+        labels[i] = clusterer.cluster(test[i]);
+    }
+
+    return labels;
+
+}
+
+void compare_distances(size_t n_training, size_t n_test) {
+
+    auto event_gen = getRandomEventGenerator(100, 100, 0);
+    auto pool = cpphots::create_pool<cpphots::LinearTimeSurface>(1, 100, 100, 5, 5, 500.);
+
+    cpphots::Events training_evs(n_training), test_evs(n_test);
+    std::generate(training_evs.begin(), training_evs.end(), event_gen);
+    std::generate(test_evs.begin(), test_evs.end(), event_gen);
+
+    auto training = cpphots::generateTS(pool, training_evs, true, true);
+    auto test = cpphots::generateTS(pool, test_evs, false, true);
+
+    // same seeds for all distances
+    cpphots::KMeansClusterer seeder(10);
+    cpphots::ClustererAFKMC2Seeding(5)(seeder, training);
+    const auto& seeds = seeder.getCentroids();
+
+    std::cout << std::endl << "k-means distance |  training | execution |       MSE | agreement" << std::endl;
+
+    auto reference = compare_distance<cpphots::distance::Euclidean>("Euclidean", seeds, training, test, {});
+    compare_distance<cpphots::distance::SquaredEuclidean>("squared L2", seeds, training, test, reference);
+    compare_distance<cpphots::distance::Manhattan>("L1", seeds, training, test, reference);
+    compare_distance<cpphots::distance::Chebyshev>("Chebyshev", seeds, training, test, reference);
+    compare_distance<cpphots::distance::Cosine>("cosine", seeds, training, test, reference);
+
+    cpphots::KMeansClusterer clusterer(seeds.size(), 20);
+    for (const auto& s : seeds) {
+        clusterer.addCentroid(s);
+    }
+    clusterer.train(training);
+    auto cache_reference = reference_labels(clusterer, test);
+
+    std::cout << std::endl << "label cache | execution |  hit rate | distances | agreement" << std::endl;
+
+    compare_label_cache("none", clusterer, test, cache_reference, false, false);
+    compare_label_cache("verified", clusterer, test, cache_reference, true, true);
+    compare_label_cache("unverified", clusterer, test, cache_reference, true, false);
+
+}
+
+int main(int argc, char* argv[]) {
 
     size_t n_training = 10000;
     size_t n_events = 10e6;
 
-    std::cout << "        |  training | execution" << std::endl;
+    PerfCounters perf(perfRequested(argc, argv));
+
+    std::cout << "        |  training | execution" << (perf.isEnabled() ? " | execution counters" : "") << std::endl;
 
     {
         cpphots::Layer layer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, 100, 100, 5, 5, 500.),
                              new cpphots::CosineClusterer(10));
-        auto [tr, ex] = measure_times(layer, n_training, n_events);
-        std::cout << " cosine | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << std::endl;
+        auto [tr, ex, counters] = measure_times(layer, n_training, n_events, perf);
+        std::cout << " cosine | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << (perf.isEnabled() ? " | " + perfSummary(counters, n_events) : "") << std::endl;
     }
 
     #ifdef CPPHOTS_WITH_PEREGRINE
@@ -69,15 +210,15 @@ int main() {
     {
         cpphots::Layer layer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, 100, 100, 5, 5, 500.),
                              new cpphots::GMMClusterer(cpphots::GMMClusterer::S_GMM, 10, 5, 8, 0.01, 20));
-        auto [tr, ex] = measure_times(layer, n_training, n_events);
-        std::cout << "  S-GMM | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << std::endl;
+        auto [tr, ex, counters] = measure_times(layer, n_training, n_events, perf);
+        std::cout << "  S-GMM | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << (perf.isEnabled() ? " | " + perfSummary(counters, n_events) : "") << std::endl;
     }
 
     {
         cpphots::Layer layer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, 100, 100, 5, 5, 500.),
                              new cpphots::GMMClusterer(cpphots::GMMClusterer::U_S_GMM, 10, 5, 8, 0.01, 20));
-        auto [tr, ex] = measure_times(layer, n_training, n_events);
-        std::cout << " uS-GMM | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << std::endl;
+        auto [tr, ex, counters] = measure_times(layer, n_training, n_events, perf);
+        std::cout << " uS-GMM | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << (perf.isEnabled() ? " | " + perfSummary(counters, n_events) : "") << std::endl;
     }
 
     #endif
@@ -85,10 +226,12 @@ int main() {
     {
         cpphots::Layer layer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, 100, 100, 5, 5, 500.),
                              new cpphots::KMeansClusterer(10, 20));
-        auto [tr, ex] = measure_times(layer, n_training, n_events);
-        std::cout << "k-means | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << std::endl;
+        auto [tr, ex, counters] = measure_times(layer, n_training, n_events, perf);
+        std::cout << "k-means | " << std::setw(9) << std::setprecision(5) << tr << " | " << std::setw(9) << std::setprecision(5) << ex << (perf.isEnabled() ? " | " + perfSummary(counters, n_events) : "") << std::endl;
     }
 
+    compare_distances(n_training, 1e5);
+
     return 0;
 
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 /**
  * @file network_benchmark.cpp
  * @brief Computes the overhead of using the Layer and Network classes
+ * 
+ * With the --perf option, hardware counters per event are reported for each case.
  */
 #include <chrono>
 #include <vector>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <algorithm>
 
 #include <cpphots/time_surface.h>
 #include <cpphots/layer.h>
@@ -14,6 +17,7 @@
 #include <cpphots/clustering/cosine.h>
 
 #include "commons.h"
+#include "perf_counters.h"
 
 
 using Results = std::vector<std::vector<double>>;
@@ -42,7 +46,7 @@ void save_results_csv(const std::string& filename, const std::vector<unsigned in
 
 }
 
-double test_components(unsigned int num_layers, unsigned int num_events) {
+double test_components(unsigned int num_layers, unsigned int num_events, PerfCounters& perf, PerfSample& counters) {
 
     std::vector<cpphots::TimeSurfacePool> pools;
     std::vector<cpphots::CosineClusterer> clusts;
@@ -57,6 +61,7 @@ double test_components(unsigned int num_layers, unsigned int num_events) {
         seeding(clusts.back(), {});
     }
 
+    perf.start();
     auto start = std::chrono::system_clock::now();
     for (unsigned int i = 0; i < num_events; i++) {
         auto ev = evgen();
@@ -70,12 +75,13 @@ double test_components(unsigned int num_layers, unsigned int num_events) {
     }
 
     auto end = std::chrono::system_clock::now();
+    counters = perf.stop();
     std::chrono::duration<double> diff = end - start;
     return diff.count();
 
 }
 
-double test_layer(unsigned int num_layers, unsigned int num_events) {
+double test_layer(unsigned int num_layers, unsigned int num_events, PerfCounters& perf, PerfSample& counters) {
 
     std::vector<cpphots::Layer> layers;
 
@@ -90,6 +96,7 @@ double test_layer(unsigned int num_layers, unsigned int num_events) {
         layers.push_back(layer);
     }
 
+    perf.start();
     auto start = std::chrono::system_clock::now();
     for (unsigned int i = 0; i < num_events; i++) {
         auto ev = evgen();
@@ -101,12 +108,13 @@ double test_layer(unsigned int num_layers, unsigned int num_events) {
     }
 
     auto end = std::chrono::system_clock::now();
+    counters = perf.stop();
     std::chrono::duration<double> diff = end - start;
     return diff.count();
 
 }
 
-double test_network(unsigned int num_layers, unsigned int num_events) {
+double test_network(unsigned int num_layers, unsigned int num_events, PerfCounters& perf, PerfSample& counters) {
 
     cpphots::Network network;
 
@@ -120,6 +128,7 @@ double test_network(unsigned int num_layers, unsigned int num_events) {
         seeding(network.back(), {});
     }
 
+    perf.start();
     auto start = std::chrono::system_clock::now();
     for (unsigned int i = 0; i < num_events; i++) {
         auto ev = evgen();
@@ -127,16 +136,18 @@ double test_network(unsigned int num_layers, unsigned int num_events) {
     }
 
     auto end = std::chrono::system_clock::now();
+    counters = perf.stop();
     std::chrono::duration<double> diff = end - start;
     return diff.count();
 
 }
 
 
-Results print_table(const std::string& name, const std::vector<unsigned int>& layers, const std::vector<double> events, bool average = false) {
+Results print_table(const std::string& name, const std::vector<unsigned int>& layers, const std::vector<double> events, PerfCounters& perf, bool average = false) {
 
     Results res;
     res.resize(layers.size(), std::vector<double>(events.size()));
+    std::vector<std::vector<PerfSample>> counters(layers.size(), std::vector<PerfSample>(events.size()));
 
     std::cout << std::endl;
     std::cout.width(10);
@@ -162,11 +173,11 @@ Results print_table(const std::string& name, const std::vector<unsigned int>& la
             // run the right test
             double tt = 0.0;
             if (name == "COMPONENTS") {
-                tt = test_components(nl, ne);
+                tt = test_components(nl, ne, perf, counters[l][e]);
             } else if (name == "LAYER") {
-                tt = test_layer(nl, ne);
+                tt = test_layer(nl, ne, perf, counters[l][e]);
             } else if (name == "NETWORK") {
-                tt = test_network(nl, ne);
+                tt = test_network(nl, ne, perf, counters[l][e]);
             }
 
             // adjust for average if requested
@@ -182,6 +193,17 @@ Results print_table(const std::string& name, const std::vector<unsigned int>& la
     }
     std::cout << std::endl;
 
+    if (perf.isEnabled()) {
+        for (size_t l = 0; l < layers.size(); l++) {
+            for (size_t e = 0; e < events.size(); e++) {
+                std::cout << std::setw(10) << (std::to_string(layers[l]) + " layers") << " | "
+                          << std::scientific << std::setprecision(0) << events[e] << " events | "
+                          << perfSummary(counters[l][e], events[e]) << std::endl;
+            }
+        }
+        std::cout << std::endl;
+    }
+
     return res;
 
 }
@@ -189,34 +211,23 @@ Results print_table(const std::string& name, const std::vector<unsigned int>& la
 
 int main(int argc, char* argv[]) {
 
-    if (argc > 3) {
-        std::cerr << "Too many arguments. Only arguments available are '--save' and '--avg'" << std::endl;
+    if (argc > 4) {
+        std::cerr << "Too many arguments. Only arguments available are '--save', '--avg' and '--perf'" << std::endl;
         return 1;
     }
 
-    std::string arg1, arg2;
-    if (argc > 1) {
-        arg1 = std::string(argv[1]);
-    }
-    if (argc > 2) {
-        arg2 = std::string(argv[2]);
-    }
+    std::vector<std::string> args(argv + 1, argv + argc);
 
-    bool save = false;
-    if (arg1 == "--save" || arg2 == "--save") {
-        save = true;
-    }
+    bool save = std::find(args.begin(), args.end(), "--save") != args.end();
+    bool avg = std::find(args.begin(), args.end(), "--avg") != args.end();
 
-    bool avg = false;
-    if (arg1 == "--avg" || arg2 == "--avg") {
-        avg = true;
-    }
+    PerfCounters perf(perfRequested(argc, argv));
 
     std::vector<unsigned int> layers{1, 2, 5, 10};
     std::vector<double> events{1e6, 10e6, 100e6, 1e9};
 
     for (auto name : {"COMPONENTS", "LAYER", "NETWORK"}) {
-        auto res = print_table(name, layers, events, avg);
+        auto res = print_table(name, layers, events, perf, avg);
         if (save) {
             if (avg) {
                 save_results_csv(std::string(name) + "_avg.csv", layers, events, res);
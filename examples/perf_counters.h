@@ -0,0 +1,245 @@
+/**
+ * @file perf_counters.h
+ * @brief Optional hardware performance counters for the benchmarks
+ *
+ * On Linux, counters are read with perf_event_open, for the calling thread and in user space only.
+ * On other systems, or when the counters cannot be opened (e.g., restrictive perf_event_paranoid,
+ * virtual machines without PMU), the missing values are reported as nan.
+ */
+#ifndef CPPHOTS_EXAMPLES_PERF_COUNTERS_H
+#define CPPHOTS_EXAMPLES_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * @brief Values of the counters over one or more measurements
+ */
+struct PerfSample {
+
+    enum Counter {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        NumCounters
+    };
+
+    std::array<double, NumCounters> values{};
+    std::array<bool, NumCounters> valid{};
+
+    PerfSample& operator+=(const PerfSample& other) {
+        for (size_t i = 0; i < NumCounters; i++) {
+            values[i] += other.values[i];
+            valid[i] = valid[i] || other.valid[i];
+        }
+        return *this;
+    }
+
+    double get(Counter c) const {
+        return valid[c] ? values[c] : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    double ipc() const {
+        return get(Instructions) / get(Cycles);
+    }
+
+    double perEvent(Counter c, double events) const {
+        return get(c) / events;
+    }
+
+};
+
+
+/**
+ * @brief Group of hardware counters for the calling thread
+ */
+class PerfCounters {
+
+public:
+
+    explicit PerfCounters(bool enable)
+        :enabled(enable) {
+
+        fds.fill(-1);
+
+        if (!enable) {
+            return;
+        }
+
+#ifdef __linux__
+        const std::array<uint64_t, PerfSample::NumCounters> configs{PERF_COUNT_HW_CPU_CYCLES,
+                                                                     PERF_COUNT_HW_INSTRUCTIONS,
+                                                                     PERF_COUNT_HW_CACHE_MISSES,
+                                                                     PERF_COUNT_HW_BRANCH_MISSES};
+
+        for (size_t i = 0; i < configs.size(); i++) {
+
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[i] < 0 && error.empty()) {
+                error = std::strerror(errno);
+            }
+
+        }
+#else
+        error = "not supported on this platform";
+#endif
+
+        if (!available()) {
+            std::cerr << "Hardware performance counters not available (" << error << "), values will be reported as nan" << std::endl;
+        } else if (!error.empty()) {
+            std::cerr << "Some hardware performance counters are not available (" << error << "), their values will be reported as nan" << std::endl;
+        }
+
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    bool available() const {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    PerfSample stop() {
+
+        PerfSample sample;
+
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+
+        for (size_t i = 0; i < fds.size(); i++) {
+
+            if (fds[i] < 0) {
+                continue;
+            }
+
+            // value, time enabled, time running
+            uint64_t data[3];
+            if (read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+                continue;
+            }
+
+            // scale if the counter has been multiplexed
+            sample.values[i] = double(data[0]) * double(data[1]) / double(data[2]);
+            sample.valid[i] = true;
+
+        }
+#endif
+
+        return sample;
+
+    }
+
+private:
+    std::array<int, PerfSample::NumCounters> fds;
+    std::string error;
+    bool enabled;
+
+};
+
+
+/**
+ * @brief Check if counters were requested on the command line
+ */
+inline bool perfRequested(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--perf") {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief CSV header for the counters, one column per value
+ */
+inline std::string perfCSVHeader(const std::string& prefix) {
+    return "," + prefix + "_ipc," + prefix + "_ins," + prefix + "_cmiss," + prefix + "_bmiss";
+}
+
+/**
+ * @brief CSV values for the counters, normalized per event
+ */
+inline std::string perfCSV(const PerfSample& sample, double events) {
+    std::ostringstream out;
+    out << "," << sample.ipc()
+        << "," << sample.perEvent(PerfSample::Instructions, events)
+        << "," << sample.perEvent(PerfSample::CacheMisses, events)
+        << "," << sample.perEvent(PerfSample::BranchMisses, events);
+    return out.str();
+}
+
+/**
+ * @brief Human readable summary of the counters, normalized per event
+ */
+inline std::string perfSummary(const PerfSample& sample, double events) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "IPC " << sample.ipc()
+        << ", " << sample.perEvent(PerfSample::Instructions, events) << " ins/ev"
+        << ", " << std::setprecision(3) << sample.perEvent(PerfSample::CacheMisses, events) << " cache-miss/ev"
+        << ", " << sample.perEvent(PerfSample::BranchMisses, events) << " br-miss/ev";
+    return out.str();
+}
+
+#endif
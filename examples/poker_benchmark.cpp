@@ -0,0 +1,279 @@
+/**
+ * @file poker_benchmark.cpp
+ * @brief End-to-end throughput and accuracy benchmark on POKER-DVS
+ *
+ * Trains the network of poker_dvs.cpp and classifies the test recordings, printing a single JSON record with:
+ * - the training time of each layer, in seconds;
+ * - the inference throughput of the network, in events per second;
+ * - the memory used by the network (as reported by memoryUsage) and the peak resident memory of the process;
+ * - the accuracy of each classifier.
+ *
+ * Usage: poker_benchmark [data_folder]
+ *
+ * With a folder, the POKER-DVS recordings in EventStream format are used (see poker_dvs.cpp).
+ * Without a folder, a synthetic dataset with the same layout is generated from a fixed seed:
+ * four pips (club, diamond, heart, spade), drawn as simple shapes that move across a 32x32 sensor,
+ * with ON events on the leading half, OFF events on the trailing half and some background noise.
+ *
+ * Layers are trained one at a time, with the same procedure as cpphots::train, so that each one can be timed.
+ * The seeding of the clusterers uses a fixed seed, so that the accuracy is the same in every run.
+ * The peak resident memory is only available on Linux, it is null on other systems.
+ * The throughput is null when the inference is too short to be timed.
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include <cpphots/classification.h>
+#include <cpphots/run.h>
+
+#include "poker_dvs.h"
+
+
+using Dataset = std::vector<std::pair<cpphots::Events, std::string>>;
+
+const std::vector<std::string> pips{"club", "diamond", "heart", "spade"};
+
+
+std::pair<Dataset, Dataset> poker_dvs_dataset(const std::string& folder) {
+
+    Dataset train_set, test_set;
+
+    for (const auto& sample : poker_dvs_trainset(folder)) {
+        train_set.push_back({load_file(sample.first), sample.second});
+    }
+
+    for (const auto& sample : poker_dvs_testset(folder)) {
+        test_set.push_back({load_file(sample.first), sample.second});
+    }
+
+    return {train_set, test_set};
+
+}
+
+// shape of a pip, with radius r, for the offset (dx, dy) from its center
+bool pip_shape(size_t pip, int dx, int dy, int r) {
+
+    switch (pip) {
+        case 0:
+            return (std::abs(dx) <= 1 || std::abs(dy) <= 1) && std::max(std::abs(dx), std::abs(dy)) <= r;
+        case 1:
+            return std::abs(dx) + std::abs(dy) == r;
+        case 2:
+            return std::abs(std::sqrt(dx*dx + dy*dy) - r) < 0.5;
+        default:
+            return std::max(std::abs(dx), std::abs(dy)) == r;
+    }
+
+}
+
+cpphots::Events synthetic_recording(size_t pip, std::mt19937& gen) {
+
+    const int r = 6;
+    const uint64_t step = 100;
+
+    std::uniform_real_distribution<double> speed_dist(1.5, 2.5);
+    std::uniform_real_distribution<double> y_dist(10, 22);
+    std::uniform_real_distribution<double> drift_dist(-0.02, 0.02);
+    std::uniform_real_distribution<double> unif(0.0, 1.0);
+    std::uniform_int_distribution<uint64_t> jitter(0, step - 1);
+    std::uniform_int_distribution<uint16_t> coord(0, 31);
+    std::uniform_int_distribution<uint16_t> pol(0, 1);
+
+    // pixels per step
+    double speed = speed_dist(gen) / 10;
+    double cy = y_dist(gen);
+    double drift = drift_dist(gen);
+
+    cpphots::Events events;
+    uint64_t t = 0;
+    for (double cx = -r; cx < 32 + r; cx += speed, cy += drift, t += step) {
+
+        for (int dy = -r; dy <= r; dy++) {
+            for (int dx = -r; dx <= r; dx++) {
+                int x = std::lround(cx) + dx;
+                int y = std::lround(cy) + dy;
+                if (x < 0 || x >= 32 || y < 0 || y >= 32 || !pip_shape(pip, dx, dy, r) || unif(gen) > 0.3) {
+                    continue;
+                }
+                events.push_back({t + jitter(gen), uint16_t(x), uint16_t(y), uint16_t(dx >= 0)});
+            }
+        }
+
+        if (unif(gen) < 0.5) {
+            events.push_back({t + jitter(gen), coord(gen), coord(gen), pol(gen)});
+        }
+
+    }
+
+    std::sort(events.begin(), events.end(), [] (const cpphots::event& e1, const cpphots::event& e2) { return e1.t < e2.t; });
+
+    return events;
+
+}
+
+std::pair<Dataset, Dataset> synthetic_dataset() {
+
+    std::mt19937 gen(0);
+
+    Dataset train_set, test_set;
+
+    for (size_t c = 0; c < pips.size(); c++) {
+        train_set.push_back({synthetic_recording(c, gen), pips[c]});
+    }
+
+    for (size_t c = 0; c < pips.size(); c++) {
+        for (int i = 0; i < 16; i++) {
+            test_set.push_back({synthetic_recording(c, gen), pips[c]});
+        }
+    }
+
+    return {train_set, test_set};
+
+}
+
+size_t count_events(const Dataset& dataset) {
+
+    size_t n = 0;
+    for (const auto& sample : dataset) {
+        n += sample.first.size();
+    }
+
+    return n;
+
+}
+
+// train the layers one at a time and return the time taken by each one
+std::vector<double> train_layers(cpphots::Network& network, const Dataset& train_set) {
+
+    std::vector<cpphots::Events> events;
+    for (const auto& sample : train_set) {
+        events.push_back(sample.first);
+    }
+
+    std::vector<double> times;
+    for (auto& layer : network) {
+
+        cpphots::Network single;
+        single.addLayer(layer);
+
+        auto start = std::chrono::steady_clock::now();
+        events = cpphots::train(single, events, cpphots::ClustererAFKMC2Seeding(3, 0), true);
+        auto end = std::chrono::steady_clock::now();
+
+        layer = single[0];
+        times.push_back(std::chrono::duration<double>(end - start).count());
+
+    }
+
+    return times;
+
+}
+
+cpphots::Features process_recording(cpphots::Network& network, const cpphots::Events& events) {
+
+    network.reset();
+    for (const auto& ev : events) {
+        network.process(ev);
+    }
+
+    return network.back().getHistogram();
+
+}
+
+// peak resident memory of the process in bytes, negative if not available
+long peak_memory() {
+
+#ifdef __linux__
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss * 1024L;
+    }
+#endif
+
+    return -1;
+
+}
+
+
+int main(int argc, char* argv[]) {
+
+    if (argc > 2) {
+        std::cerr << "Usage: " << argv[0] << " [data_folder]" << std::endl;
+        return 1;
+    }
+
+    bool synthetic = argc < 2;
+    auto [train_set, test_set] = synthetic ? synthetic_dataset() : poker_dvs_dataset(argv[1]);
+
+    // training
+    auto network = create_network();
+    auto layer_times = train_layers(network, train_set);
+
+    cpphots::StandardClassifier standard(pips);
+    for (const auto& sample : train_set) {
+        standard.setClassFeatures(sample.second, process_recording(network, sample.first));
+    }
+    cpphots::NormalizedClassifier normalized(&standard);
+    cpphots::BhattacharyyaClassifier bhattacharyya(&standard);
+
+    const std::vector<std::pair<std::string, const cpphots::Classifier*>> classifiers{{"standard", &standard},
+                                                                                     {"normalized", &normalized},
+                                                                                     {"bhattacharyya", &bhattacharyya}};
+
+    // inference, only the network is timed
+    std::vector<double> correct(classifiers.size());
+    double inference_time = 0.0;
+    for (const auto& sample : test_set) {
+
+        auto start = std::chrono::steady_clock::now();
+        auto feats = process_recording(network, sample.first);
+        auto end = std::chrono::steady_clock::now();
+        inference_time += std::chrono::duration<double>(end - start).count();
+
+        for (size_t i = 0; i < classifiers.size(); i++) {
+            correct[i] += classifiers[i].second->classifyName(feats) == sample.second;
+        }
+
+    }
+
+    long peak = peak_memory();
+
+    // record
+    std::cout << std::setprecision(6);
+    std::cout << "{\"dataset\": \"" << (synthetic ? "synthetic" : "poker-dvs") << "\""
+              << ", \"train_recordings\": " << train_set.size()
+              << ", \"train_events\": " << count_events(train_set)
+              << ", \"test_recordings\": " << test_set.size()
+              << ", \"test_events\": " << count_events(test_set);
+
+    std::cout << ", \"training_seconds\": [";
+    for (size_t l = 0; l < layer_times.size(); l++) {
+        std::cout << (l > 0 ? ", " : "") << layer_times[l];
+    }
+    std::cout << "]";
+
+    std::cout << ", \"inference_seconds\": " << inference_time
+              << ", \"inference_events_per_second\": " << (inference_time > 0 ? std::to_string(count_events(test_set) / inference_time) : "null")
+              << ", \"network_memory_bytes\": " << network.memoryUsage().total()
+              << ", \"peak_memory_bytes\": " << (peak < 0 ? "null" : std::to_string(peak));
+
+    std::cout << ", \"accuracy\": {";
+    for (size_t i = 0; i < classifiers.size(); i++) {
+        std::cout << (i > 0 ? ", " : "") << "\"" << classifiers[i].first << "\": " << correct[i] / test_set.size();
+    }
+    std::cout << "}}" << std::endl;
+
+    return 0;
+
+}
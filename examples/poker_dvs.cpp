@@ -4,34 +4,30 @@
  * 
  * Example of how to use cpphots for a classification task, using the dataset from http://www2.imse-cnm.csic.es/caviar/POKERDVS.html
  * A version of the dataset in EventStream format can be downloaded from https://www.dropbox.com/s/6700gh70mbwzxa0/poker-dvs-eventstream.zip?dl=0
+ * 
+ * With --anytime [margin] [check_every] the test recordings are also classified with cpphots::classifyAnytime,
+ * reporting the events and latency saved by stopping as soon as the decision is confident.
  */
 
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <algorithm>
 
-#include <cpphots/time_surface.h>
-#include <cpphots/network.h>
-#include <cpphots/events_utils.h>
 #include <cpphots/classification.h>
 #include <cpphots/run.h>
-#include "cpphots/clustering/kmeans.h"
+
+#include "poker_dvs.h"
 
 
 cpphots::Features process_file(cpphots::Network& network, const std::string& filename) {
 
     // load file
-    auto events = cpphots::loadFromFile(filename);
+    auto events = load_file(filename);
 
     // run network
     network.reset();
     for (const auto& ev : events) {
-
-        // there are some events outside the range
-        if (ev.x >= 32 || ev.y >= 32) {
-            continue;
-        }
-
         network.process(ev);
     }
 
@@ -105,73 +101,9 @@ void train(cpphots::Network& network, const std::vector<std::string>& training_s
 }
 
 
-std::vector<std::pair<std::string, std::string>> poker_dvs_trainset(const std::string& folder) {
-
-    std::vector<std::pair<std::string, std::string>> ret;
-
-    std::vector<std::string> pips{"cl", "di", "he", "sp"};
-
-    std::unordered_map<std::string, std::string> longer{{"cl", "club"},
-                                                        {"di", "diamond"},
-                                                        {"he", "heart"},
-                                                        {"sp", "spade"}};
-
-    for (auto p : pips) {
-        ret.push_back({folder + "/tr" + p + "0.es", longer[p]});
-    }
-
-    return ret;
-
-}
-
-
-std::vector<std::pair<std::string, std::string>> poker_dvs_testset(const std::string& folder) {
-
-    std::vector<std::pair<std::string, std::string>> ret;
-
-    std::vector<std::string> pips{"cl", "di", "he", "sp"};
-
-    std::unordered_map<std::string, std::string> longer{{"cl", "club"},
-                                                        {"di", "diamond"},
-                                                        {"he", "heart"},
-                                                        {"sp", "spade"}};
-
-    for (auto p : pips) {
-        for (int i = 0; i < 5; i++) {
-            ret.push_back({folder + "/te" + p + std::to_string(i) + ".es", longer[p]});
-        }
-    }
-
-    for (auto p : pips) {
-        for (int i = 1; i < 12; i++) {
-            ret.push_back({folder + "/tr" + p + std::to_string(i) + ".es", longer[p]});
-        }
-    }
-
-    return ret;
-
-}
-
-
-std::vector<std::pair<std::string, std::string>> poker_dvs_all(const std::string& folder) {
-
-    auto tr = poker_dvs_trainset(folder);
-    auto te = poker_dvs_testset(folder);
-
-    tr.insert(tr.end(), te.begin(), te.end());
-
-    return tr;
-
-}
-
-
 std::tuple<double, double, double> test_training(const std::string& folder, bool multi, const cpphots::ClustererSeedingType& seeding) {
 
-    cpphots::Network network;
-    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 32, 32, 2, 2, 1000),
-                        new cpphots::KMeansClusterer(16));
-    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(16, 32, 32, 4, 4, 5000),
-                        new cpphots::KMeansClusterer(32));
+    auto network = create_network();
 
     auto train_set = poker_dvs_trainset(folder);
 
@@ -205,6 +137,75 @@ std::tuple<double, double, double> test_training(const std::string& folder, bool
 }
 
 
+// compare the classification of full recordings with the anytime one
+void test_anytime(const std::string& folder, const cpphots::AnytimeCriterion& criterion) {
+
+    auto network = create_network();
+
+    auto train_set = poker_dvs_trainset(folder);
+
+    train(network,
+          {train_set[0].first,
+           train_set[1].first,
+           train_set[2].first,
+           train_set[3].first},
+          cpphots::ClustererAFKMC2Seeding(3),
+          true);
+
+    // the normalized distance does not depend on the number of events seen so far
+    cpphots::NormalizedClassifier classifier({"club", "diamond", "heart", "spade"});
+    for (size_t i = 0; i < 4; i++) {
+        classifier.setClassFeatures(train_set[i].second, process_file(network, train_set[i].first));
+    }
+
+    auto test_set = poker_dvs_testset(folder);
+
+    double acc_full = 0, acc_anytime = 0;
+    size_t events_total = 0, events_processed = 0, early = 0;
+    uint64_t duration_total = 0, duration_processed = 0;
+    double time_full = 0, time_anytime = 0;
+
+    for (const auto& sample : test_set) {
+
+        auto events = load_file(sample.first);
+        if (events.empty()) {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        network.reset();
+        for (const auto& ev : events) {
+            network.process(ev);
+        }
+        auto predicted = classifier.classifyName(network.back().getSparseHistogram());
+        auto mid = std::chrono::steady_clock::now();
+        auto result = cpphots::classifyAnytime(network, events, classifier, criterion);
+        auto end = std::chrono::steady_clock::now();
+
+        acc_full += predicted == sample.second;
+        acc_anytime += classifier.getClassName(result.class_id) == sample.second;
+
+        events_total += result.events_total;
+        events_processed += result.events_processed;
+        early += result.early;
+        duration_total += result.end_time - events.front().t;
+        duration_processed += result.decision_time - events.front().t;
+        time_full += std::chrono::duration<double, std::milli>(mid - start).count();
+        time_anytime += std::chrono::duration<double, std::milli>(end - mid).count();
+
+    }
+
+    std::cout << "full:    acc = " << acc_full / test_set.size()
+              << ", time = " << time_full << " ms" << std::endl;
+    std::cout << "anytime: acc = " << acc_anytime / test_set.size()
+              << ", time = " << time_anytime << " ms"
+              << ", early decisions = " << early << "/" << test_set.size() << std::endl;
+    std::cout << "events saved = " << 100.0 * (events_total - events_processed) / events_total << "%"
+              << ", latency saved = " << 100.0 * (duration_total - duration_processed) / duration_total << "%" << std::endl;
+
+}
+
+
 int main(int argc, char* argv[]) {
 
     if (argc < 2) {
@@ -249,6 +250,18 @@ int main(int argc, char* argv[]) {
             file.close();
         }
 
+    } else if (argc > 2 && std::string(argv[2]) == "--anytime") {
+
+        cpphots::AnytimeCriterion criterion;
+        if (argc > 3) {
+            criterion.margin = std::atof(argv[3]);
+        }
+        if (argc > 4) {
+            criterion.check_every = std::atoi(argv[4]);
+        }
+
+        test_anytime(datafolder, criterion);
+
     } else {
 
         auto res = test_training(datafolder, true, cpphots::ClustererAFKMC2Seeding(3));
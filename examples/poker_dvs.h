@@ -0,0 +1,101 @@
+#ifndef CPPHOTS_EXAMPLES_POKER_DVS_H
+#define CPPHOTS_EXAMPLES_POKER_DVS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+
+#include <cpphots/time_surface.h>
+#include <cpphots/network.h>
+#include <cpphots/events_utils.h>
+#include <cpphots/clustering/kmeans.h>
+
+
+cpphots::Events load_file(const std::string& filename) {
+
+    auto events = cpphots::loadFromFile(filename);
+
+    // there are some events outside the range
+    events.erase(std::remove_if(events.begin(), events.end(), [] (const cpphots::event& ev) { return ev.x >= 32 || ev.y >= 32; }),
+                 events.end());
+
+    return events;
+
+}
+
+
+std::vector<std::pair<std::string, std::string>> poker_dvs_trainset(const std::string& folder) {
+
+    std::vector<std::pair<std::string, std::string>> ret;
+
+    std::vector<std::string> pips{"cl", "di", "he", "sp"};
+
+    std::unordered_map<std::string, std::string> longer{{"cl", "club"},
+                                                        {"di", "diamond"},
+                                                        {"he", "heart"},
+                                                        {"sp", "spade"}};
+
+    for (auto p : pips) {
+        ret.push_back({folder + "/tr" + p + "0.es", longer[p]});
+    }
+
+    return ret;
+
+}
+
+
+std::vector<std::pair<std::string, std::string>> poker_dvs_testset(const std::string& folder) {
+
+    std::vector<std::pair<std::string, std::string>> ret;
+
+    std::vector<std::string> pips{"cl", "di", "he", "sp"};
+
+    std::unordered_map<std::string, std::string> longer{{"cl", "club"},
+                                                        {"di", "diamond"},
+                                                        {"he", "heart"},
+                                                        {"sp", "spade"}};
+
+    for (auto p : pips) {
+        for (int i = 0; i < 5; i++) {
+            ret.push_back({folder + "/te" + p + std::to_string(i) + ".es", longer[p]});
+        }
+    }
+
+    for (auto p : pips) {
+        for (int i = 1; i < 12; i++) {
+            ret.push_back({folder + "/tr" + p + std::to_string(i) + ".es", longer[p]});
+        }
+    }
+
+    return ret;
+
+}
+
+
+std::vector<std::pair<std::string, std::string>> poker_dvs_all(const std::string& folder) {
+
+    auto tr = poker_dvs_trainset(folder);
+    auto te = poker_dvs_testset(folder);
+
+    tr.insert(tr.end(), te.begin(), te.end());
+
+    return tr;
+
+}
+
+
+cpphots::Network create_network() {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 32, 32, 2, 2, 1000),
+                        new cpphots::KMeansClusterer(16));
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(16, 32, 32, 4, 4, 5000),
+                        new cpphots::KMeansClusterer(32));
+
+    return network;
+
+}
+
+#endif
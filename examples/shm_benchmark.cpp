@@ -0,0 +1,196 @@
+/**
+ * @file shm_benchmark.cpp
+ * @brief Throughput and latency of the shared-memory event transport
+ *
+ * A child process acts as a stand-in for an external event producer (e.g., a camera driver),
+ * writing random events in batches with the C interface. The parent consumes them, either
+ * discarding them or processing them with a Network, and the results are compared with
+ * processing the same number of events directly in memory.
+ *
+ * Latency is measured from the moment a batch is pushed to the moment its events are consumed,
+ * with the producer writing batches at a fixed rate.
+ */
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <cpphots/shm_ring.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/network.h>
+
+#include "commons.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// producer process, if period_us > 0 timestamps are replaced with the push time
+void run_producer(const std::string& name, size_t n_events, size_t batch, unsigned int period_us) {
+
+    auto* producer = cpphots_shm_producer_create(name.c_str(), 1 << 16);
+    if (producer == nullptr) {
+        std::perror("cpphots_shm_producer_create");
+        _exit(1);
+    }
+
+    auto event_gen = getRandomEventGenerator(100, 100, 0);
+    std::vector<cpphots_event> evs(batch);
+
+    // give some time to the consumer to open the buffer
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto next = Clock::now();
+    for (size_t i = 0; i < n_events; i += batch) {
+        uint64_t t = now_ns();
+        for (auto& ev : evs) {
+            auto e = event_gen();
+            ev = {period_us > 0 ? t : e.t, e.x, e.y, e.p};
+        }
+        cpphots_shm_producer_push(producer, evs.data(), std::min(batch, n_events - i), -1);
+        if (period_us > 0) {
+            next += std::chrono::microseconds(period_us);
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    cpphots_shm_producer_close(producer);
+    _exit(0);
+
+}
+
+cpphots::Network create_network() {
+    cpphots::Network net;
+    net.addLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, 100, 100, 2, 2, 100));
+    return net;
+}
+
+// returns the consumer time and the latencies of the consumed events
+std::pair<double, std::vector<uint64_t>> run_consumer(const std::string& name, cpphots::Network* net, bool latency) {
+
+    // wait for the producer to create the buffer
+    cpphots::ShmEventConsumer* consumer = nullptr;
+    while (consumer == nullptr) {
+        try {
+            consumer = new cpphots::ShmEventConsumer(name);
+        } catch (const std::runtime_error&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    std::vector<uint64_t> latencies;
+    Clock::time_point start;
+    bool started = false;
+
+    while (consumer->wait()) {
+        if (!started) {
+            start = Clock::now();
+            started = true;
+        }
+        consumer->consume([net, latency, &latencies] (const cpphots::event& ev) {
+            if (net) {
+                net->process(ev);
+            }
+            if (latency) {
+                latencies.push_back(now_ns() - ev.t);
+            }
+        });
+    }
+    std::chrono::duration<double> diff = Clock::now() - start;
+
+    delete consumer;
+    cpphots_shm_unlink(name.c_str());
+
+    return {diff.count(), latencies};
+
+}
+
+std::pair<double, std::vector<uint64_t>> run_transport(size_t n_events, size_t batch, unsigned int period_us, bool process) {
+
+    std::string name = "/cpphots_benchmark_" + std::to_string(getpid());
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_producer(name, n_events, batch, period_us);
+    }
+
+    cpphots::Network net = create_network();
+    auto res = run_consumer(name, process ? &net : nullptr, period_us > 0);
+
+    waitpid(pid, nullptr, 0);
+
+    return res;
+
+}
+
+double run_local(size_t n_events) {
+
+    auto event_gen = getRandomEventGenerator(100, 100, 0);
+    cpphots::Events evs(n_events);
+    std::generate(evs.begin(), evs.end(), event_gen);
+
+    cpphots::Network net = create_network();
+
+    auto start = Clock::now();
+    for (const auto& ev : evs) {
+        net.process(ev);
+    }
+    std::chrono::duration<double> diff = Clock::now() - start;
+
+    return diff.count();
+
+}
+
+void print_latency(const std::string& label, std::vector<uint64_t> lat) {
+
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&lat] (double p) { return lat[std::min(lat.size() - 1, size_t(p * lat.size()))] / 1000.0; };
+
+    std::cout << std::setw(22) << label << " | "
+              << std::fixed << std::setprecision(2)
+              << std::setw(8) << pct(0.5) << " | "
+              << std::setw(8) << pct(0.99) << " | "
+              << std::setw(8) << pct(1.0) << std::endl;
+
+}
+
+int main() {
+
+    size_t n_events = 10e6;
+
+    std::cout << "Throughput (" << n_events << " events)" << std::endl;
+    std::cout << "                       |   Mev/s" << std::endl;
+
+    for (size_t batch : {1, 64, 4096}) {
+        double time = run_transport(n_events, batch, 0, false).first;
+        std::cout << std::setw(16) << "transport, batch " << std::setw(5) << batch << " | " << std::setw(7) << std::setprecision(3) << n_events / time / 1e6 << std::endl;
+    }
+    for (size_t batch : {1, 64, 4096}) {
+        double time = run_transport(n_events, batch, 0, true).first;
+        std::cout << std::setw(16) << "  network, batch " << std::setw(5) << batch << " | " << std::setw(7) << std::setprecision(3) << n_events / time / 1e6 << std::endl;
+    }
+    double local = run_local(n_events);
+    std::cout << std::setw(22) << "network, in memory" << " | " << std::setw(7) << std::setprecision(3) << n_events / local / 1e6 << std::endl;
+
+    std::cout << std::endl << "Latency (us), batches every 100 us" << std::endl;
+    std::cout << "                       |      p50 |      p99 |      max" << std::endl;
+
+    for (size_t batch : {1, 64}) {
+        auto lat = run_transport(2e4 * batch, batch, 100, false).second;
+        print_latency("transport, batch " + std::to_string(batch), lat);
+        lat = run_transport(2e4 * batch, batch, 100, true).second;
+        print_latency("network, batch " + std::to_string(batch), lat);
+    }
+
+    return 0;
+
+}
@@ -4,6 +4,10 @@
  * 
  * Computes the amount of time that it takes to compute a million time surfaces from random events,
  * with various parameters values.
+ * The layer is run both with the validity check (l) and without it (ls).
+ * 
+ * With the --perf option, hardware counters (IPC, instructions, cache misses and branch misses per event)
+ * are reported for each case as well.
  */
 #include <iostream>
 #include <chrono>
@@ -14,11 +18,13 @@
 #include <cpphots/network.h>
 
 #include "commons.h"
+#include "perf_counters.h"
 
 
-void perform_test_ts(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, unsigned int repetitions = 5) {
+void perform_test_ts(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, PerfCounters& perf, unsigned int repetitions = 5) {
 
     double time = 0.0;
+    PerfSample counters;
 
     for (unsigned int i = 0; i < repetitions; i++) {
 
@@ -26,11 +32,13 @@ void perform_test_ts(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau
 
         cpphots::LinearTimeSurface ts(sz, sz, r, r, tau);
 
+        perf.start();
         auto start = std::chrono::system_clock::now();
         for (size_t i = 0; i < 1e6; i++) {
             ts.updateAndCompute(event_gen());
         }
         auto end = std::chrono::system_clock::now();
+        counters += perf.stop();
         std::chrono::duration<double> diff = end - start;
 
         time += diff.count();
@@ -40,12 +48,16 @@ void perform_test_ts(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau
     time /= repetitions;
 
     std::cout << "," << time;
+    if (perf.isEnabled()) {
+        std::cout << perfCSV(counters, 1e6 * repetitions);
+    }
 
 }
 
-void perform_test_p(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, unsigned int repetitions = 5) {
+void perform_test_p(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, PerfCounters& perf, unsigned int repetitions = 5) {
 
     double time = 0.0;
+    PerfSample counters;
 
     for (unsigned int i = 0; i < repetitions; i++) {
 
@@ -53,11 +65,13 @@ void perform_test_p(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau,
 
         auto tsp = cpphots::create_pool<cpphots::LinearTimeSurface>(1, sz, sz, r, r, tau);
 
+        perf.start();
         auto start = std::chrono::system_clock::now();
         for (size_t i = 0; i < 1e6; i++) {
             tsp.updateAndCompute(event_gen());
         }
         auto end = std::chrono::system_clock::now();
+        counters += perf.stop();
         std::chrono::duration<double> diff = end - start;
 
         time += diff.count();
@@ -67,12 +81,16 @@ void perform_test_p(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau,
     time /= repetitions;
 
     std::cout << "," << time;
+    if (perf.isEnabled()) {
+        std::cout << perfCSV(counters, 1e6 * repetitions);
+    }
 
 }
 
-void perform_test_l(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, unsigned int repetitions = 5) {
+void perform_test_l(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, PerfCounters& perf, bool skip_check, unsigned int repetitions = 5) {
 
     double time = 0.0;
+    PerfSample counters;
 
     for (unsigned int i = 0; i < repetitions; i++) {
 
@@ -80,11 +98,13 @@ void perform_test_l(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau,
 
         cpphots::Layer layer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, sz, sz, r, r, tau));
 
+        perf.start();
         auto start = std::chrono::system_clock::now();
         for (size_t i = 0; i < 1e6; i++) {
-            layer.process(event_gen());
+            layer.process(event_gen(), skip_check);
         }
         auto end = std::chrono::system_clock::now();
+        counters += perf.stop();
         std::chrono::duration<double> diff = end - start;
 
         time += diff.count();
@@ -94,12 +114,16 @@ void perform_test_l(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau,
     time /= repetitions;
 
     std::cout << "," << time;
+    if (perf.isEnabled()) {
+        std::cout << perfCSV(counters, 1e6 * repetitions);
+    }
 
 }
 
-void perform_test_n(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, unsigned int repetitions = 5) {
+void perform_test_n(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau, PerfCounters& perf, unsigned int repetitions = 5) {
 
     double time = 0.0;
+    PerfSample counters;
 
     for (unsigned int i = 0; i < repetitions; i++) {
 
@@ -108,11 +132,13 @@ void perform_test_n(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau,
         cpphots::Network net;
         net.addLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(1, sz, sz, r, r, tau));
 
+        perf.start();
         auto start = std::chrono::system_clock::now();
         for (size_t i = 0; i < 1e6; i++) {
             net.process(event_gen());
         }
         auto end = std::chrono::system_clock::now();
+        counters += perf.stop();
         std::chrono::duration<double> diff = end - start;
 
         time += diff.count();
@@ -122,21 +148,31 @@ void perform_test_n(uint16_t sz, uint16_t r, cpphots::TimeSurfaceScalarType tau,
     time /= repetitions;
 
     std::cout << "," << time;
+    if (perf.isEnabled()) {
+        std::cout << perfCSV(counters, 1e6 * repetitions);
+    }
 
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+
+    PerfCounters perf(perfRequested(argc, argv));
 
-    std::cout << "sz,r,tau,ts,p,l,n" << std::endl;
+    if (perf.isEnabled()) {
+        std::cout << "sz,r,tau,ts" << perfCSVHeader("ts") << ",p" << perfCSVHeader("p") << ",l" << perfCSVHeader("l") << ",ls" << perfCSVHeader("ls") << ",n" << perfCSVHeader("n") << std::endl;
+    } else {
+        std::cout << "sz,r,tau,ts,p,l,ls,n" << std::endl;
+    }
 
     for (auto sz : {32, 64, 346}) {
         for (auto r : {2, 4, 8, 16}) {
             for (auto tau : {50., 100., 200., 500.}) {
                 std::cout << sz << "," << r << "," << tau;
-                perform_test_ts(sz, r, tau);
-                perform_test_p(sz, r, tau);
-                perform_test_l(sz, r, tau);
-                perform_test_n(sz, r, tau);
+                perform_test_ts(sz, r, tau, perf);
+                perform_test_p(sz, r, tau, perf);
+                perform_test_l(sz, r, tau, perf, false);
+                perform_test_l(sz, r, tau, perf, true);
+                perform_test_n(sz, r, tau, perf);
                 std::cout << std::endl;
             }
         }
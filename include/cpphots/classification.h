@@ -10,6 +10,11 @@
 #include <string>
 #include <unordered_map>
 #include <ostream>
+#include <istream>
+
+#include "types.h"
+#include "interfaces/streamable.h"
+#include "interfaces/memory.h"
 
 
 namespace cpphots {
@@ -19,6 +24,31 @@ namespace cpphots {
  */
 using Features = std::vector<uint32_t>;
 
+/**
+ * @brief Sparse features for the classification
+ * 
+ * List of (index, value) pairs sorted by index, zero values are omitted.
+ * Sparse features can be obtained directly from Clusterer::getSparseHistogram.
+ */
+using SparseFeatures = SparseHistogram;
+
+/**
+ * @brief Convert dense features to sparse features
+ * 
+ * @param feats dense features
+ * @return sparse features
+ */
+SparseFeatures toSparse(const Features& feats);
+
+/**
+ * @brief Convert sparse features to dense features
+ * 
+ * @param feats sparse features
+ * @param size size of the dense features
+ * @return dense features
+ */
+Features toDense(const SparseFeatures& feats, size_t size);
+
 /**
  * @brief Stream insertion operator for Features
  * 
@@ -120,13 +150,86 @@ public:
      */
     std::string classifyName(const Features& feats) const;
 
+    /**
+     * @brief Classify sparse features
+     * 
+     * This method outputs the ID of the predicted class.
+     * The cost of the classification is proportional to the number of non-zero features.
+     * 
+     * @param feats sparse features
+     * @return index the predicted class
+     */
+    size_t classifyID(const SparseFeatures& feats) const;
+
+    /**
+     * @brief Classify sparse features
+     * 
+     * This method outputs the label of the predicted class.
+     * This method will raise an erro if the Classifier has not been constructed using labels.
+     * 
+     * @param feats sparse features
+     * @return label of the predicted class
+     */
+    std::string classifyName(const SparseFeatures& feats) const;
+
+    /**
+     * @brief Compute the distance of features from all classes
+     * 
+     * The predicted class is the one at minimum distance.
+     * 
+     * @param feats features
+     * @return distances, indexed by class ID
+     */
+    std::vector<double> classDistances(const Features& feats) const;
+
+    /**
+     * @brief Compute the distance of sparse features from all classes
+     * 
+     * The predicted class is the one at minimum distance.
+     * The cost is proportional to the number of non-zero features.
+     * 
+     * @param feats sparse features
+     * @return distances, indexed by class ID
+     */
+    std::vector<double> classDistances(const SparseFeatures& feats) const;
+
+    /**
+     * @brief Get the number of classes
+     * 
+     * @return number of classes
+     */
+    size_t getNumClasses() const;
+
+    /**
+     * @brief Get the label of a class
+     * 
+     * This method will raise an error if the Classifier has not been constructed using labels.
+     * 
+     * @param cid index of the class
+     * @return label of the class
+     */
+    std::string getClassName(size_t cid) const;
+
+protected:
+    /**
+     * @brief Precomputed statistics of the features of a class
+     */
+    struct ClassStats {
+        double card;       ///< sum of the features
+        double sqnorm;     ///< squared L2 norm of the features
+        double normsqnorm; ///< squared L2 norm of the features divided by their sum
+    };
+
 private:
     std::vector<Features> class_feats;
+    std::vector<ClassStats> class_stats;
     std::vector<std::string> class_names;
     std::unordered_map<std::string, size_t> reverse_class_names;
 
     virtual double computeDistance(const Features& f1, const Features& f2) const = 0;
 
+    virtual double computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const = 0;
+
 };
 
 
@@ -143,6 +246,8 @@ public:
 private:
     double computeDistance(const Features& f1, const Features& f2) const override;
 
+    double computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const override;
+
 };
 
 
@@ -159,6 +264,8 @@ public:
 private:
     double computeDistance(const Features& f1, const Features& f2) const override;
 
+    double computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const override;
+
 };
 
 
@@ -175,6 +282,206 @@ public:
 private:
     double computeDistance(const Features& f1, const Features& f2) const override;
 
+    double computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const override;
+
+};
+
+
+/**
+ * @brief k-nearest neighbours classifier
+ * 
+ * Differently from Classifier, which keeps a single prototype per class, this classifier
+ * stores all the training features and assigns new features to the most frequent
+ * class among the k closest training samples.
+ * 
+ * Training features are stored as rows of a contiguous matrix, transformed according
+ * to the metric so that the search can always be performed with the L2 distance:
+ *  - Standard: features are stored as they are (same as StandardClassifier)
+ *  - Normalized: features are divided by their sum (same as NormalizedClassifier)
+ *  - Bhattacharyya: the square root of the normalized features is stored,
+ *    the L2 distance between these is monotonic with the Bhattacharyya distance
+ *    (same ranking as BhattacharyyaClassifier)
+ * 
+ * Nearest neighbours are found with a vantage-point tree, that must be built with #build
+ * after all samples have been added and before classification.
+ */
+class KNNClassifier : public interfaces::Streamable, public interfaces::MemoryReporting {
+
+public:
+
+    /**
+     * @brief Metric used to compare features
+     */
+    enum Metric {
+        Standard,
+        Normalized,
+        Bhattacharyya
+    };
+
+    /**
+     * @brief Construct a new KNNClassifier object
+     * 
+     * This constructor is provided only to load a classifier from a stream.
+     */
+    KNNClassifier();
+
+    /**
+     * @brief Construct a new KNNClassifier object
+     * 
+     * The constructed classifier will only work with class indexes.
+     * 
+     * @param n_classes the number of classes for the classification task
+     * @param k number of neighbours
+     * @param metric metric used to compare features
+     */
+    explicit KNNClassifier(size_t n_classes, size_t k = 1, Metric metric = Standard);
+
+    /**
+     * @brief Construct a new KNNClassifier object
+     * 
+     * The constructed classifier will work with both class labels and indexes.
+     * 
+     * @param l_classes a list of class labels
+     * @param k number of neighbours
+     * @param metric metric used to compare features
+     */
+    explicit KNNClassifier(const std::vector<std::string>& l_classes, size_t k = 1, Metric metric = Standard);
+
+    /**
+     * @brief Add a training sample
+     * 
+     * All samples must have the same size.
+     * The index must be rebuilt with #build before classifying.
+     * 
+     * @param cid index of the class
+     * @param feats features of the sample
+     */
+    void addSample(size_t cid, const Features& feats);
+
+    /**
+     * @brief Add a training sample
+     * 
+     * All samples must have the same size.
+     * The index must be rebuilt with #build before classifying.
+     * 
+     * @param clabel label of the class
+     * @param feats features of the sample
+     */
+    void addSample(const std::string& clabel, const Features& feats);
+
+    /**
+     * @brief Build the search index over the training samples
+     */
+    void build();
+
+    /**
+     * @brief Get the number of training samples
+     * 
+     * @return number of samples
+     */
+    size_t getNumSamples() const;
+
+    /**
+     * @brief Get the size of the features of the training samples
+     * 
+     * @return size of the features, 0 if there are no samples
+     */
+    size_t getNumFeatures() const;
+
+    /**
+     * @brief Classify features
+     * 
+     * This method outputs the ID of the predicted class.
+     * 
+     * @param feats features
+     * @return index the predicted class
+     */
+    size_t classifyID(const Features& feats) const;
+
+    /**
+     * @brief Classify features
+     * 
+     * This method outputs the label of the predicted class.
+     * This method will raise an error if the classifier has not been constructed using labels.
+     * 
+     * @param feats features
+     * @return label of the predicted class
+     */
+    std::string classifyName(const Features& feats) const;
+
+    /**
+     * @brief Classify a batch of features
+     * 
+     * Queries are split among several threads.
+     * 
+     * @param feats batch of features
+     * @param threads number of threads to use (0 to use all available cores)
+     * @return indexes of the predicted classes
+     */
+    std::vector<size_t> classifyID(const std::vector<Features>& feats, unsigned int threads = 0) const;
+
+    /**
+     * @brief Classify a batch of features
+     * 
+     * Queries are split among several threads.
+     * This method will raise an error if the classifier has not been constructed using labels.
+     * 
+     * @param feats batch of features
+     * @param threads number of threads to use (0 to use all available cores)
+     * @return labels of the predicted classes
+     */
+    std::vector<std::string> classifyName(const std::vector<Features>& feats, unsigned int threads = 0) const;
+
+    /**
+     * @copydoc interfaces::Streamable::toStream
+     * 
+     * Save parameters and training samples.
+     */
+    void toStream(std::ostream& out) const override;
+
+    /**
+     * @copydoc interfaces::Streamable::fromStream
+     * 
+     * Load parameters and training samples and rebuild the index.
+     */
+    void fromStream(std::istream& in) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * Memory used by the training samples and by the index.
+     */
+    MemoryUsage memoryUsage() const override;
+
+private:
+
+    struct VPNode {
+        size_t sample;
+        double radius;
+        int left, right;
+    };
+
+    size_t n_classes = 0;
+    size_t k = 1;
+    Metric metric = Standard;
+    std::vector<std::string> class_names;
+    std::unordered_map<std::string, size_t> reverse_class_names;
+
+    size_t dims = 0;
+    std::vector<double> samples;
+    std::vector<size_t> labels;
+
+    std::vector<VPNode> tree;
+    int root = -1;
+
+    std::vector<double> transform(const Features& feats) const;
+
+    double sampleDistance(size_t i, const double* query) const;
+
+    int buildTree(std::vector<size_t>& items, size_t lo, size_t hi);
+
+    void searchTree(int node, const double* query, std::vector<std::pair<double, size_t>>& heap) const;
+
 };
 
 }
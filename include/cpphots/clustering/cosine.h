@@ -8,6 +8,9 @@
 #include "../types.h"
 #include "../interfaces/clustering.h"
 #include "utils.h"
+#include "distance.h"
+
+#include <string>
 
 
 namespace cpphots {
@@ -16,29 +19,35 @@ namespace cpphots {
  * @brief HOTS basic clusterer
  * 
  * Clusters time surface according to the HOTS formulation (cosine rule).
+ * 
+ * Surfaces are assigned to the closest centroid according to a distance policy (see distance.h),
+ * while the online update of the centroids always follows the cosine rule.
+ * 
+ * @tparam Distance distance policy
  */
-class CosineClusterer : public interfaces::Clonable<CosineClusterer, interfaces::Clusterer>, public ClustererHistogramMixin, public ClustererOnlineMixin {
+template <typename Distance>
+class BasicCosineClusterer : public interfaces::Clonable<BasicCosineClusterer<Distance>, interfaces::Clusterer>, public ClustererHistogramMixin, public ClustererOnlineMixin {
 
 public:
 
     /**
-     * @brief Construct a new CosineClusterer
+     * @brief Construct a new BasicCosineClusterer
      * 
      * This constructor should never be used to create a new object,
      * it is provided only to create containers with Clusterer instances
      * or to read parameters from a file.
      */
-    CosineClusterer();
+    BasicCosineClusterer();
 
     /**
-     * @brief Construct a new CosineClusterer
+     * @brief Construct a new BasicCosineClusterer
      * 
      * The constructor will not seed the centroids.
      * 
      * @param clusters number of clusters
      * @param homeostasis homeostatic regulation
      */
-    CosineClusterer(uint16_t clusters, TimeSurfaceScalarType homeostasis = 0.0);
+    BasicCosineClusterer(uint16_t clusters, TimeSurfaceScalarType homeostasis = 0.0);
 
     /**
      * @copydoc interfaces::Clusterer::cluster
@@ -80,6 +89,36 @@ public:
      */
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the histogram, the centroids and their activations.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Get the metacommand used to save the clusterer
+     * 
+     * The name of the distance is appended, except for the default distance.
+     * 
+     * @return the metacommand
+     */
+    static std::string getMetacommand();
+
+    /**
+     * @brief Estimate the memory used by a cosine clusterer
+     * 
+     * @param clusters number of clusters
+     * @param wx width of the time surfaces
+     * @param wy height of the time surfaces
+     * @return estimated memory
+     */
+    static MemoryUsage estimateMemoryUsage(uint16_t clusters, uint16_t wx, uint16_t wy);
+
 private:
     std::vector<TimeSurfaceType> centroids;
     std::vector<uint32_t> centroids_activations;
@@ -90,6 +129,11 @@ private:
 
 };
 
+/**
+ * @brief HOTS basic clusterer, with the Euclidean distance
+ */
+using CosineClusterer = BasicCosineClusterer<distance::Euclidean>;
+
 }
 
 #endif
\ No newline at end of file
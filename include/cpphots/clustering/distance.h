@@ -0,0 +1,125 @@
+/**
+ * @file clustering/distance.h
+ * @brief Distance policies for clusterers and seeding functions
+ */
+#ifndef CPPHOTS_CLUSTERING_DISTANCE_H
+#define CPPHOTS_CLUSTERING_DISTANCE_H
+
+#include "../types.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Distances between time surfaces
+ *
+ * Each policy is a class with a static compute function, which is inlined in the
+ * clusterers instantiated with it, and a name used to save the clusterers.
+ *
+ * Policies also provide a static safeRadius function: given the distance between a centroid and
+ * the closest other centroid, it returns a distance from the centroid below which a surface is
+ * certainly closer to it than to any other centroid. For metrics this is half of the distance
+ * (by the triangle inequality), distances that are not metrics return 0.
+ *
+ * Clusterers and seeding functions are instantiated for all the policies defined here.
+ */
+namespace distance {
+
+/**
+ * @brief Squared Euclidean distance
+ *
+ * Gives the same ordering as the Euclidean distance without the square root.
+ */
+struct SquaredEuclidean {
+
+    static constexpr const char* name = "SQEUCLIDEAN";
+
+    static TimeSurfaceScalarType compute(const TimeSurfaceType& a, const TimeSurfaceType& b) {
+        return (a - b).matrix().squaredNorm();
+    }
+
+    static TimeSurfaceScalarType safeRadius(TimeSurfaceScalarType separation) {
+        return separation / 4;  // half of the Euclidean distance, squared
+    }
+
+};
+
+/**
+ * @brief Euclidean (L2) distance
+ */
+struct Euclidean {
+
+    static constexpr const char* name = "EUCLIDEAN";
+
+    static TimeSurfaceScalarType compute(const TimeSurfaceType& a, const TimeSurfaceType& b) {
+        return (a - b).matrix().norm();
+    }
+
+    static TimeSurfaceScalarType safeRadius(TimeSurfaceScalarType separation) {
+        return separation / 2;
+    }
+
+};
+
+/**
+ * @brief Manhattan (L1) distance
+ */
+struct Manhattan {
+
+    static constexpr const char* name = "MANHATTAN";
+
+    static TimeSurfaceScalarType compute(const TimeSurfaceType& a, const TimeSurfaceType& b) {
+        return (a - b).abs().sum();
+    }
+
+    static TimeSurfaceScalarType safeRadius(TimeSurfaceScalarType separation) {
+        return separation / 2;
+    }
+
+};
+
+/**
+ * @brief Chebyshev (L-infinity) distance
+ */
+struct Chebyshev {
+
+    static constexpr const char* name = "CHEBYSHEV";
+
+    static TimeSurfaceScalarType compute(const TimeSurfaceType& a, const TimeSurfaceType& b) {
+        return (a - b).abs().maxCoeff();
+    }
+
+    static TimeSurfaceScalarType safeRadius(TimeSurfaceScalarType separation) {
+        return separation / 2;
+    }
+
+};
+
+/**
+ * @brief Cosine distance
+ *
+ * One minus the cosine similarity, it is 1 if any of the surfaces is zero.
+ */
+struct Cosine {
+
+    static constexpr const char* name = "COSINE";
+
+    static TimeSurfaceScalarType compute(const TimeSurfaceType& a, const TimeSurfaceType& b) {
+        TimeSurfaceScalarType norms = a.matrix().norm() * b.matrix().norm();
+        if (norms == 0) {
+            return 1;
+        }
+        return 1 - (a * b).sum() / norms;
+    }
+
+    static TimeSurfaceScalarType safeRadius(TimeSurfaceScalarType) {
+        return 0;  // not a metric
+    }
+
+};
+
+}
+
+}
+
+#endif
@@ -106,6 +106,23 @@ public:
      */
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the histogram and the time surfaces stored for learning.
+     * The mixture model is not part of the state and it is saved with #toStream.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * Only the means of the mixture are taken into account for the model.
+     */
+    MemoryUsage memoryUsage() const override;
+
 private:
     GMMType type;
     std::shared_ptr<Gmm_core<TimeSurfaceScalarType>> algo;
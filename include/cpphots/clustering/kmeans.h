@@ -5,19 +5,91 @@
 #ifndef CPPHOTS_CLUSTERING_KMEANS_H
 #define CPPHOTS_CLUSTERING_KMEANS_H
 
+#include <functional>
+#include <string>
+#include <unordered_map>
+
 #include "../types.h"
 #include "../interfaces/clustering.h"
 #include "utils.h"
+#include "distance.h"
 
 namespace cpphots {
 
-class KMeansClusterer : public interfaces::Clonable<KMeansClusterer, interfaces::Clusterer>, public ClustererHistogramMixin, public ClustererOfflineMixin {
+/**
+ * @brief Statistics collected during a single k-means iteration
+ */
+struct KMeansIteration {
+
+    /**
+     * @brief index of the iteration, starting from 0
+     */
+    uint16_t iteration;
+
+    /**
+     * @brief sum of distances between the samples and their closest centroid
+     * 
+     * With the default squared Euclidean distance, this is the usual k-means inertia.
+     */
+    TimeSurfaceScalarType inertia;
+
+    /**
+     * @brief sum of squared displacements of the centroids during the iteration
+     */
+    TimeSurfaceScalarType shift;
+
+};
+
+/**
+ * @brief Signature of the callback called after every k-means iteration
+ */
+using KMeansCallbackType = std::function<void(const KMeansIteration&)>;
+
+/**
+ * @brief Counters of the label cache of a k-means clusterer
+ * 
+ * The hit rate is hits / lookups, the reduction of the work of the search can be estimated
+ * comparing distances with lookups times the number of clusters.
+ */
+struct KMeansLabelCacheStats {
+    size_t lookups = 0;      ///< surfaces clustered with the cache enabled
+    size_t hits = 0;         ///< labels returned from the cache
+    size_t rejected = 0;     ///< cached labels that failed the verification and required a full search
+    size_t misses = 0;       ///< surfaces whose key was not in the cache
+    size_t audits = 0;       ///< unverified hits checked with a full search
+    size_t audit_errors = 0; ///< audited hits whose cached label was not the closest centroid
+    size_t distances = 0;    ///< distances computed by cluster
+    size_t flushes = 0;      ///< times the cache was emptied because full
+};
+
+/**
+ * @brief K-means clusterer
+ * 
+ * Samples are assigned to the closest centroid according to a distance policy (see distance.h),
+ * centroids are updated as the mean of their samples. Only with the (squared) Euclidean distance
+ * this minimizes the inertia, the other distances can be used as cheaper approximations.
+ * 
+ * @tparam Distance distance policy
+ */
+template <typename Distance>
+class BasicKMeansClusterer : public interfaces::Clonable<BasicKMeansClusterer<Distance>, interfaces::Clusterer>, public ClustererHistogramMixin, public ClustererOfflineMixin {
 
 public:
 
-    KMeansClusterer();
+    BasicKMeansClusterer();
 
-    KMeansClusterer(uint16_t clusters, uint16_t max_iterations = 1000);
+    /**
+     * @brief Construct a new BasicKMeansClusterer
+     * 
+     * Training stops when centroids do not change anymore, after max_iterations
+     * or when the relative change of the inertia between two iterations is below tolerance.
+     * A tolerance of 0 disables the last criterion.
+     * 
+     * @param clusters number of clusters
+     * @param max_iterations maximum number of iterations
+     * @param tolerance relative tolerance on the inertia
+     */
+    BasicKMeansClusterer(uint16_t clusters, uint16_t max_iterations = 1000, TimeSurfaceScalarType tolerance = 0.0);
 
     uint16_t cluster(const TimeSurfaceType& surface) override;
 
@@ -31,8 +103,78 @@ public:
 
     bool hasCentroids() const override;
 
+    /**
+     * @copydoc interfaces::Clusterer::train
+     * 
+     * Statistics of every iteration are recorded and passed to the
+     * progress callback, if any.
+     */
     void train(const std::vector<TimeSurfaceType>& tss) override;
 
+    /**
+     * @brief Set a function to be called after every training iteration
+     * 
+     * @param callback the callback, an empty function disables it
+     */
+    void setProgressCallback(const KMeansCallbackType& callback);
+
+    /**
+     * @brief Get the statistics of the last training
+     * 
+     * @return statistics for every iteration performed
+     */
+    const std::vector<KMeansIteration>& getTelemetry() const;
+
+    /**
+     * @brief Enable the cache of labels of recurring surfaces
+     * 
+     * Surfaces are quantised to a few levels per pixel (values are expected in [0, 1]) and the hash of the quantised
+     * surface is used as key of the label found for it, so that recurring patterns, such as isolated events, are
+     * not searched again.
+     * 
+     * If verify is true, a cached label is used only if the surface is within the safe radius of its centroid
+     * (see distance.h), which guarantees that the centroid is still the closest one, otherwise a full search
+     * is performed. Labels are the same as without cache, but the verification is never satisfied with
+     * distances that are not metrics, such as the cosine distance.
+     * 
+     * If verify is false, cached labels are always used and surfaces that are quantised to the same key
+     * can be assigned to a different cluster than the closest. The error can be estimated by auditing
+     * a fraction of the hits with a full search.
+     * 
+     * The cache is emptied when the centroids change and when it reaches its capacity.
+     * It is not saved with the clusterer.
+     * 
+     * @param bits bits per pixel of the quantisation, between 1 and 8
+     * @param capacity maximum number of cached labels
+     * @param verify whether cached labels are verified
+     * @param audit_every audit one in audit_every unverified hits, 0 to disable
+     */
+    void enableLabelCache(uint8_t bits = 2, size_t capacity = 65536, bool verify = true, size_t audit_every = 0);
+
+    /**
+     * @brief Disable the cache of labels
+     */
+    void disableLabelCache();
+
+    /**
+     * @brief Check if the cache of labels is enabled
+     * 
+     * @return true if enabled
+     */
+    bool isLabelCacheEnabled() const;
+
+    /**
+     * @brief Get the counters of the cache of labels
+     * 
+     * @return the counters
+     */
+    const KMeansLabelCacheStats& getLabelCacheStats() const;
+
+    /**
+     * @brief Reset the counters of the cache of labels
+     */
+    void resetLabelCacheStats();
+
     /**
      * @copydoc interfaces::Streamable::toStream
      * 
@@ -47,12 +189,77 @@ public:
      */
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the histogram, the centroids and the time surfaces stored for learning.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Get the metacommand used to save the clusterer
+     * 
+     * The name of the distance is appended, except for the default distance.
+     * 
+     * @return the metacommand
+     */
+    static std::string getMetacommand();
+
+    /**
+     * @brief Estimate the memory used by a k-means clusterer
+     * 
+     * @param clusters number of clusters
+     * @param wx width of the time surfaces
+     * @param wy height of the time surfaces
+     * @param training_surfaces number of time surfaces stored while learning
+     * @return estimated memory
+     */
+    static MemoryUsage estimateMemoryUsage(uint16_t clusters, uint16_t wx, uint16_t wy, size_t training_surfaces = 0);
+
 private:
+    uint16_t clusterCached(const TimeSurfaceType& surface);
+
+    uint64_t cacheKey(const TimeSurfaceType& surface) const;
+
+    void invalidateLabelCache();
+
     std::vector<TimeSurfaceType> centroids;
     uint16_t clusters, max_iterations;
+    TimeSurfaceScalarType tolerance;
+    KMeansCallbackType callback;
+    std::vector<KMeansIteration> telemetry;
+
+    bool cache_enabled = false;
+    uint8_t cache_bits = 2;
+    size_t cache_capacity = 0;
+    bool cache_verify = true;
+    size_t cache_audit_every = 0;
+    std::unordered_map<uint64_t, uint16_t> cache;
+    std::vector<TimeSurfaceScalarType> safe_radius;
+    KMeansLabelCacheStats cache_stats;
 
 };
 
+/**
+ * @brief K-means clusterer with the Euclidean distance
+ * 
+ * The squared distance is used, which gives the same clustering without the square root.
+ */
+using KMeansClusterer = BasicKMeansClusterer<distance::SquaredEuclidean>;
+
+/**
+ * @brief Set the progress callback of a k-means clusterer of any distance
+ * 
+ * @param clusterer the clusterer
+ * @param callback the callback, an empty function disables it
+ * @return false if the clusterer is not a k-means clusterer
+ */
+bool setKMeansProgressCallback(interfaces::Clusterer& clusterer, const KMeansCallbackType& callback);
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,236 @@
+/**
+ * @file clustering/tiled.h
+ * @brief Clustering with a separate dictionary for each region of the field of view
+ */
+#ifndef CPPHOTS_CLUSTERING_TILED_H
+#define CPPHOTS_CLUSTERING_TILED_H
+
+#include "../types.h"
+#include "../interfaces/clustering.h"
+
+#include <vector>
+
+
+namespace cpphots {
+
+/**
+ * @brief Clusterer with a separate clusterer for each tile of the field of view
+ *
+ * The field of view is divided in a grid of tiles and every surface is clustered
+ * only by the clusterer of the tile containing the event that generated it.
+ * With fixed cameras patterns depend on the position, so small dictionaries
+ * in each tile can replace a large dictionary for the whole field of view, and
+ * each event is compared only with the centroids of its tile.
+ *
+ * The clusterers of the tiles are copies of a prototype, such as a KMeansClusterer or a CosineClusterer.
+ * Cluster IDs are global: the IDs of the clusters of each tile follow those of the previous tile,
+ * in row-major order, so the total number of clusters is the number of tiles
+ * times the number of clusters of the prototype.
+ *
+ * Surfaces must be clustered together with their position, with the overloads of cluster and train
+ * that take positions, as done by Layer. The overloads without positions raise an exception.
+ *
+ * Centroids added with addCentroid fill the tiles in order, so seeding functions applied to the
+ * whole clusterer seed every tile with surfaces taken from the whole field of view.
+ * Training with positions then fits each tile on its surfaces only, and tiles are trained in parallel.
+ */
+class TiledClusterer : public interfaces::Clonable<TiledClusterer, interfaces::Clusterer> {
+
+public:
+
+    /**
+     * @brief Construct a new TiledClusterer
+     *
+     * This constructor should never be used to create a new object,
+     * it is provided only to create containers with Clusterer instances
+     * or to read parameters from a file.
+     */
+    TiledClusterer();
+
+    /**
+     * @brief Construct a new TiledClusterer
+     *
+     * @param width width of the field of view
+     * @param height height of the field of view
+     * @param tiles_x number of tiles along the horizontal axis
+     * @param tiles_y number of tiles along the vertical axis
+     * @param prototype clusterer copied in every tile, including its centroids if any
+     * @param threads number of threads used for training, 0 for the number of cores
+     */
+    TiledClusterer(uint16_t width, uint16_t height, uint16_t tiles_x, uint16_t tiles_y, const interfaces::Clusterer& prototype, unsigned int threads = 0);
+
+    /**
+     * @brief Copy constructor
+     *
+     * @param other clusterer to copy
+     */
+    TiledClusterer(const TiledClusterer& other);
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other clusterer to move
+     */
+    TiledClusterer(TiledClusterer&& other);
+
+    /**
+     * @brief Copy assignment
+     *
+     * @param other clusterer to copy
+     * @return reference to this
+     */
+    TiledClusterer& operator=(const TiledClusterer& other);
+
+    /**
+     * @brief Move assignment
+     *
+     * @param other clusterer to move
+     * @return reference to this
+     */
+    TiledClusterer& operator=(TiledClusterer&& other);
+
+    /**
+     * @brief Destroy the TiledClusterer object
+     */
+    ~TiledClusterer();
+
+    /**
+     * @brief Not available, surfaces must be clustered with their position
+     *
+     * @param surface the timesurface to cluster
+     * @return never returns
+     */
+    uint16_t cluster(const TimeSurfaceType& surface) override;
+
+    /**
+     * @copydoc interfaces::Clusterer::cluster(const TimeSurfaceType&, uint16_t, uint16_t)
+     *
+     * The surface is clustered by the clusterer of the tile containing the position.
+     */
+    uint16_t cluster(const TimeSurfaceType& surface, uint16_t x, uint16_t y) override;
+
+    uint16_t getNumClusters() const override;
+
+    /**
+     * @copydoc interfaces::Clusterer::addCentroid
+     *
+     * The centroid is added to the first tile that does not have all its centroids.
+     */
+    void addCentroid(const TimeSurfaceType& centroid) override;
+
+    /**
+     * @copydoc interfaces::Clusterer::getCentroids
+     *
+     * Centroids of all the tiles, in the order of the global cluster IDs.
+     */
+    const std::vector<TimeSurfaceType>& getCentroids() const override;
+
+    void clearCentroids() override;
+
+    bool hasCentroids() const override;
+
+    bool isOnline() const override;
+
+    bool toggleLearning(bool enable = true) override;
+
+    /**
+     * @brief Not available, surfaces must be trained with their position
+     *
+     * @param tss set of time surfaces
+     */
+    void train(const std::vector<TimeSurfaceType>& tss) override;
+
+    /**
+     * @copydoc interfaces::Clusterer::train(const std::vector<TimeSurfaceType>&, const std::vector<std::pair<uint16_t, uint16_t>>&)
+     *
+     * Every tile is trained on the surfaces in its region, in parallel. Tiles without surfaces are left unchanged.
+     */
+    void train(const std::vector<TimeSurfaceType>& tss, const std::vector<std::pair<uint16_t, uint16_t>>& positions) override;
+
+    std::vector<uint32_t> getHistogram() const override;
+
+    SparseHistogram getSparseHistogram() const override;
+
+    void reset() override;
+
+    /**
+     * @copydoc interfaces::Streamable::toStream
+     *
+     * Insert the grid and the clusterers of all the tiles on the stream.
+     */
+    void toStream(std::ostream& out) const override;
+
+    /**
+     * @copydoc interfaces::Streamable::fromStream
+     *
+     * Reads the grid and the clusterers of all the tiles from the stream.
+     */
+    void fromStream(std::istream& in) override;
+
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Get the number of tiles
+     *
+     * @return number of tiles
+     */
+    size_t getNumTiles() const;
+
+    /**
+     * @brief Get the tile containing a position
+     *
+     * @param x horizontal coordinate
+     * @param y vertical coordinate
+     * @return index of the tile, in row-major order
+     */
+    size_t getTile(uint16_t x, uint16_t y) const;
+
+    /**
+     * @brief Get the clusterer of a tile
+     *
+     * @param tile index of the tile
+     * @return the clusterer
+     */
+    interfaces::Clusterer& getTileClusterer(size_t tile);
+
+    /**
+     * @brief Get the clusterer of a tile
+     *
+     * @param tile index of the tile
+     * @return the clusterer
+     */
+    const interfaces::Clusterer& getTileClusterer(size_t tile) const;
+
+    /**
+     * @brief Get the global ID of the first cluster of a tile
+     *
+     * @param tile index of the tile
+     * @return the ID
+     */
+    uint16_t getTileOffset(size_t tile) const;
+
+private:
+
+    void delete_tiles();
+
+    void updateOffsets();
+
+    uint16_t width;
+    uint16_t height;
+    uint16_t tiles_x;
+    uint16_t tiles_y;
+    unsigned int threads;
+
+    std::vector<interfaces::Clusterer*> tiles;
+    std::vector<uint16_t> offsets;
+    mutable std::vector<TimeSurfaceType> centroids;
+
+};
+
+}
+
+#endif
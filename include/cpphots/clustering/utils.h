@@ -7,6 +7,7 @@
 
 #include "../types.h"
 #include "../interfaces/clustering.h"
+#include "distance.h"
 
 
 namespace cpphots {
@@ -20,8 +21,31 @@ public:
 
     std::vector<uint32_t> getHistogram() const override;
 
+    SparseHistogram getSparseHistogram() const override;
+
+    /**
+     * @copydoc interfaces::Clusterer::reset
+     * 
+     * Only the bins activated since the last reset are cleared.
+     */
     void reset() override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the histogram of activations.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * Memory used by the histogram of activations.
+     */
+    MemoryUsage memoryUsage() const override;
+
 protected:
     /**
      * @brief Updated the histogram of activations
@@ -35,6 +59,7 @@ protected:
 private:
 
     std::vector<uint32_t> hist;
+    std::vector<uint16_t> active_bins;
 
 };
 
@@ -84,7 +109,8 @@ public:
      * @copydoc interfaces::Clusterer::toggleLearning
      * 
      * If learning is enabled start to store time surfaces.
-     * If learning is disabled call train with stored time surfaces.
+     * If learning is disabled call train with stored time surfaces,
+     * only if learning was enabled before, so that disabling it again does not train on an empty set.
      */
     bool toggleLearning(bool enable = true) override;
 
@@ -97,6 +123,33 @@ protected:
      */
     bool isLearning() const;
 
+    /**
+     * @brief Save the learning state and the stored time surfaces
+     * 
+     * This function should be called by subclasses in their saveState implementation.
+     * 
+     * @param state buffer
+     */
+    void saveLearningState(interfaces::StateBuffer& state) const;
+
+    /**
+     * @brief Restore the learning state and the stored time surfaces
+     * 
+     * This function should be called by subclasses in their loadState implementation.
+     * 
+     * @param state buffer
+     */
+    void loadLearningState(interfaces::StateBuffer& state);
+
+    /**
+     * @brief Memory used by the time surfaces stored for learning
+     * 
+     * This function should be called by subclasses in their memoryUsage implementation.
+     * 
+     * @return memory report
+     */
+    MemoryUsage learningMemoryUsage() const;
+
 private:
     std::vector<TimeSurfaceType> learning_tss;
     bool learning = false;
@@ -125,6 +178,17 @@ void ClustererUniformSeeding(interfaces::Clusterer& clusterer, const std::vector
  */
 void ClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces);
 
+/**
+ * @brief k-means++ seeding with a distance policy
+ * 
+ * Time surfaces are chosen with probability proportional to their distance from the closest
+ * centroid already chosen, so with distance::SquaredEuclidean this is the standard k-means++.
+ * 
+ * @tparam Distance distance policy, one of those in distance.h
+ */
+template <typename Distance>
+void BasicClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces);
+
 /**
  * @brief AFK-MC2 clustering seeding
  * 
@@ -137,6 +201,30 @@ void ClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vecto
  */
 ClustererSeedingType ClustererAFKMC2Seeding(uint16_t chain);
 
+/**
+ * @brief AFK-MC2 clustering seeding with a fixed seed
+ * 
+ * Same as ClustererAFKMC2Seeding, but the random generator is initialized with the same seed
+ * at every call, so that the same time surfaces always produce the same centroids.
+ * 
+ * @param chain length of the Markov chain
+ * @param seed seed of the random generator
+ * @return the actual seeding function
+ */
+ClustererSeedingType ClustererAFKMC2Seeding(uint16_t chain, uint32_t seed);
+
+/**
+ * @brief AFK-MC2 clustering seeding with a distance policy
+ * 
+ * As for BasicClustererPlusPlusSeeding, distances are used in place of squared Euclidean distances.
+ * 
+ * @tparam Distance distance policy, one of those in distance.h
+ * @param chain length of the Markov chain
+ * @return the actual seeding function
+ */
+template <typename Distance>
+ClustererSeedingType BasicClustererAFKMC2Seeding(uint16_t chain);
+
 /**
  * @brief Random clustering seeding
  * 
@@ -0,0 +1,161 @@
+/**
+ * @file correlation.h
+ * @brief Experimental layer with incremental correlation maps
+ */
+#ifndef CPPHOTS_CORRELATION_H
+#define CPPHOTS_CORRELATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "layer.h"
+#include "time_surface.h"
+#include "interfaces/memory.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Layer that clusters exponential time surfaces from incremental correlation maps
+ *
+ * With an exponential decay, all the pixels of the context decay by the same factor, so the dot product
+ * between the surface of any pixel and a centroid is a common scale factor times a correlation
+ * that changes only when an event updates a pixel in the window. This layer keeps, for every polarity,
+ * a map with the correlation of the surface of each pixel with each centroid and, at every event,
+ * updates the entries affected by the new timestamp (K x Wx x Wy of them). The cluster of an event
+ * is then found from the correlations at its position, without computing the surface and the distances.
+ *
+ * The layer is built from a trained Layer with:
+ * - a TimeSurfacePool of ExponentialTimeSurface, all with the same parameters and Rx, Ry > 0;
+ * - a KMeansClusterer or CosineClusterer, with the Euclidean, squared Euclidean or cosine distance;
+ * - optionally a remapper, but no supercell.
+ *
+ * Centroids are copied when the layer is built and are never updated, as with learning disabled.
+ * The histograms of the clusterer are not updated.
+ *
+ * Correlations are stored in double precision relative to a reference time, which is moved forward
+ * when the scale factors become too large, recomputing all the maps from scratch. This bounds both
+ * the range of the values and the error accumulated by the incremental updates.
+ * Assignments can still differ from those of the original layer when two centroids are almost at the same
+ * distance from a surface, because of the different rounding.
+ *
+ * This class is experimental: it cannot be added to a Network, but it has the same process and reset
+ * methods as Layer, so it can be used with the functions in run.h. It can be moved but not copied.
+ */
+class CorrelationLayer : public interfaces::MemoryReporting {
+
+public:
+
+    /**
+     * @brief Construct a new CorrelationLayer object
+     *
+     * The layer is copied and its state is reset.
+     *
+     * @param layer a trained layer
+     */
+    explicit CorrelationLayer(const Layer& layer);
+
+    CorrelationLayer(const CorrelationLayer& other) = delete;
+
+    CorrelationLayer& operator=(const CorrelationLayer& other) = delete;
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other layer to move
+     */
+    CorrelationLayer(CorrelationLayer&& other) = default;
+
+    /**
+     * @brief Move assignment
+     *
+     * @param other layer to move
+     * @return reference to this
+     */
+    CorrelationLayer& operator=(CorrelationLayer&& other) = default;
+
+    /**
+     * @brief Process an event
+     *
+     * Same as Layer::process.
+     *
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @param p polarity of the event
+     * @param skip_check if true consider all events as valid
+     * @return the output event, or invalid_event
+     */
+    event process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip_check = false);
+
+    /**
+     * @brief Process an event
+     *
+     * Same as Layer::process.
+     *
+     * @param ev the event
+     * @param skip_check if true consider all events as valid
+     * @return the output event, or invalid_event
+     */
+    event process(const event& ev, bool skip_check = false) {
+        return process(ev.t, ev.x, ev.y, ev.p, skip_check);
+    }
+
+    /**
+     * @brief Reset the contexts and the correlation maps
+     */
+    void reset();
+
+    /**
+     * @brief Get the dot product between the current surface of a pixel and a centroid
+     *
+     * @param t time at which the surface is sampled
+     * @param x horizontal coordinate
+     * @param y vertical coordinate
+     * @param p polarity
+     * @param k centroid
+     * @return the dot product
+     */
+    double getCorrelation(uint64_t t, uint16_t x, uint16_t y, uint16_t p, uint16_t k) const;
+
+    /**
+     * @brief Get the copy of the layer used for the contexts
+     *
+     * @return the layer
+     */
+    const Layer& getLayer() const;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     *
+     * Correlation maps are reported as "correlation".
+     */
+    MemoryUsage memoryUsage() const override;
+
+private:
+
+    void rebase(uint64_t t);
+
+    Layer layer;
+    std::vector<const ExponentialTimeSurface*> surfaces;
+
+    uint16_t width, height, Rx, Ry, Wx, Wy;
+    double tau;
+    uint16_t clusters;
+    bool cosine;
+
+    // centroids as [Wy*Wx][K], for the updates of all the clusters at once
+    std::vector<double> kernels;
+    std::vector<double> norms;
+
+    // exp((t_i - t0) / tau) for every pixel of the padded contexts, and the maps as [polarity][y][x][K]
+    double t0;
+    std::vector<std::vector<double>> decayed;
+    std::vector<std::vector<double>> maps;
+
+};
+
+}
+
+#endif
@@ -8,6 +8,8 @@
 #include "clustering.h"
 #include "layer_modifiers.h"
 #include "streamable.h"
+#include "stateful.h"
+#include "memory.h"
 #include "time_surface.h"
 #include "clonable.h"
 
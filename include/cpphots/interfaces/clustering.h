@@ -7,9 +7,12 @@
 
 
 #include <vector>
+#include <utility>
 
 #include "../types.h"
 #include "streamable.h"
+#include "stateful.h"
+#include "memory.h"
 #include "clonable.h"
 
 
@@ -20,7 +23,7 @@ namespace interfaces {
 /**
  * @brief Interface for time surface clustering based on centroids
  */
-class Clusterer : public virtual Streamable, public ClonableBase<Clusterer> {
+class Clusterer : public virtual Streamable, public virtual Stateful, public virtual MemoryReporting, public ClonableBase<Clusterer> {
 
 public:
 
@@ -39,6 +42,21 @@ public:
      */
     virtual uint16_t cluster(const TimeSurfaceType& surface) = 0;
 
+    /**
+     * @brief Performs clustering of a surface generated at a position
+     * 
+     * Clusterers that depend on the position of the surfaces override this function,
+     * the default implementation ignores the position.
+     * 
+     * @param surface the timesurface to cluster
+     * @param x horizontal coordinate of the event that generated the surface
+     * @param y vertical coordinate of the event that generated the surface
+     * @return id of the cluster
+     */
+    virtual uint16_t cluster(const TimeSurfaceType& surface, uint16_t /*x*/, uint16_t /*y*/) {
+        return cluster(surface);
+    }
+
     /**
      * @brief Get the number of clusters
      * 
@@ -109,6 +127,19 @@ public:
      */
     virtual void train(const std::vector<TimeSurfaceType>& tss) = 0;
 
+    /**
+     * @brief Fit a set of time surfaces generated at known positions
+     * 
+     * Clusterers that depend on the position of the surfaces override this function,
+     * the default implementation ignores the positions.
+     * 
+     * @param tss set of time surfaces
+     * @param positions coordinates of the events that generated the surfaces
+     */
+    virtual void train(const std::vector<TimeSurfaceType>& tss, const std::vector<std::pair<uint16_t, uint16_t>>& /*positions*/) {
+        train(tss);
+    }
+
     /**
      * @brief Get the histogram of centroids activations
      * 
@@ -116,6 +147,15 @@ public:
      */
     virtual std::vector<uint32_t> getHistogram() const = 0;
 
+    /**
+     * @brief Get the histogram of centroids activations in sparse form
+     * 
+     * Only the clusters that have been activated at least once are returned.
+     * 
+     * @return the sparse histogram of activations
+     */
+    virtual SparseHistogram getSparseHistogram() const = 0;
+
     /**
      * @brief Reset the histogram of activations
      */
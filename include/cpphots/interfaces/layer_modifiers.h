@@ -7,6 +7,8 @@
 
 #include "../types.h"
 #include "streamable.h"
+#include "stateful.h"
+#include "memory.h"
 #include "clonable.h"
 
 
@@ -20,7 +22,7 @@ namespace interfaces {
  * A remapper usually changes the coordinates or the polarity of an event,
  * withoud modifying the event timestamp.
  */
-struct EventRemapper : public virtual Streamable, public ClonableBase<EventRemapper> {
+struct EventRemapper : public virtual Streamable, public virtual MemoryReporting, public ClonableBase<EventRemapper> {
 
     /**
      * @brief Destroy the EventRemapper object
@@ -47,7 +49,7 @@ struct EventRemapper : public virtual Streamable, public ClonableBase<EventRemap
  * 
  * Modifiers can also average time surfaces from the same cell.
  */
-class SuperCell : public virtual Streamable, public ClonableBase<SuperCell> {
+class SuperCell : public virtual Streamable, public virtual Stateful, public virtual MemoryReporting, public ClonableBase<SuperCell> {
 
 public:
 
@@ -0,0 +1,163 @@
+/**
+ * @file interfaces/memory.h
+ * @brief Interface for memory accounting of components
+ */
+#ifndef CPPHOTS_INTERFACES_MEMORY_H
+#define CPPHOTS_INTERFACES_MEMORY_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "../types.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Report of the memory used by a component
+ * 
+ * Memory is broken down by category (e.g., "context", "centroids", "learning").
+ * Only the dynamically allocated data is taken into account, allocator overhead
+ * and the size of the objects themselves are ignored.
+ */
+struct MemoryUsage {
+
+    /**
+     * @brief Bytes used by each category
+     */
+    std::map<std::string, size_t> categories;
+
+    /**
+     * @brief Add memory to a category
+     * 
+     * @param category name of the category
+     * @param bytes number of bytes
+     * @return this report
+     */
+    MemoryUsage& add(const std::string& category, size_t bytes);
+
+    /**
+     * @brief Merge another report into this one
+     * 
+     * @param other another report
+     * @return this report
+     */
+    MemoryUsage& operator+=(const MemoryUsage& other);
+
+    /**
+     * @brief Get the memory used by a category
+     * 
+     * @param category name of the category
+     * @return number of bytes, 0 if the category is not present
+     */
+    size_t get(const std::string& category) const;
+
+    /**
+     * @brief Get the total memory used
+     * 
+     * @return number of bytes
+     */
+    size_t total() const;
+
+};
+
+/**
+ * @brief Merge two memory reports
+ * 
+ * @param m1 first report
+ * @param m2 second report
+ * @return merged report
+ */
+MemoryUsage operator+(MemoryUsage m1, const MemoryUsage& m2);
+
+/**
+ * @brief Multiply all categories of a memory report
+ * 
+ * @param m report
+ * @param n factor
+ * @return scaled report
+ */
+MemoryUsage operator*(MemoryUsage m, size_t n);
+
+/**
+ * @brief Stream insertion operator for MemoryUsage
+ * 
+ * Insert the report as "category: bytes" lines, followed by the total.
+ * 
+ * @param out output stream
+ * @param mem memory report
+ * @return output stream
+ */
+std::ostream& operator<<(std::ostream& out, const MemoryUsage& mem);
+
+/**
+ * @brief Memory used by the data of an array
+ * 
+ * @param array the array
+ * @return number of bytes
+ */
+inline size_t arrayMemory(const TimeSurfaceType& array) {
+    return array.size() * sizeof(TimeSurfaceScalarType);
+}
+
+/**
+ * @brief Memory used by the data of an array with given size
+ * 
+ * @param rows number of rows
+ * @param cols number of columns
+ * @return number of bytes
+ */
+inline size_t arrayMemory(size_t rows, size_t cols) {
+    return rows * cols * sizeof(TimeSurfaceScalarType);
+}
+
+/**
+ * @brief Memory used by a vector of arrays, including the arrays data
+ * 
+ * @param arrays the vector of arrays
+ * @return number of bytes
+ */
+size_t arrayMemory(const std::vector<TimeSurfaceType>& arrays);
+
+/**
+ * @brief Memory used by the data of a vector
+ * 
+ * @tparam T type of the elements
+ * @param vec the vector
+ * @return number of bytes
+ */
+template <typename T>
+size_t vectorMemory(const std::vector<T>& vec) {
+    return vec.capacity() * sizeof(T);
+}
+
+namespace interfaces {
+
+/**
+ * @brief Interface for components that can report their memory usage
+ */
+class MemoryReporting {
+
+public:
+
+    /**
+     * @brief Destroy the MemoryReporting object
+     */
+    virtual ~MemoryReporting() {}
+
+    /**
+     * @brief Get the memory currently used by the component
+     * 
+     * @return memory report
+     */
+    virtual MemoryUsage memoryUsage() const = 0;
+
+};
+
+}
+
+}
+
+#endif
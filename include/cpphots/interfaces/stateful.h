@@ -0,0 +1,220 @@
+/**
+ * @file interfaces/stateful.h
+ * @brief Interface for components with a runtime state
+ */
+#ifndef CPPHOTS_INTERFACES_STATEFUL_H
+#define CPPHOTS_INTERFACES_STATEFUL_H
+
+#include <vector>
+#include <cstring>
+#include <ostream>
+#include <istream>
+#include <type_traits>
+
+#include "../types.h"
+
+
+namespace cpphots {
+
+namespace interfaces {
+
+/**
+ * @brief Binary buffer holding the runtime state of some components
+ *
+ * Data is appended with the write functions and read back in the same order
+ * with the read functions, using an internal read position.
+ *
+ * Clearing the buffer does not release its memory, so that the same buffer
+ * can be reused for repeated snapshots without allocations.
+ */
+class StateBuffer {
+
+public:
+
+    /**
+     * @brief Remove all data from the buffer
+     *
+     * Allocated memory is kept.
+     */
+    void clear();
+
+    /**
+     * @brief Move the read position to the beginning of the buffer
+     */
+    void rewind();
+
+    /**
+     * @brief Get the size of the data in the buffer
+     *
+     * @return size in bytes
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get a pointer to the data in the buffer
+     *
+     * @return pointer to the data
+     */
+    const char* data() const;
+
+    /**
+     * @brief Append raw bytes to the buffer
+     *
+     * @param src pointer to the data
+     * @param bytes number of bytes
+     */
+    void writeBytes(const void* src, size_t bytes);
+
+    /**
+     * @brief Read raw bytes from the buffer
+     *
+     * An exception is thrown if there is not enough data left.
+     *
+     * @param dst pointer to the destination
+     * @param bytes number of bytes
+     */
+    void readBytes(void* dst, size_t bytes);
+
+    /**
+     * @brief Append a value to the buffer
+     *
+     * @tparam T trivially copyable type
+     * @param value the value to append
+     */
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "StateBuffer can only write trivially copyable types");
+        writeBytes(&value, sizeof(T));
+    }
+
+    /**
+     * @brief Read a value from the buffer
+     *
+     * @tparam T trivially copyable type
+     * @return the value read
+     */
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>, "StateBuffer can only read trivially copyable types");
+        T value;
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Append a vector to the buffer
+     *
+     * @tparam T trivially copyable type
+     * @param vec the vector to append
+     */
+    template <typename T>
+    void writeVector(const std::vector<T>& vec) {
+        static_assert(std::is_trivially_copyable_v<T>, "StateBuffer can only write trivially copyable types");
+        write<uint64_t>(vec.size());
+        writeBytes(vec.data(), vec.size() * sizeof(T));
+    }
+
+    /**
+     * @brief Read a vector from the buffer
+     *
+     * @tparam T trivially copyable type
+     * @param vec the vector that will be filled
+     */
+    template <typename T>
+    void readVector(std::vector<T>& vec) {
+        static_assert(std::is_trivially_copyable_v<T>, "StateBuffer can only read trivially copyable types");
+        vec.resize(read<uint64_t>());
+        readBytes(vec.data(), vec.size() * sizeof(T));
+    }
+
+    /**
+     * @brief Append an array to the buffer
+     *
+     * Both the size and the content of the array are written.
+     *
+     * @param array the array to append
+     */
+    void writeArray(const TimeSurfaceType& array);
+
+    /**
+     * @brief Read an array from the buffer
+     *
+     * The array is resized if needed.
+     *
+     * @param array the array that will be filled
+     */
+    void readArray(TimeSurfaceType& array);
+
+    /**
+     * @brief Read an array from the buffer, checking its size
+     *
+     * An exception is thrown if the stored array does not have
+     * the same size as the one passed, which is not modified in this case.
+     *
+     * @param array the array that will be filled
+     */
+    void readArrayInPlace(TimeSurfaceType& array);
+
+    /**
+     * @brief Write the content of the buffer to a binary stream
+     *
+     * @param out output stream
+     */
+    void writeTo(std::ostream& out) const;
+
+    /**
+     * @brief Replace the content of the buffer with data from a binary stream
+     *
+     * The read position is rewound.
+     *
+     * @param in input stream
+     */
+    void readFrom(std::istream& in);
+
+private:
+    std::vector<char> buffer;
+    size_t read_pos = 0;
+
+};
+
+
+/**
+ * @brief Interface for components that have a runtime state
+ *
+ * The runtime state is what changes while processing events (e.g., time contexts, histograms),
+ * as opposed to the parameters that are saved with Streamable::toStream.
+ *
+ * The state can be restored only on a component with the same parameters as the one it was saved from.
+ */
+class Stateful {
+
+public:
+
+    /**
+     * @brief Destroy the Stateful object
+     */
+    virtual ~Stateful() {}
+
+    /**
+     * @brief Append the runtime state to a buffer
+     *
+     * @param state buffer
+     */
+    virtual void saveState(StateBuffer& state) const = 0;
+
+    /**
+     * @brief Restore the runtime state from a buffer
+     *
+     * An exception is thrown if the state is not compatible with the component.
+     *
+     * @param state buffer
+     */
+    virtual void loadState(StateBuffer& state) = 0;
+
+};
+
+}
+
+}
+
+#endif
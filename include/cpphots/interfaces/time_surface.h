@@ -11,6 +11,8 @@
 
 #include "../types.h"
 #include "streamable.h"
+#include "stateful.h"
+#include "memory.h"
 #include "clonable.h"
 
 
@@ -21,7 +23,7 @@ namespace interfaces {
 /**
  * @brief Interface for that can compute time surfaces
  */
-class TimeSurfaceCalculator : public virtual interfaces::Streamable, public ClonableBase<TimeSurfaceCalculator> {
+class TimeSurfaceCalculator : public virtual interfaces::Streamable, public virtual interfaces::Stateful, public virtual interfaces::MemoryReporting, public ClonableBase<TimeSurfaceCalculator> {
 
 public:
 
@@ -74,6 +76,34 @@ public:
      */
     virtual std::pair<TimeSurfaceType, bool> compute(const event& ev) const = 0;
 
+    /**
+     * @brief Compute the time surface for an event, only if it is valid
+     * 
+     * Same as #compute, but the surface returned for invalid events may be empty.
+     * Time surfaces that can detect invalid events cheaply should override it to skip their computation,
+     * the default implementation calls #compute.
+     * 
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @return a std::pair with the computed time surface and whether the surface is valid or not
+     */
+    virtual std::pair<TimeSurfaceType, bool> computeIfValid(uint64_t t, uint16_t x, uint16_t y) const {
+        return compute(t, x, y);
+    }
+
+    /**
+     * @brief Compute the time surface for an event, only if it is valid
+     * 
+     * Same as #compute, but the surface returned for invalid events may be empty.
+     * 
+     * @param ev the event
+     * @return a std::pair with the computed time surface and whether the surface is valid or not
+     */
+    virtual std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev) const {
+        return computeIfValid(ev.t, ev.x, ev.y);
+    }
+
     /**
      * @brief Update the time context and compute the new surface
      * 
@@ -123,6 +153,24 @@ public:
      */
     virtual TimeSurfaceType sampleContext(uint64_t t) const = 0;
 
+    /**
+     * @brief Sample and decay a block of the temporal context
+     * 
+     * Same as sampleContext(t).block(y, x, h, w), but writes into an existing buffer.
+     * The default implementation samples the whole context, time surfaces should
+     * override it to decay only the requested block.
+     * 
+     * @param t sample time
+     * @param x horizontal coordinate of the top-left corner of the block
+     * @param y vertical coordinate of the top-left corner of the block
+     * @param w width of the block
+     * @param h height of the block
+     * @param out output buffer of size h x w
+     */
+    virtual void sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const {
+        out = sampleContext(t).block(y, x, h, w);
+    }
+
     /**
      * @brief Reset the time context
      * 
@@ -170,7 +218,7 @@ namespace interfaces {
  * events with different polarities to the appropriate time surface.
  * 
  */
-class TimeSurfacePoolCalculator : public virtual interfaces::Streamable, public ClonableBase<TimeSurfacePoolCalculator> {
+class TimeSurfacePoolCalculator : public virtual interfaces::Streamable, public virtual interfaces::Stateful, public virtual interfaces::MemoryReporting, public ClonableBase<TimeSurfacePoolCalculator> {
 
 public:
 
@@ -226,6 +274,34 @@ public:
      */
     virtual std::pair<TimeSurfaceType, bool> compute(const event& ev) const = 0;
 
+    /**
+     * @brief Compute the time surface for an event, only if it is valid
+     * 
+     * Same as #compute, but the surface returned for invalid events may be empty,
+     * see TimeSurfaceCalculator::computeIfValid. The default implementation calls #compute.
+     * 
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @param p polarity of the event
+     * @return a std::pair with the computed time surface and whether the surface is valid or not
+     */
+    virtual std::pair<TimeSurfaceType, bool> computeIfValid(uint64_t t, uint16_t x, uint16_t y, uint16_t p) const {
+        return compute(t, x, y, p);
+    }
+
+    /**
+     * @brief Compute the time surface for an event, only if it is valid
+     * 
+     * Same as #compute, but the surface returned for invalid events may be empty.
+     * 
+     * @param ev the event
+     * @return a std::pair with the computed time surface and whether the surface is valid or not
+     */
+    virtual std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev) const {
+        return computeIfValid(ev.t, ev.x, ev.y, ev.p);
+    }
+
     /**
      * @brief Update the time context and compute the new surface
      * 
@@ -282,6 +282,22 @@ public:
      */
     bool canCluster() const;
 
+    /**
+     * @brief Check if the layer has an event remapper
+     * 
+     * @return true if the layer has a remapper
+     * @return false otherwise
+     */
+    bool hasRemapper() const;
+
+    /**
+     * @brief Check if the layer has a supercell modifier
+     * 
+     * @return true if the layer has a supercell
+     * @return false otherwise
+     */
+    bool hasSuperCell() const;
+
     // interfaces::TimeSurfacePoolCalculator
     void update(uint64_t t, uint16_t x, uint16_t y, uint16_t p) override {
         tspool->update(t, x, y, p);
@@ -299,6 +315,14 @@ public:
         return tspool->compute(ev);
     }
 
+    std::pair<TimeSurfaceType, bool> computeIfValid(uint64_t t, uint16_t x, uint16_t y, uint16_t p) const override {
+        return tspool->computeIfValid(t, x, y, p);
+    }
+
+    std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev) const override {
+        return tspool->computeIfValid(ev);
+    }
+
     std::pair<TimeSurfaceType, bool> updateAndCompute(uint64_t t, uint16_t x, uint16_t y, uint16_t p) override {
         return tspool->updateAndCompute(t, x, y, p);
     }
@@ -333,6 +357,11 @@ public:
         return clusterer->cluster(surface);
     }
 
+    uint16_t cluster(const TimeSurfaceType& surface, uint16_t x, uint16_t y) override {
+        cpphots_assert(clusterer != nullptr);
+        return clusterer->cluster(surface, x, y);
+    }
+
     uint16_t getNumClusters() const override {
         cpphots_assert(clusterer != nullptr);
         return clusterer->getNumClusters();
@@ -373,11 +402,21 @@ public:
         return clusterer->train(tss);
     }
 
+    void train(const std::vector<TimeSurfaceType>& tss, const std::vector<std::pair<uint16_t, uint16_t>>& positions) override {
+        cpphots_assert(clusterer != nullptr);
+        return clusterer->train(tss, positions);
+    }
+
     std::vector<uint32_t> getHistogram() const override {
         cpphots_assert(clusterer != nullptr);
         return clusterer->getHistogram();
     }
 
+    SparseHistogram getSparseHistogram() const override {
+        cpphots_assert(clusterer != nullptr);
+        return clusterer->getSparseHistogram();
+    }
+
     /**
      * @brief Reset the layer
      * 
@@ -399,6 +438,27 @@ public:
      */
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Saves the state of the pool, the clusterer and the supercell, if present.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    /**
+     * @copydoc interfaces::Stateful::loadState
+     * 
+     * The layer must have the same components as the one the state was saved from.
+     */
+    void loadState(interfaces::StateBuffer& state) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * Sums the memory used by all the components of the layer.
+     */
+    MemoryUsage memoryUsage() const override;
+
     Layer* clone() const override;
 
 private:
@@ -433,6 +493,19 @@ void layerSeedCentroids(const ClustererSeedingType& seeding, Layer& layer, const
  */
 void layerSeedCentroids(const ClustererSeedingType& seeding, Layer& layer, const std::vector<Events>& event_streams, bool valid_only = true);
 
+
+/**
+ * @brief Seed centroids from already computed time surfaces
+ * 
+ * This can be used to avoid computing the same time surfaces twice,
+ * when they are also needed for training.
+ * 
+ * @param seeding the seeding algorithm
+ * @param layer layer to be seeded
+ * @param time_surfaces the time surfaces to be used
+ */
+void layerSeedCentroids(const ClustererSeedingType& seeding, Layer& layer, const std::vector<TimeSurfaceType>& time_surfaces);
+
 }
 
 #endif
\ No newline at end of file
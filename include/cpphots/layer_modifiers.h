@@ -28,6 +28,8 @@ struct ArrayLayer : public interfaces::Clonable<ArrayLayer, interfaces::EventRem
 
     void fromStream(std::istream& in) override;
 
+    MemoryUsage memoryUsage() const override;
+
 };
 
 /**
@@ -71,6 +73,8 @@ public:
 
     void fromStream(std::istream& in) override;
 
+    MemoryUsage memoryUsage() const override;
+
 private:
     uint16_t w, h;
 
@@ -127,6 +131,17 @@ public:
 
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * This modifier has no runtime state, nothing is saved.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    MemoryUsage memoryUsage() const override;
+
 protected:
 
     /**
@@ -223,6 +238,34 @@ public:
 
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the accumulated time surfaces of all cells.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * The time surface of a cell is allocated only when the first event falls in the cell.
+     */
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Estimate the memory used by a SuperCellAverage, when all cells are active
+     * 
+     * @param width width of the context
+     * @param height height of the context
+     * @param K size of the cells
+     * @param wx width of the time surfaces
+     * @param wy height of the time surfaces
+     * @return estimated memory
+     */
+    static MemoryUsage estimateMemoryUsage(uint16_t width, uint16_t height, uint16_t K, uint16_t wx, uint16_t wy);
+
 private:
 
     struct CellMem {
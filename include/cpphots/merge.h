@@ -0,0 +1,235 @@
+/**
+ * @file merge.h
+ * @brief Time-ordered merge of several event sources
+ */
+#ifndef CPPHOTS_MERGE_H
+#define CPPHOTS_MERGE_H
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+#include "types.h"
+#include "network.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Counters of an EventMerger
+ */
+struct EventMergerStats {
+    size_t received = 0;     ///< events pushed
+    size_t emitted = 0;      ///< events emitted in order
+    size_t late = 0;         ///< events dropped because older than an event already emitted
+    size_t forced = 0;       ///< events emitted before their watermark because the buffer was full
+    size_t max_buffered = 0; ///< maximum number of events held in the buffer
+};
+
+/**
+ * @brief Merge events from several sources in timestamp order
+ *
+ * Time surfaces assume that timestamps are monotonic, while events coming from several sensors
+ * or readers are interleaved and can be slightly out of order. The merger buffers the events
+ * in a min-heap and emits them in global timestamp order.
+ *
+ * Each source is assumed to be out of order by at most a reorder window: after an event with timestamp t
+ * is received from a source, no event older than t - window is expected from it. An event is emitted when
+ * its timestamp is not newer than this watermark for all the open sources, so the added latency is
+ * the window plus the lag of the slowest source. A source that has not produced any event yet
+ * holds back all the others. Sources that do not produce events can advance
+ * their watermark with #heartbeat, or be removed from the computation with #closeSource.
+ * If the buffer reaches its capacity, the oldest events are emitted regardless of the watermark.
+ *
+ * Events older than the last emitted one cannot be placed in order anymore: they are dropped and counted as late.
+ *
+ * Sources can be tagged by offsetting their coordinates or polarities, for instance to place
+ * two cameras side by side in the same network, or to give them different input channels.
+ *
+ * The merger is not thread safe, events from different threads must be pushed under a lock.
+ */
+class EventMerger {
+
+public:
+
+    /**
+     * @brief Construct a new EventMerger object
+     *
+     * @param window maximum disorder of the events of each source, in time units
+     * @param capacity maximum number of buffered events, 0 for no limit
+     */
+    explicit EventMerger(uint64_t window, size_t capacity = 0);
+
+    /**
+     * @brief Add a source
+     *
+     * The offsets are added to the coordinates and polarity of all the events of the source.
+     *
+     * @param x_offset offset of the horizontal coordinate
+     * @param y_offset offset of the vertical coordinate
+     * @param p_offset offset of the polarity
+     * @return ID of the source
+     */
+    size_t addSource(uint16_t x_offset = 0, uint16_t y_offset = 0, uint16_t p_offset = 0);
+
+    /**
+     * @brief Get the number of sources
+     *
+     * @return number of sources, including closed ones
+     */
+    size_t getNumSources() const;
+
+    /**
+     * @brief Push an event from a source
+     *
+     * @param source ID of the source
+     * @param ev the event, with the coordinates of the source
+     * @return false if the event was dropped because late
+     */
+    bool push(size_t source, const event& ev);
+
+    /**
+     * @brief Push a sequence of events from a source
+     *
+     * @param source ID of the source
+     * @param events the events
+     * @return number of events dropped because late
+     */
+    size_t push(size_t source, const Events& events);
+
+    /**
+     * @brief Signal that a source will not produce events older than a time
+     *
+     * The watermark of the source is advanced as if an event with timestamp t had been received.
+     *
+     * @param source ID of the source
+     * @param t current time of the source
+     */
+    void heartbeat(size_t source, uint64_t t);
+
+    /**
+     * @brief Signal that a source will not produce more events
+     *
+     * Closed sources do not hold back the events of the others.
+     *
+     * @param source ID of the source
+     */
+    void closeSource(size_t source);
+
+    /**
+     * @brief Release all buffered events regardless of the watermark
+     *
+     * To be called at the end of the streams. Events pushed afterwards
+     * wait for the watermark again and are late if they are older than the last one emitted.
+     */
+    void flush();
+
+    /**
+     * @brief Get the next event in order, if it can be emitted
+     *
+     * @param ev the event, if any
+     * @return true if an event was emitted
+     */
+    bool pop(event& ev);
+
+    /**
+     * @brief Call a function on all events that can be emitted
+     *
+     * @tparam F function type
+     * @param f function called with each event, in timestamp order
+     * @param max maximum number of events
+     * @return number of events emitted
+     */
+    template <typename F>
+    size_t consume(F&& f, size_t max = std::numeric_limits<size_t>::max()) {
+
+        size_t total = 0;
+        event ev;
+        while (total < max && pop(ev)) {
+            f(ev);
+            total++;
+        }
+
+        return total;
+
+    }
+
+    /**
+     * @brief Process all events that can be emitted with a Network
+     *
+     * @param network the network
+     * @param skip_check if true consider all events as valid
+     * @param max maximum number of events
+     * @return number of events processed
+     */
+    size_t process(Network& network, bool skip_check = false, size_t max = std::numeric_limits<size_t>::max());
+
+    /**
+     * @brief Get the number of buffered events
+     *
+     * @return number of events
+     */
+    size_t getBuffered() const;
+
+    /**
+     * @brief Get the current watermark
+     *
+     * Events with timestamp up to the watermark can be emitted,
+     * the watermark is 0 while a source has not produced any event.
+     *
+     * @return the watermark
+     */
+    uint64_t getWatermark() const;
+
+    /**
+     * @brief Get the counters of the merger
+     *
+     * @return the counters
+     */
+    EventMergerStats getStats() const;
+
+    /**
+     * @brief Get the number of late events of a source
+     *
+     * @param source ID of the source
+     * @return number of events dropped
+     */
+    size_t getLateEvents(size_t source) const;
+
+private:
+
+    struct Source {
+        uint16_t x_offset;
+        uint16_t y_offset;
+        uint16_t p_offset;
+        uint64_t latest = 0;
+        bool started = false;
+        bool closed = false;
+        size_t late = 0;
+    };
+
+    struct Entry {
+        event ev;
+        uint64_t seq;
+    };
+
+    void updateWatermark();
+
+    uint64_t window;
+    size_t capacity;
+    std::vector<Source> sources;
+    std::vector<Entry> heap;
+    uint64_t seq = 0;
+    uint64_t watermark = 0;
+    bool blocked = true;
+    uint64_t release_until = 0;
+    bool released = false;
+    bool emitted_any = false;
+    uint64_t last_emitted = 0;
+    EventMergerStats stats;
+
+};
+
+}
+
+#endif
@@ -16,10 +16,14 @@
 #include "types.h"
 #include "layer.h"
 #include "interfaces/streamable.h"
+#include "interfaces/stateful.h"
+#include "interfaces/memory.h"
 
 
 namespace cpphots {
 
+class ExecutionPlan;
+
 /**
  * @brief A multi-layered HOTS network
  * 
@@ -27,7 +31,7 @@ namespace cpphots {
  * 
  * A Network owns no layers, only references to them.
  */
-class Network : public interfaces::Streamable {
+class Network : public interfaces::Streamable, public interfaces::Stateful, public interfaces::MemoryReporting {
 
 public:
 
@@ -152,6 +156,16 @@ public:
      */
     Network getSubnetwork(int start, int stop = 0) const;
 
+    /**
+     * @brief Compile the network for inference
+     * 
+     * See ExecutionPlan for the details.
+     * 
+     * @param sample events used to choose the fastest kernels of each layer
+     * @return a plan that processes events as this network, with learning disabled
+     */
+    ExecutionPlan compile(const Events& sample = Events()) const;
+
     /**
      * @brief Reset the network
      * 
@@ -173,6 +187,28 @@ public:
      */
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the state of all layers.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    /**
+     * @copydoc interfaces::Stateful::loadState
+     * 
+     * The network must have the same structure and parameters as the one the state was saved from,
+     * e.g. loaded with #fromStream.
+     */
+    void loadState(interfaces::StateBuffer& state) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * Sums the memory used by all layers.
+     */
+    MemoryUsage memoryUsage() const override;
+
     /**
      * @brief Iterator over layers
      */
@@ -0,0 +1,176 @@
+/**
+ * @file plan.h
+ * @brief Execution plans for trained networks
+ */
+#ifndef CPPHOTS_PLAN_H
+#define CPPHOTS_PLAN_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <utility>
+#include <ostream>
+
+#include "types.h"
+#include "network.h"
+#include "time_surface.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief A choice made when compiling an ExecutionPlan
+ */
+struct PlanDecision {
+    size_t layer;          ///< index of the layer
+    std::string stage;     ///< stage of the layer, "surface" or "clustering"
+    std::string choice;    ///< kernel chosen for the stage
+    std::vector<std::pair<std::string, double>> candidates; ///< kernels measured, with their time in nanoseconds per event
+};
+
+/**
+ * @brief A frozen copy of a trained network, specialised for fast inference
+ *
+ * When the plan is built, every layer of a copy of the network is analysed and, for each stage,
+ * the available kernels are timed on a sample of events and the fastest is chosen:
+ * - surfaces: for pools of LinearTimeSurface, surfaces can be computed in a buffer preallocated
+ *   by the plan, with a generic window size or, for the common square windows from 3x3 to 11x11,
+ *   with a window size known at compile time. Other surfaces, and layers with a supercell,
+ *   are processed by Layer::process;
+ * - clustering: k-means clusterers with a metric distance can use the label cache
+ *   (see BasicKMeansClusterer::enableLabelCache), with verification so that the output does not change.
+ *
+ * Learning is disabled in all the layers, so that the plan produces the same events as the
+ * original network after training, but the network itself is never modified.
+ * On the specialised paths no memory is allocated while processing events.
+ *
+ * The plan has the same process and reset methods as Network, so it can be used with the functions in run.h.
+ * It can be moved but not copied.
+ */
+class ExecutionPlan {
+
+public:
+
+    /**
+     * @brief Compile a network
+     *
+     * If no sample is given, random events are generated over the size of the first layer.
+     * The sample should be representative of the input, as the choices depend on the rate
+     * of valid surfaces and on the recurrence of patterns. The state of the plan is reset after compilation.
+     *
+     * @param network the network, which is copied
+     * @param sample events used to time the kernels
+     */
+    explicit ExecutionPlan(const Network& network, const Events& sample = Events());
+
+    ExecutionPlan(const ExecutionPlan& other) = delete;
+
+    ExecutionPlan& operator=(const ExecutionPlan& other) = delete;
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other plan to move
+     */
+    ExecutionPlan(ExecutionPlan&& other) = default;
+
+    /**
+     * @brief Move assignment
+     *
+     * @param other plan to move
+     * @return reference to this
+     */
+    ExecutionPlan& operator=(ExecutionPlan&& other) = default;
+
+    /**
+     * @brief Process an event
+     *
+     * Same as Network::process.
+     *
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @param p polarity of the event
+     * @param skip_check if true consider all events as valid
+     * @return the output event, or invalid_event
+     */
+    event process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip_check = false);
+
+    /**
+     * @brief Process an event
+     *
+     * Same as Network::process.
+     *
+     * @param ev the event
+     * @param skip_check if true consider all events as valid
+     * @return the output event, or invalid_event
+     */
+    event process(const event& ev, bool skip_check = false);
+
+    /**
+     * @brief Reset the state of all the layers
+     */
+    void reset();
+
+    /**
+     * @brief Get the frozen network executed by the plan
+     *
+     * @return the network
+     */
+    const Network& getNetwork() const;
+
+    /**
+     * @brief Get the choices made during compilation
+     *
+     * @return one decision per stage of every layer
+     */
+    const std::vector<PlanDecision>& getDecisions() const;
+
+private:
+
+    enum class SurfaceKernel {
+        Generic,
+        Dynamic,
+        Fixed3,
+        Fixed5,
+        Fixed7,
+        Fixed9,
+        Fixed11
+    };
+
+    struct LayerPlan {
+        SurfaceKernel kernel = SurfaceKernel::Generic;
+        std::vector<LinearTimeSurface*> surfaces;
+        interfaces::Clusterer* clusterer = nullptr;
+        interfaces::EventRemapper* remapper = nullptr;
+        TimeSurfaceType buffer;
+    };
+
+    event processLayer(size_t l, const event& ev, bool skip_check);
+
+    static bool computeSurface(SurfaceKernel kernel, const LinearTimeSurface& ts, const event& ev, TimeSurfaceType& buffer);
+
+    static std::string kernelName(SurfaceKernel kernel);
+
+    void compileSurfaces(size_t l, const Events& input);
+
+    void compileClustering(size_t l, const Events& input);
+
+    Network network;
+    std::vector<LayerPlan> layers;
+    std::vector<PlanDecision> decisions;
+
+};
+
+/**
+ * @brief Print the choices of an execution plan
+ *
+ * @param out output stream
+ * @param plan the plan
+ * @return the output stream
+ */
+std::ostream& operator<<(std::ostream& out, const ExecutionPlan& plan);
+
+}
+
+#endif
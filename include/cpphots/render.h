@@ -0,0 +1,164 @@
+/**
+ * @file render.h
+ * @brief Rendering of the temporal contexts to frames
+ */
+#ifndef CPPHOTS_RENDER_H
+#define CPPHOTS_RENDER_H
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+#include "types.h"
+#include "interfaces/time_surface.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Renders decayed frames of the temporal contexts of a pool
+ *
+ * This is equivalent to calling sampleContexts on the pool, but meant for previews rendered at a fixed rate
+ * from a live pool (or from a ContextFrame): output buffers are reused across frames, the sensor is split
+ * in square tiles that are rendered in parallel and tiles are recomputed only when needed.
+ *
+ * A tile is skipped when it was completely decayed in the previous frame and no event has updated
+ * it since then, in which case it is still completely decayed. Tiles that are still decaying are
+ * recomputed at every frame, even if no event reached them.
+ *
+ * Frames can be obtained as floating point arrays, with one frame per polarity, or as 8-bit images:
+ * one quantised gray-scale image per polarity or a single RGB image where every polarity has its own colour.
+ * 8-bit images are stored row by row.
+ *
+ * The renderer is not thread safe and, as for sampleContexts, the pool must not be updated during rendering.
+ */
+class FrameRenderer {
+
+public:
+
+    /**
+     * @brief An RGB colour
+     */
+    using Color = std::array<uint8_t, 3>;
+
+    /**
+     * @brief Construct a new FrameRenderer object
+     *
+     * @param width width of the contexts
+     * @param height height of the contexts
+     * @param polarities number of polarities
+     * @param tile_size size of the side of the tiles
+     * @param threads number of threads used for rendering, 0 for the number of cores
+     */
+    FrameRenderer(uint16_t width, uint16_t height, uint16_t polarities, uint16_t tile_size = 32, unsigned int threads = 0);
+
+    /**
+     * @brief Construct a new FrameRenderer object for a pool
+     *
+     * @param pool a pool with the same size and number of surfaces as the ones that will be rendered
+     * @param tile_size size of the side of the tiles
+     * @param threads number of threads used for rendering, 0 for the number of cores
+     */
+    explicit FrameRenderer(const interfaces::TimeSurfacePoolCalculator& pool, uint16_t tile_size = 32, unsigned int threads = 0);
+
+    /**
+     * @brief Render the decayed contexts
+     *
+     * @param pool the pool
+     * @param t sample time
+     * @return one frame per polarity, valid until the next call
+     */
+    const std::vector<TimeSurfaceType>& render(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t);
+
+    /**
+     * @brief Render the decayed contexts as 8-bit gray-scale images
+     *
+     * Values in [0, 1] are mapped to [0, 255].
+     *
+     * @param pool the pool
+     * @param t sample time
+     * @return one image per polarity, valid until the next call
+     */
+    const std::vector<std::vector<uint8_t>>& renderQuantized(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t);
+
+    /**
+     * @brief Render the decayed contexts as a single RGB image
+     *
+     * Each polarity contributes its colour, scaled by the decayed value. Contributions are summed and saturated.
+     *
+     * @param pool the pool
+     * @param t sample time
+     * @return RGB image (3 bytes per pixel), valid until the next call
+     */
+    const std::vector<uint8_t>& renderColor(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t);
+
+    /**
+     * @brief Set the colours used by #renderColor
+     *
+     * By default polarity 0 is blue, polarity 1 is red and others follow a fixed palette.
+     *
+     * @param colors one colour per polarity
+     */
+    void setColors(const std::vector<Color>& colors);
+
+    /**
+     * @brief Force the recomputation of all tiles in the next frame
+     */
+    void invalidate();
+
+    /**
+     * @brief Get the number of tiles
+     *
+     * @return number of tiles
+     */
+    size_t getNumTiles() const;
+
+    /**
+     * @brief Get the number of tiles recomputed in the last frame
+     *
+     * @return number of tiles
+     */
+    size_t getRenderedTiles() const;
+
+private:
+
+    enum class Output {
+        None,
+        Float,
+        Quantized,
+        Color
+    };
+
+    struct TileState {
+        TimeSurfaceScalarType newest;
+        bool decayed;
+    };
+
+    void renderTiles(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t, Output output);
+
+    bool renderTile(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t, size_t tile, Output output, bool force);
+
+    uint16_t width;
+    uint16_t height;
+    uint16_t polarities;
+    uint16_t tile_size;
+    uint16_t tiles_x;
+    uint16_t tiles_y;
+    unsigned int threads;
+
+    std::vector<TimeSurfaceType> frames;
+    std::vector<std::vector<uint8_t>> gray;
+    std::vector<uint8_t> rgb;
+    std::vector<Color> colors;
+
+    // indexed by tile * polarities + polarity
+    std::vector<TileState> tile_states;
+    Output last_output = Output::None;
+    uint64_t last_t = 0;
+    size_t rendered = 0;
+
+};
+
+}
+
+#endif
@@ -8,14 +8,446 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <iterator>
+#include <type_traits>
 
 #include "layer.h"
 #include "network.h"
 #include "classification.h"
+#include "clustering/kmeans.h"
 
 
 namespace cpphots {
 
+/**
+ * @brief Process a sequence of events, pushing the results to a sink
+ * 
+ * Same as #process, but the valid events emitted by the processor are passed to
+ * a callable with signature void(const event&) instead of being collected in a vector.
+ * 
+ * The events can be any range, including the lazy ranges returned by #processView.
+ * 
+ * @tparam P processor type
+ * @tparam R range of events
+ * @tparam Sink callable type
+ * @param processor the processor
+ * @param events events
+ * @param sink callable receiving the emitted events
+ * @param reset true if processor.reset() should be called
+ * @param skip_check if true consider all events as valid
+ */
+template <typename P, typename R, typename Sink>
+void processToSink(P& processor, R&& events, Sink&& sink, bool reset = true, bool skip_check = false) {
+
+    if (reset) {
+        processor.reset();
+    }
+
+    for (const auto& ev : events) {
+        auto rev = processor.process(ev, skip_check);
+        if (rev != invalid_event) {
+            sink(rev);
+        }
+    }
+
+}
+
+/**
+ * @brief Generate all possible time surfaces from a sequence of events, pushing them to a sink
+ * 
+ * Same as #generateTS, but the time surfaces are passed to a callable with
+ * signature void(const TimeSurfaceType&) instead of being collected in a vector.
+ * 
+ * @tparam TSC time surface calculator type
+ * @tparam R range of events
+ * @tparam Sink callable type
+ * @param calculator time surface calculator
+ * @param events events
+ * @param sink callable receiving the time surfaces
+ * @param reset true if calculator.reset() should be called
+ * @param skip_check if true consider all events as valid
+ */
+template <typename TSC, typename R, typename Sink>
+void generateTSToSink(TSC& calculator, R&& events, Sink&& sink, bool reset = true, bool skip_check = false) {
+
+    if (reset) {
+        calculator.reset();
+    }
+
+    for (const auto& ev : events) {
+        if (skip_check) {
+            sink(calculator.updateAndCompute(ev).first);
+        } else {
+            calculator.update(ev);
+            auto [ts, good] = calculator.computeIfValid(ev);
+            if (good) {
+                sink(ts);
+            }
+        }
+    }
+
+}
+
+/**
+ * @brief Sink that processes events and forwards the results to another sink
+ * 
+ * Can be used to chain processors in a push fashion, e.g.
+ * 
+ *     processToSink(layer1, events, makeProcessingSink(layer2, [] (const event& ev) { ... }));
+ * 
+ * @tparam P processor type
+ * @tparam Sink type of the next sink
+ */
+template <typename P, typename Sink>
+class ProcessingSink {
+
+public:
+
+    /**
+     * @brief Construct a new ProcessingSink object
+     * 
+     * @param processor the processor, which is not reset
+     * @param sink next sink
+     * @param skip_check if true consider all events as valid
+     */
+    ProcessingSink(P& processor, Sink sink, bool skip_check = false)
+        :processor(processor), sink(std::move(sink)), skip_check(skip_check) {}
+
+    /**
+     * @brief Process an event
+     * 
+     * @param ev the event
+     */
+    void operator()(const event& ev) {
+        auto rev = processor.process(ev, skip_check);
+        if (rev != invalid_event) {
+            sink(rev);
+        }
+    }
+
+private:
+    P& processor;
+    Sink sink;
+    bool skip_check;
+
+};
+
+/**
+ * @brief Create a ProcessingSink
+ * 
+ * @tparam P processor type
+ * @tparam Sink type of the next sink
+ * @param processor the processor, which is not reset
+ * @param sink next sink
+ * @param skip_check if true consider all events as valid
+ * @return the new sink
+ */
+template <typename P, typename Sink>
+ProcessingSink<P, std::decay_t<Sink>> makeProcessingSink(P& processor, Sink&& sink, bool skip_check = false) {
+    return ProcessingSink<P, std::decay_t<Sink>>(processor, std::forward<Sink>(sink), skip_check);
+}
+
+
+namespace detail {
+
+template <typename R>
+using RangeIterator = decltype(std::begin(std::declval<R&>()));
+
+}
+
+/**
+ * @brief Lazy range of the events emitted by a processor
+ * 
+ * Events are pulled from the input range and processed only when the range is iterated,
+ * so no intermediate vector is created and the input range can be unbounded.
+ * The input range can itself be a ProcessView, to chain several processors.
+ * 
+ * This is a single-pass range: #begin should be called only once and the view
+ * must not be moved while it is being iterated. Use #processView to create it.
+ * 
+ * @tparam P processor type
+ * @tparam R range of events, a reference type if the range is not owned by the view
+ */
+template <typename P, typename R>
+class ProcessView {
+
+public:
+
+    /**
+     * @brief Input iterator over the emitted events
+     */
+    class iterator {
+
+    public:
+
+        using iterator_category = std::input_iterator_tag;
+        using value_type = event;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const event*;
+        using reference = const event&;
+
+        iterator() {}
+
+        explicit iterator(ProcessView* view)
+            :view(view), it(std::begin(view->range)) {
+            advance();
+        }
+
+        reference operator*() const {
+            return current;
+        }
+
+        pointer operator->() const {
+            return &current;
+        }
+
+        iterator& operator++() {
+            advance();
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator tmp = *this;
+            advance();
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const {
+            return view == other.view;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return view != other.view;
+        }
+
+    private:
+
+        // a null view marks the end of the range
+        void advance() {
+            auto last = std::end(view->range);
+            while (it != last) {
+                current = view->processor.process(*it, view->skip_check);
+                ++it;
+                if (current != invalid_event) {
+                    return;
+                }
+            }
+            view = nullptr;
+        }
+
+        ProcessView* view = nullptr;
+        detail::RangeIterator<R> it;
+        event current = invalid_event;
+
+    };
+
+    /**
+     * @brief Construct a new ProcessView object
+     * 
+     * @param processor the processor
+     * @param range input events
+     * @param reset true if processor.reset() should be called when the iteration starts
+     * @param skip_check if true consider all events as valid
+     */
+    ProcessView(P& processor, R range, bool reset, bool skip_check)
+        :processor(processor), range(std::forward<R>(range)), reset(reset), skip_check(skip_check) {}
+
+    /**
+     * @brief Start the iteration
+     * 
+     * @return iterator to the first emitted event
+     */
+    iterator begin() {
+        if (reset) {
+            processor.reset();
+        }
+        return iterator(this);
+    }
+
+    /**
+     * @brief End of the iteration
+     * 
+     * @return end iterator
+     */
+    iterator end() {
+        return iterator();
+    }
+
+private:
+    P& processor;
+    R range;
+    bool reset;
+    bool skip_check;
+
+};
+
+/**
+ * @brief Create a lazy range of the events emitted by a processor
+ * 
+ * Lvalue ranges are referenced, rvalue ranges (e.g., another view) are moved into the view.
+ * 
+ *     for (const auto& ev : processView(layer2, processView(layer1, events))) { ... }
+ * 
+ * @tparam P processor type
+ * @tparam R range of events
+ * @param processor the processor
+ * @param events input events
+ * @param reset true if processor.reset() should be called when the iteration starts
+ * @param skip_check if true consider all events as valid
+ * @return the lazy range
+ */
+template <typename P, typename R>
+ProcessView<P, R> processView(P& processor, R&& events, bool reset = true, bool skip_check = false) {
+    return ProcessView<P, R>(processor, std::forward<R>(events), reset, skip_check);
+}
+
+/**
+ * @brief Lazy range of the time surfaces computed from a sequence of events
+ * 
+ * The lazy counterpart of #generateTS, with the same single-pass restrictions of ProcessView.
+ * Use #generateTSView to create it.
+ * 
+ * @tparam TSC time surface calculator type
+ * @tparam R range of events, a reference type if the range is not owned by the view
+ */
+template <typename TSC, typename R>
+class TimeSurfaceView {
+
+public:
+
+    /**
+     * @brief Input iterator over the time surfaces
+     */
+    class iterator {
+
+    public:
+
+        using iterator_category = std::input_iterator_tag;
+        using value_type = TimeSurfaceType;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const TimeSurfaceType*;
+        using reference = const TimeSurfaceType&;
+
+        iterator() {}
+
+        explicit iterator(TimeSurfaceView* view)
+            :view(view), it(std::begin(view->range)) {
+            advance();
+        }
+
+        reference operator*() const {
+            return current;
+        }
+
+        pointer operator->() const {
+            return &current;
+        }
+
+        iterator& operator++() {
+            advance();
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator tmp = *this;
+            advance();
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const {
+            return view == other.view;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return view != other.view;
+        }
+
+    private:
+
+        void advance() {
+            auto last = std::end(view->range);
+            while (it != last) {
+                std::pair<TimeSurfaceType, bool> ts_good;
+                if (view->skip_check) {
+                    ts_good = view->calculator.updateAndCompute(*it);
+                } else {
+                    view->calculator.update(*it);
+                    ts_good = view->calculator.computeIfValid(*it);
+                }
+                ++it;
+                if (ts_good.second || view->skip_check) {
+                    current = std::move(ts_good.first);
+                    return;
+                }
+            }
+            view = nullptr;
+        }
+
+        TimeSurfaceView* view = nullptr;
+        detail::RangeIterator<R> it;
+        TimeSurfaceType current;
+
+    };
+
+    /**
+     * @brief Construct a new TimeSurfaceView object
+     * 
+     * @param calculator time surface calculator
+     * @param range input events
+     * @param reset true if calculator.reset() should be called when the iteration starts
+     * @param skip_check if true consider all events as valid
+     */
+    TimeSurfaceView(TSC& calculator, R range, bool reset, bool skip_check)
+        :calculator(calculator), range(std::forward<R>(range)), reset(reset), skip_check(skip_check) {}
+
+    /**
+     * @brief Start the iteration
+     * 
+     * @return iterator to the first time surface
+     */
+    iterator begin() {
+        if (reset) {
+            calculator.reset();
+        }
+        return iterator(this);
+    }
+
+    /**
+     * @brief End of the iteration
+     * 
+     * @return end iterator
+     */
+    iterator end() {
+        return iterator();
+    }
+
+private:
+    TSC& calculator;
+    R range;
+    bool reset;
+    bool skip_check;
+
+};
+
+/**
+ * @brief Create a lazy range of the time surfaces computed from a sequence of events
+ * 
+ * Lvalue ranges are referenced, rvalue ranges (e.g., a ProcessView) are moved into the view.
+ * 
+ * @tparam TSC time surface calculator type
+ * @tparam R range of events
+ * @param calculator time surface calculator
+ * @param events input events
+ * @param reset true if calculator.reset() should be called when the iteration starts
+ * @param skip_check if true consider all events as valid
+ * @return the lazy range
+ */
+template <typename TSC, typename R>
+TimeSurfaceView<TSC, R> generateTSView(TSC& calculator, R&& events, bool reset = true, bool skip_check = false) {
+    return TimeSurfaceView<TSC, R>(calculator, std::forward<R>(events), reset, skip_check);
+}
+
+
 /**
  * @brief Generic event processing function
  * 
@@ -38,16 +470,8 @@ namespace cpphots {
 template<typename P>
 Events process(P& processor, const Events& events, bool reset = true, bool skip_check = false) {
 
-    if (reset) {
-        processor.reset();
-    }
-
     Events ret;
-    for (const auto& ev : events) {
-        auto rev = processor.process(ev, skip_check);
-        if (rev != invalid_event)
-            ret.push_back(rev);
-    }
+    processToSink(processor, events, [&ret] (const event& ev) { ret.push_back(ev); }, reset, skip_check);
 
     return ret;
 
@@ -95,6 +519,8 @@ std::vector<Events> process(P& processor, const std::vector<Events>& events, boo
  * 
  *   - void reset()
  *   - std::pair<TimeSurfaceType, bool> updateAndCompute(const event& ev)
+ *   - void update(const event& ev)
+ *   - std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev)
  * 
  * TimeSurfaceCalculator, TimeSurfacePoolCalculator and Layer satisfy the requirements.
  * 
@@ -108,18 +534,8 @@ std::vector<Events> process(P& processor, const std::vector<Events>& events, boo
 template <typename TSC>
 std::vector<TimeSurfaceType> generateTS(TSC& calculator, const Events& events, bool reset = true, bool skip_check = false) {
 
-    if (reset) {
-        calculator.reset();
-    }
-
     std::vector<TimeSurfaceType> ret;
-
-    for (const auto& ev : events) {
-        auto [ts, good] = calculator.updateAndCompute(ev);
-        if (good || skip_check) {
-            ret.push_back(ts);
-        }
-    }
+    generateTSToSink(calculator, events, [&ret] (const TimeSurfaceType& ts) { ret.push_back(ts); }, reset, skip_check);
 
     return ret;
 
@@ -134,6 +550,8 @@ std::vector<TimeSurfaceType> generateTS(TSC& calculator, const Events& events, b
  * 
  *   - void reset()
  *   - std::pair<TimeSurfaceType, bool> updateAndCompute(const event& ev)
+ *   - void update(const event& ev)
+ *   - std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev)
  * 
  * TimeSurfaceCalculator, TimeSurfacePoolCalculator and Layer satisfy the requirements.
  * 
@@ -158,19 +576,30 @@ std::vector<std::vector<TimeSurfaceType>> generateTS(TSC& calculator, const std:
 }
 
 
+/**
+ * @brief Signature of the callback used to monitor k-means training in a network
+ * 
+ * The callback receives the index of the layer being trained and the statistics of the last iteration.
+ */
+using KMeansNetworkCallbackType = std::function<void(size_t, const KMeansIteration&)>;
+
 /**
  * @brief Seed and train layers in a network
  * 
  * This function seeds the centroids of each layer and then train the layer with the events,
  * in a layer-by-layer sequence.
  * 
+ * For offline clusterers, time surfaces for each layer are computed only once
+ * and shared between seeding and training.
+ * 
  * @param network the newtork
  * @param training_events events
  * @param seeding a clustering seeding function
  * @param skip_check if true consider all events as valid
+ * @param progress optional callback called after every k-means iteration of every KMeansClusterer layer
  * @return events generated by the last layer of the network
  */
-Events train(Network& network, Events training_events, const ClustererSeedingType& seeding, bool skip_check = false);
+Events train(Network& network, Events training_events, const ClustererSeedingType& seeding, bool skip_check = false, const KMeansNetworkCallbackType& progress = nullptr);
 
 /**
  * @brief Seed and train layers in a network
@@ -178,14 +607,71 @@ Events train(Network& network, Events training_events, const ClustererSeedingTyp
  * This function seeds the centroids of each layer and then train the layer with the events,
  * in a layer-by-layer sequence.
  * 
+ * For offline clusterers, time surfaces for each layer are computed only once
+ * and shared between seeding and training.
+ * 
  * @param network the newtork
  * @param training_events sequences of events
  * @param seeding a clustering seeding function
  * @param use_all if true use all sequence to seed the centroids (all sequences will used for training regardless)
  * @param skip_check if true consider all events as valid
+ * @param progress optional callback called after every k-means iteration of every KMeansClusterer layer
  * @return events generated by the last layer of the network
  */
-std::vector<Events> train(Network& network, std::vector<Events> training_events, const ClustererSeedingType& seeding, bool use_all = true, bool skip_check = false);
+std::vector<Events> train(Network& network, std::vector<Events> training_events, const ClustererSeedingType& seeding, bool use_all = true, bool skip_check = false, const KMeansNetworkCallbackType& progress = nullptr);
+
+
+/**
+ * @brief Stopping criterion for #classifyAnytime
+ * 
+ * The confidence of the classification is measured by the relative margin between
+ * the distances of the best and second best classes, (d2 - d1) / d2, which is 0 when
+ * the two classes are tied and 1 when the features match the best class exactly.
+ */
+struct AnytimeCriterion {
+    double margin = 0.2;      ///< minimum relative margin to stop processing
+    size_t min_events = 0;    ///< minimum number of input events processed before stopping
+    size_t check_every = 100; ///< number of input events between two evaluations of the classifier
+    size_t stable_checks = 3; ///< number of consecutive evaluations with the same class above the margin required to stop
+};
+
+/**
+ * @brief Result of #classifyAnytime
+ */
+struct AnytimeResult {
+    size_t class_id = 0;         ///< index of the predicted class
+    double margin = 0.0;         ///< relative margin at the time of the decision
+    bool early = false;          ///< true if the decision was taken before the end of the events
+    size_t events_processed = 0; ///< number of input events processed
+    size_t events_total = 0;     ///< number of input events available
+    size_t checks = 0;           ///< number of evaluations of the classifier
+    uint64_t decision_time = 0;  ///< timestamp of the last event processed
+    uint64_t end_time = 0;       ///< timestamp of the last event available
+};
+
+/**
+ * @brief Classify a sequence of events, stopping as soon as the decision is confident
+ * 
+ * The network is reset and the events are processed one by one. Every
+ * AnytimeCriterion::check_every events, the classifier is evaluated on the sparse
+ * histogram of the last layer and processing stops when the relative margin between the
+ * two best classes has been above AnytimeCriterion::margin, with the same predicted class,
+ * for AnytimeCriterion::stable_checks consecutive evaluations.
+ * The classifier is not evaluated while the last layer has not produced any event.
+ * If the criterion is never satisfied, all events are processed and the histogram
+ * at the end is classified, as in the usual flow.
+ * 
+ * The difference between AnytimeResult::end_time and AnytimeResult::decision_time
+ * is the latency saved, the events not processed are the computation saved.
+ * 
+ * @param network the network, its state after the call is the one at decision time
+ * @param events events
+ * @param classifier a trained classifier
+ * @param criterion stopping criterion
+ * @param skip_check if true consider all events as valid
+ * @return the classification and when it was taken
+ */
+AnytimeResult classifyAnytime(Network& network, const Events& events, const Classifier& classifier, const AnytimeCriterion& criterion = AnytimeCriterion(), bool skip_check = false);
 
 }
 
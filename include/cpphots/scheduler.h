@@ -0,0 +1,237 @@
+/**
+ * @file scheduler.h
+ * @brief Processing of many concurrent event streams on a pool of workers
+ */
+#ifndef CPPHOTS_SCHEDULER_H
+#define CPPHOTS_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "types.h"
+#include "network.h"
+#include "interfaces/stateful.h"
+#include "interfaces/memory.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Counters of a StreamScheduler
+ */
+struct StreamSchedulerStats {
+    size_t events = 0;       ///< events processed
+    size_t slices = 0;       ///< slices of events processed
+    size_t switches = 0;     ///< number of times a worker changed the stream loaded in its network
+    size_t compressions = 0; ///< number of states compressed
+    size_t evictions = 0;    ///< number of streams evicted
+};
+
+/**
+ * @brief Multiplexes many event streams on a fixed pool of workers
+ *
+ * Each stream has its own runtime state (time contexts, histograms, ...), while the model
+ * is shared: every worker owns a single copy of the network, with learning disabled, and loads the
+ * state of a stream into it before processing its events (see interfaces::Stateful).
+ *
+ * Streams are assigned to workers by their ID, so all the events of a stream are processed
+ * by the same worker, in the order they were submitted. Workers serve their streams in a
+ * round robin fashion, processing at most a quantum of events before moving to the next stream,
+ * so that a busy stream cannot starve the others.
+ *
+ * To bound memory, the state of streams that have been idle for a while can be compressed
+ * and streams idle for longer can be evicted, see #setIdlePolicy. An evicted stream
+ * is started again from a reset state if new events are submitted.
+ */
+class StreamScheduler : public interfaces::MemoryReporting {
+
+public:
+
+    /**
+     * @brief Identifier of a stream
+     */
+    using StreamID = uint64_t;
+
+    /**
+     * @brief Signature of the callback called after each slice of events is processed
+     *
+     * The callback receives the stream ID, the valid events emitted by the network for the slice,
+     * whether the slice completed a submitted batch and the network with the state of the stream loaded.
+     * It is called from the worker threads, concurrently for streams on different workers.
+     */
+    using Callback = std::function<void(StreamID, const Events&, bool, const Network&)>;
+
+    /**
+     * @brief Construct a new StreamScheduler object
+     *
+     * Workers are started immediately.
+     *
+     * @param network the network used for all streams, it is copied once for every worker
+     * @param callback function called after each slice of events, can be null
+     * @param workers number of worker threads, 0 for the number of cores
+     * @param quantum maximum number of events processed for a stream before moving to the next one
+     * @param skip_check if true consider all events as valid
+     */
+    StreamScheduler(const Network& network, Callback callback = nullptr, unsigned int workers = 0, size_t quantum = 4096, bool skip_check = false);
+
+    /**
+     * @brief Destroy the StreamScheduler object
+     *
+     * All submitted events are processed before stopping the workers.
+     */
+    ~StreamScheduler();
+
+    StreamScheduler(const StreamScheduler&) = delete;
+    StreamScheduler& operator=(const StreamScheduler&) = delete;
+
+    /**
+     * @brief Set the policy for idle streams
+     *
+     * The state of a stream that has not received events for compress_after is compressed,
+     * a stream that has not received events for evict_after is removed with its state.
+     * Zero disables the corresponding action.
+     *
+     * @param compress_after idle time before compression
+     * @param evict_after idle time before eviction
+     */
+    void setIdlePolicy(std::chrono::milliseconds compress_after, std::chrono::milliseconds evict_after);
+
+    /**
+     * @brief Submit a batch of events for a stream
+     *
+     * New streams are created on their first batch. This function can be called from any thread,
+     * batches of the same stream are processed in the order they are submitted.
+     *
+     * @param stream ID of the stream
+     * @param events the events
+     */
+    void submit(StreamID stream, Events events);
+
+    /**
+     * @brief Remove a stream and its state
+     *
+     * The stream is removed after its pending events have been processed.
+     *
+     * @param stream ID of the stream
+     */
+    void closeStream(StreamID stream);
+
+    /**
+     * @brief Wait until all submitted events have been processed
+     */
+    void flush();
+
+    /**
+     * @brief Get the number of streams known to the scheduler
+     *
+     * @return number of streams, including compressed ones
+     */
+    size_t getNumStreams() const;
+
+    /**
+     * @brief Get the number of workers
+     *
+     * @return number of workers
+     */
+    unsigned int getNumWorkers() const;
+
+    /**
+     * @brief Get the counters of the scheduler
+     *
+     * @return the counters
+     */
+    StreamSchedulerStats getStats() const;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     *
+     * Reports the networks of the workers, plus "streams" for the states of the streams,
+     * "compressed" for compressed states and "queues" for pending events.
+     */
+    MemoryUsage memoryUsage() const override;
+
+private:
+
+    enum class Residency {
+        Empty,
+        Loaded,
+        Resident,
+        Compressed
+    };
+
+    struct Stream {
+        std::deque<Events> pending;
+        size_t offset = 0;
+        bool scheduled = false;
+        bool closed = false;
+        std::chrono::steady_clock::time_point last_active;
+
+        // only accessed by the worker
+        Residency residency = Residency::Empty;
+        interfaces::StateBuffer state;
+        std::vector<uint32_t> compressed;
+        size_t state_size = 0;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::unordered_map<StreamID, Stream> streams;
+        std::deque<StreamID> ready;
+        bool stopping = false;
+
+        // only accessed by the worker
+        Network network;
+        Stream* loaded = nullptr;
+        interfaces::StateBuffer scratch;
+        Events output;
+
+        std::atomic<size_t> state_bytes{0};
+        std::atomic<size_t> compressed_bytes{0};
+
+        std::thread thread;
+    };
+
+    void run(Worker& worker);
+
+    void load(Worker& worker, Stream& stream);
+
+    void unload(Worker& worker);
+
+    void maintain(Worker& worker, std::chrono::steady_clock::time_point now);
+
+    Worker& workerFor(StreamID stream);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    Callback callback;
+    size_t quantum;
+    bool skip_check;
+    MemoryUsage model_memory;
+
+    std::atomic<int64_t> compress_after{0};
+    std::atomic<int64_t> evict_after{0};
+
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+    size_t outstanding = 0;
+
+    std::atomic<size_t> n_events{0};
+    std::atomic<size_t> n_slices{0};
+    std::atomic<size_t> n_switches{0};
+    std::atomic<size_t> n_compressions{0};
+    std::atomic<size_t> n_evictions{0};
+
+};
+
+}
+
+#endif
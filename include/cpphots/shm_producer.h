@@ -0,0 +1,86 @@
+/**
+ * @file shm_producer.h
+ * @brief C interface for producing events into a shared-memory ring buffer
+ *
+ * This header can be included from C and C++ code (e.g., a camera driver running in a separate process).
+ * Events written with this interface are read by cpphots::ShmEventConsumer.
+ *
+ * The ring buffer supports a single producer and a single consumer.
+ * Available only on Linux.
+ */
+#ifndef CPPHOTS_SHM_PRODUCER_H
+#define CPPHOTS_SHM_PRODUCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Event, with the same layout as cpphots::event
+ */
+typedef struct __attribute__((__packed__)) cpphots_event {
+    uint64_t t;
+    uint16_t x;
+    uint16_t y;
+    uint16_t p;
+} cpphots_event;
+
+/**
+ * @brief Opaque handle to the producer side of a ring buffer
+ */
+typedef struct cpphots_shm_producer cpphots_shm_producer;
+
+/**
+ * @brief Create a shared-memory ring buffer and open it for writing
+ *
+ * An existing segment with the same name is replaced.
+ *
+ * @param name name of the shared-memory segment (e.g., "/cpphots_camera")
+ * @param capacity minimum number of events in the buffer, rounded up to a power of two
+ * @return the producer handle, NULL on error (errno is set)
+ */
+cpphots_shm_producer* cpphots_shm_producer_create(const char* name, uint64_t capacity);
+
+/**
+ * @brief Write events to the ring buffer
+ *
+ * Events are made visible to the consumer in batches, as soon as they are written.
+ * If the buffer is full, the function waits for the consumer to free some space.
+ *
+ * @param producer the producer handle
+ * @param events array of events
+ * @param n number of events
+ * @param timeout_ms maximum time to wait for free space, 0 to never wait, negative to wait indefinitely
+ * @return number of events written, less than n only on timeout
+ */
+size_t cpphots_shm_producer_push(cpphots_shm_producer* producer, const cpphots_event* events, size_t n, int timeout_ms);
+
+/**
+ * @brief Close the producer
+ *
+ * The consumer is notified that no more events will be written and the handle is freed.
+ * The shared-memory segment is not removed, see cpphots_shm_unlink.
+ *
+ * @param producer the producer handle
+ */
+void cpphots_shm_producer_close(cpphots_shm_producer* producer);
+
+/**
+ * @brief Remove a shared-memory segment
+ *
+ * Processes that have the segment open can continue using it.
+ *
+ * @param name name of the shared-memory segment
+ * @return 0 on success, -1 on error (errno is set)
+ */
+int cpphots_shm_unlink(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * @file shm_ring.h
+ * @brief Consumer of events from a shared-memory ring buffer
+ *
+ * Events are written by another process with the C interface in shm_producer.h.
+ * Available only on Linux.
+ */
+#ifndef CPPHOTS_SHM_RING_H
+#define CPPHOTS_SHM_RING_H
+
+#include <cstdint>
+#include <string>
+#include <limits>
+#include <utility>
+
+#include "types.h"
+#include "network.h"
+#include "shm_producer.h"
+
+
+namespace cpphots {
+
+namespace detail {
+struct ShmRingHeader;
+}
+
+/**
+ * @brief Consumer side of a shared-memory ring buffer of events
+ *
+ * Events are accessed directly in shared memory, without copies:
+ * #acquire returns a contiguous range of events, which is given back to the producer with #release.
+ *
+ * When the buffer is empty, #wait sleeps on a futex until the producer writes new events.
+ */
+class ShmEventConsumer {
+
+public:
+
+    /**
+     * @brief Open an existing ring buffer
+     *
+     * The buffer must have been created with cpphots_shm_producer_create.
+     * An exception is thrown if the buffer cannot be opened or it is not compatible.
+     *
+     * @param name name of the shared-memory segment
+     */
+    explicit ShmEventConsumer(const std::string& name);
+
+    /**
+     * @brief Close the ring buffer
+     */
+    ~ShmEventConsumer();
+
+    ShmEventConsumer(const ShmEventConsumer&) = delete;
+    ShmEventConsumer& operator=(const ShmEventConsumer&) = delete;
+
+    /**
+     * @brief Get the events available for reading
+     *
+     * The returned range is contiguous, so it may not contain all available events
+     * if they wrap around the end of the buffer.
+     * The events stay valid until they are released.
+     *
+     * @param max maximum number of events
+     * @return pointer to the first event and number of events (0 if the buffer is empty)
+     */
+    std::pair<const event*, size_t> acquire(size_t max = std::numeric_limits<size_t>::max()) const;
+
+    /**
+     * @brief Give events back to the producer
+     *
+     * @param n number of events, at most the number returned by the last #acquire
+     */
+    void release(size_t n);
+
+    /**
+     * @brief Wait until new events are available
+     *
+     * @param timeout_ms maximum time to wait, negative to wait indefinitely
+     * @return true if there are events to read
+     * @return false on timeout or if the producer has been closed and all events have been read
+     */
+    bool wait(int timeout_ms = -1);
+
+    /**
+     * @brief Check if the producer has been closed and all events have been read
+     *
+     * @return true if no more events will be available
+     * @return false otherwise
+     */
+    bool isFinished() const;
+
+    /**
+     * @brief Get the capacity of the buffer
+     *
+     * @return number of events
+     */
+    uint64_t getCapacity() const;
+
+    /**
+     * @brief Call a function on all available events, then release them
+     *
+     * Events are passed by reference from shared memory.
+     *
+     * @tparam F function type
+     * @param f function called with each event
+     * @param max maximum number of events
+     * @return number of events consumed
+     */
+    template <typename F>
+    size_t consume(F&& f, size_t max = std::numeric_limits<size_t>::max()) {
+
+        size_t total = 0;
+
+        while (total < max) {
+            auto [evs, n] = acquire(max - total);
+            if (n == 0) {
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                f(evs[i]);
+            }
+            release(n);
+            total += n;
+        }
+
+        return total;
+
+    }
+
+    /**
+     * @brief Process all available events with a Network, then release them
+     *
+     * @param network the network
+     * @param skip_check if true consider all events as valid
+     * @param max maximum number of events
+     * @return number of events processed
+     */
+    size_t process(Network& network, bool skip_check = false, size_t max = std::numeric_limits<size_t>::max());
+
+private:
+    int fd = -1;
+    size_t map_size = 0;
+    detail::ShmRingHeader* header = nullptr;
+    event* ring = nullptr;
+    uint64_t tail = 0;
+
+};
+
+}
+
+#endif
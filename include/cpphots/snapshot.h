@@ -0,0 +1,198 @@
+/**
+ * @file snapshot.h
+ * @brief Periodic snapshots of the runtime state of components
+ */
+#ifndef CPPHOTS_SNAPSHOT_H
+#define CPPHOTS_SNAPSHOT_H
+
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+#include "interfaces/stateful.h"
+#include "interfaces/time_surface.h"
+
+
+namespace cpphots {
+
+/**
+ * @brief Double buffered snapshots of a runtime state
+ * 
+ * The processing thread captures the state of a component (e.g., a Network) into a private
+ * back buffer, which is then swapped with the published one. Other threads can read or
+ * restore the latest published snapshot at any time.
+ * 
+ * Capturing never waits for readers: if the published snapshot is being read,
+ * the new one is simply not published and #capture returns false.
+ * Buffers are reused, so after the first captures no memory is allocated.
+ */
+class SnapshotBuffer {
+
+public:
+
+    /**
+     * @brief Capture and publish the state of a component
+     * 
+     * This function should always be called from the same thread, which must be
+     * the one modifying the component.
+     * 
+     * @param component the component
+     * @return true if the snapshot was published
+     * @return false if a reader was holding the published snapshot
+     */
+    bool capture(const interfaces::Stateful& component);
+
+    /**
+     * @brief Copy the latest published snapshot
+     * 
+     * @param state buffer that will contain the snapshot
+     * @return generation of the snapshot, 0 if nothing has been published yet
+     */
+    uint64_t latest(interfaces::StateBuffer& state) const;
+
+    /**
+     * @brief Restore the latest published snapshot into a component
+     * 
+     * @param component the component, with the same parameters as the captured one
+     * @return generation of the snapshot restored, 0 if nothing has been published yet
+     */
+    uint64_t restore(interfaces::Stateful& component);
+
+    /**
+     * @brief Get the generation of the latest published snapshot
+     * 
+     * Generations start from 1 and increase with every published snapshot.
+     * 
+     * @return generation, 0 if nothing has been published yet
+     */
+    uint64_t getGeneration() const;
+
+private:
+    interfaces::StateBuffer back, front;
+    uint64_t generation = 0;
+    mutable std::mutex mutex;
+
+};
+
+
+/**
+ * @brief Published copy of the temporal contexts of a pool
+ */
+struct ContextFrame {
+
+    /**
+     * @brief Private copy of the pool
+     * 
+     * Surfaces, contexts and sampling (e.g., sampleContexts) can be used as in the original pool.
+     */
+    std::unique_ptr<interfaces::TimeSurfacePoolCalculator> pool;
+
+    /**
+     * @brief Time of the publication
+     */
+    uint64_t t = 0;
+
+    /**
+     * @brief Generation of the frame, 0 if nothing has been published yet
+     */
+    uint64_t generation = 0;
+
+};
+
+/**
+ * @brief Lock-free publication of the temporal contexts of a pool to another thread
+ * 
+ * The processing thread periodically copies the contexts of a pool into a private frame
+ * and publishes it, while a reader thread (e.g., a monitoring UI) can access the latest published
+ * frame at any time.
+ * 
+ * Frames are triple buffered, so neither the writer nor the reader ever waits: publishing a frame
+ * costs a copy of the contexts and an atomic exchange, acquiring a frame costs an atomic exchange.
+ * Every frame is a consistent copy of all contexts at the time of publication.
+ * No memory is allocated after construction.
+ * 
+ * The publisher supports a single writer and a single reader thread.
+ */
+class ContextPublisher {
+
+public:
+
+    /**
+     * @brief Construct a new ContextPublisher
+     * 
+     * The pool is cloned to create the frames, so it must have the same parameters
+     * as the pools that will be published.
+     * 
+     * @param pool the pool to be published
+     * @param period minimum time between two publications with #publishIfDue
+     */
+    explicit ContextPublisher(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t period = 0);
+
+    ContextPublisher(const ContextPublisher&) = delete;
+    ContextPublisher& operator=(const ContextPublisher&) = delete;
+
+    /**
+     * @brief Publish the contexts of a pool
+     * 
+     * This function should always be called from the same thread, which must be
+     * the one updating the pool.
+     * 
+     * @param pool the pool
+     * @param t current time
+     */
+    void publish(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t);
+
+    /**
+     * @brief Publish the contexts of a pool if enough time has passed since the last publication
+     * 
+     * This function can be called after every event, only one every `period`
+     * time units will actually be copied.
+     * 
+     * @param pool the pool
+     * @param t current time
+     * @return true if the contexts have been published
+     * @return false otherwise
+     */
+    bool publishIfDue(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t);
+
+    /**
+     * @brief Check if a new frame has been published since the last #acquire
+     * 
+     * @return true if a new frame is available
+     * @return false otherwise
+     */
+    bool hasNew() const;
+
+    /**
+     * @brief Get the latest published frame
+     * 
+     * The frame stays valid and unmodified until the next call to acquire.
+     * This function should always be called from the same thread.
+     * 
+     * @return the latest frame
+     */
+    const ContextFrame& acquire();
+
+private:
+    static constexpr uint8_t FRESH = 0x4;
+    static constexpr uint8_t INDEX = 0x3;
+
+    ContextFrame frames[3];
+    std::atomic<uint8_t> middle{1};
+
+    // writer side
+    uint8_t back = 0;
+    interfaces::StateBuffer scratch;
+    uint64_t period;
+    uint64_t last_t = 0;
+    uint64_t generation = 0;
+
+    // reader side
+    uint8_t front = 2;
+
+};
+
+}
+
+#endif
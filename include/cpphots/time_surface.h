@@ -8,6 +8,8 @@
 #include <ostream>
 #include <istream>
 #include <memory>
+#include <vector>
+#include <deque>
 
 #include "assert.h"
 #include "types.h"
@@ -68,9 +70,13 @@ public:
         return compute(ev.t, ev.x, ev.y);
     }
 
-    const TimeSurfaceType& getFullContext() const override {
-        return context;
-    }
+    /**
+     * @copydoc interfaces::TimeSurfaceCalculator::getFullContext
+     * 
+     * With the sparse storage, the full context is built at the first call after an update
+     * and released at the next update, it requires as much memory as the dense storage.
+     */
+    const TimeSurfaceType& getFullContext() const override;
 
     TimeSurfaceType getContext() const override;
 
@@ -86,17 +92,156 @@ public:
         return Wy;
     }
 
+    /**
+     * @brief Get the horizontal radius of the window
+     * 
+     * @return the horizontal radius, 0 if the full width is used
+     */
+    uint16_t getRx() const {
+        return Rx;
+    }
+
+    /**
+     * @brief Get the vertical radius of the window
+     * 
+     * @return the vertical radius, 0 if the full height is used
+     */
+    uint16_t getRy() const {
+        return Ry;
+    }
+
+    /**
+     * @brief Get the time constant
+     * 
+     * @return the time constant
+     */
+    TimeSurfaceScalarType getTau() const {
+        return tau;
+    }
+
     /**
      * @copydoc interfaces::Streamable::toStream
      * 
-     * Does not save the current time context.
+     * Does not save the current time context, see #saveState.
      */
     void toStream(std::ostream& out) const override;
 
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the current time context.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Estimate the memory used by a time surface
+     * 
+     * Parameters are the same as the constructor.
+     * The counters of #activityBound are included, the queue of the active updates is not:
+     * it holds one entry per update in the last tau and it grows with the event rate.
+     * 
+     * @param width width of the full time context
+     * @param height height of the full time context
+     * @param Rx horizontal radius of the window
+     * @param Ry vertical radius of the window
+     * @param tau time constant of the surface
+     * @return estimated memory
+     */
+    static MemoryUsage estimateMemoryUsage(uint16_t width, uint16_t height, uint16_t Rx, uint16_t Ry, TimeSurfaceScalarType tau = 0);
+
+    /**
+     * @brief Upper bound of the number of active pixels in the window of an event
+     * 
+     * A pixel is active if its decayed value with a linear decay is positive at the time of the last update.
+     * The context is divided in blocks of the size of the window and the updates of each block
+     * are counted while they are active, expiring them in order, so that the bound is the number of
+     * active updates in the (at most four) blocks overlapping the window and it is computed in constant time.
+     * 
+     * Updates are counted only after the first call, which rebuilds the counters from the context,
+     * so surfaces that never check validity do not pay for them. The first call modifies the surface
+     * and it must not run concurrently with other calls on the same surface.
+     * 
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @return upper bound of the active pixels
+     */
+    size_t activityBound(uint16_t x, uint16_t y) const;
+
+    /**
+     * @brief Switch between the dense and the sparse storage of the time context
+     * 
+     * The dense storage keeps the whole padded context in memory. The sparse storage divides it in pages
+     * of 8x8 pixels that are allocated at their first update, pixels in missing pages have never been
+     * updated, so memory grows with the area reached by the events rather than with the size of the context,
+     * apart from a table of 4 bytes per page. This is meant for layers with many polarities or very wide
+     * contexts, such as those after a SerializingLayer, at the cost of slower updates and surfaces.
+     * 
+     * The current context is preserved. The storage is not saved with the surface.
+     * 
+     * @param enable true for the sparse storage, false for the dense one
+     */
+    void setSparseContext(bool enable = true);
+
+    /**
+     * @brief Check if the time context uses the sparse storage
+     * 
+     * @return true if sparse
+     */
+    bool isSparseContext() const;
+
+    /**
+     * @brief Get the time of the last update of a pixel
+     * 
+     * Same as reading the full context, without building it with the sparse storage.
+     * 
+     * @param x horizontal coordinate
+     * @param y vertical coordinate
+     * @return time of the last update, -tau if never updated
+     */
+    TimeSurfaceScalarType getLastUpdate(uint16_t x, uint16_t y) const;
+
 protected:
 
+    /**
+     * @brief Copy a block of the padded time context, with any storage
+     * 
+     * @param py first row of the padded context
+     * @param px first column of the padded context
+     * @param h number of rows
+     * @param w number of columns
+     * @return the block
+     */
+    TimeSurfaceType contextBlock(uint16_t py, uint16_t px, uint16_t h, uint16_t w) const;
+
+    /**
+     * @brief Copy a block of the padded time context, with the sparse storage
+     * 
+     * @param py first row of the padded context
+     * @param px first column of the padded context
+     * @param out array of the size of the block
+     */
+    template <typename Derived>
+    void gatherContext(uint16_t py, uint16_t px, Eigen::DenseBase<Derived>& out) const {
+        for (Eigen::Index c = 0; c < out.cols(); c++) {
+            for (Eigen::Index r = 0; r < out.rows(); r++) {
+                out(r, c) = sparseValue(py + r, px + c);
+            }
+        }
+    }
+
+    /**
+     * @brief Whether the time context uses the sparse storage
+     * 
+     * With the sparse storage, #context is empty.
+     */
+    bool sparse = false;
+
     /**
      * @brief Time context
      */
@@ -142,6 +287,48 @@ protected:
      */
     uint16_t min_events;
 
+private:
+
+    void resetActivity() const;
+
+    void rebuildActivity() const;
+
+    void expireActivity(uint64_t t) const;
+
+    TimeSurfaceScalarType sparseValue(size_t py, size_t px) const {
+        uint32_t page = page_table[(py >> PAGE_SHIFT) * pages_x + (px >> PAGE_SHIFT)];
+        if (page == 0) {
+            return -tau;
+        }
+        return pages[(size_t(page - 1) << (2 * PAGE_SHIFT)) + ((py & (PAGE_SIDE - 1)) << PAGE_SHIFT) + (px & (PAGE_SIDE - 1))];
+    }
+
+    void setSparseValue(size_t py, size_t px, TimeSurfaceScalarType value);
+
+    void resetSparse();
+
+    void scatterContext(const TimeSurfaceType& dense);
+
+    static constexpr size_t PAGE_SHIFT = 3;
+    static constexpr size_t PAGE_SIDE = 1 << PAGE_SHIFT;
+
+    // index + 1 of the page of each block of the padded context, 0 if not allocated
+    size_t pages_x = 0;
+    std::vector<uint32_t> page_table;
+    std::vector<TimeSurfaceScalarType> pages;
+
+    // full context built from the pages
+    mutable TimeSurfaceType full_context;
+    mutable bool full_context_valid = false;
+
+    // active updates per block, counted after the first call to activityBound
+    mutable bool track_activity = false;
+    mutable uint16_t cell_w = 1;
+    mutable uint16_t cell_h = 1;
+    mutable uint16_t cells_x = 0;
+    mutable std::vector<uint32_t> activity;
+    mutable std::deque<std::pair<uint64_t, uint32_t>> active_updates;
+
 };
 
 
@@ -163,8 +350,133 @@ public:
 
     std::pair<TimeSurfaceType, bool> compute(const event& ev) const override;
 
+    /**
+     * @copydoc interfaces::TimeSurfaceCalculator::computeIfValid
+     * 
+     * Events are rejected in constant time if #activityBound is below the minimum number of events.
+     */
+    std::pair<TimeSurfaceType, bool> computeIfValid(uint64_t t, uint16_t x, uint16_t y) const override;
+
+    std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev) const override;
+
+    /**
+     * @brief Check if the surface of an event could be valid
+     * 
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @return false if the surface is certainly not valid, see #activityBound
+     */
+    bool mayBeValid(uint16_t x, uint16_t y) const {
+        return activityBound(x, y) >= min_events;
+    }
+
+    /**
+     * @brief Compute the time surface for an event in a preallocated array
+     * 
+     * Same as #compute, without allocating the surface.
+     * 
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @param out array of size (Wy, Wx) where the surface is written
+     * @return whether the surface is valid or not
+     */
+    bool computeInto(uint64_t t, uint16_t x, uint16_t y, Eigen::Ref<TimeSurfaceType> out) const;
+
+    /**
+     * @brief Compute the time surface for an event in a preallocated array, with a window size known at compile time
+     * 
+     * Same as #computeInto, for square windows of side W.
+     * 
+     * @tparam W size of the window, 2R+1
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @param out array of size (W, W) where the surface is written
+     * @return whether the surface is valid or not
+     */
+    template <int W>
+    bool computeFixedInto(uint64_t t, uint16_t x, uint16_t y, Eigen::Ref<TimeSurfaceType> out) const {
+
+        cpphots_assert(Wx == W && Wy == W);
+        cpphots_assert(x < width && y < height);
+
+        if (Rx == 0)
+            x = 0;
+        if (Ry == 0)
+            y = 0;
+
+        Eigen::Array<TimeSurfaceScalarType, W, W> ret;
+        if (sparse) {
+            gatherContext(y, x, ret);
+            ret = 1. - (t - ret) / tau;
+        } else {
+            ret = 1. - (t - context.template block<W, W>(y, x)) / tau;
+        }
+        bool good = (ret > 0.).count() >= min_events;
+        out = (ret <= 0.).select(0., ret);
+
+        return good;
+
+    }
+
     TimeSurfaceType sampleContext(uint64_t t) const override;
 
+    void sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const override;
+
+    void toStream(std::ostream& out) const override;
+
+    void fromStream(std::istream& in) override;
+
+};
+
+
+/**
+ * @brief Class that can compute exponential time surfaces
+ * 
+ * This class keeps track of the time context for the current stream of events and can compute
+ * the time surface for new ones.
+ * 
+ * The time surface has an exponential decay exp(-(t - t_i) / tau), as in (Lagorce et al., 2017).
+ * Since the decay never reaches zero, a surface is valid if enough pixels of its window were
+ * updated in the last tau, the same pixels that have a positive value with a linear decay.
+ * 
+ * With this decay the whole context is scaled by the same factor as time passes,
+ * which is exploited by CorrelationLayer.
+ */
+class ExponentialTimeSurface : public interfaces::Clonable<ExponentialTimeSurface, TimeSurfaceBase> {
+
+public:
+
+    using Clonable::Clonable;
+
+    std::pair<TimeSurfaceType, bool> compute(uint64_t t, uint16_t x, uint16_t y) const override;
+
+    std::pair<TimeSurfaceType, bool> compute(const event& ev) const override;
+
+    /**
+     * @copydoc interfaces::TimeSurfaceCalculator::computeIfValid
+     * 
+     * Events are rejected without computing the surface if it is not valid.
+     */
+    std::pair<TimeSurfaceType, bool> computeIfValid(uint64_t t, uint16_t x, uint16_t y) const override;
+
+    std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev) const override;
+
+    /**
+     * @brief Check if the surface of an event is valid, without computing it
+     * 
+     * @param t time of the event
+     * @param x horizontal coordinate of the event
+     * @param y vertical coordinate of the event
+     * @return whether the surface is valid or not
+     */
+    bool isValid(uint64_t t, uint16_t x, uint16_t y) const;
+
+    TimeSurfaceType sampleContext(uint64_t t) const override;
+
+    void sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const override;
+
     void toStream(std::ostream& out) const override;
 
     void fromStream(std::istream& in) override;
@@ -220,10 +532,29 @@ public:
      */
     TimeSurfaceType sampleContext(uint64_t t) const override;
 
+    void sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const override;
+
     void toStream(std::ostream& out) const override;
 
     void fromStream(std::istream& in) override;
 
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Estimate the memory used by a weighted time surface
+     * 
+     * Parameters are the same as the constructor.
+     * 
+     * @param width width of the full time context
+     * @param height height of the full time context
+     * @param Rx horizontal radius of the window
+     * @param Ry vertical radius of the window
+     * @param tau time constant of the surface
+     * @param weightmatrix matrix used to weight the time surfaces
+     * @return estimated memory
+     */
+    static MemoryUsage estimateMemoryUsage(uint16_t width, uint16_t height, uint16_t Rx, uint16_t Ry, TimeSurfaceScalarType tau, const TimeSurfaceType& weightmatrix);
+
 private:
 
     TimeSurfaceType weights;
@@ -356,6 +687,15 @@ public:
         return compute(ev.t, ev.x, ev.y, ev.p);
     }
 
+    std::pair<TimeSurfaceType, bool> computeIfValid(uint64_t t, uint16_t x, uint16_t y, uint16_t p) const override {
+        cpphots_assert(p < surfaces.size());
+        return surfaces[p]->computeIfValid(t, x, y);
+    }
+
+    std::pair<TimeSurfaceType, bool> computeIfValid(const event& ev) const override {
+        return computeIfValid(ev.t, ev.x, ev.y, ev.p);
+    }
+
     std::pair<TimeSurfaceType, bool> updateAndCompute(uint64_t t, uint16_t x, uint16_t y, uint16_t p) override {
         update(t, x, y, p);
         return compute(t, x, y, p);
@@ -412,6 +752,47 @@ public:
      */
     void fromStream(std::istream& in) override;
 
+    /**
+     * @copydoc interfaces::Stateful::saveState
+     * 
+     * Save the time contexts of all time surfaces.
+     */
+    void saveState(interfaces::StateBuffer& state) const override;
+
+    void loadState(interfaces::StateBuffer& state) override;
+
+    /**
+     * @copydoc interfaces::MemoryReporting::memoryUsage
+     * 
+     * Sum of the memory used by all time surfaces.
+     */
+    MemoryUsage memoryUsage() const override;
+
+    /**
+     * @brief Estimate the memory used by a time surface pool
+     * 
+     * Parameters are the same as TimeSurfacePool::create.
+     * 
+     * @tparam TS time surface type
+     * @tparam TSArgs types of the time surface constructor arguments
+     * @param polarities numer of polarities (size of the pool)
+     * @param tsargs arguments of the time surface constructor
+     * @return estimated memory
+     */
+    template <typename TS, typename... TSArgs>
+    static MemoryUsage estimateMemoryUsage(uint16_t polarities, TSArgs... tsargs) {
+        return TS::estimateMemoryUsage(std::forward<TSArgs>(tsargs)...) * polarities;
+    }
+
+    /**
+     * @brief Switch the storage of the contexts of all time surfaces
+     * 
+     * See TimeSurfaceBase::setSparseContext.
+     * 
+     * @param enable true for the sparse storage, false for the dense one
+     */
+    void setSparseContexts(bool enable = true);
+
 private:
     std::vector<TimeSurfacePtr> surfaces;
 
@@ -0,0 +1,144 @@
+/**
+ * @file trace.h
+ * @brief Optional tracing of processing spans
+ *
+ * When the library is built with tracing support (ENABLE_TRACING cmake option, which
+ * defines CPPHOTS_TRACING), the main processing stages record spans in per-thread
+ * ring buffers. Spans can then be exported in the Chrome trace-event JSON format and
+ * inspected with chrome://tracing or Perfetto.
+ *
+ * Without tracing support the tracing macros expand to nothing, the functions in this
+ * file are still available but no span is ever recorded.
+ */
+#ifndef CPPHOTS_TRACE_H
+#define CPPHOTS_TRACE_H
+
+#include <cstdint>
+#include <ostream>
+
+
+namespace cpphots {
+
+namespace trace {
+
+/**
+ * @brief Enable or disable recording of spans
+ *
+ * Recording is disabled by default.
+ *
+ * @param enable true to record spans
+ */
+void enable(bool enable = true);
+
+/**
+ * @brief Check if spans are being recorded
+ *
+ * @return true if recording is enabled
+ * @return false otherwise
+ */
+bool isEnabled();
+
+/**
+ * @brief Set the sampling rate of hot spans
+ *
+ * Only one every `every` hot spans (e.g., the processing of a single event) is recorded,
+ * together with all the spans nested inside it. Spans nested in a discarded hot span are discarded as well.
+ * Other spans are always recorded.
+ *
+ * @param every sampling period, 1 to record all spans
+ */
+void setSampling(uint32_t every);
+
+/**
+ * @brief Set the size of the per-thread ring buffers
+ *
+ * Only buffers of threads that have not recorded anything yet are affected.
+ * When a buffer is full, the oldest spans are overwritten.
+ *
+ * The buffer of a thread that exits is kept, with its spans, and it is reused by the next thread
+ * that records a span, if it has the same size. Hence the number of buffers is bounded by the number
+ * of threads recording at the same time, rather than by the number of threads ever created.
+ * Buffers that are not in use are released by #clear.
+ *
+ * @param spans number of spans in each buffer
+ */
+void setBufferSize(size_t spans);
+
+/**
+ * @brief Discard all the recorded spans
+ *
+ * Buffers of threads that have exited are released as well.
+ */
+void clear();
+
+/**
+ * @brief Write recorded spans in the Chrome trace-event JSON format
+ *
+ * This function can be called while other threads are recording,
+ * spans that are overwritten while being read are skipped.
+ *
+ * @param out output stream
+ */
+void dump(std::ostream& out);
+
+/**
+ * @brief Get the number of spans currently stored in all buffers
+ *
+ * @return number of spans
+ */
+size_t getNumSpans();
+
+/**
+ * @brief Scoped span
+ *
+ * Records the time between construction and destruction under the given name.
+ * This class should be used through the CPPHOTS_TRACE_SPAN and CPPHOTS_TRACE_HOT_SPAN macros.
+ */
+class Span {
+
+public:
+
+    /**
+     * @brief Start a new span
+     *
+     * @param name name of the span, must be a string literal
+     * @param hot true if the span is subject to sampling
+     * @param arg optional argument shown with the span (negative for none)
+     */
+    Span(const char* name, bool hot = false, int64_t arg = -1);
+
+    /**
+     * @brief End the span
+     */
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* name;
+    int64_t arg;
+    uint64_t start;
+    uint8_t mode;
+    bool hot;
+
+};
+
+}
+
+}
+
+
+#ifdef CPPHOTS_TRACING
+#  define CPPHOTS_TRACE_CONCAT_IMPL(a, b) a##b
+#  define CPPHOTS_TRACE_CONCAT(a, b) CPPHOTS_TRACE_CONCAT_IMPL(a, b)
+#  define CPPHOTS_TRACE_SPAN(name) cpphots::trace::Span CPPHOTS_TRACE_CONCAT(__cpphots_span_, __COUNTER__)(name)
+#  define CPPHOTS_TRACE_SPAN_ARG(name, arg) cpphots::trace::Span CPPHOTS_TRACE_CONCAT(__cpphots_span_, __COUNTER__)(name, false, arg)
+#  define CPPHOTS_TRACE_HOT_SPAN(name) cpphots::trace::Span CPPHOTS_TRACE_CONCAT(__cpphots_span_, __COUNTER__)(name, true)
+#else
+#  define CPPHOTS_TRACE_SPAN(name) static_cast<void>(0)
+#  define CPPHOTS_TRACE_SPAN_ARG(name, arg) static_cast<void>(0)
+#  define CPPHOTS_TRACE_HOT_SPAN(name) static_cast<void>(0)
+#endif
+
+#endif
@@ -6,6 +6,7 @@
 #define CPPHOTS_TYPES_H
 
 #include <vector>
+#include <utility>
 #include <Eigen/Dense>
 
 
@@ -26,6 +27,14 @@ using TimeSurfaceType = Eigen::ArrayXXf;  // using floating point instead of uin
 using TimeSurfaceScalarType = TimeSurfaceType::Scalar;
 
 
+/**
+ * @brief Alias type for a sparse histogram
+ * 
+ * List of (bin, count) pairs, sorted by bin and containing only non-zero counts.
+ */
+using SparseHistogram = std::vector<std::pair<uint16_t, uint32_t>>;
+
+
 /**
  * @brief Structure representing an event
  * 
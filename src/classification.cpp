@@ -6,6 +6,8 @@
 #include <numeric>
 #include <iomanip>
 #include <algorithm>
+#include <thread>
+#include <exception>
 
 namespace cpphots {
 
@@ -43,9 +45,38 @@ double features_quality(const Features& feats) {
 }
 
 
+SparseFeatures toSparse(const Features& feats) {
+
+    SparseFeatures ret;
+    for (size_t i = 0; i < feats.size(); i++) {
+        if (feats[i] > 0) {
+            ret.push_back({i, feats[i]});
+        }
+    }
+
+    return ret;
+
+}
+
+Features toDense(const SparseFeatures& feats, size_t size) {
+
+    Features ret(size, 0);
+    for (const auto& [i, v] : feats) {
+        if (i >= size) {
+            throw std::invalid_argument("Sparse features do not fit in the requested size");
+        }
+        ret[i] = v;
+    }
+
+    return ret;
+
+}
+
+
 Classifier::Classifier(size_t n_classes) {
 
     class_feats.resize(n_classes);
+    class_stats.resize(n_classes);
 
 }
 
@@ -53,6 +84,7 @@ Classifier::Classifier(const std::vector<std::string>& classes)
     :class_names(classes) {
 
     class_feats.resize(classes.size());
+    class_stats.resize(classes.size());
 
     for (size_t i = 0; i < classes.size(); i++) {
         reverse_class_names.insert({classes[i], i});
@@ -61,10 +93,20 @@ Classifier::Classifier(const std::vector<std::string>& classes)
 }
 
 Classifier::Classifier(Classifier* other)
-    :class_feats(other->class_feats), class_names(other->class_names), reverse_class_names(other->reverse_class_names) {}
+    :class_feats(other->class_feats), class_stats(other->class_stats), class_names(other->class_names), reverse_class_names(other->reverse_class_names) {}
 
 void Classifier::setClassFeatures(size_t cid, const Features& feats) {
+
     class_feats[cid] = feats;
+
+    ClassStats& stats = class_stats[cid];
+    stats.card = std::accumulate(feats.begin(), feats.end(), 0.0);
+    stats.sqnorm = 0.0;
+    for (auto f : feats) {
+        stats.sqnorm += double(f) * double(f);
+    }
+    stats.normsqnorm = stats.card > 0 ? stats.sqnorm / (stats.card * stats.card) : 0.0;
+
 }
 
 void Classifier::setClassFeatures(const std::string& cname, const Features& feats) {
@@ -99,6 +141,74 @@ std::string Classifier::classifyName(const Features& feats) const {
 
 }
 
+size_t Classifier::classifyID(const SparseFeatures& feats) const {
+
+    size_t argmin = class_feats.size();
+    double mindist = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < class_feats.size(); i++) {
+        if (!feats.empty() && feats.back().first >= class_feats[i].size()) {
+            throw std::runtime_error("Features must have the same size");
+        }
+        double d = computeDistance(class_feats[i], class_stats[i], feats);
+        if (d < mindist) {
+            mindist = d;
+            argmin = i;
+        }
+    }
+
+    return argmin;
+
+}
+
+std::string Classifier::classifyName(const SparseFeatures& feats) const {
+
+    if (class_names.empty())
+        throw std::runtime_error("Cannot output class name if no names were set at construction time");
+
+    size_t cid = classifyID(feats);
+
+    return class_names[cid];
+
+}
+
+std::vector<double> Classifier::classDistances(const Features& feats) const {
+
+    std::vector<double> dists(class_feats.size());
+    for (size_t i = 0; i < class_feats.size(); i++) {
+        dists[i] = computeDistance(class_feats[i], feats);
+    }
+
+    return dists;
+
+}
+
+std::vector<double> Classifier::classDistances(const SparseFeatures& feats) const {
+
+    std::vector<double> dists(class_feats.size());
+    for (size_t i = 0; i < class_feats.size(); i++) {
+        if (!feats.empty() && feats.back().first >= class_feats[i].size()) {
+            throw std::runtime_error("Features must have the same size");
+        }
+        dists[i] = computeDistance(class_feats[i], class_stats[i], feats);
+    }
+
+    return dists;
+
+}
+
+size_t Classifier::getNumClasses() const {
+    return class_feats.size();
+}
+
+std::string Classifier::getClassName(size_t cid) const {
+
+    if (class_names.empty())
+        throw std::runtime_error("Cannot output class name if no names were set at construction time");
+
+    return class_names.at(cid);
+
+}
+
 
 double StandardClassifier::computeDistance(const Features& f1, const Features& f2) const {
 
@@ -115,6 +225,18 @@ double StandardClassifier::computeDistance(const Features& f1, const Features& f
 
 }
 
+double StandardClassifier::computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const {
+
+    // ||f1 - f2||^2 = ||f1||^2 + sum over non-zero f2 of (f2^2 - 2 f1 f2)
+    double dist = s1.sqnorm;
+    for (const auto& [i, v] : f2) {
+        dist += double(v) * (double(v) - 2.0 * double(f1[i]));
+    }
+
+    return std::sqrt(std::max(dist, 0.0));
+
+}
+
 
 double NormalizedClassifier::computeDistance(const Features& f1, const Features& f2) const {
 
@@ -134,6 +256,23 @@ double NormalizedClassifier::computeDistance(const Features& f1, const Features&
 
 }
 
+double NormalizedClassifier::computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const {
+
+    double card2 = 0.0;
+    for (const auto& p : f2) {
+        card2 += p.second;
+    }
+
+    double dist = s1.normsqnorm;
+    for (const auto& [i, v] : f2) {
+        double n2 = v / card2;
+        dist += n2 * (n2 - 2.0 * f1[i] / s1.card);
+    }
+
+    return std::sqrt(std::max(dist, 0.0));
+
+}
+
 
 double BhattacharyyaClassifier::computeDistance(const Features& f1, const Features& f2) const {
 
@@ -153,4 +292,403 @@ double BhattacharyyaClassifier::computeDistance(const Features& f1, const Featur
 
 }
 
+double BhattacharyyaClassifier::computeDistance(const Features& f1, const ClassStats& s1, const SparseFeatures& f2) const {
+
+    double card2 = 0.0;
+    for (const auto& p : f2) {
+        card2 += p.second;
+    }
+
+    // terms where f2 is zero do not contribute to the coefficient
+    double dist = 0.0;
+    for (const auto& [i, v] : f2) {
+        dist += std::sqrt(f1[i] / s1.card * v / card2);
+    }
+
+    return -std::log(dist);
+
+}
+
+
+KNNClassifier::KNNClassifier() {}
+
+KNNClassifier::KNNClassifier(size_t n_classes, size_t k, Metric metric)
+    :n_classes(n_classes), k(k), metric(metric) {
+
+    if (k == 0) {
+        throw std::invalid_argument("The number of neighbours should be > 0");
+    }
+
+}
+
+KNNClassifier::KNNClassifier(const std::vector<std::string>& classes, size_t k, Metric metric)
+    :KNNClassifier(classes.size(), k, metric) {
+
+    class_names = classes;
+
+    for (size_t i = 0; i < classes.size(); i++) {
+        reverse_class_names.insert({classes[i], i});
+    }
+
+}
+
+void KNNClassifier::addSample(size_t cid, const Features& feats) {
+
+    if (cid >= n_classes) {
+        throw std::invalid_argument("Invalid class index");
+    }
+
+    if (samples.empty()) {
+        dims = feats.size();
+    } else if (feats.size() != dims) {
+        throw std::runtime_error("Features must have the same size");
+    }
+
+    auto row = transform(feats);
+    samples.insert(samples.end(), row.begin(), row.end());
+    labels.push_back(cid);
+
+    // index is invalidated
+    tree.clear();
+    root = -1;
+
+}
+
+void KNNClassifier::addSample(const std::string& cname, const Features& feats) {
+    size_t cid = reverse_class_names.at(cname);
+    addSample(cid, feats);
+}
+
+void KNNClassifier::build() {
+
+    tree.clear();
+    tree.reserve(labels.size());
+
+    std::vector<size_t> items(labels.size());
+    std::iota(items.begin(), items.end(), 0);
+
+    root = buildTree(items, 0, items.size());
+
+}
+
+size_t KNNClassifier::getNumSamples() const {
+    return labels.size();
+}
+
+size_t KNNClassifier::getNumFeatures() const {
+    return dims;
+}
+
+size_t KNNClassifier::classifyID(const Features& feats) const {
+
+    if (root < 0) {
+        throw std::runtime_error("KNNClassifier index has not been built");
+    }
+
+    if (feats.size() != dims) {
+        throw std::runtime_error("Features must have the same size");
+    }
+
+    auto query = transform(feats);
+
+    // max-heap of the k closest samples
+    std::vector<std::pair<double, size_t>> heap;
+    heap.reserve(k + 1);
+    searchTree(root, query.data(), heap);
+
+    // majority voting, ties are broken by the closest sample
+    std::vector<size_t> votes(n_classes, 0);
+    std::vector<double> closest(n_classes, std::numeric_limits<double>::max());
+    for (const auto& [d, i] : heap) {
+        size_t c = labels[i];
+        votes[c]++;
+        closest[c] = std::min(closest[c], d);
+    }
+
+    size_t best = 0;
+    for (size_t c = 1; c < n_classes; c++) {
+        if (votes[c] > votes[best] || (votes[c] == votes[best] && closest[c] < closest[best])) {
+            best = c;
+        }
+    }
+
+    return best;
+
+}
+
+std::string KNNClassifier::classifyName(const Features& feats) const {
+
+    if (class_names.empty())
+        throw std::runtime_error("Cannot output class name if no names were set at construction time");
+
+    return class_names[classifyID(feats)];
+
+}
+
+std::vector<size_t> KNNClassifier::classifyID(const std::vector<Features>& feats, unsigned int threads) const {
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<size_t>(threads, std::max<size_t>(1, feats.size()));
+
+    std::vector<size_t> ret(feats.size());
+
+    // errors are raised in the calling thread, after all workers have finished
+    std::vector<std::exception_ptr> errors(threads);
+    auto worker = [&] (unsigned int t, size_t start, size_t stop) {
+        try {
+            for (size_t i = start; i < stop; i++) {
+                ret[i] = classifyID(feats[i]);
+            }
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    size_t chunk = (feats.size() + threads - 1) / threads;
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; t++) {
+        pool.emplace_back(worker, t, std::min(t * chunk, feats.size()), std::min((t + 1) * chunk, feats.size()));
+    }
+    worker(0, 0, std::min(chunk, feats.size()));
+
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    for (auto& err : errors) {
+        if (err) {
+            std::rethrow_exception(err);
+        }
+    }
+
+    return ret;
+
+}
+
+std::vector<std::string> KNNClassifier::classifyName(const std::vector<Features>& feats, unsigned int threads) const {
+
+    if (class_names.empty())
+        throw std::runtime_error("Cannot output class name if no names were set at construction time");
+
+    auto cids = classifyID(feats, threads);
+
+    std::vector<std::string> ret;
+    ret.reserve(cids.size());
+    for (auto cid : cids) {
+        ret.push_back(class_names[cid]);
+    }
+
+    return ret;
+
+}
+
+void KNNClassifier::toStream(std::ostream& out) const {
+
+    writeMetacommand(out, "KNNCLASSIFIER");
+
+    out << n_classes << " ";
+    out << k << " ";
+    out << metric << " ";
+    out << class_names.size() << "\n";
+    for (const auto& name : class_names) {
+        out << std::quoted(name) << "\n";
+    }
+
+    out << dims << " ";
+    out << labels.size() << "\n";
+
+    auto prec = out.precision();
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (size_t i = 0; i < labels.size(); i++) {
+        out << labels[i];
+        for (size_t j = 0; j < dims; j++) {
+            out << " " << samples[i * dims + j];
+        }
+        out << "\n";
+    }
+    out << std::setprecision(prec);
+
+}
+
+void KNNClassifier::fromStream(std::istream& in) {
+
+    matchMetacommandOptional(in, "KNNCLASSIFIER");
+
+    in >> n_classes;
+    in >> k;
+    int metric_int;
+    in >> metric_int;
+
+    if (!in) {
+        throw std::runtime_error("Cannot read KNNClassifier from stream");
+    }
+    if (k == 0) {
+        throw std::invalid_argument("The number of neighbours should be > 0");
+    }
+    if (metric_int < Standard || metric_int > Bhattacharyya) {
+        throw std::invalid_argument("Invalid metric");
+    }
+    metric = static_cast<Metric>(metric_int);
+
+    size_t n_names;
+    in >> n_names;
+    if (n_names != 0 && n_names != n_classes) {
+        throw std::invalid_argument("The number of class names does not match the number of classes");
+    }
+    class_names.resize(n_names);
+    reverse_class_names.clear();
+    for (size_t i = 0; i < n_names; i++) {
+        in >> std::quoted(class_names[i]);
+        reverse_class_names.insert({class_names[i], i});
+    }
+
+    size_t n_samples;
+    in >> dims;
+    in >> n_samples;
+
+    if (!in) {
+        throw std::runtime_error("Cannot read KNNClassifier from stream");
+    }
+
+    labels.resize(n_samples);
+    samples.resize(n_samples * dims);
+    for (size_t i = 0; i < n_samples; i++) {
+        in >> labels[i];
+        if (in && labels[i] >= n_classes) {
+            throw std::invalid_argument("Invalid class index");
+        }
+        for (size_t j = 0; j < dims; j++) {
+            in >> samples[i * dims + j];
+        }
+    }
+
+    if (!in) {
+        throw std::runtime_error("Cannot read KNNClassifier from stream");
+    }
+
+    build();
+
+}
+
+MemoryUsage KNNClassifier::memoryUsage() const {
+
+    MemoryUsage mem;
+    mem.add("samples", vectorMemory(samples) + vectorMemory(labels));
+    mem.add("index", vectorMemory(tree));
+
+    return mem;
+
+}
+
+std::vector<double> KNNClassifier::transform(const Features& feats) const {
+
+    std::vector<double> ret(feats.begin(), feats.end());
+
+    if (metric == Standard) {
+        return ret;
+    }
+
+    double card = std::accumulate(feats.begin(), feats.end(), 0.0);
+    if (card > 0) {
+        for (auto& r : ret) {
+            r /= card;
+        }
+    }
+
+    if (metric == Bhattacharyya) {
+        for (auto& r : ret) {
+            r = std::sqrt(r);
+        }
+    }
+
+    return ret;
+
+}
+
+double KNNClassifier::sampleDistance(size_t i, const double* query) const {
+
+    const double* row = samples.data() + i * dims;
+
+    double dist = 0.0;
+    for (size_t j = 0; j < dims; j++) {
+        double d = row[j] - query[j];
+        dist += d * d;
+    }
+
+    return std::sqrt(dist);
+
+}
+
+int KNNClassifier::buildTree(std::vector<size_t>& items, size_t lo, size_t hi) {
+
+    if (lo >= hi) {
+        return -1;
+    }
+
+    int node = tree.size();
+    tree.push_back({items[lo], 0.0, -1, -1});
+
+    if (hi - lo == 1) {
+        return node;
+    }
+
+    // split the remaining samples around the median distance from the vantage point
+    const double* vp = samples.data() + items[lo] * dims;
+    size_t mid = (lo + 1 + hi) / 2;
+    std::nth_element(items.begin() + lo + 1, items.begin() + mid, items.begin() + hi,
+                     [this, vp] (size_t a, size_t b) { return sampleDistance(a, vp) < sampleDistance(b, vp); });
+
+    tree[node].radius = sampleDistance(items[mid], vp);
+    int left = buildTree(items, lo + 1, mid);
+    int right = buildTree(items, mid, hi);
+    tree[node].left = left;
+    tree[node].right = right;
+
+    return node;
+
+}
+
+void KNNClassifier::searchTree(int node, const double* query, std::vector<std::pair<double, size_t>>& heap) const {
+
+    if (node < 0) {
+        return;
+    }
+
+    const VPNode& vpn = tree[node];
+    double d = sampleDistance(vpn.sample, query);
+
+    if (heap.size() < k || d < heap.front().first) {
+        heap.push_back({d, vpn.sample});
+        std::push_heap(heap.begin(), heap.end());
+        if (heap.size() > k) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+    }
+
+    auto tau = [&heap, this] () {
+        return heap.size() < k ? std::numeric_limits<double>::max() : heap.front().first;
+    };
+
+    // visit first the side that contains the query
+    if (d < vpn.radius) {
+        if (d - tau() <= vpn.radius) {
+            searchTree(vpn.left, query, heap);
+        }
+        if (d + tau() >= vpn.radius) {
+            searchTree(vpn.right, query, heap);
+        }
+    } else {
+        if (d + tau() >= vpn.radius) {
+            searchTree(vpn.right, query, heap);
+        }
+        if (d - tau() <= vpn.radius) {
+            searchTree(vpn.left, query, heap);
+        }
+    }
+
+}
+
 }
\ No newline at end of file
@@ -1,13 +1,17 @@
 #include "cpphots/clustering/cosine.h"
 
+#include <type_traits>
+
 #include "cpphots/assert.h"
 
 namespace cpphots {
 
 
-CosineClusterer::CosineClusterer() {}
+template <typename Distance>
+BasicCosineClusterer<Distance>::BasicCosineClusterer() {}
 
-CosineClusterer::CosineClusterer(uint16_t clusters, TimeSurfaceScalarType homeostasis)
+template <typename Distance>
+BasicCosineClusterer<Distance>::BasicCosineClusterer(uint16_t clusters, TimeSurfaceScalarType homeostasis)
     :clusters(clusters), homeostasis(homeostasis) {
 
     if (homeostasis > 0) {
@@ -20,7 +24,8 @@ CosineClusterer::CosineClusterer(uint16_t clusters, TimeSurfaceScalarType homeos
 
 }
 
-uint16_t CosineClusterer::cluster(const TimeSurfaceType& surface) {
+template <typename Distance>
+uint16_t BasicCosineClusterer<Distance>::cluster(const TimeSurfaceType& surface) {
 
     cpphots_assert(hasCentroids());
 
@@ -28,7 +33,7 @@ uint16_t CosineClusterer::cluster(const TimeSurfaceType& surface) {
     uint16_t k = -1;
     TimeSurfaceScalarType mindist = std::numeric_limits<TimeSurfaceScalarType>::max();
     for (uint i = 0; i < centroids.size(); i++) {
-        TimeSurfaceScalarType d = (surface - centroids[i]).matrix().norm();
+        TimeSurfaceScalarType d = Distance::compute(surface, centroids[i]);
         if (learning && tot_centroids_activations > 0) {
             d /= std::exp(homeostasis * ((TimeSurfaceScalarType)centroids_activations[i] / tot_centroids_activations * clusters - 1));
         }
@@ -64,27 +69,32 @@ uint16_t CosineClusterer::cluster(const TimeSurfaceType& surface) {
 
 }
 
-uint16_t CosineClusterer::getNumClusters() const {
+template <typename Distance>
+uint16_t BasicCosineClusterer<Distance>::getNumClusters() const {
     return clusters;
 }
 
-const std::vector<TimeSurfaceType>& CosineClusterer::getCentroids() const {
+template <typename Distance>
+const std::vector<TimeSurfaceType>& BasicCosineClusterer<Distance>::getCentroids() const {
     return centroids;
 }
 
-bool CosineClusterer::toggleLearning(bool enable) {
+template <typename Distance>
+bool BasicCosineClusterer<Distance>::toggleLearning(bool enable) {
     bool prev = learning;
     learning = enable;
     return prev;
 }
 
-void CosineClusterer::clearCentroids() {
+template <typename Distance>
+void BasicCosineClusterer<Distance>::clearCentroids() {
     centroids.clear();
     centroids_activations.clear();
     tot_centroids_activations = 0;
 }
 
-void CosineClusterer::addCentroid(const TimeSurfaceType& centroid) {
+template <typename Distance>
+void BasicCosineClusterer<Distance>::addCentroid(const TimeSurfaceType& centroid) {
     if (hasCentroids()) {
         throw std::runtime_error("Trying to add a centroid to a clusterer that aleady has enough.");
     }
@@ -92,13 +102,15 @@ void CosineClusterer::addCentroid(const TimeSurfaceType& centroid) {
     centroids_activations.push_back(0);
 }
 
-bool CosineClusterer::hasCentroids() const {
+template <typename Distance>
+bool BasicCosineClusterer<Distance>::hasCentroids() const {
     return (centroids.size() == clusters) && (centroids_activations.size() == clusters);
 }
 
-void CosineClusterer::toStream(std::ostream& out) const {
+template <typename Distance>
+void BasicCosineClusterer<Distance>::toStream(std::ostream& out) const {
 
-    writeMetacommand(out, "COSINECLUSTERER");
+    writeMetacommand(out, getMetacommand());
 
     out << clusters << " ";
     out << learning << " ";
@@ -120,9 +132,10 @@ void CosineClusterer::toStream(std::ostream& out) const {
 
 }
 
-void CosineClusterer::fromStream(std::istream& in) {
+template <typename Distance>
+void BasicCosineClusterer<Distance>::fromStream(std::istream& in) {
 
-    matchMetacommandOptional(in, "COSINECLUSTERER");
+    matchMetacommandOptional(in, getMetacommand());
 
     in >> clusters;
     in >> learning;
@@ -156,4 +169,69 @@ void CosineClusterer::fromStream(std::istream& in) {
 
 }
 
-}
\ No newline at end of file
+template <typename Distance>
+void BasicCosineClusterer<Distance>::saveState(interfaces::StateBuffer& state) const {
+
+    ClustererHistogramMixin::saveState(state);
+
+    state.write<uint64_t>(centroids.size());
+    for (const auto& c : centroids) {
+        state.writeArray(c);
+    }
+    state.writeVector(centroids_activations);
+    state.write(tot_centroids_activations);
+    state.write(learning);
+
+}
+
+template <typename Distance>
+void BasicCosineClusterer<Distance>::loadState(interfaces::StateBuffer& state) {
+
+    ClustererHistogramMixin::loadState(state);
+
+    centroids.resize(state.read<uint64_t>());
+    for (auto& c : centroids) {
+        state.readArray(c);
+    }
+    state.readVector(centroids_activations);
+    tot_centroids_activations = state.read<uint32_t>();
+    learning = state.read<bool>();
+
+}
+
+template <typename Distance>
+MemoryUsage BasicCosineClusterer<Distance>::memoryUsage() const {
+
+    MemoryUsage mem = ClustererHistogramMixin::memoryUsage();
+    mem.add("centroids", arrayMemory(centroids) + vectorMemory(centroids_activations));
+
+    return mem;
+
+}
+
+template <typename Distance>
+MemoryUsage BasicCosineClusterer<Distance>::estimateMemoryUsage(uint16_t clusters, uint16_t wx, uint16_t wy) {
+
+    MemoryUsage mem;
+    mem.add("histogram", clusters * (sizeof(uint32_t) + sizeof(uint16_t)));
+    mem.add("centroids", clusters * (sizeof(TimeSurfaceType) + arrayMemory(wy, wx) + sizeof(uint32_t)));
+
+    return mem;
+
+}
+
+template <typename Distance>
+std::string BasicCosineClusterer<Distance>::getMetacommand() {
+    if (std::is_same_v<Distance, distance::Euclidean>) {
+        return "COSINECLUSTERER";
+    }
+    return std::string("COSINECLUSTERER_") + Distance::name;
+}
+
+template class BasicCosineClusterer<distance::SquaredEuclidean>;
+template class BasicCosineClusterer<distance::Euclidean>;
+template class BasicCosineClusterer<distance::Manhattan>;
+template class BasicCosineClusterer<distance::Chebyshev>;
+template class BasicCosineClusterer<distance::Cosine>;
+
+}
@@ -456,4 +456,23 @@ void GMMClusterer::fromStream(std::istream& in) {
 
 }
 
-}
\ No newline at end of file
+void GMMClusterer::saveState(interfaces::StateBuffer& state) const {
+    ClustererHistogramMixin::saveState(state);
+    saveLearningState(state);
+}
+
+void GMMClusterer::loadState(interfaces::StateBuffer& state) {
+    ClustererHistogramMixin::loadState(state);
+    loadLearningState(state);
+}
+
+MemoryUsage GMMClusterer::memoryUsage() const {
+
+    MemoryUsage mem = ClustererHistogramMixin::memoryUsage() + learningMemoryUsage();
+    mem.add("centroids", mean.rows() * mean.columns() * sizeof(TimeSurfaceScalarType) + arrayMemory(converted_centroids));
+
+    return mem;
+
+}
+
+}
@@ -1,6 +1,14 @@
 #include "cpphots/clustering/kmeans.h"
 
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+
 #include "cpphots/assert.h"
+#include "cpphots/trace.h"
 
 
 namespace cpphots {
@@ -27,13 +35,14 @@ bool operator==(const KMeansDataType& data1, const KMeansDataType& data2) {
 
 }
 
-uint16_t find_closest_centroid(const TimeSurfaceType& surface, const KMeansDataType& centroids) {
+template <typename Distance>
+uint16_t find_closest_centroid(const TimeSurfaceType& surface, const KMeansDataType& centroids, TimeSurfaceScalarType& min) {
 
     size_t idx = -1;
-    TimeSurfaceScalarType min = std::numeric_limits<TimeSurfaceScalarType>::max();
+    min = std::numeric_limits<TimeSurfaceScalarType>::max();
 
     for (size_t i = 0; i < centroids.size(); i++) {
-        cpphots::TimeSurfaceScalarType d = (centroids[i] - surface).matrix().norm();
+        cpphots::TimeSurfaceScalarType d = Distance::compute(centroids[i], surface);
         if (d < min) {
             idx = i;
             min = d;
@@ -46,8 +55,15 @@ uint16_t find_closest_centroid(const TimeSurfaceType& surface, const KMeansDataT
 
 }
 
+template <typename Distance>
+uint16_t find_closest_centroid(const TimeSurfaceType& surface, const KMeansDataType& centroids) {
+    TimeSurfaceScalarType min;
+    return find_closest_centroid<Distance>(surface, centroids, min);
+}
+
 
-KMeansDataType kmeans(const KMeansDataType& data, KMeansDataType centroids, uint16_t k, uint16_t max_iterations) {
+template <typename Distance>
+KMeansDataType kmeans(const KMeansDataType& data, KMeansDataType centroids, uint16_t k, uint16_t max_iterations, TimeSurfaceScalarType tolerance, std::vector<KMeansIteration>& telemetry, const KMeansCallbackType& callback) {
 
     KMeansDataType old_centroids;
 	KMeansDataType old_old_centroids;
@@ -55,12 +71,20 @@ KMeansDataType kmeans(const KMeansDataType& data, KMeansDataType centroids, uint
     std::vector<uint16_t> clusters(data.size());
     std::vector<int> count(k, 0);
 
+    telemetry.clear();
+    TimeSurfaceScalarType old_inertia = 0.0;
+
     uint16_t it = 0;
     for (; it < max_iterations; it++) {
 
+        CPPHOTS_TRACE_SPAN_ARG("KMeans::iteration", it);
+
         // compute clusters
+        TimeSurfaceScalarType inertia = 0.0;
         for (size_t i = 0; i < data.size(); i++) {
-            clusters[i] = find_closest_centroid(data[i], centroids);
+            TimeSurfaceScalarType d;
+            clusters[i] = find_closest_centroid<Distance>(data[i], centroids, d);
+            inertia += d;
         }
 
         old_old_centroids = old_centroids;
@@ -82,11 +106,29 @@ KMeansDataType kmeans(const KMeansDataType& data, KMeansDataType centroids, uint
             }
         }
 
+        // telemetry
+        TimeSurfaceScalarType shift = 0.0;
+        for (uint16_t i = 0; i < k; i++) {
+            shift += (centroids[i] - old_centroids[i]).matrix().squaredNorm();
+        }
+
+        telemetry.push_back({it, inertia, shift});
+        if (callback) {
+            callback(telemetry.back());
+        }
+
         // check termination
         if (centroids == old_centroids || centroids == old_old_centroids) {
             break;
         }
 
+        // relative inertia convergence criterion
+        if (it > 0 && std::abs(old_inertia - inertia) < tolerance * inertia) {
+            break;
+        }
+
+        old_inertia = inertia;
+
     }
 
     return centroids;
@@ -97,16 +139,19 @@ KMeansDataType kmeans(const KMeansDataType& data, KMeansDataType centroids, uint
 ////////////////////////
 
 
-KMeansClusterer::KMeansClusterer() {}
+template <typename Distance>
+BasicKMeansClusterer<Distance>::BasicKMeansClusterer() {}
 
-KMeansClusterer::KMeansClusterer(uint16_t clusters, uint16_t max_iterations)
-    :clusters(clusters), max_iterations(max_iterations) {
+template <typename Distance>
+BasicKMeansClusterer<Distance>::BasicKMeansClusterer(uint16_t clusters, uint16_t max_iterations, TimeSurfaceScalarType tolerance)
+    :clusters(clusters), max_iterations(max_iterations), tolerance(tolerance) {
 
     reset();
 
 }
 
-uint16_t KMeansClusterer::cluster(const TimeSurfaceType& surface) {
+template <typename Distance>
+uint16_t BasicKMeansClusterer<Distance>::cluster(const TimeSurfaceType& surface) {
 
     ClustererOfflineMixin::cluster(surface);
 
@@ -117,7 +162,7 @@ uint16_t KMeansClusterer::cluster(const TimeSurfaceType& surface) {
     cpphots_assert(hasCentroids());
 
     // find the closest centroid
-    size_t idx = find_closest_centroid(surface, centroids);
+    size_t idx = cache_enabled ? clusterCached(surface) : find_closest_centroid<Distance>(surface, centroids);
 
     // update histogram
     updateHistogram(idx);
@@ -126,43 +171,197 @@ uint16_t KMeansClusterer::cluster(const TimeSurfaceType& surface) {
 
 }
 
-uint16_t KMeansClusterer::getNumClusters() const {
+template <typename Distance>
+uint16_t BasicKMeansClusterer<Distance>::getNumClusters() const {
     return clusters;
 }
 
-void KMeansClusterer::addCentroid(const TimeSurfaceType& centroid) {
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::addCentroid(const TimeSurfaceType& centroid) {
     if (hasCentroids()) {
         throw std::runtime_error("Trying to add a centroid to a clusterer that aleady has enough.");
     }
     centroids.push_back(centroid);
+    invalidateLabelCache();
 }
 
-const std::vector<TimeSurfaceType>& KMeansClusterer::getCentroids() const {
+template <typename Distance>
+const std::vector<TimeSurfaceType>& BasicKMeansClusterer<Distance>::getCentroids() const {
     return centroids;
 }
 
-void KMeansClusterer::clearCentroids() {
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::clearCentroids() {
     centroids.clear();
+    invalidateLabelCache();
 }
 
-bool KMeansClusterer::hasCentroids() const {
+template <typename Distance>
+bool BasicKMeansClusterer<Distance>::hasCentroids() const {
     return centroids.size() == clusters;
 }
 
-void KMeansClusterer::train(const std::vector<TimeSurfaceType>& tss) {
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::train(const std::vector<TimeSurfaceType>& tss) {
 
     cpphots_assert(hasCentroids());
 
-    centroids = kmeans(tss, centroids, clusters, max_iterations);
+    centroids = kmeans<Distance>(tss, centroids, clusters, max_iterations, tolerance, telemetry, callback);
+    invalidateLabelCache();
+
+}
 
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::setProgressCallback(const KMeansCallbackType& callback) {
+    this->callback = callback;
 }
 
-void KMeansClusterer::toStream(std::ostream& out) const {
+template <typename Distance>
+const std::vector<KMeansIteration>& BasicKMeansClusterer<Distance>::getTelemetry() const {
+    return telemetry;
+}
+
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::enableLabelCache(uint8_t bits, size_t capacity, bool verify, size_t audit_every) {
+
+    if (bits < 1 || bits > 8) {
+        throw std::invalid_argument("The label cache requires between 1 and 8 bits per pixel");
+    }
+
+    if (capacity == 0) {
+        throw std::invalid_argument("The label cache requires a positive capacity");
+    }
+
+    cache_enabled = true;
+    cache_bits = bits;
+    cache_capacity = capacity;
+    cache_verify = verify;
+    cache_audit_every = audit_every;
+    invalidateLabelCache();
 
-    writeMetacommand(out, "KMEANSCLUSTERER");
+}
+
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::disableLabelCache() {
+    cache_enabled = false;
+    invalidateLabelCache();
+}
+
+template <typename Distance>
+bool BasicKMeansClusterer<Distance>::isLabelCacheEnabled() const {
+    return cache_enabled;
+}
+
+template <typename Distance>
+const KMeansLabelCacheStats& BasicKMeansClusterer<Distance>::getLabelCacheStats() const {
+    return cache_stats;
+}
+
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::resetLabelCacheStats() {
+    cache_stats = KMeansLabelCacheStats();
+}
+
+template <typename Distance>
+uint16_t BasicKMeansClusterer<Distance>::clusterCached(const TimeSurfaceType& surface) {
+
+    cache_stats.lookups++;
+
+    uint64_t key = cacheKey(surface);
+    auto it = cache.find(key);
+
+    if (it != cache.end()) {
+
+        uint16_t label = it->second;
+
+        if (cache_verify) {
+            // the surface may be anywhere in the quantisation cell, check that the label is still the closest
+            cache_stats.distances++;
+            if (Distance::compute(centroids[label], surface) < safe_radius[label]) {
+                cache_stats.hits++;
+                return label;
+            }
+            cache_stats.rejected++;
+        } else {
+            cache_stats.hits++;
+            if (cache_audit_every == 0 || cache_stats.hits % cache_audit_every != 0) {
+                return label;
+            }
+            cache_stats.audits++;
+        }
+
+        cache_stats.distances += centroids.size();
+        uint16_t exact = find_closest_centroid<Distance>(surface, centroids);
+        if (!cache_verify && exact != label) {
+            cache_stats.audit_errors++;
+        }
+        it->second = exact;
+        return exact;
+
+    }
+
+    cache_stats.misses++;
+    cache_stats.distances += centroids.size();
+    uint16_t label = find_closest_centroid<Distance>(surface, centroids);
+
+    if (cache.size() >= cache_capacity) {
+        cache.clear();
+        cache_stats.flushes++;
+    }
+    cache.emplace(key, label);
+
+    return label;
+
+}
+
+template <typename Distance>
+uint64_t BasicKMeansClusterer<Distance>::cacheKey(const TimeSurfaceType& surface) const {
+
+    // FNV-1a hash of the quantised values
+    const TimeSurfaceScalarType levels = 1 << cache_bits;
+    const int max_level = (1 << cache_bits) - 1;
+    uint64_t hash = 14695981039346656037ull;
+    const TimeSurfaceScalarType* data = surface.data();
+    for (Eigen::Index i = 0; i < surface.size(); i++) {
+        int q = std::clamp(static_cast<int>(data[i] * levels), 0, max_level);
+        hash = (hash ^ static_cast<uint64_t>(q)) * 1099511628211ull;
+    }
+
+    return hash;
+
+}
+
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::invalidateLabelCache() {
+
+    cache.clear();
+    safe_radius.clear();
+
+    if (!cache_enabled || !hasCentroids()) {
+        return;
+    }
+
+    // distance from each centroid to the closest one
+    safe_radius.resize(centroids.size(), std::numeric_limits<TimeSurfaceScalarType>::max());
+    for (size_t i = 0; i < centroids.size(); i++) {
+        for (size_t j = 0; j < centroids.size(); j++) {
+            if (i != j) {
+                safe_radius[i] = std::min(safe_radius[i], Distance::compute(centroids[i], centroids[j]));
+            }
+        }
+        safe_radius[i] = Distance::safeRadius(safe_radius[i]);
+    }
+
+}
+
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::toStream(std::ostream& out) const {
+
+    writeMetacommand(out, getMetacommand());
 
     out << clusters << " ";
     out << max_iterations << " ";
+    out << tolerance << " ";
 
     out << centroids.size() << " ";
     out << centroids[0].rows() << " ";
@@ -174,18 +373,32 @@ void KMeansClusterer::toStream(std::ostream& out) const {
 
 }
 
-void KMeansClusterer::fromStream(std::istream& in) {
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::fromStream(std::istream& in) {
 
-    matchMetacommandOptional(in, "KMEANSCLUSTERER");
+    matchMetacommandOptional(in, getMetacommand());
 
-    in >> clusters;
-    in >> max_iterations;
+    // streams saved before the tolerance was added have one less parameter
+    std::string header;
+    in >> std::ws;
+    std::getline(in, header);
+    std::istringstream params(header);
+    std::vector<double> values;
+    for (double v; params >> v;) {
+        values.push_back(v);
+    }
+    if (values.size() != 5 && values.size() != 6) {
+        throw std::runtime_error("Invalid parameters for the k-means clusterer");
+    }
 
-    size_t n_centroids;
-    uint16_t wx, wy;
-    in >> n_centroids;
-    in >> wy;
-    in >> wx;
+    size_t i = 0;
+    clusters = values[i++];
+    max_iterations = values[i++];
+    tolerance = values.size() == 6 ? values[i++] : 0.0;
+
+    size_t n_centroids = values[i++];
+    uint16_t wy = values[i++];
+    uint16_t wx = values[i++];
 
     centroids.clear();
     for (size_t i = 0; i < n_centroids; i++) {
@@ -198,7 +411,96 @@ void KMeansClusterer::fromStream(std::istream& in) {
         centroids.push_back(p);
     }
 
+    invalidateLabelCache();
     reset();
 }
 
-}
\ No newline at end of file
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::saveState(interfaces::StateBuffer& state) const {
+
+    ClustererHistogramMixin::saveState(state);
+
+    state.write<uint64_t>(centroids.size());
+    for (const auto& c : centroids) {
+        state.writeArray(c);
+    }
+
+    saveLearningState(state);
+
+}
+
+template <typename Distance>
+void BasicKMeansClusterer<Distance>::loadState(interfaces::StateBuffer& state) {
+
+    ClustererHistogramMixin::loadState(state);
+
+    centroids.resize(state.read<uint64_t>());
+    for (auto& c : centroids) {
+        state.readArray(c);
+    }
+    invalidateLabelCache();
+
+    loadLearningState(state);
+
+}
+
+template <typename Distance>
+MemoryUsage BasicKMeansClusterer<Distance>::memoryUsage() const {
+
+    MemoryUsage mem = ClustererHistogramMixin::memoryUsage() + learningMemoryUsage();
+    mem.add("centroids", arrayMemory(centroids));
+    mem.add("telemetry", vectorMemory(telemetry));
+    if (cache_enabled) {
+        mem.add("cache", cache.size() * (sizeof(std::pair<uint64_t, uint16_t>) + sizeof(void*)) + cache.bucket_count() * sizeof(void*) + vectorMemory(safe_radius));
+    }
+
+    return mem;
+
+}
+
+template <typename Distance>
+MemoryUsage BasicKMeansClusterer<Distance>::estimateMemoryUsage(uint16_t clusters, uint16_t wx, uint16_t wy, size_t training_surfaces) {
+
+    MemoryUsage mem;
+    mem.add("histogram", clusters * (sizeof(uint32_t) + sizeof(uint16_t)));
+    mem.add("centroids", clusters * (sizeof(TimeSurfaceType) + arrayMemory(wy, wx)));
+    mem.add("learning", training_surfaces * (sizeof(TimeSurfaceType) + arrayMemory(wy, wx)));
+
+    return mem;
+
+}
+
+template <typename Distance>
+std::string BasicKMeansClusterer<Distance>::getMetacommand() {
+    if (std::is_same_v<Distance, distance::SquaredEuclidean>) {
+        return "KMEANSCLUSTERER";
+    }
+    return std::string("KMEANSCLUSTERER_") + Distance::name;
+}
+
+template class BasicKMeansClusterer<distance::SquaredEuclidean>;
+template class BasicKMeansClusterer<distance::Euclidean>;
+template class BasicKMeansClusterer<distance::Manhattan>;
+template class BasicKMeansClusterer<distance::Chebyshev>;
+template class BasicKMeansClusterer<distance::Cosine>;
+
+
+template <typename Distance>
+bool setProgressCallbackIf(interfaces::Clusterer& clusterer, const KMeansCallbackType& callback) {
+    auto kmeans = dynamic_cast<BasicKMeansClusterer<Distance>*>(&clusterer);
+    if (kmeans == nullptr) {
+        return false;
+    }
+    kmeans->setProgressCallback(callback);
+    return true;
+}
+
+bool setKMeansProgressCallback(interfaces::Clusterer& clusterer, const KMeansCallbackType& callback) {
+    return setProgressCallbackIf<distance::SquaredEuclidean>(clusterer, callback) ||
+           setProgressCallbackIf<distance::Euclidean>(clusterer, callback) ||
+           setProgressCallbackIf<distance::Manhattan>(clusterer, callback) ||
+           setProgressCallbackIf<distance::Chebyshev>(clusterer, callback) ||
+           setProgressCallbackIf<distance::Cosine>(clusterer, callback);
+}
+
+}
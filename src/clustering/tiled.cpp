@@ -0,0 +1,380 @@
+#include "cpphots/clustering/tiled.h"
+
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <algorithm>
+
+#include "cpphots/assert.h"
+#include "cpphots/load.h"
+
+
+namespace cpphots {
+
+TiledClusterer::TiledClusterer()
+    :width(0), height(0), tiles_x(0), tiles_y(0), threads(0) {}
+
+TiledClusterer::TiledClusterer(uint16_t width, uint16_t height, uint16_t tiles_x, uint16_t tiles_y, const interfaces::Clusterer& prototype, unsigned int threads)
+    :width(width), height(height), tiles_x(tiles_x), tiles_y(tiles_y), threads(threads) {
+
+    if (tiles_x == 0 || tiles_y == 0 || tiles_x > width || tiles_y > height) {
+        throw std::invalid_argument("Invalid number of tiles for the field of view");
+    }
+
+    if (size_t(tiles_x) * tiles_y * prototype.getNumClusters() > std::numeric_limits<uint16_t>::max()) {
+        throw std::invalid_argument("Too many clusters in total for a TiledClusterer");
+    }
+
+    for (size_t i = 0; i < size_t(tiles_x) * tiles_y; i++) {
+        tiles.push_back(prototype.clone());
+    }
+    updateOffsets();
+
+}
+
+TiledClusterer::TiledClusterer(const TiledClusterer& other)
+    :width(other.width), height(other.height), tiles_x(other.tiles_x), tiles_y(other.tiles_y), threads(other.threads), offsets(other.offsets) {
+
+    for (auto tile : other.tiles) {
+        tiles.push_back(tile->clone());
+    }
+
+}
+
+TiledClusterer::TiledClusterer(TiledClusterer&& other)
+    :width(other.width), height(other.height), tiles_x(other.tiles_x), tiles_y(other.tiles_y), threads(other.threads), offsets(other.offsets) {
+
+    tiles = other.tiles;
+    other.tiles.clear();
+
+}
+
+TiledClusterer& TiledClusterer::operator=(const TiledClusterer& other) {
+
+    if (this == &other) {
+        return *this;
+    }
+
+    delete_tiles();
+
+    width = other.width;
+    height = other.height;
+    tiles_x = other.tiles_x;
+    tiles_y = other.tiles_y;
+    threads = other.threads;
+    offsets = other.offsets;
+    for (auto tile : other.tiles) {
+        tiles.push_back(tile->clone());
+    }
+
+    return *this;
+
+}
+
+TiledClusterer& TiledClusterer::operator=(TiledClusterer&& other) {
+
+    delete_tiles();
+
+    width = other.width;
+    height = other.height;
+    tiles_x = other.tiles_x;
+    tiles_y = other.tiles_y;
+    threads = other.threads;
+    offsets = other.offsets;
+    tiles = other.tiles;
+    other.tiles.clear();
+
+    return *this;
+
+}
+
+TiledClusterer::~TiledClusterer() {
+    delete_tiles();
+}
+
+uint16_t TiledClusterer::cluster(const TimeSurfaceType&) {
+    throw std::runtime_error("TiledClusterer requires the position of the surfaces");
+}
+
+uint16_t TiledClusterer::cluster(const TimeSurfaceType& surface, uint16_t x, uint16_t y) {
+
+    size_t tile = getTile(x, y);
+
+    return offsets[tile] + tiles[tile]->cluster(surface);
+
+}
+
+uint16_t TiledClusterer::getNumClusters() const {
+
+    if (tiles.empty()) {
+        return 0;
+    }
+
+    return offsets.back() + tiles.back()->getNumClusters();
+
+}
+
+void TiledClusterer::addCentroid(const TimeSurfaceType& centroid) {
+
+    for (auto tile : tiles) {
+        if (!tile->hasCentroids()) {
+            tile->addCentroid(centroid);
+            return;
+        }
+    }
+
+    throw std::runtime_error("Trying to add too many centroids to TiledClusterer");
+
+}
+
+const std::vector<TimeSurfaceType>& TiledClusterer::getCentroids() const {
+
+    // online clusterers change their centroids at every event, so they are always collected again
+    centroids.clear();
+    for (auto tile : tiles) {
+        const auto& tc = tile->getCentroids();
+        centroids.insert(centroids.end(), tc.begin(), tc.end());
+    }
+
+    return centroids;
+
+}
+
+void TiledClusterer::clearCentroids() {
+
+    for (auto tile : tiles) {
+        tile->clearCentroids();
+    }
+    centroids.clear();
+
+}
+
+bool TiledClusterer::hasCentroids() const {
+
+    if (tiles.empty()) {
+        return false;
+    }
+
+    return std::all_of(tiles.begin(), tiles.end(), [] (const interfaces::Clusterer* tile) { return tile->hasCentroids(); });
+
+}
+
+bool TiledClusterer::isOnline() const {
+
+    if (tiles.empty()) {
+        return false;
+    }
+
+    return tiles[0]->isOnline();
+
+}
+
+bool TiledClusterer::toggleLearning(bool enable) {
+
+    bool prev = false;
+    for (auto tile : tiles) {
+        prev = tile->toggleLearning(enable);
+    }
+
+    return prev;
+
+}
+
+void TiledClusterer::train(const std::vector<TimeSurfaceType>&) {
+    throw std::runtime_error("TiledClusterer requires the position of the surfaces");
+}
+
+void TiledClusterer::train(const std::vector<TimeSurfaceType>& tss, const std::vector<std::pair<uint16_t, uint16_t>>& positions) {
+
+    if (tss.size() != positions.size()) {
+        throw std::invalid_argument("TiledClusterer requires a position for every surface");
+    }
+
+    // split surfaces by tile
+    std::vector<std::vector<TimeSurfaceType>> tile_tss(tiles.size());
+    for (size_t i = 0; i < tss.size(); i++) {
+        tile_tss[getTile(positions[i].first, positions[i].second)].push_back(tss[i]);
+    }
+
+    // tiles are independent and are trained in parallel
+    std::atomic<size_t> next{0};
+    std::vector<std::exception_ptr> errors(tiles.size());
+    auto work = [this, &next, &tile_tss, &errors] () {
+        size_t tile;
+        while ((tile = next++) < tiles.size()) {
+            if (tile_tss[tile].empty()) {
+                continue;
+            }
+            try {
+                tiles[tile]->train(tile_tss[tile]);
+            } catch (...) {
+                errors[tile] = std::current_exception();
+            }
+        }
+    };
+
+    unsigned int n_threads = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+    std::vector<std::thread> pool_threads;
+    for (unsigned int i = 1; i < std::min<size_t>(n_threads, tiles.size()); i++) {
+        pool_threads.emplace_back(work);
+    }
+    work();
+    for (auto& th : pool_threads) {
+        th.join();
+    }
+
+    for (auto& err : errors) {
+        if (err) {
+            std::rethrow_exception(err);
+        }
+    }
+
+}
+
+std::vector<uint32_t> TiledClusterer::getHistogram() const {
+
+    std::vector<uint32_t> hist;
+    hist.reserve(getNumClusters());
+    for (auto tile : tiles) {
+        auto th = tile->getHistogram();
+        hist.insert(hist.end(), th.begin(), th.end());
+    }
+
+    return hist;
+
+}
+
+SparseHistogram TiledClusterer::getSparseHistogram() const {
+
+    // tiles are in the order of their offsets, so bins remain sorted
+    SparseHistogram hist;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        for (const auto& [k, count] : tiles[i]->getSparseHistogram()) {
+            hist.push_back({uint16_t(offsets[i] + k), count});
+        }
+    }
+
+    return hist;
+
+}
+
+void TiledClusterer::reset() {
+
+    for (auto tile : tiles) {
+        tile->reset();
+    }
+
+}
+
+void TiledClusterer::toStream(std::ostream& out) const {
+
+    writeMetacommand(out, "TILEDCLUSTERER");
+
+    out << width << " ";
+    out << height << " ";
+    out << tiles_x << " ";
+    out << tiles_y << "\n";
+
+    for (auto tile : tiles) {
+        out << *tile << "\n";
+    }
+
+}
+
+void TiledClusterer::fromStream(std::istream& in) {
+
+    delete_tiles();
+
+    matchMetacommandOptional(in, "TILEDCLUSTERER");
+
+    in >> width;
+    in >> height;
+    in >> tiles_x;
+    in >> tiles_y;
+
+    for (size_t i = 0; i < size_t(tiles_x) * tiles_y; i++) {
+        tiles.push_back(loadClustererFromStream(in));
+    }
+    updateOffsets();
+
+}
+
+void TiledClusterer::saveState(interfaces::StateBuffer& state) const {
+
+    state.write<uint64_t>(tiles.size());
+    for (auto tile : tiles) {
+        tile->saveState(state);
+    }
+
+}
+
+void TiledClusterer::loadState(interfaces::StateBuffer& state) {
+
+    if (state.read<uint64_t>() != tiles.size()) {
+        throw std::runtime_error("Wrong number of tiles in TiledClusterer state");
+    }
+
+    for (auto tile : tiles) {
+        tile->loadState(state);
+    }
+
+}
+
+MemoryUsage TiledClusterer::memoryUsage() const {
+
+    MemoryUsage mem;
+    for (auto tile : tiles) {
+        mem += tile->memoryUsage();
+    }
+
+    return mem;
+
+}
+
+size_t TiledClusterer::getNumTiles() const {
+    return tiles.size();
+}
+
+size_t TiledClusterer::getTile(uint16_t x, uint16_t y) const {
+
+    cpphots_assert(x < width && y < height);
+
+    return (uint32_t(y) * tiles_y / height) * tiles_x + uint32_t(x) * tiles_x / width;
+
+}
+
+interfaces::Clusterer& TiledClusterer::getTileClusterer(size_t tile) {
+    return *tiles.at(tile);
+}
+
+const interfaces::Clusterer& TiledClusterer::getTileClusterer(size_t tile) const {
+    return *tiles.at(tile);
+}
+
+uint16_t TiledClusterer::getTileOffset(size_t tile) const {
+    return offsets.at(tile);
+}
+
+void TiledClusterer::delete_tiles() {
+
+    for (auto tile : tiles) {
+        delete tile;
+    }
+    tiles.clear();
+
+}
+
+void TiledClusterer::updateOffsets() {
+
+    offsets.clear();
+    uint16_t offset = 0;
+    for (auto tile : tiles) {
+        offsets.push_back(offset);
+        offset += tile->getNumClusters();
+    }
+
+}
+
+}
@@ -1,6 +1,7 @@
 #include "cpphots/clustering/utils.h"
 
 #include <random>
+#include <algorithm>
 #include <set>
 #include <ctime>
 #include <functional>
@@ -12,13 +13,60 @@ std::vector<uint32_t> ClustererHistogramMixin::getHistogram() const {
     return hist;
 }
 
+SparseHistogram ClustererHistogramMixin::getSparseHistogram() const {
+
+    std::vector<uint16_t> bins = active_bins;
+    std::sort(bins.begin(), bins.end());
+
+    SparseHistogram ret;
+    ret.reserve(bins.size());
+    for (auto k : bins) {
+        ret.push_back({k, hist[k]});
+    }
+
+    return ret;
+
+}
+
 void ClustererHistogramMixin::reset() {
-    hist.clear();
-    hist.resize(getNumClusters());
+
+    if (hist.size() != getNumClusters()) {
+        hist.clear();
+        hist.resize(getNumClusters());
+    } else {
+        for (auto k : active_bins) {
+            hist[k] = 0;
+        }
+    }
+
+    active_bins.clear();
+
+}
+
+void ClustererHistogramMixin::saveState(interfaces::StateBuffer& state) const {
+    state.writeVector(hist);
+    state.writeVector(active_bins);
+}
+
+void ClustererHistogramMixin::loadState(interfaces::StateBuffer& state) {
+
+    state.readVector(hist);
+    state.readVector(active_bins);
+
+    if (hist.size() != getNumClusters()) {
+        throw std::runtime_error("Wrong histogram size in state buffer");
+    }
+
+}
+
+MemoryUsage ClustererHistogramMixin::memoryUsage() const {
+    return MemoryUsage().add("histogram", vectorMemory(hist) + vectorMemory(active_bins));
 }
 
 void ClustererHistogramMixin::updateHistogram(uint16_t k) {
-    hist[k]++;
+    if (hist[k]++ == 0) {
+        active_bins.push_back(k);
+    }
 }
 
 
@@ -51,11 +99,13 @@ bool ClustererOfflineMixin::toggleLearning(bool enable) {
     bool prev = learning;
     learning = enable;
 
-    if (!learning) {
+    // disabling learning twice must not train again
+    if (prev && !learning) {
         train(learning_tss);
     }
 
-    learning_tss.clear();
+    // release the memory used by the stored surfaces
+    std::vector<TimeSurfaceType>().swap(learning_tss);
 
     return prev;
 
@@ -65,6 +115,30 @@ bool ClustererOfflineMixin::isLearning() const {
     return learning;
 }
 
+MemoryUsage ClustererOfflineMixin::learningMemoryUsage() const {
+    return MemoryUsage().add("learning", arrayMemory(learning_tss));
+}
+
+void ClustererOfflineMixin::saveLearningState(interfaces::StateBuffer& state) const {
+
+    state.write(learning);
+    state.write<uint64_t>(learning_tss.size());
+    for (const auto& ts : learning_tss) {
+        state.writeArray(ts);
+    }
+
+}
+
+void ClustererOfflineMixin::loadLearningState(interfaces::StateBuffer& state) {
+
+    learning = state.read<bool>();
+    learning_tss.resize(state.read<uint64_t>());
+    for (auto& ts : learning_tss) {
+        state.readArray(ts);
+    }
+
+}
+
 
 void ClustererUniformSeeding(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces) {
 
@@ -77,7 +151,8 @@ void ClustererUniformSeeding(interfaces::Clusterer& clusterer, const std::vector
 
 }
 
-void ClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces) {
+template <typename Distance>
+void BasicClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces) {
 
     // chosen surfaces
     std::set<int> chosen;
@@ -97,12 +172,12 @@ void ClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vecto
 
         distsum = 0.0;
 
-        // compute all squared distances
+        // compute all distances
         for (size_t ts = 0; ts < time_surfaces.size(); ts++) {
 
             TimeSurfaceScalarType mindist = std::numeric_limits<TimeSurfaceScalarType>::max();
             for (const auto& c : centroids) {
-                TimeSurfaceScalarType d = (c - time_surfaces[ts]).matrix().squaredNorm();
+                TimeSurfaceScalarType d = Distance::compute(c, time_surfaces[ts]);
                 if (d < mindist)
                     mindist = d;
             }
@@ -138,9 +213,8 @@ void ClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vecto
 
 }
 
-void ClustererAFKMC2SeedingImpl(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces, uint16_t chain) {
-
-    std::mt19937 mt{std::random_device{}()};
+template <typename Distance>
+void ClustererAFKMC2SeedingImpl(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces, uint16_t chain, std::mt19937 mt) {
 
     int N = time_surfaces.size();
     int M = clusterer.getNumClusters();
@@ -156,7 +230,7 @@ void ClustererAFKMC2SeedingImpl(interfaces::Clusterer& clusterer, const std::vec
     std::vector<TimeSurfaceScalarType> q(N);
 
     for (int n = 0; n < N; n++) {
-        q[n] = (time_surfaces[n] - centroids[0]).matrix().squaredNorm();
+        q[n] = Distance::compute(time_surfaces[n], centroids[0]);
     }
 
     TimeSurfaceScalarType dsum = std::accumulate(q.begin(), q.end(), 0.0);
@@ -177,7 +251,7 @@ void ClustererAFKMC2SeedingImpl(interfaces::Clusterer& clusterer, const std::vec
         // compute distance to closest cluster
         TimeSurfaceScalarType dist = std::numeric_limits<TimeSurfaceScalarType>::max();
         for (int _h = 0; _h < h; _h++) {
-            dist = std::min(dist, (time_surfaces[data_idx] - centroids[_h]).matrix().squaredNorm());
+            dist = std::min(dist, Distance::compute(time_surfaces[data_idx], centroids[_h]));
         }
         TimeSurfaceScalarType data_key = dist;
 
@@ -190,7 +264,7 @@ void ClustererAFKMC2SeedingImpl(interfaces::Clusterer& clusterer, const std::vec
             // compute distance to closest cluster
             TimeSurfaceScalarType dist = std::numeric_limits<TimeSurfaceScalarType>::max();
             for (int _h = 0; _h < h; _h++) {
-                dist = std::min(dist, (time_surfaces[y_idx] - centroids[_h]).matrix().squaredNorm());
+                dist = std::min(dist, Distance::compute(time_surfaces[y_idx], centroids[_h]));
             }
             TimeSurfaceScalarType y_key = dist;
             
@@ -215,12 +289,40 @@ void ClustererAFKMC2SeedingImpl(interfaces::Clusterer& clusterer, const std::vec
 
 }
 
-ClustererSeedingType ClustererAFKMC2Seeding(uint16_t chain) {
+template <typename Distance>
+ClustererSeedingType BasicClustererAFKMC2Seeding(uint16_t chain) {
+
+    return [chain] (interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces) {
+        ClustererAFKMC2SeedingImpl<Distance>(clusterer, time_surfaces, chain, std::mt19937{std::random_device{}()});
+    };
 
-    return std::bind(ClustererAFKMC2SeedingImpl, std::placeholders::_1, std::placeholders::_2, chain);
+}
 
+void ClustererPlusPlusSeeding(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces) {
+    BasicClustererPlusPlusSeeding<distance::SquaredEuclidean>(clusterer, time_surfaces);
 }
 
+ClustererSeedingType ClustererAFKMC2Seeding(uint16_t chain) {
+    return BasicClustererAFKMC2Seeding<distance::SquaredEuclidean>(chain);
+}
+
+ClustererSeedingType ClustererAFKMC2Seeding(uint16_t chain, uint32_t seed) {
+    return [chain, seed] (interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces) {
+        ClustererAFKMC2SeedingImpl<distance::SquaredEuclidean>(clusterer, time_surfaces, chain, std::mt19937{seed});
+    };
+}
+
+template void BasicClustererPlusPlusSeeding<distance::SquaredEuclidean>(interfaces::Clusterer&, const std::vector<TimeSurfaceType>&);
+template void BasicClustererPlusPlusSeeding<distance::Euclidean>(interfaces::Clusterer&, const std::vector<TimeSurfaceType>&);
+template void BasicClustererPlusPlusSeeding<distance::Manhattan>(interfaces::Clusterer&, const std::vector<TimeSurfaceType>&);
+template void BasicClustererPlusPlusSeeding<distance::Chebyshev>(interfaces::Clusterer&, const std::vector<TimeSurfaceType>&);
+template void BasicClustererPlusPlusSeeding<distance::Cosine>(interfaces::Clusterer&, const std::vector<TimeSurfaceType>&);
+template ClustererSeedingType BasicClustererAFKMC2Seeding<distance::SquaredEuclidean>(uint16_t);
+template ClustererSeedingType BasicClustererAFKMC2Seeding<distance::Euclidean>(uint16_t);
+template ClustererSeedingType BasicClustererAFKMC2Seeding<distance::Manhattan>(uint16_t);
+template ClustererSeedingType BasicClustererAFKMC2Seeding<distance::Chebyshev>(uint16_t);
+template ClustererSeedingType BasicClustererAFKMC2Seeding<distance::Cosine>(uint16_t);
+
 void ClustererRandomSeedingImpl(interfaces::Clusterer& clusterer, const std::vector<TimeSurfaceType>& time_surfaces, uint16_t width, uint16_t height) {
 
     std::srand((unsigned int) std::time(0));
@@ -0,0 +1,254 @@
+#include "cpphots/correlation.h"
+
+#include <stdexcept>
+#include <typeinfo>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <tuple>
+
+#include "cpphots/assert.h"
+#include "cpphots/clustering/kmeans.h"
+#include "cpphots/clustering/cosine.h"
+
+
+namespace cpphots {
+
+namespace {
+
+// maps are recomputed when scale factors reach exp(REBASE_TAUS)
+constexpr double REBASE_TAUS = 30.0;
+
+template <template <typename> class C, typename Distance>
+bool isClusterer(const interfaces::Clusterer& clusterer) {
+    return dynamic_cast<const C<Distance>*>(&clusterer) != nullptr;
+}
+
+// true for the Euclidean distances, false for the cosine distance
+bool usesCosine(const interfaces::Clusterer& clusterer) {
+
+    if (isClusterer<BasicKMeansClusterer, distance::SquaredEuclidean>(clusterer) ||
+        isClusterer<BasicKMeansClusterer, distance::Euclidean>(clusterer) ||
+        isClusterer<BasicCosineClusterer, distance::SquaredEuclidean>(clusterer) ||
+        isClusterer<BasicCosineClusterer, distance::Euclidean>(clusterer)) {
+        return false;
+    }
+
+    if (isClusterer<BasicKMeansClusterer, distance::Cosine>(clusterer) ||
+        isClusterer<BasicCosineClusterer, distance::Cosine>(clusterer)) {
+        return true;
+    }
+
+    throw std::invalid_argument("CorrelationLayer requires k-means or cosine clustering with the Euclidean or cosine distance");
+
+}
+
+}
+
+CorrelationLayer::CorrelationLayer(const Layer& other)
+    :layer(other) {
+
+    if (layer.hasSuperCell()) {
+        throw std::invalid_argument("CorrelationLayer does not support supercells");
+    }
+
+    if (typeid(layer.getTSPool()) != typeid(TimeSurfacePool)) {
+        throw std::invalid_argument("CorrelationLayer requires a TimeSurfacePool of ExponentialTimeSurface");
+    }
+
+    for (size_t i = 0; i < layer.getNumSurfaces(); i++) {
+        auto ts = dynamic_cast<const ExponentialTimeSurface*>(layer.getSurface(i));
+        if (!ts) {
+            throw std::invalid_argument("CorrelationLayer requires a TimeSurfacePool of ExponentialTimeSurface");
+        }
+        surfaces.push_back(ts);
+    }
+
+    std::tie(width, height) = surfaces[0]->getSize();
+    Rx = surfaces[0]->getRx();
+    Ry = surfaces[0]->getRy();
+    Wx = surfaces[0]->getWx();
+    Wy = surfaces[0]->getWy();
+    tau = surfaces[0]->getTau();
+
+    for (auto ts : surfaces) {
+        if (ts->getSize() != surfaces[0]->getSize() || ts->getRx() != Rx || ts->getRy() != Ry || ts->getTau() != tau) {
+            throw std::invalid_argument("All the surfaces of a CorrelationLayer must have the same parameters");
+        }
+    }
+
+    if (Rx == 0 || Ry == 0) {
+        throw std::invalid_argument("CorrelationLayer requires windows smaller than the context");
+    }
+
+    if (!layer.canCluster() || !layer.hasCentroids()) {
+        throw std::invalid_argument("CorrelationLayer requires a trained clusterer");
+    }
+
+    cosine = usesCosine(layer.getClusterer());
+    layer.toggleLearning(false);
+
+    const auto& centroids = layer.getCentroids();
+    clusters = centroids.size();
+
+    kernels.resize(size_t(Wy) * Wx * clusters);
+    norms.resize(clusters);
+    for (uint16_t k = 0; k < clusters; k++) {
+        for (uint16_t i = 0; i < Wy; i++) {
+            for (uint16_t j = 0; j < Wx; j++) {
+                kernels[(size_t(i) * Wx + j) * clusters + k] = centroids[k](i, j);
+            }
+        }
+        // the norm for the cosine distance, the squared norm for the Euclidean distances
+        norms[k] = cosine ? centroids[k].matrix().norm() : centroids[k].matrix().squaredNorm();
+    }
+
+    reset();
+
+}
+
+event CorrelationLayer::process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip_check) {
+
+    cpphots_assert(p < surfaces.size());
+    cpphots_assert(x < width && y < height);
+
+    layer.update(t, x, y, p);
+
+    if ((t - t0) / tau > REBASE_TAUS) {
+        rebase(t);
+    } else {
+
+        // only the surfaces with the updated pixel in their window change
+        size_t pw = width + 2*Rx;
+        double& e = decayed[p][(y + Ry) * pw + x + Rx];
+        double ne = std::exp((surfaces[p]->getLastUpdate(x, y) - t0) / tau);
+        double delta = ne - e;
+        e = ne;
+
+        auto& map = maps[p];
+        for (int i = 0; i < Wy; i++) {
+            int ye = int(y) + Ry - i;
+            if (ye < 0 || ye >= height) {
+                continue;
+            }
+            for (int j = 0; j < Wx; j++) {
+                int xe = int(x) + Rx - j;
+                if (xe < 0 || xe >= width) {
+                    continue;
+                }
+                double* m = &map[(size_t(ye) * width + xe) * clusters];
+                const double* kern = &kernels[(size_t(i) * Wx + j) * clusters];
+                for (uint16_t k = 0; k < clusters; k++) {
+                    m[k] += delta * kern[k];
+                }
+            }
+        }
+
+    }
+
+    if (!skip_check && !surfaces[p]->isValid(t, x, y)) {
+        return invalid_event;
+    }
+
+    // the norm of the surface is the same for all the centroids
+    double scale = std::exp(-(t - t0) / tau);
+    const double* m = &maps[p][(size_t(y) * width + x) * clusters];
+    uint16_t best = 0;
+    double best_score = -std::numeric_limits<double>::infinity();
+    for (uint16_t k = 0; k < clusters; k++) {
+        double score;
+        if (cosine) {
+            score = norms[k] > 0 ? m[k] / norms[k] : 0.0;
+        } else {
+            score = 2 * scale * m[k] - norms[k];
+        }
+        if (score > best_score) {
+            best_score = score;
+            best = k;
+        }
+    }
+
+    if (layer.hasRemapper()) {
+        return layer.getRemapper().remapEvent({t, x, y, p}, best);
+    }
+
+    return event{t, x, y, best};
+
+}
+
+void CorrelationLayer::reset() {
+
+    layer.reset();
+
+    decayed.assign(surfaces.size(), std::vector<double>(size_t(width + 2*Rx) * (height + 2*Ry)));
+    maps.assign(surfaces.size(), std::vector<double>(size_t(width) * height * clusters));
+
+    rebase(0);
+
+}
+
+double CorrelationLayer::getCorrelation(uint64_t t, uint16_t x, uint16_t y, uint16_t p, uint16_t k) const {
+
+    cpphots_assert(p < surfaces.size() && k < clusters);
+    cpphots_assert(x < width && y < height);
+
+    return std::exp(-(t - t0) / tau) * maps[p][(size_t(y) * width + x) * clusters + k];
+
+}
+
+const Layer& CorrelationLayer::getLayer() const {
+    return layer;
+}
+
+MemoryUsage CorrelationLayer::memoryUsage() const {
+
+    MemoryUsage mem = layer.memoryUsage();
+
+    size_t bytes = vectorMemory(kernels) + vectorMemory(norms);
+    for (size_t p = 0; p < surfaces.size(); p++) {
+        bytes += vectorMemory(decayed[p]) + vectorMemory(maps[p]);
+    }
+    mem.add("correlation", bytes);
+
+    return mem;
+
+}
+
+void CorrelationLayer::rebase(uint64_t t) {
+
+    t0 = t;
+
+    size_t pw = width + 2*Rx;
+    for (size_t p = 0; p < surfaces.size(); p++) {
+
+        // the padding is never updated
+        auto& e = decayed[p];
+        std::fill(e.begin(), e.end(), std::exp((-tau - t0) / tau));
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                e[(y + Ry) * pw + x + Rx] = std::exp((surfaces[p]->getLastUpdate(x, y) - t0) / tau);
+            }
+        }
+
+        auto& map = maps[p];
+        std::fill(map.begin(), map.end(), 0.0);
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                double* m = &map[(y * width + x) * clusters];
+                for (size_t i = 0; i < Wy; i++) {
+                    for (size_t j = 0; j < Wx; j++) {
+                        double v = e[(y + i) * pw + x + j];
+                        const double* kern = &kernels[(i * Wx + j) * clusters];
+                        for (uint16_t k = 0; k < clusters; k++) {
+                            m[k] += v * kern[k];
+                        }
+                    }
+                }
+            }
+        }
+
+    }
+
+}
+
+}
@@ -0,0 +1,68 @@
+#include "cpphots/interfaces/memory.h"
+
+
+namespace cpphots {
+
+MemoryUsage& MemoryUsage::add(const std::string& category, size_t bytes) {
+    categories[category] += bytes;
+    return *this;
+}
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) {
+    for (const auto& [category, bytes] : other.categories) {
+        categories[category] += bytes;
+    }
+    return *this;
+}
+
+size_t MemoryUsage::get(const std::string& category) const {
+    auto it = categories.find(category);
+    if (it == categories.end()) {
+        return 0;
+    }
+    return it->second;
+}
+
+size_t MemoryUsage::total() const {
+    size_t tot = 0;
+    for (const auto& c : categories) {
+        tot += c.second;
+    }
+    return tot;
+}
+
+MemoryUsage operator+(MemoryUsage m1, const MemoryUsage& m2) {
+    m1 += m2;
+    return m1;
+}
+
+MemoryUsage operator*(MemoryUsage m, size_t n) {
+    for (auto& c : m.categories) {
+        c.second *= n;
+    }
+    return m;
+}
+
+std::ostream& operator<<(std::ostream& out, const MemoryUsage& mem) {
+
+    for (const auto& [category, bytes] : mem.categories) {
+        out << category << ": " << bytes << "\n";
+    }
+    out << "total: " << mem.total() << "\n";
+
+    return out;
+
+}
+
+size_t arrayMemory(const std::vector<TimeSurfaceType>& arrays) {
+
+    size_t mem = vectorMemory(arrays);
+    for (const auto& a : arrays) {
+        mem += arrayMemory(a);
+    }
+
+    return mem;
+
+}
+
+}
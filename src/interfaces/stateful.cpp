@@ -0,0 +1,97 @@
+#include "cpphots/interfaces/stateful.h"
+
+#include <stdexcept>
+#include <string>
+
+
+namespace cpphots {
+
+namespace interfaces {
+
+void StateBuffer::clear() {
+    buffer.clear();
+    read_pos = 0;
+}
+
+void StateBuffer::rewind() {
+    read_pos = 0;
+}
+
+size_t StateBuffer::size() const {
+    return buffer.size();
+}
+
+const char* StateBuffer::data() const {
+    return buffer.data();
+}
+
+void StateBuffer::writeBytes(const void* src, size_t bytes) {
+    const char* csrc = static_cast<const char*>(src);
+    buffer.insert(buffer.end(), csrc, csrc + bytes);
+}
+
+void StateBuffer::readBytes(void* dst, size_t bytes) {
+
+    if (read_pos + bytes > buffer.size()) {
+        throw std::runtime_error("Not enough data in state buffer");
+    }
+
+    std::memcpy(dst, buffer.data() + read_pos, bytes);
+    read_pos += bytes;
+
+}
+
+void StateBuffer::writeArray(const TimeSurfaceType& array) {
+    write<int64_t>(array.rows());
+    write<int64_t>(array.cols());
+    writeBytes(array.data(), array.size() * sizeof(TimeSurfaceScalarType));
+}
+
+void StateBuffer::readArray(TimeSurfaceType& array) {
+    int64_t rows = read<int64_t>();
+    int64_t cols = read<int64_t>();
+    array.resize(rows, cols);
+    readBytes(array.data(), array.size() * sizeof(TimeSurfaceScalarType));
+}
+
+void StateBuffer::readArrayInPlace(TimeSurfaceType& array) {
+
+    int64_t rows = read<int64_t>();
+    int64_t cols = read<int64_t>();
+
+    if (rows != array.rows() || cols != array.cols()) {
+        throw std::runtime_error("Wrong array size in state buffer: expected " + std::to_string(array.rows()) + "x" + std::to_string(array.cols()) +
+                                 ", found " + std::to_string(rows) + "x" + std::to_string(cols));
+    }
+
+    readBytes(array.data(), array.size() * sizeof(TimeSurfaceScalarType));
+
+}
+
+void StateBuffer::writeTo(std::ostream& out) const {
+    uint64_t sz = buffer.size();
+    out.write(reinterpret_cast<const char*>(&sz), sizeof(sz));
+    out.write(buffer.data(), buffer.size());
+}
+
+void StateBuffer::readFrom(std::istream& in) {
+
+    uint64_t sz;
+    in.read(reinterpret_cast<char*>(&sz), sizeof(sz));
+    if (!in) {
+        throw std::runtime_error("Cannot read state buffer from stream");
+    }
+
+    buffer.resize(sz);
+    in.read(buffer.data(), sz);
+    if (!in) {
+        throw std::runtime_error("Cannot read state buffer from stream");
+    }
+
+    read_pos = 0;
+
+}
+
+}
+
+}
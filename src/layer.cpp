@@ -1,6 +1,7 @@
 #include "cpphots/layer.h"
 
 #include "cpphots/load.h"
+#include "cpphots/trace.h"
 
 
 namespace cpphots {
@@ -215,15 +216,31 @@ event Layer::process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip_c
 
     cpphots_assert(tspool != nullptr);
 
-    auto [surface, good] = tspool->updateAndCompute(t, x, y, p);
+    CPPHOTS_TRACE_HOT_SPAN("Layer::process");
+
+    TimeSurfaceType surface;
+    bool good;
+    if (skip_check) {
+        CPPHOTS_TRACE_SPAN("Layer::updateAndCompute");
+        std::tie(surface, good) = tspool->updateAndCompute(t, x, y, p);
+    } else {
+        // invalid events can be rejected before computing their surface
+        CPPHOTS_TRACE_SPAN("Layer::updateAndCompute");
+        tspool->update(t, x, y, p);
+        std::tie(surface, good) = tspool->computeIfValid(t, x, y, p);
+    }
 
     // if the surface is not good we say it upstream
     if (!skip_check && !good) {
         return invalid_event;
     }
 
+    // clustering uses the position of the event, not of the cell
+    uint16_t ex = x, ey = y;
+
     // supercell modifier
     if (supercell) {
+        CPPHOTS_TRACE_SPAN("Layer::supercell");
         std::tie(x, y) = supercell->findCell(x, y);
         surface = supercell->averageTS(surface, x, y);
         if (x == invalid_coordinates.first || y == invalid_coordinates.second) {
@@ -235,7 +252,8 @@ event Layer::process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip_c
 
     // if there is a clustering algorithm we can use it
     if (clusterer) {
-        k = clusterer->cluster(surface);
+        CPPHOTS_TRACE_SPAN("Layer::cluster");
+        k = clusterer->cluster(surface, ex, ey);
     }
 
     // remap event
@@ -251,6 +269,14 @@ bool Layer::canCluster() const {
     return clusterer != nullptr;
 }
 
+bool Layer::hasRemapper() const {
+    return remapper != nullptr;
+}
+
+bool Layer::hasSuperCell() const {
+    return supercell != nullptr;
+}
+
 void Layer::reset() {
     tspool->reset();
     if (clusterer)
@@ -326,6 +352,62 @@ void Layer::fromStream(std::istream& in) {
 
 }
 
+void Layer::saveState(interfaces::StateBuffer& state) const {
+
+    tspool->saveState(state);
+
+    state.write<bool>(clusterer != nullptr);
+    if (clusterer) {
+        clusterer->saveState(state);
+    }
+
+    state.write<bool>(supercell != nullptr);
+    if (supercell) {
+        supercell->saveState(state);
+    }
+
+}
+
+void Layer::loadState(interfaces::StateBuffer& state) {
+
+    tspool->loadState(state);
+
+    if (state.read<bool>() != (clusterer != nullptr)) {
+        throw std::runtime_error("Clusterer presence does not match state buffer");
+    }
+    if (clusterer) {
+        clusterer->loadState(state);
+    }
+
+    if (state.read<bool>() != (supercell != nullptr)) {
+        throw std::runtime_error("SuperCell presence does not match state buffer");
+    }
+    if (supercell) {
+        supercell->loadState(state);
+    }
+
+}
+
+MemoryUsage Layer::memoryUsage() const {
+
+    MemoryUsage mem = tspool->memoryUsage();
+
+    if (clusterer) {
+        mem += clusterer->memoryUsage();
+    }
+
+    if (remapper) {
+        mem += remapper->memoryUsage();
+    }
+
+    if (supercell) {
+        mem += supercell->memoryUsage();
+    }
+
+    return mem;
+
+}
+
 Layer* Layer::clone() const {
     return new Layer(*this);
 }
@@ -353,19 +435,18 @@ void layerSeedCentroids(const ClustererSeedingType& seeding, Layer& layer, const
     layer.reset();
     std::vector<TimeSurfaceType> time_surfaces;
     for (auto& ev : events) {
-        auto surface_good = layer.updateAndCompute(ev);
-        if (valid_only && surface_good.second) {
-            time_surfaces.push_back(surface_good.first);
-        } else if (!valid_only) {
-            time_surfaces.push_back(surface_good.first);
+        if (valid_only) {
+            layer.update(ev);
+            auto surface_good = layer.computeIfValid(ev);
+            if (surface_good.second) {
+                time_surfaces.push_back(surface_good.first);
+            }
+        } else {
+            time_surfaces.push_back(layer.updateAndCompute(ev).first);
         }
     }
 
-    if (time_surfaces.size() < layer.getNumClusters()) {
-        throw std::runtime_error("Not enough good events to seed centroids.");
-    }
-
-    seeding(layer, time_surfaces);
+    layerSeedCentroids(seeding, layer, time_surfaces);
 
 }
 
@@ -376,19 +457,29 @@ void layerSeedCentroids(const ClustererSeedingType& seeding, Layer& layer, const
     for (auto& stream : event_streams) {
         layer.reset();
         for (auto& ev : stream) {
-            auto surface_good = layer.updateAndCompute(ev);
-            if (valid_only && surface_good.second) {
-                time_surfaces.push_back(surface_good.first);
-            } else if (!valid_only) {
-                time_surfaces.push_back(surface_good.first);
+            if (valid_only) {
+                layer.update(ev);
+                auto surface_good = layer.computeIfValid(ev);
+                if (surface_good.second) {
+                    time_surfaces.push_back(surface_good.first);
+                }
+            } else {
+                time_surfaces.push_back(layer.updateAndCompute(ev).first);
             }
         }
     }
 
+    layerSeedCentroids(seeding, layer, time_surfaces);
+
+}
+
+void layerSeedCentroids(const ClustererSeedingType& seeding, Layer& layer, const std::vector<TimeSurfaceType>& time_surfaces) {
+
     if (time_surfaces.size() < layer.getNumClusters()) {
         throw std::runtime_error("Not enough good events to seed centroids.");
     }
 
+    CPPHOTS_TRACE_SPAN("seeding");
     seeding(layer, time_surfaces);
 
 }
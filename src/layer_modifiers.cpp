@@ -26,6 +26,10 @@ void ArrayLayer::fromStream(std::istream& in) {
     in >> n;
 }
 
+MemoryUsage ArrayLayer::memoryUsage() const {
+    return {};
+}
+
 
 SerializingLayer::SerializingLayer(uint16_t width, uint16_t height)
     :w(width), h(height) {}
@@ -61,6 +65,10 @@ void SerializingLayer::fromStream(std::istream& in) {
     in >> h;
 }
 
+MemoryUsage SerializingLayer::memoryUsage() const {
+    return {};
+}
+
 
 
 SuperCell::SuperCell(uint16_t width, uint16_t height, uint16_t K)
@@ -130,6 +138,14 @@ void SuperCell::fromStream(std::istream& in) {
     in >> hmax;
 }
 
+void SuperCell::saveState(interfaces::StateBuffer&) const {}
+
+void SuperCell::loadState(interfaces::StateBuffer&) {}
+
+MemoryUsage SuperCell::memoryUsage() const {
+    return {};
+}
+
 std::pair<uint16_t, uint16_t> SuperCell::getCellCenter(uint16_t cx, uint16_t cy) const {
 
     return {cx * K + K / 2, cy * K + K / 2};
@@ -200,4 +216,64 @@ void SuperCellAverage::fromStream(std::istream& in) {
     cells = std::vector<std::vector<CellMem>>(hcell, std::vector<CellMem>(wcell));
 }
 
-}
\ No newline at end of file
+void SuperCellAverage::saveState(interfaces::StateBuffer& state) const {
+
+    state.write<uint16_t>(wcell);
+    state.write<uint16_t>(hcell);
+
+    for (const auto& row : cells) {
+        for (const auto& cell : row) {
+            state.write(cell.count);
+            if (cell.count > 0) {
+                state.writeArray(cell.ts);
+            }
+        }
+    }
+
+}
+
+void SuperCellAverage::loadState(interfaces::StateBuffer& state) {
+
+    uint16_t w = state.read<uint16_t>();
+    uint16_t h = state.read<uint16_t>();
+    if (w != wcell || h != hcell) {
+        throw std::runtime_error("Wrong number of cells in state buffer");
+    }
+
+    for (auto& row : cells) {
+        for (auto& cell : row) {
+            cell.count = state.read<unsigned int>();
+            if (cell.count > 0) {
+                state.readArray(cell.ts);
+            }
+        }
+    }
+
+}
+
+MemoryUsage SuperCellAverage::memoryUsage() const {
+
+    size_t mem = vectorMemory(cells);
+    for (const auto& row : cells) {
+        mem += vectorMemory(row);
+        for (const auto& cell : row) {
+            mem += arrayMemory(cell.ts);
+        }
+    }
+
+    return MemoryUsage().add("supercell", mem);
+
+}
+
+MemoryUsage SuperCellAverage::estimateMemoryUsage(uint16_t width, uint16_t height, uint16_t K, uint16_t wx, uint16_t wy) {
+
+    size_t wcell = 1 + (width - K) / K;
+    size_t hcell = 1 + (height - K) / K;
+
+    size_t mem = hcell * sizeof(std::vector<CellMem>) + hcell * wcell * (sizeof(CellMem) + arrayMemory(wy, wx));
+
+    return MemoryUsage().add("supercell", mem);
+
+}
+
+}
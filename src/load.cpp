@@ -9,6 +9,7 @@
 #include "cpphots/clustering/gmm.h"
 #endif
 #include "cpphots/clustering/kmeans.h"
+#include "cpphots/clustering/tiled.h"
 #include "cpphots/layer_modifiers.h"
 
 
@@ -24,6 +25,12 @@ TimeSurfacePtr loadTSFromStream(std::istream& in) {
         return TimeSurfacePtr(ts);
     }
 
+    if (metacmd == "EXPONENTIALTIMESURFACE") {
+        ExponentialTimeSurface* ts = new ExponentialTimeSurface();
+        ts->fromStream(in);
+        return TimeSurfacePtr(ts);
+    }
+
     if (metacmd == "WEIGHTEDLINEARTIMESURFACE") {
         WeightedLinearTimeSurface* ts = new WeightedLinearTimeSurface();
         ts->fromStream(in);
@@ -48,13 +55,37 @@ interfaces::TimeSurfacePoolCalculator* loadTSPoolFromStream(std::istream& in) {
 
 }
 
+// create and load C if it matches the metacommand, for every distance policy
+template <template <typename> class C>
+interfaces::Clusterer* loadWithDistance(const std::string& metacmd, std::istream& in) {
+
+    interfaces::Clusterer* clust = nullptr;
+
+    if (metacmd == C<distance::SquaredEuclidean>::getMetacommand()) {
+        clust = new C<distance::SquaredEuclidean>();
+    } else if (metacmd == C<distance::Euclidean>::getMetacommand()) {
+        clust = new C<distance::Euclidean>();
+    } else if (metacmd == C<distance::Manhattan>::getMetacommand()) {
+        clust = new C<distance::Manhattan>();
+    } else if (metacmd == C<distance::Chebyshev>::getMetacommand()) {
+        clust = new C<distance::Chebyshev>();
+    } else if (metacmd == C<distance::Cosine>::getMetacommand()) {
+        clust = new C<distance::Cosine>();
+    }
+
+    if (clust != nullptr) {
+        clust->fromStream(in);
+    }
+
+    return clust;
+
+}
+
 interfaces::Clusterer* loadClustererFromStream(std::istream& in) {
 
     auto metacmd = interfaces::Streamable::getNextMetacommand(in);
 
-    if (metacmd == "COSINECLUSTERER") {
-        CosineClusterer* clust = new CosineClusterer();
-        clust->fromStream(in);
+    if (auto clust = loadWithDistance<BasicCosineClusterer>(metacmd, in)) {
         return clust;
     }
 
@@ -66,8 +97,12 @@ interfaces::Clusterer* loadClustererFromStream(std::istream& in) {
     }
 #endif
 
-    if (metacmd == "KMEANSCLUSTERER") {
-        KMeansClusterer* clust = new KMeansClusterer();
+    if (auto clust = loadWithDistance<BasicKMeansClusterer>(metacmd, in)) {
+        return clust;
+    }
+
+    if (metacmd == "TILEDCLUSTERER") {
+        TiledClusterer* clust = new TiledClusterer();
         clust->fromStream(in);
         return clust;
     }
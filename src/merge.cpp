@@ -0,0 +1,175 @@
+#include "cpphots/merge.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace cpphots {
+
+namespace {
+
+// min-heap on the timestamp, events with the same timestamp keep the arrival order
+struct Later {
+    template <typename E>
+    bool operator()(const E& a, const E& b) const {
+        return a.ev.t > b.ev.t || (a.ev.t == b.ev.t && a.seq > b.seq);
+    }
+};
+
+}
+
+EventMerger::EventMerger(uint64_t window, size_t capacity)
+    :window(window), capacity(capacity) {}
+
+size_t EventMerger::addSource(uint16_t x_offset, uint16_t y_offset, uint16_t p_offset) {
+
+    Source source;
+    source.x_offset = x_offset;
+    source.y_offset = y_offset;
+    source.p_offset = p_offset;
+    sources.push_back(source);
+
+    updateWatermark();
+
+    return sources.size() - 1;
+
+}
+
+size_t EventMerger::getNumSources() const {
+    return sources.size();
+}
+
+bool EventMerger::push(size_t source, const event& ev) {
+
+    Source& src = sources.at(source);
+
+    stats.received++;
+
+    if (emitted_any && ev.t < last_emitted) {
+        src.late++;
+        stats.late++;
+        return false;
+    }
+
+    heap.push_back({{ev.t,
+                     uint16_t(ev.x + src.x_offset),
+                     uint16_t(ev.y + src.y_offset),
+                     uint16_t(ev.p + src.p_offset)},
+                    seq++});
+    std::push_heap(heap.begin(), heap.end(), Later());
+    stats.max_buffered = std::max(stats.max_buffered, heap.size());
+
+    if (!src.started || ev.t > src.latest) {
+        src.started = true;
+        src.latest = ev.t;
+        updateWatermark();
+    }
+
+    return true;
+
+}
+
+size_t EventMerger::push(size_t source, const Events& events) {
+
+    size_t late = 0;
+    for (const auto& ev : events) {
+        late += !push(source, ev);
+    }
+
+    return late;
+
+}
+
+void EventMerger::heartbeat(size_t source, uint64_t t) {
+
+    Source& src = sources.at(source);
+
+    if (!src.started || t > src.latest) {
+        src.started = true;
+        src.latest = t;
+        updateWatermark();
+    }
+
+}
+
+void EventMerger::closeSource(size_t source) {
+    sources.at(source).closed = true;
+    updateWatermark();
+}
+
+void EventMerger::flush() {
+    released = !heap.empty();
+    for (const auto& e : heap) {
+        release_until = std::max(release_until, e.ev.t);
+    }
+}
+
+bool EventMerger::pop(event& ev) {
+
+    if (heap.empty()) {
+        return false;
+    }
+
+    uint64_t t = heap.front().ev.t;
+    bool ready = (!blocked && t <= watermark) || (released && t <= release_until);
+    bool full = capacity > 0 && heap.size() >= capacity;
+
+    if (!ready && !full) {
+        return false;
+    }
+
+    std::pop_heap(heap.begin(), heap.end(), Later());
+    ev = heap.back().ev;
+    heap.pop_back();
+
+    if (!ready) {
+        stats.forced++;
+    }
+    stats.emitted++;
+    emitted_any = true;
+    last_emitted = ev.t;
+
+    return true;
+
+}
+
+size_t EventMerger::process(Network& network, bool skip_check, size_t max) {
+    return consume([&network, skip_check] (const event& ev) { network.process(ev, skip_check); }, max);
+}
+
+size_t EventMerger::getBuffered() const {
+    return heap.size();
+}
+
+uint64_t EventMerger::getWatermark() const {
+    return watermark;
+}
+
+EventMergerStats EventMerger::getStats() const {
+    return stats;
+}
+
+size_t EventMerger::getLateEvents(size_t source) const {
+    return sources.at(source).late;
+}
+
+void EventMerger::updateWatermark() {
+
+    blocked = false;
+    watermark = std::numeric_limits<uint64_t>::max();
+
+    for (const auto& src : sources) {
+        if (src.closed) {
+            continue;
+        }
+        if (!src.started) {
+            blocked = true;
+            watermark = 0;
+            return;
+        }
+        watermark = std::min(watermark, src.latest > window ? src.latest - window : 0);
+    }
+
+}
+
+}
@@ -1,6 +1,8 @@
 #include "cpphots/network.h"
 
 #include "cpphots/load.h"
+#include "cpphots/plan.h"
+#include "cpphots/trace.h"
 
 
 namespace cpphots {
@@ -26,11 +28,15 @@ event Network::process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip
 
 event Network::process(const event& ev, bool skip_check) {
 
+    CPPHOTS_TRACE_HOT_SPAN("Network::process");
+
     event nev = ev;
-    for (auto& layer : layers) {
+    for (size_t l = 0; l < layers.size(); l++) {
+
+        CPPHOTS_TRACE_SPAN_ARG("Network::layer", l);
 
         // Events next_evs;
-        nev = layer.process(nev, skip_check);
+        nev = layers[l].process(nev, skip_check);
 
         if (nev == invalid_event) {
             return invalid_event;
@@ -89,6 +95,10 @@ Network Network::getSubnetwork(int start, int stop) const {
 
 }
 
+ExecutionPlan Network::compile(const Events& sample) const {
+    return ExecutionPlan(*this, sample);
+}
+
 void Network::reset() {
     for (auto& l : layers) {
         l.reset();
@@ -97,6 +107,7 @@ void Network::reset() {
 
 
 void Network::toStream(std::ostream& out) const {
+    CPPHOTS_TRACE_SPAN("Network::toStream");
     writeMetacommand(out, "NETWORKBEGIN");
     for (const auto& l : layers) {
         l.toStream(out);
@@ -107,6 +118,8 @@ void Network::toStream(std::ostream& out) const {
 
 void Network::fromStream(std::istream& in) {
 
+    CPPHOTS_TRACE_SPAN("Network::fromStream");
+
     layers.clear();
 
     matchMetacommandRequired(in, "NETWORKBEGIN");
@@ -127,6 +140,42 @@ void Network::fromStream(std::istream& in) {
 
 }
 
+void Network::saveState(interfaces::StateBuffer& state) const {
+
+    CPPHOTS_TRACE_SPAN("Network::saveState");
+
+    state.write<uint64_t>(layers.size());
+    for (const auto& l : layers) {
+        l.saveState(state);
+    }
+
+}
+
+void Network::loadState(interfaces::StateBuffer& state) {
+
+    CPPHOTS_TRACE_SPAN("Network::loadState");
+
+    if (state.read<uint64_t>() != layers.size()) {
+        throw std::runtime_error("Wrong number of layers in state buffer");
+    }
+
+    for (auto& l : layers) {
+        l.loadState(state);
+    }
+
+}
+
+MemoryUsage Network::memoryUsage() const {
+
+    MemoryUsage mem;
+    for (const auto& l : layers) {
+        mem += l.memoryUsage();
+    }
+
+    return mem;
+
+}
+
 Network::iterator Network::begin() noexcept {
     return layers.begin();
 }
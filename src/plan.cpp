@@ -0,0 +1,392 @@
+#include "cpphots/plan.h"
+
+#include <stdexcept>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <random>
+#include <typeinfo>
+#include <algorithm>
+#include <iomanip>
+
+#include "cpphots/assert.h"
+#include "cpphots/trace.h"
+#include "cpphots/clustering/kmeans.h"
+
+
+namespace cpphots {
+
+namespace {
+
+// sample used when compiling without events
+Events randomSample(const Layer& layer, size_t n_events = 20000) {
+
+    auto [width, height] = layer.getSize();
+
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<uint16_t> xd(0, width - 1);
+    std::uniform_int_distribution<uint16_t> yd(0, height - 1);
+    std::uniform_int_distribution<uint16_t> pd(0, layer.getNumSurfaces() - 1);
+
+    Events events;
+    events.reserve(n_events);
+    for (size_t i = 0; i < n_events; i++) {
+        events.push_back({i, xd(gen), yd(gen), pd(gen)});
+    }
+
+    return events;
+
+}
+
+// best of a few runs, in nanoseconds per event
+template <typename F>
+double timePerEvent(size_t n_events, F&& run) {
+
+    double best = std::numeric_limits<double>::infinity();
+    for (int rep = 0; rep < 3; rep++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    return best / std::max<size_t>(n_events, 1);
+
+}
+
+// results of the kernels must be used, or timings are meaningless
+volatile size_t timing_sink;
+
+template <typename Distance>
+bool compileKMeans(interfaces::Clusterer* clusterer, const std::vector<TimeSurfaceType>& tss, PlanDecision& decision) {
+
+    auto kmeans = dynamic_cast<BasicKMeansClusterer<Distance>*>(clusterer);
+    if (!kmeans) {
+        return false;
+    }
+
+    auto run = [&tss] (BasicKMeansClusterer<Distance>& clust, bool cache) {
+        // the cache starts empty at every run
+        if (cache) {
+            clust.enableLabelCache();
+        }
+        size_t sum = 0;
+        for (const auto& ts : tss) {
+            sum += clust.cluster(ts);
+        }
+        timing_sink = sum;
+    };
+
+    BasicKMeansClusterer<Distance> brute = *kmeans;
+    brute.disableLabelCache();
+    BasicKMeansClusterer<Distance> cached = *kmeans;
+
+    double brute_time = timePerEvent(tss.size(), [&] () { run(brute, false); });
+    double cached_time = timePerEvent(tss.size(), [&] () { run(cached, true); });
+
+    decision.candidates = {{"brute-force", brute_time}, {"label-cache", cached_time}};
+    if (cached_time < brute_time) {
+        decision.choice = "label-cache";
+        kmeans->enableLabelCache();
+    } else {
+        decision.choice = "brute-force";
+        kmeans->disableLabelCache();
+    }
+
+    return true;
+
+}
+
+}
+
+ExecutionPlan::ExecutionPlan(const Network& net, const Events& sample)
+    :network(net) {
+
+    if (network.getNumLayers() == 0) {
+        throw std::invalid_argument("Cannot compile a network without layers");
+    }
+
+    for (auto& layer : network) {
+        if (layer.canCluster()) {
+            if (!layer.hasCentroids()) {
+                throw std::invalid_argument("Layers must be trained before compiling the network");
+            }
+            layer.toggleLearning(false);
+        }
+    }
+    network.reset();
+
+    Events input = sample.empty() ? randomSample(network[0]) : sample;
+
+    layers.resize(network.getNumLayers());
+    for (size_t l = 0; l < network.getNumLayers(); l++) {
+
+        compileSurfaces(l, input);
+        compileClustering(l, input);
+
+        if (l + 1 == network.getNumLayers()) {
+            break;
+        }
+
+        // input of the next layer, invalid events are kept only if no event is valid
+        Layer layer = network[l];
+        Events next;
+        for (bool skip_check : {false, true}) {
+            layer.reset();
+            for (const auto& ev : input) {
+                event nev = layer.process(ev, skip_check);
+                if (nev != invalid_event) {
+                    next.push_back(nev);
+                }
+            }
+            if (!next.empty()) {
+                break;
+            }
+        }
+        input = std::move(next);
+
+    }
+
+    reset();
+
+}
+
+event ExecutionPlan::process(uint64_t t, uint16_t x, uint16_t y, uint16_t p, bool skip_check) {
+
+    return process({t, x, y, p}, skip_check);
+
+}
+
+event ExecutionPlan::process(const event& ev, bool skip_check) {
+
+    CPPHOTS_TRACE_HOT_SPAN("ExecutionPlan::process");
+
+    event nev = ev;
+    for (size_t l = 0; l < layers.size(); l++) {
+
+        if (layers[l].kernel == SurfaceKernel::Generic) {
+            nev = network[l].process(nev, skip_check);
+        } else {
+            nev = processLayer(l, nev, skip_check);
+        }
+
+        if (nev == invalid_event) {
+            return invalid_event;
+        }
+
+    }
+
+    return nev;
+
+}
+
+void ExecutionPlan::reset() {
+    network.reset();
+}
+
+const Network& ExecutionPlan::getNetwork() const {
+    return network;
+}
+
+const std::vector<PlanDecision>& ExecutionPlan::getDecisions() const {
+    return decisions;
+}
+
+event ExecutionPlan::processLayer(size_t l, const event& ev, bool skip_check) {
+
+    LayerPlan& lp = layers[l];
+
+    cpphots_assert(ev.p < lp.surfaces.size());
+    LinearTimeSurface& ts = *lp.surfaces[ev.p];
+
+    ts.update(ev.t, ev.x, ev.y);
+
+    if (!skip_check && !ts.mayBeValid(ev.x, ev.y)) {
+        return invalid_event;
+    }
+
+    bool good = computeSurface(lp.kernel, ts, ev, lp.buffer);
+    if (!skip_check && !good) {
+        return invalid_event;
+    }
+
+    uint16_t k = ev.p;
+    if (lp.clusterer) {
+        k = lp.clusterer->cluster(lp.buffer, ev.x, ev.y);
+    }
+
+    if (lp.remapper) {
+        return lp.remapper->remapEvent(ev, k);
+    }
+
+    return event{ev.t, ev.x, ev.y, k};
+
+}
+
+bool ExecutionPlan::computeSurface(SurfaceKernel kernel, const LinearTimeSurface& ts, const event& ev, TimeSurfaceType& buffer) {
+
+    switch (kernel) {
+        case SurfaceKernel::Fixed3:
+            return ts.computeFixedInto<3>(ev.t, ev.x, ev.y, buffer);
+        case SurfaceKernel::Fixed5:
+            return ts.computeFixedInto<5>(ev.t, ev.x, ev.y, buffer);
+        case SurfaceKernel::Fixed7:
+            return ts.computeFixedInto<7>(ev.t, ev.x, ev.y, buffer);
+        case SurfaceKernel::Fixed9:
+            return ts.computeFixedInto<9>(ev.t, ev.x, ev.y, buffer);
+        case SurfaceKernel::Fixed11:
+            return ts.computeFixedInto<11>(ev.t, ev.x, ev.y, buffer);
+        default:
+            return ts.computeInto(ev.t, ev.x, ev.y, buffer);
+    }
+
+}
+
+std::string ExecutionPlan::kernelName(SurfaceKernel kernel) {
+
+    switch (kernel) {
+        case SurfaceKernel::Generic:
+            return "generic";
+        case SurfaceKernel::Dynamic:
+            return "dynamic";
+        case SurfaceKernel::Fixed3:
+            return "fixed-3x3";
+        case SurfaceKernel::Fixed5:
+            return "fixed-5x5";
+        case SurfaceKernel::Fixed7:
+            return "fixed-7x7";
+        case SurfaceKernel::Fixed9:
+            return "fixed-9x9";
+        default:
+            return "fixed-11x11";
+    }
+
+}
+
+void ExecutionPlan::compileSurfaces(size_t l, const Events& input) {
+
+    Layer& layer = network[l];
+    LayerPlan& lp = layers[l];
+
+    lp.clusterer = layer.canCluster() ? &layer.getClusterer() : nullptr;
+    lp.remapper = layer.hasRemapper() ? &layer.getRemapper() : nullptr;
+
+    // only linear surfaces in a standard pool can be computed in place
+    bool specializable = !layer.hasSuperCell() && typeid(layer.getTSPool()) == typeid(TimeSurfacePool);
+    for (size_t i = 0; specializable && i < layer.getNumSurfaces(); i++) {
+        specializable = typeid(*layer.getSurface(i)) == typeid(LinearTimeSurface);
+    }
+
+    std::vector<SurfaceKernel> kernels{SurfaceKernel::Generic};
+    if (specializable) {
+        kernels.push_back(SurfaceKernel::Dynamic);
+        uint16_t wx = layer.getSurface(0)->getWx();
+        uint16_t wy = layer.getSurface(0)->getWy();
+        const SurfaceKernel fixed[] = {SurfaceKernel::Fixed3, SurfaceKernel::Fixed5, SurfaceKernel::Fixed7, SurfaceKernel::Fixed9, SurfaceKernel::Fixed11};
+        if (wx == wy && wx >= 3 && wx <= 11 && wx % 2 == 1) {
+            kernels.push_back(fixed[(wx - 3) / 2]);
+        }
+    }
+
+    PlanDecision decision{l, "surface", "", {}};
+    double best = std::numeric_limits<double>::infinity();
+    for (auto kernel : kernels) {
+
+        std::unique_ptr<interfaces::TimeSurfacePoolCalculator> pool(layer.getTSPool().clone());
+        double time;
+
+        if (kernel == SurfaceKernel::Generic) {
+            time = timePerEvent(input.size(), [&] () {
+                pool->reset();
+                size_t sum = 0;
+                for (const auto& ev : input) {
+                    sum += pool->updateAndCompute(ev).second;
+                }
+                timing_sink = sum;
+            });
+        } else {
+            std::vector<LinearTimeSurface*> surfaces;
+            for (size_t i = 0; i < pool->getNumSurfaces(); i++) {
+                surfaces.push_back(dynamic_cast<LinearTimeSurface*>(pool->getSurface(i)));
+            }
+            TimeSurfaceType buffer(surfaces[0]->getWy(), surfaces[0]->getWx());
+            time = timePerEvent(input.size(), [&] () {
+                pool->reset();
+                size_t sum = 0;
+                for (const auto& ev : input) {
+                    surfaces[ev.p]->update(ev.t, ev.x, ev.y);
+                    sum += computeSurface(kernel, *surfaces[ev.p], ev, buffer);
+                }
+                timing_sink = sum;
+            });
+        }
+
+        decision.candidates.push_back({kernelName(kernel), time});
+        if (time < best) {
+            best = time;
+            lp.kernel = kernel;
+        }
+
+    }
+    decision.choice = kernelName(lp.kernel);
+    decisions.push_back(decision);
+
+    lp.surfaces.clear();
+    if (lp.kernel != SurfaceKernel::Generic) {
+        for (size_t i = 0; i < layer.getNumSurfaces(); i++) {
+            lp.surfaces.push_back(dynamic_cast<LinearTimeSurface*>(layer.getSurface(i)));
+        }
+        lp.buffer.resize(lp.surfaces[0]->getWy(), lp.surfaces[0]->getWx());
+    }
+
+}
+
+void ExecutionPlan::compileClustering(size_t l, const Events& input) {
+
+    Layer& layer = network[l];
+
+    if (!layer.canCluster()) {
+        return;
+    }
+
+    PlanDecision decision{l, "clustering", "generic", {}};
+
+    // surfaces of the sample, as seen by the clusterer
+    std::vector<TimeSurfaceType> tss;
+    std::unique_ptr<interfaces::TimeSurfacePoolCalculator> pool(layer.getTSPool().clone());
+    pool->reset();
+    for (const auto& ev : input) {
+        auto [surface, good] = pool->updateAndCompute(ev);
+        if (good) {
+            tss.push_back(std::move(surface));
+        }
+    }
+
+    interfaces::Clusterer* clusterer = &layer.getClusterer();
+    if (!tss.empty() && !layer.hasSuperCell()) {
+        // the label cache never verifies with the cosine distance
+        compileKMeans<distance::SquaredEuclidean>(clusterer, tss, decision) ||
+        compileKMeans<distance::Euclidean>(clusterer, tss, decision) ||
+        compileKMeans<distance::Manhattan>(clusterer, tss, decision) ||
+        compileKMeans<distance::Chebyshev>(clusterer, tss, decision);
+    }
+
+    decisions.push_back(decision);
+
+}
+
+std::ostream& operator<<(std::ostream& out, const ExecutionPlan& plan) {
+
+    for (const auto& decision : plan.getDecisions()) {
+        out << "layer " << decision.layer << " " << decision.stage << ": " << decision.choice;
+        for (const auto& [name, time] : decision.candidates) {
+            out << " | " << name << " " << std::fixed << std::setprecision(1) << time << " ns";
+        }
+        out << std::defaultfloat << "\n";
+    }
+
+    return out;
+
+}
+
+}
@@ -0,0 +1,225 @@
+#include "cpphots/render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "cpphots/time_surface.h"
+#include "cpphots/trace.h"
+
+
+namespace cpphots {
+
+namespace {
+
+// most recent update in a block, sparse contexts are read without building the full context
+TimeSurfaceScalarType newestUpdate(const interfaces::TimeSurfaceCalculator& ts, uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+
+    auto base = dynamic_cast<const TimeSurfaceBase*>(&ts);
+    if (base && base->isSparseContext()) {
+        TimeSurfaceScalarType newest = -std::numeric_limits<TimeSurfaceScalarType>::infinity();
+        for (uint16_t j = y; j < y + h; j++) {
+            for (uint16_t i = x; i < x + w; i++) {
+                newest = std::max(newest, base->getLastUpdate(i, j));
+            }
+        }
+        return newest;
+    }
+
+    auto [width, height] = ts.getSize();
+    const auto& ctx = ts.getFullContext();
+    uint16_t rx = (ctx.cols() - width) / 2;
+    uint16_t ry = (ctx.rows() - height) / 2;
+
+    return ctx.block(y + ry, x + rx, h, w).maxCoeff();
+
+}
+
+}
+
+FrameRenderer::FrameRenderer(uint16_t width, uint16_t height, uint16_t polarities, uint16_t tile_size, unsigned int threads)
+    :width(width), height(height), polarities(polarities), tile_size(tile_size), threads(threads) {
+
+    if (width == 0 || height == 0 || polarities == 0) {
+        throw std::invalid_argument("Cannot render empty frames");
+    }
+
+    if (tile_size == 0) {
+        throw std::invalid_argument("The size of the tiles must be positive");
+    }
+
+    if (this->threads == 0) {
+        this->threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    tiles_x = (width + tile_size - 1) / tile_size;
+    tiles_y = (height + tile_size - 1) / tile_size;
+
+    frames.assign(polarities, TimeSurfaceType::Zero(height, width));
+    tile_states.resize(getNumTiles() * polarities);
+
+    const std::vector<Color> palette{{0, 0, 255}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}};
+    for (uint16_t p = 0; p < polarities; p++) {
+        colors.push_back(palette[p % palette.size()]);
+    }
+
+}
+
+FrameRenderer::FrameRenderer(const interfaces::TimeSurfacePoolCalculator& pool, uint16_t tile_size, unsigned int threads)
+    :FrameRenderer(pool.getSize().first, pool.getSize().second, pool.getNumSurfaces(), tile_size, threads) {}
+
+const std::vector<TimeSurfaceType>& FrameRenderer::render(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t) {
+    renderTiles(pool, t, Output::Float);
+    return frames;
+}
+
+const std::vector<std::vector<uint8_t>>& FrameRenderer::renderQuantized(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t) {
+
+    if (gray.empty()) {
+        gray.assign(polarities, std::vector<uint8_t>(size_t(width) * height, 0));
+    }
+
+    renderTiles(pool, t, Output::Quantized);
+
+    return gray;
+
+}
+
+const std::vector<uint8_t>& FrameRenderer::renderColor(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t) {
+
+    if (rgb.empty()) {
+        rgb.assign(size_t(width) * height * 3, 0);
+    }
+
+    renderTiles(pool, t, Output::Color);
+
+    return rgb;
+
+}
+
+void FrameRenderer::setColors(const std::vector<Color>& colors) {
+
+    if (colors.size() != polarities) {
+        throw std::invalid_argument("One colour per polarity is required");
+    }
+
+    this->colors = colors;
+
+    if (last_output == Output::Color) {
+        invalidate();
+    }
+
+}
+
+void FrameRenderer::invalidate() {
+    last_output = Output::None;
+}
+
+size_t FrameRenderer::getNumTiles() const {
+    return size_t(tiles_x) * tiles_y;
+}
+
+size_t FrameRenderer::getRenderedTiles() const {
+    return rendered;
+}
+
+void FrameRenderer::renderTiles(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t, Output output) {
+
+    CPPHOTS_TRACE_SPAN("FrameRenderer::render");
+
+    if (pool.getNumSurfaces() != polarities || pool.getSize() != std::make_pair(width, height)) {
+        throw std::invalid_argument("The pool does not match the size of the renderer");
+    }
+
+    // going back in time, decayed tiles may not be decayed anymore
+    bool force = (output != last_output) || (t < last_t);
+
+    size_t n_tiles = getNumTiles();
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> count{0};
+
+    auto work = [&] () {
+        size_t local = 0;
+        for (size_t i = next++; i < n_tiles; i = next++) {
+            local += renderTile(pool, t, i, output, force);
+        }
+        count += local;
+    };
+
+    std::vector<std::thread> pool_threads;
+    for (unsigned int i = 1; i < std::min<size_t>(threads, n_tiles); i++) {
+        pool_threads.emplace_back(work);
+    }
+    work();
+    for (auto& th : pool_threads) {
+        th.join();
+    }
+
+    rendered = count;
+    last_output = output;
+    last_t = t;
+
+}
+
+bool FrameRenderer::renderTile(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t, size_t tile, Output output, bool force) {
+
+    uint16_t tx = (tile % tiles_x) * tile_size;
+    uint16_t ty = (tile / tiles_x) * tile_size;
+    uint16_t w = std::min<uint16_t>(tile_size, width - tx);
+    uint16_t h = std::min<uint16_t>(tile_size, height - ty);
+
+    TileState* states = &tile_states[tile * polarities];
+
+    // the most recent timestamp tells if the tile was updated, reading it is much cheaper than decaying
+    std::vector<TimeSurfaceScalarType> newest(polarities);
+    bool skip = !force;
+    for (uint16_t p = 0; p < polarities; p++) {
+        newest[p] = newestUpdate(*pool.getSurface(p), tx, ty, w, h);
+        skip = skip && states[p].decayed && newest[p] == states[p].newest;
+    }
+
+    if (skip) {
+        return false;
+    }
+
+    for (uint16_t p = 0; p < polarities; p++) {
+        auto block = frames[p].block(ty, tx, h, w);
+        pool.getSurface(p)->sampleContextBlock(t, tx, ty, w, h, block);
+        states[p].newest = newest[p];
+        states[p].decayed = (block == 0).all();
+    }
+
+    if (output == Output::Quantized) {
+        for (uint16_t p = 0; p < polarities; p++) {
+            for (uint16_t y = ty; y < ty + h; y++) {
+                for (uint16_t x = tx; x < tx + w; x++) {
+                    TimeSurfaceScalarType v = std::clamp<TimeSurfaceScalarType>(frames[p](y, x), 0, 1);
+                    gray[p][size_t(y) * width + x] = uint8_t(v * 255 + 0.5f);
+                }
+            }
+        }
+    } else if (output == Output::Color) {
+        for (uint16_t y = ty; y < ty + h; y++) {
+            for (uint16_t x = tx; x < tx + w; x++) {
+                TimeSurfaceScalarType c[3] = {0, 0, 0};
+                for (uint16_t p = 0; p < polarities; p++) {
+                    TimeSurfaceScalarType v = std::clamp<TimeSurfaceScalarType>(frames[p](y, x), 0, 1);
+                    for (int k = 0; k < 3; k++) {
+                        c[k] += v * colors[p][k];
+                    }
+                }
+                uint8_t* px = &rgb[(size_t(y) * width + x) * 3];
+                for (int k = 0; k < 3; k++) {
+                    px[k] = uint8_t(std::min<TimeSurfaceScalarType>(c[k], 255) + 0.5f);
+                }
+            }
+        }
+    }
+
+    return true;
+
+}
+
+}
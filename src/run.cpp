@@ -1,36 +1,125 @@
 #include "cpphots/run.h"
 
+#include <limits>
+#include <stdexcept>
+
 #include "cpphots/events_utils.h"
 #include "cpphots/interfaces/time_surface.h"
 #include "cpphots/interfaces/clustering.h"
+#include "cpphots/trace.h"
 
 
 namespace cpphots {
 
-Events train(Network& network, Events training_events, const ClustererSeedingType& seeding, bool skip_check) {
+namespace {
+
+void seedFromAllStreams(const ClustererSeedingType& seeding, Layer& layer, std::vector<std::vector<TimeSurfaceType>>& tssvec) {
+
+    // surfaces are moved (not copied) into a single vector for seeding
+    size_t total = 0;
+    for (const auto& tss : tssvec) {
+        total += tss.size();
+    }
+
+    std::vector<TimeSurfaceType> all_tss;
+    all_tss.reserve(total);
+    for (auto& tss : tssvec) {
+        for (auto& ts : tss) {
+            all_tss.push_back(std::move(ts));
+        }
+    }
+
+    layerSeedCentroids(seeding, layer, all_tss);
+
+    // and then moved back to their streams
+    size_t idx = 0;
+    for (auto& tss : tssvec) {
+        for (auto& ts : tss) {
+            ts = std::move(all_tss[idx++]);
+        }
+    }
+
+}
+
+// surfaces of a stream, with the positions of the events that generated them
+void generateTSAndPositions(Layer& layer, const Events& events, bool skip_check,
+                            std::vector<TimeSurfaceType>& tss, std::vector<std::pair<uint16_t, uint16_t>>& positions) {
+
+    tss.clear();
+    positions.clear();
+
+    layer.reset();
+    for (const auto& ev : events) {
+        std::pair<TimeSurfaceType, bool> ts_good;
+        if (skip_check) {
+            ts_good = layer.updateAndCompute(ev);
+        } else {
+            layer.update(ev);
+            ts_good = layer.computeIfValid(ev);
+        }
+        if (ts_good.second || skip_check) {
+            tss.push_back(std::move(ts_good.first));
+            positions.push_back({ev.x, ev.y});
+        }
+    }
+
+}
+
+void setKMeansCallback(Layer& layer, size_t l, const KMeansNetworkCallbackType& progress) {
+
+    if (progress) {
+        setKMeansProgressCallback(layer.getClusterer(), [progress, l] (const KMeansIteration& iteration) { progress(l, iteration); });
+    } else {
+        setKMeansProgressCallback(layer.getClusterer(), nullptr);
+    }
+
+}
+
+}
+
+Events train(Network& network, Events training_events, const ClustererSeedingType& seeding, bool skip_check, const KMeansNetworkCallbackType& progress) {
 
     for (size_t l = 0; l < network.getNumLayers(); l++) {
 
+        CPPHOTS_TRACE_SPAN_ARG("train::layer", l);
+
         Layer& layer = network[l];
 
         if (layer.canCluster()) {
 
+            // time surfaces are generated once and used for both seeding and training
+            std::vector<TimeSurfaceType> tss;
+            std::vector<std::pair<uint16_t, uint16_t>> positions;
+            {
+                CPPHOTS_TRACE_SPAN("train::generateTS");
+                generateTSAndPositions(layer, training_events, skip_check, tss, positions);
+            }
+
             // seed centroids for this layer
-            layerSeedCentroids(seeding, layer, training_events, !skip_check);
+            layerSeedCentroids(seeding, layer, tss);
 
             // train
             if (layer.isOnline()) {
+                CPPHOTS_TRACE_SPAN("train::learning");
+                tss = std::vector<TimeSurfaceType>();
                 layer.toggleLearning(true);
                 process(layer, training_events, true, skip_check);
                 layer.toggleLearning(false);
             } else {
-                auto tss = generateTS(layer, training_events, true, skip_check);
-                layer.train(tss);
+                CPPHOTS_TRACE_SPAN("train::learning");
+                if (progress) {
+                    setKMeansCallback(layer, l, progress);
+                }
+                layer.train(tss, positions);
+                if (progress) {
+                    setKMeansCallback(layer, l, nullptr);
+                }
             }
 
         }
 
         // genereate events for the next layer
+        CPPHOTS_TRACE_SPAN("train::regenerate");
         training_events = cpphots::process(layer, training_events, skip_check);
 
     }
@@ -39,35 +128,66 @@ Events train(Network& network, Events training_events, const ClustererSeedingTyp
 
 }
 
-std::vector<Events> train(Network& network, std::vector<Events> training_events, const ClustererSeedingType& seeding, bool use_all, bool skip_check) {
+std::vector<Events> train(Network& network, std::vector<Events> training_events, const ClustererSeedingType& seeding, bool use_all, bool skip_check, const KMeansNetworkCallbackType& progress) {
 
     for (size_t l = 0; l < network.getNumLayers(); l++) {
 
+        CPPHOTS_TRACE_SPAN_ARG("train::layer", l);
+
         Layer& layer = network[l];
 
         if (layer.canCluster()) {
 
-            // seed centroids for this layer
-            if (use_all)
-                layerSeedCentroids(seeding, layer, training_events, !skip_check);
-            else
-                layerSeedCentroids(seeding, layer, training_events[0], !skip_check);
-
-            // train
             if (layer.isOnline()) {
+
+                // seed centroids for this layer
+                if (use_all)
+                    layerSeedCentroids(seeding, layer, training_events, !skip_check);
+                else
+                    layerSeedCentroids(seeding, layer, training_events[0], !skip_check);
+
+                // train
+                CPPHOTS_TRACE_SPAN("train::learning");
                 layer.toggleLearning(true);
                 process(layer, training_events, true, skip_check);
                 layer.toggleLearning(false);
+
             } else {
-                auto tssvec = generateTS(layer, training_events, true, skip_check);
-                for (const auto& tss : tssvec) {
-                    layer.train(tss);
+
+                // time surfaces are generated once and used for both seeding and training
+                std::vector<std::vector<TimeSurfaceType>> tssvec(training_events.size());
+                std::vector<std::vector<std::pair<uint16_t, uint16_t>>> positions(training_events.size());
+                {
+                    CPPHOTS_TRACE_SPAN("train::generateTS");
+                    for (size_t i = 0; i < training_events.size(); i++) {
+                        generateTSAndPositions(layer, training_events[i], skip_check, tssvec[i], positions[i]);
+                    }
+                }
+
+                // seed centroids for this layer
+                if (use_all)
+                    seedFromAllStreams(seeding, layer, tssvec);
+                else
+                    layerSeedCentroids(seeding, layer, tssvec[0]);
+
+                // train
+                CPPHOTS_TRACE_SPAN("train::learning");
+                if (progress) {
+                    setKMeansCallback(layer, l, progress);
+                }
+                for (size_t i = 0; i < tssvec.size(); i++) {
+                    layer.train(tssvec[i], positions[i]);
+                }
+                if (progress) {
+                    setKMeansCallback(layer, l, nullptr);
                 }
+
             }
 
         }
 
         // genereate events for the next layer
+        CPPHOTS_TRACE_SPAN("train::regenerate");
         training_events = process(layer, training_events, true, skip_check);
 
     }
@@ -76,4 +196,98 @@ std::vector<Events> train(Network& network, std::vector<Events> training_events,
 
 }
 
+
+namespace {
+
+// best class and relative margin from the second best
+std::pair<size_t, double> bestWithMargin(const std::vector<double>& dists) {
+
+    size_t best = 0;
+    double d1 = std::numeric_limits<double>::max();
+    double d2 = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < dists.size(); i++) {
+        if (dists[i] < d1) {
+            d2 = d1;
+            d1 = dists[i];
+            best = i;
+        } else if (dists[i] < d2) {
+            d2 = dists[i];
+        }
+    }
+
+    double margin = (dists.size() > 1 && d2 > 0) ? (d2 - d1) / d2 : 0.0;
+
+    return {best, margin};
+
+}
+
+}
+
+AnytimeResult classifyAnytime(Network& network, const Events& events, const Classifier& classifier, const AnytimeCriterion& criterion, bool skip_check) {
+
+    if (criterion.check_every == 0) {
+        throw std::invalid_argument("Anytime classification requires a positive check interval");
+    }
+
+    if (network.getNumLayers() == 0) {
+        throw std::invalid_argument("Anytime classification requires a network with at least a layer");
+    }
+
+    CPPHOTS_TRACE_SPAN("classifyAnytime");
+
+    AnytimeResult result;
+    result.events_total = events.size();
+    if (!events.empty()) {
+        result.end_time = events.back().t;
+    }
+
+    network.reset();
+
+    size_t stable = 0;
+    size_t i = 0;
+    while (i < events.size()) {
+
+        size_t end = std::min(events.size(), i + criterion.check_every);
+        for (; i < end; i++) {
+            network.process(events[i], skip_check);
+        }
+
+        result.events_processed = i;
+        result.decision_time = events[i-1].t;
+
+        // without output events, distances only depend on the classes
+        auto hist = network.back().getSparseHistogram();
+        if (hist.empty()) {
+            stable = 0;
+            continue;
+        }
+
+        auto [cid, margin] = bestWithMargin(classifier.classDistances(hist));
+        result.checks++;
+
+        if (margin >= criterion.margin && (stable == 0 || cid == result.class_id)) {
+            stable++;
+        } else {
+            stable = margin >= criterion.margin ? 1 : 0;
+        }
+
+        result.class_id = cid;
+        result.margin = margin;
+
+        if (stable >= criterion.stable_checks && i >= criterion.min_events && i < events.size()) {
+            result.early = true;
+            break;
+        }
+
+    }
+
+    if (result.checks == 0) {
+        std::tie(result.class_id, result.margin) = bestWithMargin(classifier.classDistances(network.back().getSparseHistogram()));
+        result.checks++;
+    }
+
+    return result;
+
+}
+
 }
@@ -0,0 +1,468 @@
+#include "cpphots/scheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#include "cpphots/trace.h"
+
+
+namespace {
+
+// run-length encoding of the state on 32-bit words, which is effective on
+// untouched regions of the contexts and on empty histograms
+const uint32_t REPEAT_FLAG = 0x80000000u;
+
+void compressState(const cpphots::interfaces::StateBuffer& state, std::vector<uint32_t>& out) {
+
+    std::vector<uint32_t> words((state.size() + 3) / 4, 0);
+    std::memcpy(words.data(), state.data(), state.size());
+
+    out.clear();
+
+    size_t literal_start = 0;
+    auto flush_literals = [&] (size_t end) {
+        if (end > literal_start) {
+            out.push_back(end - literal_start);
+            out.insert(out.end(), words.begin() + literal_start, words.begin() + end);
+        }
+    };
+
+    size_t i = 0;
+    while (i < words.size()) {
+
+        size_t j = i + 1;
+        while (j < words.size() && words[j] == words[i] && j - i < REPEAT_FLAG - 1) {
+            j++;
+        }
+
+        if (j - i >= 3) {
+            flush_literals(i);
+            out.push_back(REPEAT_FLAG | (j - i));
+            out.push_back(words[i]);
+            literal_start = j;
+        }
+
+        i = j;
+
+    }
+    flush_literals(words.size());
+
+    out.shrink_to_fit();
+
+}
+
+void decompressState(const std::vector<uint32_t>& in, size_t bytes, cpphots::interfaces::StateBuffer& state) {
+
+    std::vector<uint32_t> words;
+    words.reserve((bytes + 3) / 4);
+
+    size_t i = 0;
+    while (i < in.size()) {
+        uint32_t header = in[i++];
+        if (header & REPEAT_FLAG) {
+            words.insert(words.end(), header & ~REPEAT_FLAG, in[i++]);
+        } else {
+            words.insert(words.end(), in.begin() + i, in.begin() + i + header);
+            i += header;
+        }
+    }
+
+    state.clear();
+    state.writeBytes(words.data(), bytes);
+
+}
+
+}
+
+
+namespace cpphots {
+
+StreamScheduler::StreamScheduler(const Network& network, Callback callback, unsigned int workers, size_t quantum, bool skip_check)
+    :callback(callback), quantum(quantum), skip_check(skip_check) {
+
+    if (quantum == 0) {
+        throw std::invalid_argument("The quantum of the scheduler must be positive");
+    }
+
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 0; i < workers; i++) {
+        auto worker = std::make_unique<Worker>();
+        worker->network = network;
+        for (size_t l = 0; l < worker->network.getNumLayers(); l++) {
+            if (worker->network[l].canCluster()) {
+                worker->network[l].toggleLearning(false);
+            }
+        }
+        this->workers.push_back(std::move(worker));
+    }
+
+    model_memory = this->workers[0]->network.memoryUsage();
+
+    for (auto& worker : this->workers) {
+        worker->thread = std::thread(&StreamScheduler::run, this, std::ref(*worker));
+    }
+
+}
+
+StreamScheduler::~StreamScheduler() {
+
+    flush();
+
+    for (auto& worker : workers) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->stopping = true;
+        }
+        worker->cv.notify_all();
+    }
+
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+
+}
+
+void StreamScheduler::setIdlePolicy(std::chrono::milliseconds compress_after, std::chrono::milliseconds evict_after) {
+
+    this->compress_after = compress_after.count();
+    this->evict_after = evict_after.count();
+
+    // wake up the workers so that they pick the new maintenance period
+    for (auto& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->cv.notify_all();
+    }
+
+}
+
+void StreamScheduler::submit(StreamID stream, Events events) {
+
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        outstanding++;
+    }
+
+    Worker& worker = workerFor(stream);
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        Stream& s = worker.streams[stream];
+        s.closed = false;
+        s.pending.push_back(std::move(events));
+        if (!s.scheduled) {
+            s.scheduled = true;
+            worker.ready.push_back(stream);
+        }
+    }
+
+    worker.cv.notify_one();
+
+}
+
+void StreamScheduler::closeStream(StreamID stream) {
+
+    Worker& worker = workerFor(stream);
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        auto it = worker.streams.find(stream);
+        if (it == worker.streams.end()) {
+            return;
+        }
+        it->second.closed = true;
+        if (!it->second.scheduled) {
+            it->second.scheduled = true;
+            worker.ready.push_back(stream);
+        }
+    }
+
+    worker.cv.notify_one();
+
+}
+
+void StreamScheduler::flush() {
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    flush_cv.wait(lock, [this] { return outstanding == 0; });
+}
+
+size_t StreamScheduler::getNumStreams() const {
+
+    size_t n = 0;
+    for (const auto& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        n += worker->streams.size();
+    }
+
+    return n;
+
+}
+
+unsigned int StreamScheduler::getNumWorkers() const {
+    return workers.size();
+}
+
+StreamSchedulerStats StreamScheduler::getStats() const {
+
+    StreamSchedulerStats stats;
+    stats.events = n_events;
+    stats.slices = n_slices;
+    stats.switches = n_switches;
+    stats.compressions = n_compressions;
+    stats.evictions = n_evictions;
+
+    return stats;
+
+}
+
+MemoryUsage StreamScheduler::memoryUsage() const {
+
+    MemoryUsage usage = model_memory * workers.size();
+
+    for (const auto& worker : workers) {
+
+        usage.add("streams", worker->state_bytes);
+        usage.add("compressed", worker->compressed_bytes);
+
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        size_t queued = 0;
+        for (const auto& [id, stream] : worker->streams) {
+            for (const auto& batch : stream.pending) {
+                queued += vectorMemory(batch);
+            }
+        }
+        usage.add("queues", queued);
+
+    }
+
+    return usage;
+
+}
+
+void StreamScheduler::run(Worker& worker) {
+
+    using Clock = std::chrono::steady_clock;
+
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    auto last_maintenance = Clock::now();
+
+    while (true) {
+
+        // maintenance runs a few times within the shortest idle time
+        int64_t shortest = std::min(compress_after > 0 ? compress_after.load() : INT64_MAX,
+                                    evict_after > 0 ? evict_after.load() : INT64_MAX);
+        std::chrono::milliseconds period(shortest == INT64_MAX ? 0 : std::clamp<int64_t>(shortest / 4, 1, 1000));
+
+        if (worker.ready.empty()) {
+            if (worker.stopping) {
+                break;
+            }
+            auto wakeup = [&worker] { return worker.stopping || !worker.ready.empty(); };
+            if (period.count() > 0) {
+                worker.cv.wait_for(lock, period, wakeup);
+            } else {
+                worker.cv.wait(lock, wakeup);
+            }
+        }
+
+        auto now = Clock::now();
+        if (period.count() > 0 && now - last_maintenance >= period) {
+            maintain(worker, now);
+            last_maintenance = now;
+        }
+
+        if (worker.ready.empty()) {
+            continue;
+        }
+
+        StreamID id = worker.ready.front();
+        worker.ready.pop_front();
+        Stream& stream = worker.streams.at(id);
+
+        // only closed streams are scheduled without pending events
+        if (stream.pending.empty()) {
+            if (worker.loaded == &stream) {
+                worker.loaded = nullptr;
+            }
+            worker.state_bytes -= stream.state.size();
+            worker.compressed_bytes -= stream.compressed.size() * sizeof(uint32_t);
+            worker.streams.erase(id);
+            continue;
+        }
+
+        // elements of the deque are not moved by concurrent submissions
+        const Events& batch = stream.pending.front();
+        size_t begin = stream.offset;
+        size_t end = std::min(batch.size(), begin + quantum);
+
+        lock.unlock();
+
+        {
+            CPPHOTS_TRACE_SPAN("StreamScheduler::slice");
+
+            load(worker, stream);
+
+            worker.output.clear();
+            for (size_t i = begin; i < end; i++) {
+                event ev = worker.network.process(batch[i], skip_check);
+                if (ev != invalid_event) {
+                    worker.output.push_back(ev);
+                }
+            }
+        }
+
+        bool batch_done = (end == batch.size());
+        if (callback) {
+            callback(id, worker.output, batch_done, worker.network);
+        }
+
+        n_events += end - begin;
+        n_slices++;
+
+        lock.lock();
+
+        stream.last_active = Clock::now();
+
+        if (batch_done) {
+            stream.pending.pop_front();
+            stream.offset = 0;
+        } else {
+            stream.offset = end;
+        }
+
+        // go to the back of the queue, after the other streams
+        if (!stream.pending.empty() || stream.closed) {
+            worker.ready.push_back(id);
+        } else {
+            stream.scheduled = false;
+        }
+
+        if (batch_done) {
+            std::lock_guard<std::mutex> flush_lock(flush_mutex);
+            if (--outstanding == 0) {
+                flush_cv.notify_all();
+            }
+        }
+
+    }
+
+}
+
+void StreamScheduler::load(Worker& worker, Stream& stream) {
+
+    if (worker.loaded == &stream) {
+        return;
+    }
+
+    unload(worker);
+
+    switch (stream.residency) {
+
+        case Residency::Empty:
+            worker.network.reset();
+            break;
+
+        case Residency::Resident:
+            stream.state.rewind();
+            worker.network.loadState(stream.state);
+            break;
+
+        case Residency::Compressed:
+            decompressState(stream.compressed, stream.state_size, worker.scratch);
+            worker.network.loadState(worker.scratch);
+            worker.compressed_bytes -= stream.compressed.size() * sizeof(uint32_t);
+            std::vector<uint32_t>().swap(stream.compressed);
+            break;
+
+        case Residency::Loaded:
+            break;
+
+    }
+
+    stream.residency = Residency::Loaded;
+    worker.loaded = &stream;
+    n_switches++;
+
+}
+
+void StreamScheduler::unload(Worker& worker) {
+
+    Stream* stream = worker.loaded;
+    if (stream == nullptr) {
+        return;
+    }
+
+    // the buffer keeps its memory, so switching streams does not allocate
+    worker.state_bytes -= stream->state.size();
+    stream->state.clear();
+    worker.network.saveState(stream->state);
+    worker.state_bytes += stream->state.size();
+
+    stream->residency = Residency::Resident;
+    worker.loaded = nullptr;
+
+}
+
+void StreamScheduler::maintain(Worker& worker, std::chrono::steady_clock::time_point now) {
+
+    CPPHOTS_TRACE_SPAN("StreamScheduler::maintain");
+
+    std::chrono::milliseconds compress(compress_after.load());
+    std::chrono::milliseconds evict(evict_after.load());
+
+    for (auto it = worker.streams.begin(); it != worker.streams.end();) {
+
+        Stream& stream = it->second;
+        auto idle = now - stream.last_active;
+
+        if (stream.scheduled) {
+            ++it;
+            continue;
+        }
+
+        if (evict.count() > 0 && idle >= evict) {
+            if (worker.loaded == &stream) {
+                worker.loaded = nullptr;
+            }
+            worker.state_bytes -= stream.state.size();
+            worker.compressed_bytes -= stream.compressed.size() * sizeof(uint32_t);
+            it = worker.streams.erase(it);
+            n_evictions++;
+            continue;
+        }
+
+        if (compress.count() > 0 && idle >= compress &&
+            (stream.residency == Residency::Loaded || stream.residency == Residency::Resident)) {
+
+            if (worker.loaded == &stream) {
+                unload(worker);
+            }
+
+            compressState(stream.state, stream.compressed);
+            stream.state_size = stream.state.size();
+            worker.compressed_bytes += stream.compressed.size() * sizeof(uint32_t);
+
+            worker.state_bytes -= stream.state.size();
+            stream.state = interfaces::StateBuffer();
+
+            stream.residency = Residency::Compressed;
+            n_compressions++;
+
+        }
+
+        ++it;
+
+    }
+
+}
+
+StreamScheduler::Worker& StreamScheduler::workerFor(StreamID stream) {
+    // mix the bits, so that sequential IDs are spread across workers
+    uint64_t h = stream * 0x9E3779B97F4A7C15ull;
+    return *workers[(h >> 32) % workers.size()];
+}
+
+}
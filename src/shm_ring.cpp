@@ -0,0 +1,363 @@
+#include "cpphots/shm_ring.h"
+
+#include <atomic>
+#include <cstddef>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+static_assert(sizeof(cpphots_event) == sizeof(cpphots::event), "cpphots_event and cpphots::event must have the same layout");
+static_assert(offsetof(cpphots_event, p) == offsetof(cpphots::event, p), "cpphots_event and cpphots::event must have the same layout");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free, "futexes require lock-free 32 bit atomics");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory requires lock-free 64 bit atomics");
+
+
+namespace cpphots {
+
+namespace detail {
+
+// producer and consumer fields are on separate cache lines
+struct ShmRingHeader {
+
+    static constexpr uint32_t MAGIC = 0x484f5453;
+    static constexpr uint32_t VERSION = 1;
+
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t event_size;
+    uint64_t capacity;
+
+    // written by the producer
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> producer_waiting;
+    std::atomic<uint32_t> closed;
+
+    // written by the consumer
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> space_seq;
+    std::atomic<uint32_t> consumer_waiting;
+
+};
+
+}
+
+}
+
+
+namespace {
+
+using cpphots::detail::ShmRingHeader;
+using Clock = std::chrono::steady_clock;
+
+size_t ringOffset() {
+    return (sizeof(ShmRingHeader) + 63) / 64 * 64;
+}
+
+uint32_t* futexAddress(std::atomic<uint32_t>& word) {
+    return reinterpret_cast<uint32_t*>(&word);
+}
+
+// returns false if the deadline has passed
+bool futexWait(std::atomic<uint32_t>& word, uint32_t expected, bool has_deadline, Clock::time_point deadline) {
+
+    timespec ts;
+    timespec* tsp = nullptr;
+
+    if (has_deadline) {
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0) {
+            return false;
+        }
+        ts.tv_sec = remaining / 1000000000;
+        ts.tv_nsec = remaining % 1000000000;
+        tsp = &ts;
+    }
+
+    syscall(SYS_futex, futexAddress(word), FUTEX_WAIT, expected, tsp, nullptr, 0);
+
+    return true;
+
+}
+
+void futexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, futexAddress(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+Clock::time_point deadlineFromTimeout(int timeout_ms) {
+    return Clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+}
+
+}
+
+
+namespace cpphots {
+
+ShmEventConsumer::ShmEventConsumer(const std::string& name) {
+
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open shared memory " + name + ": " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < ringOffset()) {
+        close(fd);
+        throw std::runtime_error("Shared memory " + name + " is not a ring buffer");
+    }
+    map_size = st.st_size;
+
+    void* mem = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Cannot map shared memory " + name + ": " + std::strerror(errno));
+    }
+
+    header = static_cast<ShmRingHeader*>(mem);
+    ring = reinterpret_cast<event*>(static_cast<char*>(mem) + ringOffset());
+
+    if (header->magic.load(std::memory_order_acquire) != ShmRingHeader::MAGIC ||
+        header->version != ShmRingHeader::VERSION ||
+        header->event_size != sizeof(event) ||
+        map_size != ringOffset() + header->capacity * sizeof(event)) {
+        munmap(mem, map_size);
+        close(fd);
+        throw std::runtime_error("Shared memory " + name + " is not a compatible ring buffer");
+    }
+
+    tail = header->tail.load(std::memory_order_relaxed);
+
+}
+
+ShmEventConsumer::~ShmEventConsumer() {
+    munmap(header, map_size);
+    close(fd);
+}
+
+std::pair<const event*, size_t> ShmEventConsumer::acquire(size_t max) const {
+
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    uint64_t capacity = header->capacity;
+
+    uint64_t idx = tail & (capacity - 1);
+    size_t n = std::min<uint64_t>({head - tail, capacity - idx, max});
+
+    return {ring + idx, n};
+
+}
+
+void ShmEventConsumer::release(size_t n) {
+
+    tail += n;
+    header->tail.store(tail, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->producer_waiting.load(std::memory_order_relaxed)) {
+        header->space_seq.fetch_add(1, std::memory_order_release);
+        futexWake(header->space_seq);
+    }
+
+}
+
+bool ShmEventConsumer::wait(int timeout_ms) {
+
+    auto deadline = deadlineFromTimeout(timeout_ms);
+
+    while (true) {
+
+        if (header->head.load(std::memory_order_acquire) != tail) {
+            return true;
+        }
+
+        if (header->closed.load(std::memory_order_acquire)) {
+            return header->head.load(std::memory_order_acquire) != tail;
+        }
+
+        uint32_t seq = header->data_seq.load(std::memory_order_acquire);
+        header->consumer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool timeout = false;
+        if (header->head.load(std::memory_order_acquire) == tail && !header->closed.load(std::memory_order_acquire)) {
+            timeout = !futexWait(header->data_seq, seq, timeout_ms >= 0, deadline);
+        }
+
+        header->consumer_waiting.store(0, std::memory_order_relaxed);
+
+        if (timeout) {
+            return header->head.load(std::memory_order_acquire) != tail;
+        }
+
+    }
+
+}
+
+bool ShmEventConsumer::isFinished() const {
+    return header->closed.load(std::memory_order_acquire) && header->head.load(std::memory_order_acquire) == tail;
+}
+
+uint64_t ShmEventConsumer::getCapacity() const {
+    return header->capacity;
+}
+
+size_t ShmEventConsumer::process(Network& network, bool skip_check, size_t max) {
+    return consume([&network, skip_check] (const event& ev) { network.process(ev, skip_check); }, max);
+}
+
+}
+
+
+struct cpphots_shm_producer {
+    int fd;
+    size_t map_size;
+    ShmRingHeader* header;
+    cpphots_event* ring;
+    uint64_t head;
+};
+
+extern "C" {
+
+cpphots_shm_producer* cpphots_shm_producer_create(const char* name, uint64_t capacity) {
+
+    if (capacity == 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    uint64_t cap = 1;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    size_t map_size = ringOffset() + cap * sizeof(cpphots_event);
+    if (ftruncate(fd, map_size) < 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = err;
+        return nullptr;
+    }
+
+    void* mem = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = err;
+        return nullptr;
+    }
+
+    // the segment is zero-initialized, which is a valid state for all atomics
+    ShmRingHeader* header = static_cast<ShmRingHeader*>(mem);
+    header->version = ShmRingHeader::VERSION;
+    header->event_size = sizeof(cpphots_event);
+    header->capacity = cap;
+    header->magic.store(ShmRingHeader::MAGIC, std::memory_order_release);
+
+    cpphots_shm_producer* producer = new cpphots_shm_producer;
+    producer->fd = fd;
+    producer->map_size = map_size;
+    producer->header = header;
+    producer->ring = reinterpret_cast<cpphots_event*>(static_cast<char*>(mem) + ringOffset());
+    producer->head = 0;
+
+    return producer;
+
+}
+
+size_t cpphots_shm_producer_push(cpphots_shm_producer* producer, const cpphots_event* events, size_t n, int timeout_ms) {
+
+    ShmRingHeader* header = producer->header;
+    uint64_t capacity = header->capacity;
+    auto deadline = deadlineFromTimeout(timeout_ms);
+
+    size_t written = 0;
+
+    while (written < n) {
+
+        uint64_t free = capacity - (producer->head - header->tail.load(std::memory_order_acquire));
+
+        if (free == 0) {
+
+            if (timeout_ms == 0) {
+                break;
+            }
+
+            uint32_t seq = header->space_seq.load(std::memory_order_acquire);
+            header->producer_waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool timeout = false;
+            if (producer->head - header->tail.load(std::memory_order_acquire) == capacity) {
+                timeout = !futexWait(header->space_seq, seq, timeout_ms > 0, deadline);
+            }
+
+            header->producer_waiting.store(0, std::memory_order_relaxed);
+
+            if (timeout) {
+                break;
+            }
+
+            continue;
+
+        }
+
+        // copy in at most two chunks, if wrapping around the end of the buffer
+        size_t count = std::min<uint64_t>(free, n - written);
+        uint64_t idx = producer->head & (capacity - 1);
+        size_t first = std::min<uint64_t>(count, capacity - idx);
+        std::memcpy(producer->ring + idx, events + written, first * sizeof(cpphots_event));
+        std::memcpy(producer->ring, events + written + first, (count - first) * sizeof(cpphots_event));
+
+        producer->head += count;
+        header->head.store(producer->head, std::memory_order_release);
+        written += count;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header->consumer_waiting.load(std::memory_order_relaxed)) {
+            header->data_seq.fetch_add(1, std::memory_order_release);
+            futexWake(header->data_seq);
+        }
+
+    }
+
+    return written;
+
+}
+
+void cpphots_shm_producer_close(cpphots_shm_producer* producer) {
+
+    ShmRingHeader* header = producer->header;
+
+    header->closed.store(1, std::memory_order_release);
+    header->data_seq.fetch_add(1, std::memory_order_release);
+    futexWake(header->data_seq);
+
+    munmap(header, producer->map_size);
+    close(producer->fd);
+
+    delete producer;
+
+}
+
+int cpphots_shm_unlink(const char* name) {
+    return shm_unlink(name);
+}
+
+}
@@ -0,0 +1,112 @@
+#include "cpphots/snapshot.h"
+
+#include "cpphots/trace.h"
+
+
+namespace cpphots {
+
+bool SnapshotBuffer::capture(const interfaces::Stateful& component) {
+
+    CPPHOTS_TRACE_SPAN("SnapshotBuffer::capture");
+
+    back.clear();
+    component.saveState(back);
+
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+
+    std::swap(back, front);
+    generation++;
+
+    return true;
+
+}
+
+uint64_t SnapshotBuffer::latest(interfaces::StateBuffer& state) const {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    state = front;
+    state.rewind();
+
+    return generation;
+
+}
+
+uint64_t SnapshotBuffer::restore(interfaces::Stateful& component) {
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (generation > 0) {
+        front.rewind();
+        component.loadState(front);
+    }
+
+    return generation;
+
+}
+
+uint64_t SnapshotBuffer::getGeneration() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return generation;
+}
+
+
+ContextPublisher::ContextPublisher(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t period)
+    :period(period) {
+
+    for (auto& frame : frames) {
+        frame.pool.reset(pool.clone());
+    }
+
+    // allocate the scratch buffer once
+    pool.saveState(scratch);
+
+}
+
+void ContextPublisher::publish(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t) {
+
+    CPPHOTS_TRACE_SPAN("ContextPublisher::publish");
+
+    ContextFrame& frame = frames[back];
+
+    scratch.clear();
+    pool.saveState(scratch);
+    frame.pool->loadState(scratch);
+    frame.t = t;
+    frame.generation = ++generation;
+    last_t = t;
+
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+
+}
+
+bool ContextPublisher::publishIfDue(const interfaces::TimeSurfacePoolCalculator& pool, uint64_t t) {
+
+    if (generation > 0 && t < last_t + period) {
+        return false;
+    }
+
+    publish(pool, t);
+
+    return true;
+
+}
+
+bool ContextPublisher::hasNew() const {
+    return middle.load(std::memory_order_relaxed) & FRESH;
+}
+
+const ContextFrame& ContextPublisher::acquire() {
+
+    if (middle.load(std::memory_order_relaxed) & FRESH) {
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    }
+
+    return frames[front];
+
+}
+
+}
@@ -2,6 +2,20 @@
 
 #include "cpphots/load.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+
+namespace {
+
+// same test as the linear decay in LinearTimeSurface::compute, with the same rounding
+inline bool isActive(cpphots::TimeSurfaceScalarType tu, uint64_t t, cpphots::TimeSurfaceScalarType tau) {
+    return cpphots::TimeSurfaceScalarType(1.) - (cpphots::TimeSurfaceScalarType(t) - tu) / tau > 0.;
+}
+
+}
+
 
 namespace cpphots {
 
@@ -38,7 +52,25 @@ void TimeSurfaceBase::update(uint64_t t, uint16_t x, uint16_t y) {
 
     cpphots_assert(x < width && y < height);
 
-    context(y+Ry, x+Rx) = t;
+    if (sparse) {
+        setSparseValue(y+Ry, x+Rx, t);
+        if (full_context_valid) {
+            full_context = TimeSurfaceType();
+            full_context_valid = false;
+        }
+    } else {
+        context(y+Ry, x+Rx) = t;
+    }
+
+    if (!track_activity) {
+        return;
+    }
+
+    // timestamps are monotonic, so updates expire in the same order they are added
+    expireActivity(t);
+    uint32_t cell = (y / cell_h) * cells_x + x / cell_w;
+    activity[cell]++;
+    active_updates.push_back({t, cell});
 
 }
 
@@ -47,11 +79,31 @@ std::pair<uint16_t, uint16_t> TimeSurfaceBase::getSize() const {
 }
 
 void TimeSurfaceBase::reset() {
-    context = TimeSurfaceType::Zero(height+2*Ry, width+2*Rx) - tau;  // makes sense, but is not in the paper
+    if (sparse) {
+        resetSparse();
+    } else {
+        context = TimeSurfaceType::Zero(height+2*Ry, width+2*Rx) - tau;  // makes sense, but is not in the paper
+    }
+    resetActivity();
+}
+
+const TimeSurfaceType& TimeSurfaceBase::getFullContext() const {
+
+    if (!sparse) {
+        return context;
+    }
+
+    if (!full_context_valid) {
+        full_context = contextBlock(0, 0, height+2*Ry, width+2*Rx);
+        full_context_valid = true;
+    }
+
+    return full_context;
+
 }
 
 TimeSurfaceType TimeSurfaceBase::getContext() const {
-    return context.block(Ry, Rx, height, width);
+    return contextBlock(Ry, Rx, height, width);
 }
 
 void TimeSurfaceBase::toStream(std::ostream& out) const {
@@ -82,6 +134,232 @@ void TimeSurfaceBase::fromStream(std::istream& in) {
 
 }
 
+void TimeSurfaceBase::saveState(interfaces::StateBuffer& state) const {
+
+    if (!sparse) {
+        state.writeArray(context);
+        return;
+    }
+
+    // same layout as the dense array, one column at a time
+    int64_t rows = height+2*Ry;
+    int64_t cols = width+2*Rx;
+    state.write<int64_t>(rows);
+    state.write<int64_t>(cols);
+
+    std::vector<TimeSurfaceScalarType> column(rows);
+    for (int64_t c = 0; c < cols; c++) {
+        for (int64_t r = 0; r < rows; r++) {
+            column[r] = sparseValue(r, c);
+        }
+        state.writeBytes(column.data(), rows * sizeof(TimeSurfaceScalarType));
+    }
+
+}
+
+void TimeSurfaceBase::loadState(interfaces::StateBuffer& state) {
+
+    if (!sparse) {
+        state.readArrayInPlace(context);
+        rebuildActivity();
+        return;
+    }
+
+    int64_t rows = state.read<int64_t>();
+    int64_t cols = state.read<int64_t>();
+    if (rows != height+2*Ry || cols != width+2*Rx) {
+        throw std::runtime_error("Wrong array size in state buffer: expected " + std::to_string(height+2*Ry) + "x" + std::to_string(width+2*Rx) +
+                                 ", found " + std::to_string(rows) + "x" + std::to_string(cols));
+    }
+
+    resetSparse();
+    std::vector<TimeSurfaceScalarType> column(rows);
+    for (int64_t c = 0; c < cols; c++) {
+        state.readBytes(column.data(), rows * sizeof(TimeSurfaceScalarType));
+        for (int64_t r = 0; r < rows; r++) {
+            if (column[r] != -tau) {
+                setSparseValue(r, c, column[r]);
+            }
+        }
+    }
+
+    rebuildActivity();
+
+}
+
+MemoryUsage TimeSurfaceBase::memoryUsage() const {
+    size_t context_memory = sparse ? vectorMemory(page_table) + vectorMemory(pages) + arrayMemory(full_context) : arrayMemory(context);
+    return MemoryUsage().add("context", context_memory)
+                        .add("activity", vectorMemory(activity) + active_updates.size() * sizeof(active_updates[0]));
+}
+
+MemoryUsage TimeSurfaceBase::estimateMemoryUsage(uint16_t width, uint16_t height, uint16_t Rx, uint16_t Ry, TimeSurfaceScalarType) {
+    size_t cells_x = (width + (Rx == 0 ? width : 2*Rx+1) - 1) / (Rx == 0 ? width : 2*Rx+1);
+    size_t cells_y = (height + (Ry == 0 ? height : 2*Ry+1) - 1) / (Ry == 0 ? height : 2*Ry+1);
+    return MemoryUsage().add("context", arrayMemory(height+2*Ry, width+2*Rx))
+                        .add("activity", cells_x * cells_y * sizeof(uint32_t));
+}
+
+size_t TimeSurfaceBase::activityBound(uint16_t x, uint16_t y) const {
+
+    // updates are counted only once the bound is used
+    if (!track_activity) {
+        track_activity = true;
+        rebuildActivity();
+    }
+
+    uint16_t x0 = (Rx == 0 || x < Rx) ? 0 : x - Rx;
+    uint16_t x1 = (Rx == 0) ? width - 1 : std::min<uint16_t>(width - 1, x + Rx);
+    uint16_t y0 = (Ry == 0 || y < Ry) ? 0 : y - Ry;
+    uint16_t y1 = (Ry == 0) ? height - 1 : std::min<uint16_t>(height - 1, y + Ry);
+
+    size_t bound = 0;
+    for (uint16_t cy = y0 / cell_h; cy <= y1 / cell_h; cy++) {
+        for (uint16_t cx = x0 / cell_w; cx <= x1 / cell_w; cx++) {
+            bound += activity[cy * cells_x + cx];
+        }
+    }
+
+    return bound;
+
+}
+
+void TimeSurfaceBase::resetActivity() const {
+
+    // blocks as large as the window, which overlaps at most 2x2 of them
+    cell_w = (Rx == 0) ? width : 2*Rx+1;
+    cell_h = (Ry == 0) ? height : 2*Ry+1;
+    cells_x = (width + cell_w - 1) / cell_w;
+    uint16_t cells_y = (height + cell_h - 1) / cell_h;
+
+    activity.assign(size_t(cells_x) * cells_y, 0);
+    active_updates.clear();
+
+}
+
+void TimeSurfaceBase::rebuildActivity() const {
+
+    resetActivity();
+    if (!track_activity) {
+        return;
+    }
+
+    // only the last update of each pixel is known, which still gives an upper bound
+    TimeSurfaceType ctx = getContext();
+    TimeSurfaceScalarType newest = ctx.maxCoeff();
+    if (newest < 0) {
+        return;
+    }
+
+    for (uint16_t x = 0; x < width; x++) {
+        for (uint16_t y = 0; y < height; y++) {
+            if (ctx(y, x) >= 0 && isActive(ctx(y, x), newest, tau)) {
+                uint32_t cell = (y / cell_h) * cells_x + x / cell_w;
+                activity[cell]++;
+                active_updates.push_back({uint64_t(ctx(y, x)), cell});
+            }
+        }
+    }
+
+    std::sort(active_updates.begin(), active_updates.end());
+
+}
+
+void TimeSurfaceBase::setSparseContext(bool enable) {
+
+    if (enable == sparse) {
+        return;
+    }
+
+    if (enable) {
+        TimeSurfaceType dense = std::move(context);
+        context = TimeSurfaceType();
+        sparse = true;
+        resetSparse();
+        scatterContext(dense);
+    } else {
+        TimeSurfaceType dense = contextBlock(0, 0, height+2*Ry, width+2*Rx);
+        sparse = false;
+        std::vector<uint32_t>().swap(page_table);
+        std::vector<TimeSurfaceScalarType>().swap(pages);
+        full_context = TimeSurfaceType();
+        full_context_valid = false;
+        context = std::move(dense);
+    }
+
+}
+
+bool TimeSurfaceBase::isSparseContext() const {
+    return sparse;
+}
+
+TimeSurfaceScalarType TimeSurfaceBase::getLastUpdate(uint16_t x, uint16_t y) const {
+
+    cpphots_assert(x < width && y < height);
+
+    return sparse ? sparseValue(y+Ry, x+Rx) : context(y+Ry, x+Rx);
+
+}
+
+TimeSurfaceType TimeSurfaceBase::contextBlock(uint16_t py, uint16_t px, uint16_t h, uint16_t w) const {
+
+    if (!sparse) {
+        return context.block(py, px, h, w);
+    }
+
+    TimeSurfaceType out(h, w);
+    gatherContext(py, px, out);
+
+    return out;
+
+}
+
+void TimeSurfaceBase::setSparseValue(size_t py, size_t px, TimeSurfaceScalarType value) {
+
+    uint32_t& page = page_table[(py >> PAGE_SHIFT) * pages_x + (px >> PAGE_SHIFT)];
+    if (page == 0) {
+        // pixels of a new page have never been updated
+        pages.resize(pages.size() + PAGE_SIDE * PAGE_SIDE, -tau);
+        page = pages.size() / (PAGE_SIDE * PAGE_SIDE);
+    }
+
+    pages[(size_t(page - 1) << (2 * PAGE_SHIFT)) + ((py & (PAGE_SIDE - 1)) << PAGE_SHIFT) + (px & (PAGE_SIDE - 1))] = value;
+
+}
+
+void TimeSurfaceBase::resetSparse() {
+
+    pages_x = (width + 2*Rx + PAGE_SIDE - 1) / PAGE_SIDE;
+    size_t pages_y = (height + 2*Ry + PAGE_SIDE - 1) / PAGE_SIDE;
+    page_table.assign(pages_x * pages_y, 0);
+    std::vector<TimeSurfaceScalarType>().swap(pages);
+
+    full_context = TimeSurfaceType();
+    full_context_valid = false;
+
+}
+
+void TimeSurfaceBase::scatterContext(const TimeSurfaceType& dense) {
+
+    for (Eigen::Index c = 0; c < dense.cols(); c++) {
+        for (Eigen::Index r = 0; r < dense.rows(); r++) {
+            if (dense(r, c) != -tau) {
+                setSparseValue(r, c, dense(r, c));
+            }
+        }
+    }
+
+}
+
+void TimeSurfaceBase::expireActivity(uint64_t t) const {
+
+    while (!active_updates.empty() && !isActive(active_updates.front().first, t, tau)) {
+        activity[active_updates.front().second]--;
+        active_updates.pop_front();
+    }
+
+}
+
 
 std::pair<TimeSurfaceType, bool> LinearTimeSurface::compute(uint64_t t, uint16_t x, uint16_t y) const {
 
@@ -93,7 +371,7 @@ std::pair<TimeSurfaceType, bool> LinearTimeSurface::compute(uint64_t t, uint16_t
     if (Ry == 0)
         y = 0;
 
-    TimeSurfaceType retmat = context.block(y, x, Wy, Wx);  // should be (x-Rx, y-Ry), but the context is padded
+    TimeSurfaceType retmat = contextBlock(y, x, Wy, Wx);  // should be (x-Rx, y-Ry), but the context is padded
 
     TimeSurfaceType ret = 1. - (t - retmat) / tau;
 
@@ -107,6 +385,46 @@ std::pair<TimeSurfaceType, bool> LinearTimeSurface::compute(const event& ev) con
     return compute(ev.t, ev.x, ev.y);
 }
 
+std::pair<TimeSurfaceType, bool> LinearTimeSurface::computeIfValid(uint64_t t, uint16_t x, uint16_t y) const {
+
+    cpphots_assert(x < width && y < height);
+
+    if (!mayBeValid(x, y)) {
+        return {TimeSurfaceType(), false};
+    }
+
+    return compute(t, x, y);
+
+}
+
+std::pair<TimeSurfaceType, bool> LinearTimeSurface::computeIfValid(const event& ev) const {
+    return computeIfValid(ev.t, ev.x, ev.y);
+}
+
+bool LinearTimeSurface::computeInto(uint64_t t, uint16_t x, uint16_t y, Eigen::Ref<TimeSurfaceType> out) const {
+
+    cpphots_assert(x < width && y < height);
+    cpphots_assert(out.rows() == Wy && out.cols() == Wx);
+
+    // override for the full context
+    if (Rx == 0)
+        x = 0;
+    if (Ry == 0)
+        y = 0;
+
+    if (sparse) {
+        gatherContext(y, x, out);
+        out = 1. - (t - out) / tau;
+    } else {
+        out = 1. - (t - context.block(y, x, Wy, Wx)) / tau;
+    }
+    bool good = (out > 0.).count() >= min_events;
+    out = (out <= 0.).select(0., out);
+
+    return good;
+
+}
+
 TimeSurfaceType LinearTimeSurface::sampleContext(uint64_t t) const {
 
     TimeSurfaceType ret = 1. - (t - getContext()) / tau;
@@ -115,6 +433,20 @@ TimeSurfaceType LinearTimeSurface::sampleContext(uint64_t t) const {
 
 }
 
+void LinearTimeSurface::sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const {
+
+    cpphots_assert(x + w <= width && y + h <= height);
+
+    if (sparse) {
+        gatherContext(y+Ry, x+Rx, out);
+        out = 1. - (t - out) / tau;
+    } else {
+        out = 1. - (t - context.block(y+Ry, x+Rx, h, w)) / tau;
+    }
+    out = (out <= 0.).select(0., out);
+
+}
+
 void LinearTimeSurface::toStream(std::ostream& out) const {
 
     writeMetacommand(out, "LINEARTIMESURFACE");
@@ -130,6 +462,91 @@ void LinearTimeSurface::fromStream(std::istream& in) {
 }
 
 
+std::pair<TimeSurfaceType, bool> ExponentialTimeSurface::compute(uint64_t t, uint16_t x, uint16_t y) const {
+
+    cpphots_assert(x < width && y < height);
+
+    bool good = isValid(t, x, y);
+
+    // override for the full context
+    if (Rx == 0)
+        x = 0;
+    if (Ry == 0)
+        y = 0;
+
+    TimeSurfaceType ret = (-(t - contextBlock(y, x, Wy, Wx)) / tau).exp();
+
+    return std::make_pair(ret, good);
+
+}
+
+std::pair<TimeSurfaceType, bool> ExponentialTimeSurface::compute(const event& ev) const {
+    return compute(ev.t, ev.x, ev.y);
+}
+
+std::pair<TimeSurfaceType, bool> ExponentialTimeSurface::computeIfValid(uint64_t t, uint16_t x, uint16_t y) const {
+
+    cpphots_assert(x < width && y < height);
+
+    if (!isValid(t, x, y)) {
+        return {TimeSurfaceType(), false};
+    }
+
+    return compute(t, x, y);
+
+}
+
+std::pair<TimeSurfaceType, bool> ExponentialTimeSurface::computeIfValid(const event& ev) const {
+    return computeIfValid(ev.t, ev.x, ev.y);
+}
+
+bool ExponentialTimeSurface::isValid(uint64_t t, uint16_t x, uint16_t y) const {
+
+    cpphots_assert(x < width && y < height);
+
+    if (activityBound(x, y) < min_events) {
+        return false;
+    }
+
+    if (Rx == 0)
+        x = 0;
+    if (Ry == 0)
+        y = 0;
+
+    // active pixels are the same as with the linear decay
+    return (1. - (t - contextBlock(y, x, Wy, Wx)) / tau > 0.).count() >= min_events;
+
+}
+
+TimeSurfaceType ExponentialTimeSurface::sampleContext(uint64_t t) const {
+
+    return (-(t - getContext()) / tau).exp();
+
+}
+
+void ExponentialTimeSurface::sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const {
+
+    cpphots_assert(x + w <= width && y + h <= height);
+
+    out = (-(t - contextBlock(y+Ry, x+Rx, h, w)) / tau).exp();
+
+}
+
+void ExponentialTimeSurface::toStream(std::ostream& out) const {
+
+    writeMetacommand(out, "EXPONENTIALTIMESURFACE");
+    TimeSurfaceBase::toStream(out);
+
+}
+
+void ExponentialTimeSurface::fromStream(std::istream& in) {
+
+    matchMetacommandOptional(in, "EXPONENTIALTIMESURFACE");
+    TimeSurfaceBase::fromStream(in);
+
+}
+
+
 WeightedLinearTimeSurface::WeightedLinearTimeSurface() {}
 
 WeightedLinearTimeSurface::WeightedLinearTimeSurface(uint16_t width, uint16_t height, uint16_t Rx, uint16_t Ry, TimeSurfaceScalarType tau, const TimeSurfaceType& weightmatrix)
@@ -177,6 +594,14 @@ TimeSurfaceType WeightedLinearTimeSurface::sampleContext(uint64_t t) const {
 
 }
 
+void WeightedLinearTimeSurface::sampleContextBlock(uint64_t t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, Eigen::Ref<TimeSurfaceType> out) const {
+
+    LinearTimeSurface::sampleContextBlock(t, x, y, w, h, out);
+
+    out *= weights.block(y+Ry, x+Rx, h, w);
+
+}
+
 void WeightedLinearTimeSurface::setWeightMatrix(const TimeSurfaceType& weightmatrix) {
 
     weights = TimeSurfaceType::Zero(height+2*Ry, width+2*Rx);
@@ -209,6 +634,14 @@ void WeightedLinearTimeSurface::fromStream(std::istream& in) {
 
 }
 
+MemoryUsage WeightedLinearTimeSurface::memoryUsage() const {
+    return TimeSurfaceBase::memoryUsage().add("weights", arrayMemory(weights));
+}
+
+MemoryUsage WeightedLinearTimeSurface::estimateMemoryUsage(uint16_t width, uint16_t height, uint16_t Rx, uint16_t Ry, TimeSurfaceScalarType tau, const TimeSurfaceType&) {
+    return TimeSurfaceBase::estimateMemoryUsage(width, height, Rx, Ry, tau).add("weights", arrayMemory(height+2*Ry, width+2*Rx));
+}
+
 TimeSurfacePool::~TimeSurfacePool() {
     delete_surfaces();
 }
@@ -275,6 +708,53 @@ void TimeSurfacePool::fromStream(std::istream& in) {
 
 }
 
+MemoryUsage TimeSurfacePool::memoryUsage() const {
+
+    MemoryUsage mem;
+    for (const auto& ts : surfaces) {
+        mem += ts->memoryUsage();
+    }
+
+    return mem;
+
+}
+
+void TimeSurfacePool::setSparseContexts(bool enable) {
+
+    for (auto ts : surfaces) {
+        if (!dynamic_cast<TimeSurfaceBase*>(ts)) {
+            throw std::invalid_argument("Sparse contexts are available only for surfaces derived from TimeSurfaceBase");
+        }
+    }
+
+    for (auto ts : surfaces) {
+        dynamic_cast<TimeSurfaceBase*>(ts)->setSparseContext(enable);
+    }
+
+}
+
+void TimeSurfacePool::saveState(interfaces::StateBuffer& state) const {
+
+    state.write<uint64_t>(surfaces.size());
+    for (const auto& ts : surfaces) {
+        ts->saveState(state);
+    }
+
+}
+
+void TimeSurfacePool::loadState(interfaces::StateBuffer& state) {
+
+    uint64_t n_surfaces = state.read<uint64_t>();
+    if (n_surfaces != surfaces.size()) {
+        throw std::runtime_error("Wrong number of time surfaces in state buffer");
+    }
+
+    for (auto& ts : surfaces) {
+        ts->loadState(state);
+    }
+
+}
+
 void TimeSurfacePool::delete_surfaces() {
     for (size_t i = 0; i < surfaces.size(); i++) {
         delete surfaces[i];
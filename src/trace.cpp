@@ -0,0 +1,303 @@
+#include "cpphots/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+
+
+namespace cpphots {
+
+namespace trace {
+
+namespace {
+
+enum SpanMode : uint8_t {
+    Inactive,
+    Skipped,
+    Recording
+};
+
+// single producer ring buffer, each slot is protected by a sequence number
+// so that it can be read while the owning thread is writing
+struct RingBuffer {
+
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> duration{0};
+        std::atomic<int64_t> arg{-1};
+    };
+
+    RingBuffer(size_t capacity, uint32_t tid)
+        :slots(capacity), tid(tid) {}
+
+    void push(const char* name, uint64_t start, uint64_t duration, int64_t arg) {
+
+        uint64_t idx = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[idx % slots.size()];
+
+        slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.duration.store(duration, std::memory_order_relaxed);
+        slot.arg.store(arg, std::memory_order_relaxed);
+
+        slot.seq.store(2 * idx + 2, std::memory_order_release);
+        head.store(idx + 1, std::memory_order_release);
+
+    }
+
+    std::vector<Slot> slots;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    uint32_t tid;
+
+};
+
+// buffers of exited threads stay in the registry, so that their spans can still be exported,
+// and they are moved to the free list to be reused by new threads
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<RingBuffer>> buffers;
+    std::vector<std::shared_ptr<RingBuffer>> free;
+    uint32_t next_tid = 1;
+};
+
+Registry& registry() {
+    static Registry reg;
+    return reg;
+}
+
+std::atomic<bool> enabled{false};
+std::atomic<uint32_t> sampling{1};
+std::atomic<size_t> buffer_size{1 << 16};
+
+struct ThreadState {
+
+    ~ThreadState() {
+        if (buffer) {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.free.push_back(std::move(buffer));
+        }
+    }
+
+    std::shared_ptr<RingBuffer> buffer;
+    uint64_t counter = 0;
+    uint32_t skip_depth = 0;
+    uint32_t hot_depth = 0;
+
+};
+
+thread_local ThreadState thread_state;
+
+uint64_t now() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+RingBuffer& threadBuffer() {
+
+    if (!thread_state.buffer) {
+
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        // spans of the previous owner are kept and overwritten as usual
+        size_t capacity = std::max<size_t>(1, buffer_size.load());
+        auto reuse = std::find_if(reg.free.begin(), reg.free.end(),
+                                  [capacity] (const auto& buf) { return buf->slots.size() == capacity; });
+        if (reuse != reg.free.end()) {
+            thread_state.buffer = std::move(*reuse);
+            reg.free.erase(reuse);
+        } else {
+            thread_state.buffer = std::make_shared<RingBuffer>(capacity, reg.next_tid++);
+            reg.buffers.push_back(thread_state.buffer);
+        }
+
+    }
+
+    return *thread_state.buffer;
+
+}
+
+template <typename F>
+void forEachSpan(F&& f) {
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    for (const auto& buf : reg.buffers) {
+
+        uint64_t head = buf->head.load(std::memory_order_acquire);
+        uint64_t first = buf->tail.load(std::memory_order_relaxed);
+        if (head > buf->slots.size()) {
+            first = std::max<uint64_t>(first, head - buf->slots.size());
+        }
+
+        for (uint64_t idx = first; idx < head; idx++) {
+
+            const auto& slot = buf->slots[idx % buf->slots.size()];
+
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            uint64_t start = slot.start.load(std::memory_order_relaxed);
+            uint64_t duration = slot.duration.load(std::memory_order_relaxed);
+            int64_t arg = slot.arg.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            // skip slots being overwritten
+            if (seq != 2 * idx + 2 || slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+
+            f(buf->tid, name, start, duration, arg);
+
+        }
+
+    }
+
+}
+
+void writeJSONString(std::ostream& out, const char* str) {
+
+    out << '"';
+    for (const char* c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+
+}
+
+}
+
+void enable(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setSampling(uint32_t every) {
+    sampling.store(std::max<uint32_t>(1, every), std::memory_order_relaxed);
+}
+
+void setBufferSize(size_t spans) {
+    buffer_size.store(spans);
+}
+
+void clear() {
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    for (auto& buf : reg.buffers) {
+        buf->tail.store(buf->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+
+    // buffers of exited threads have nothing left to export
+    for (const auto& buf : reg.free) {
+        reg.buffers.erase(std::find(reg.buffers.begin(), reg.buffers.end(), buf));
+    }
+    reg.free.clear();
+
+}
+
+void dump(std::ostream& out) {
+
+    auto flags = out.flags();
+    auto prec = out.precision();
+
+    out << "{\"traceEvents\":[";
+
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    forEachSpan([&out, &first] (uint32_t tid, const char* name, uint64_t start, uint64_t duration, int64_t arg) {
+        if (!first) {
+            out << ",";
+        }
+        first = false;
+        out << "\n{\"name\":";
+        writeJSONString(out, name);
+        out << ",\"cat\":\"cpphots\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid;
+        out << ",\"ts\":" << start / 1000.0 << ",\"dur\":" << duration / 1000.0;
+        if (arg >= 0) {
+            out << ",\"args\":{\"arg\":" << arg << "}";
+        }
+        out << "}";
+    });
+
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+    out.flags(flags);
+    out.precision(prec);
+
+}
+
+size_t getNumSpans() {
+
+    size_t count = 0;
+    forEachSpan([&count] (uint32_t, const char*, uint64_t, uint64_t, int64_t) { count++; });
+
+    return count;
+
+}
+
+Span::Span(const char* name, bool hot, int64_t arg)
+    :name(name), arg(arg), start(0), mode(Inactive), hot(hot) {
+
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    ThreadState& state = thread_state;
+
+    // nested in a span that was not sampled
+    if (state.skip_depth > 0) {
+        state.skip_depth++;
+        mode = Skipped;
+        return;
+    }
+
+    if (hot) {
+        if (state.hot_depth == 0 && (state.counter++ % sampling.load(std::memory_order_relaxed)) != 0) {
+            state.skip_depth = 1;
+            mode = Skipped;
+            return;
+        }
+        state.hot_depth++;
+    }
+
+    mode = Recording;
+    start = now();
+
+}
+
+Span::~Span() {
+
+    if (mode == Skipped) {
+        thread_state.skip_depth--;
+    } else if (mode == Recording) {
+        uint64_t end = now();
+        if (hot) {
+            thread_state.hot_depth--;
+        }
+        threadBuffer().push(name, start, end - start, arg);
+    }
+
+}
+
+}
+
+}
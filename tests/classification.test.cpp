@@ -1,5 +1,8 @@
 #include <cpphots/classification.h>
 
+#include <sstream>
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 
@@ -152,3 +155,175 @@ TEST_F(TestClassification, BhattacharyyaClassifier) {
     EXPECT_NEAR(acc, 0.78125, 0.01);
 
 }
+
+TEST_F(TestClassification, KNNPrototypes) {
+
+    std::vector<std::string> classes{"cl", "di", "he", "sp"};
+    std::vector<cpphots::Features> prototypes{
+        { 45,  46,  28, 372,  82,  65, 222, 217, 351, 262, 291, 107, 123,  73, 169, 112},
+        { 41,  48,  71, 288,  93, 199, 145, 325, 159, 340, 228,  39, 452, 157, 205, 325},
+        { 32,  63,  43, 262, 150, 118,  71, 102, 583, 103, 310,  35, 444, 163,  62, 467},
+        { 92,  53,  76, 205, 114, 610,  83, 388, 189, 649, 446,  32, 253, 234, 115, 520}
+    };
+
+    std::vector<std::pair<cpphots::KNNClassifier::Metric, double>> expected{
+        {cpphots::KNNClassifier::Standard, 0.734375},
+        {cpphots::KNNClassifier::Normalized, 0.8125},
+        {cpphots::KNNClassifier::Bhattacharyya, 0.78125}
+    };
+
+    for (auto [metric, expacc] : expected) {
+
+        cpphots::KNNClassifier classifier(classes, 1, metric);
+        for (size_t c = 0; c < classes.size(); c++) {
+            classifier.addSample(classes[c], prototypes[c]);
+        }
+        classifier.build();
+
+        double acc = 0.0;
+
+        for (size_t i = 0; i < 68; i++) {
+            if (classifier.classifyName(computed_features[i]) == realclasses[i])
+                acc += 1.0;
+        }
+
+        acc = (acc - 4) / (68 - 4);
+
+        EXPECT_NEAR(acc, expacc, 0.01);
+
+    }
+
+}
+
+TEST_F(TestClassification, KNNClassifier) {
+
+    cpphots::KNNClassifier classifier({"cl", "di", "he", "sp"}, 1, cpphots::KNNClassifier::Normalized);
+
+    EXPECT_THROW(classifier.classifyID(computed_features[0]), std::runtime_error);
+
+    for (size_t i = 0; i < 68; i++) {
+        classifier.addSample(realclasses[i], computed_features[i]);
+    }
+    classifier.build();
+
+    EXPECT_EQ(classifier.getNumSamples(), 68);
+    EXPECT_THROW(classifier.addSample("cl", {1, 2, 3}), std::runtime_error);
+
+    // with one neighbour, the training set is perfectly classified
+    auto batch = classifier.classifyName(computed_features, 3);
+    ASSERT_EQ(batch.size(), 68);
+    for (size_t i = 0; i < 68; i++) {
+        EXPECT_EQ(classifier.classifyName(computed_features[i]), realclasses[i]);
+        EXPECT_EQ(batch[i], realclasses[i]);
+    }
+
+    // errors in the worker threads are raised by the batch call
+    auto bad_batch = computed_features;
+    bad_batch.back() = {1, 2, 3};
+    EXPECT_THROW(classifier.classifyID(bad_batch, 3), std::runtime_error);
+    EXPECT_THROW(cpphots::KNNClassifier().classifyID(computed_features, 3), std::runtime_error);
+
+}
+
+TEST_F(TestClassification, KNNSaveLoad) {
+
+    cpphots::KNNClassifier classifier({"cl", "di", "he", "sp"}, 5, cpphots::KNNClassifier::Bhattacharyya);
+    for (size_t i = 0; i < 68; i += 2) {
+        classifier.addSample(realclasses[i], computed_features[i]);
+    }
+    classifier.build();
+
+    std::stringstream ss;
+    classifier.toStream(ss);
+
+    cpphots::KNNClassifier loaded;
+    loaded.fromStream(ss);
+
+    EXPECT_EQ(loaded.getNumSamples(), classifier.getNumSamples());
+    EXPECT_EQ(loaded.classifyID(computed_features), classifier.classifyID(computed_features));
+    for (size_t i = 1; i < 68; i += 2) {
+        EXPECT_EQ(loaded.classifyName(computed_features[i]), classifier.classifyName(computed_features[i]));
+    }
+
+}
+
+TEST_F(TestClassification, KNNLoadInvalid) {
+
+    auto load = [] (const std::string& str) {
+        std::stringstream ss(str);
+        cpphots::KNNClassifier loaded;
+        loaded.fromStream(ss);
+        return loaded;
+    };
+
+    EXPECT_EQ(load("2 1 0 0\n2 2\n0 1 2\n1 3 4\n").classifyID({3, 3}), 1);
+
+    // no neighbours
+    EXPECT_THROW(load("2 0 0 0\n2 2\n0 1 2\n1 3 4\n"), std::invalid_argument);
+
+    // unknown metric
+    EXPECT_THROW(load("2 1 3 0\n2 2\n0 1 2\n1 3 4\n"), std::invalid_argument);
+    EXPECT_THROW(load("2 1 -1 0\n2 2\n0 1 2\n1 3 4\n"), std::invalid_argument);
+
+    // label out of range
+    EXPECT_THROW(load("2 1 0 0\n2 2\n0 1 2\n2 3 4\n"), std::invalid_argument);
+
+    // truncated stream
+    EXPECT_THROW(load("2 1 0 0\n2 2\n0 1 2\n1 3"), std::runtime_error);
+    EXPECT_THROW(load("2 1"), std::runtime_error);
+
+}
+
+TEST_F(TestClassification, SparseFeatures) {
+
+    cpphots::Features feats{0, 3, 0, 0, 5, 1};
+    auto sparse = cpphots::toSparse(feats);
+
+    EXPECT_EQ(sparse, cpphots::SparseFeatures({{1, 3}, {4, 5}, {5, 1}}));
+    EXPECT_EQ(cpphots::toDense(sparse, feats.size()), feats);
+    EXPECT_THROW(cpphots::toDense(sparse, 4), std::invalid_argument);
+
+}
+
+TEST_F(TestClassification, SparseClassifiers) {
+
+    std::vector<std::string> classes{"cl", "di", "he", "sp"};
+    std::vector<cpphots::Features> prototypes{
+        { 45,  46,  28, 372,  82,  65, 222, 217, 351, 262, 291, 107, 123,  73, 169, 112},
+        { 41,  48,  71, 288,  93, 199, 145, 325, 159, 340, 228,  39, 452, 157, 205, 325},
+        { 32,  63,  43, 262, 150, 118,  71, 102, 583, 103, 310,  35, 444, 163,  62, 467},
+        { 92,  53,  76, 205, 114, 610,  83, 388, 189, 649, 446,  32, 253, 234, 115, 520}
+    };
+
+    cpphots::StandardClassifier standard(classes);
+    cpphots::NormalizedClassifier normalized(classes);
+    cpphots::BhattacharyyaClassifier bhattacharyya(classes);
+    std::vector<cpphots::Classifier*> classifiers{&standard, &normalized, &bhattacharyya};
+
+    for (auto* classifier : classifiers) {
+
+        for (size_t c = 0; c < classes.size(); c++) {
+            classifier->setClassFeatures(c, prototypes[c]);
+        }
+
+        for (const auto& feats : computed_features) {
+            EXPECT_EQ(classifier->classifyID(cpphots::toSparse(feats)), classifier->classifyID(feats));
+
+            auto dists = classifier->classDistances(feats);
+            auto sparse_dists = classifier->classDistances(cpphots::toSparse(feats));
+            ASSERT_EQ(dists.size(), classes.size());
+            ASSERT_EQ(sparse_dists.size(), classes.size());
+            EXPECT_EQ(size_t(std::min_element(dists.begin(), dists.end()) - dists.begin()), classifier->classifyID(feats));
+            for (size_t c = 0; c < classes.size(); c++) {
+                EXPECT_NEAR(sparse_dists[c], dists[c], 1e-6 * std::max(1.0, dists[c]));
+            }
+        }
+
+        EXPECT_EQ(classifier->getNumClasses(), classes.size());
+        EXPECT_EQ(classifier->getClassName(2), "he");
+
+        EXPECT_THROW(classifier->classifyID(cpphots::SparseFeatures{{16, 1}}), std::runtime_error);
+
+    }
+
+}
@@ -17,14 +17,16 @@ public:
     RandomEventGenerator(uint16_t xmax = std::numeric_limits<uint16_t>::max(),
                          uint16_t ymax = std::numeric_limits<uint16_t>::max(),
                          uint16_t pmax = std::numeric_limits<uint16_t>::max(),
-                         uint64_t dt = 0)
-        :RandomEventGenerator(0, xmax, 0, ymax, 0, pmax, dt) {}
+                         uint64_t dt = 0,
+                         unsigned int seed = std::random_device{}())
+        :RandomEventGenerator(0, xmax, 0, ymax, 0, pmax, dt, seed) {}
 
     RandomEventGenerator(uint16_t xmin, uint16_t xmax,
                          uint16_t ymin, uint16_t ymax,
                          uint16_t pmin, uint16_t pmax,
-                         uint64_t dt = 0)
-        :dt(dt) {
+                         uint64_t dt = 0,
+                         unsigned int seed = std::random_device{}())
+        :dt(dt), gen(seed) {
 
             distx = std::uniform_int_distribution<uint16_t>(xmin, xmax-1);
             disty = std::uniform_int_distribution<uint16_t>(ymin, ymax-1);
@@ -71,7 +73,7 @@ private:
     uint64_t dt;
     uint16_t last_t;
 
-    std::mt19937 gen = std::mt19937{std::random_device{}()};
+    std::mt19937 gen;
 
     std::uniform_int_distribution<uint16_t> distx, disty, distp;
     std::uniform_int_distribution<uint64_t> distt;
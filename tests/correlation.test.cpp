@@ -0,0 +1,131 @@
+#include <cmath>
+#include <algorithm>
+
+#include <cpphots/correlation.h>
+#include <cpphots/network.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/layer_modifiers.h>
+#include <cpphots/clustering/kmeans.h>
+#include <cpphots/clustering/cosine.h>
+#include <cpphots/run.h>
+
+#include "commons.h"
+
+#include <gtest/gtest.h>
+
+
+static cpphots::Layer trainLayer(cpphots::interfaces::Clusterer* clusterer, const cpphots::Events& events) {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::ExponentialTimeSurface>(2, 24, 20, 2, 1, 50), clusterer);
+    cpphots::train(network, events, cpphots::ClustererUniformSeeding, true);
+    network[0].toggleLearning(false);
+
+    return network[0];
+
+}
+
+// the layer must give the same output as the original layer, except for near ties
+static void checkAgreement(cpphots::Layer& layer, const cpphots::Events& events) {
+
+    cpphots::CorrelationLayer corr(layer);
+
+    for (bool skip_check : {false, true}) {
+        layer.reset();
+        corr.reset();
+        size_t valid = 0, agree = 0;
+        for (const auto& ev : events) {
+            auto expected = layer.process(ev, skip_check);
+            auto actual = corr.process(ev, skip_check);
+            ASSERT_EQ(actual == cpphots::invalid_event, expected == cpphots::invalid_event);
+            if (expected != cpphots::invalid_event) {
+                valid++;
+                agree += (actual == expected);
+            }
+        }
+        EXPECT_GT(valid, 100u);
+        EXPECT_GE(agree, valid * 0.99);
+    }
+
+}
+
+TEST(TestCorrelationLayer, Correlations) {
+
+    cpphots::Events events(4000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(24, 20, 2, 3, 1));
+    cpphots::Layer layer = trainLayer(new cpphots::KMeansClusterer(5, 10), events);
+    cpphots::CorrelationLayer corr(layer);
+    layer.reset();
+
+    // the maps are rebuilt several times during the stream
+    ASSERT_GT(events.back().t, 100 * 50);
+
+    const auto& centroids = layer.getCentroids();
+    for (size_t i = 0; i < events.size(); i++) {
+        const auto& ev = events[i];
+        corr.process(ev, true);
+        layer.update(ev);
+        if (i % 97 != 0) {
+            continue;
+        }
+        auto [surface, good] = layer.compute(ev);
+        for (uint16_t k = 0; k < centroids.size(); k++) {
+            double expected = (surface * centroids[k]).sum();
+            EXPECT_NEAR(corr.getCorrelation(ev.t, ev.x, ev.y, ev.p, k), expected, 1e-4 * (1 + std::abs(expected)));
+        }
+    }
+
+    EXPECT_GT(corr.memoryUsage().get("correlation"), 2 * 24 * 20 * 5 * sizeof(double));
+
+}
+
+TEST(TestCorrelationLayer, KMeans) {
+
+    cpphots::Events events(4000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(24, 20, 2, 3, 2));
+    cpphots::Layer layer = trainLayer(new cpphots::KMeansClusterer(6, 10), events);
+    checkAgreement(layer, events);
+
+}
+
+TEST(TestCorrelationLayer, Cosine) {
+
+    cpphots::Events events(4000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(24, 20, 2, 3, 3));
+
+    cpphots::Layer layer = trainLayer(new cpphots::CosineClusterer(6), events);
+    checkAgreement(layer, events);
+
+    cpphots::Layer cos_layer = trainLayer(new cpphots::BasicKMeansClusterer<cpphots::distance::Cosine>(6, 10), events);
+    checkAgreement(cos_layer, events);
+
+}
+
+TEST(TestCorrelationLayer, Remapper) {
+
+    cpphots::Events events(2000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(24, 20, 2, 3, 4));
+    cpphots::Layer layer = trainLayer(new cpphots::KMeansClusterer(4, 10), events);
+    layer.addRemapper(new cpphots::ArrayLayer());
+    checkAgreement(layer, events);
+
+}
+
+TEST(TestCorrelationLayer, Unsupported) {
+
+    cpphots::Events events(2000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(24, 20, 2, 3, 5));
+
+    cpphots::Layer linear(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 24, 20, 2, 1, 50), new cpphots::KMeansClusterer(4));
+    EXPECT_THROW(cpphots::CorrelationLayer{linear}, std::invalid_argument);
+
+    cpphots::Layer untrained(cpphots::create_pool_ptr<cpphots::ExponentialTimeSurface>(2, 24, 20, 2, 1, 50), new cpphots::KMeansClusterer(4));
+    EXPECT_THROW(cpphots::CorrelationLayer{untrained}, std::invalid_argument);
+
+    cpphots::Layer manhattan = trainLayer(new cpphots::BasicKMeansClusterer<cpphots::distance::Manhattan>(4, 10), events);
+    EXPECT_THROW(cpphots::CorrelationLayer{manhattan}, std::invalid_argument);
+
+    cpphots::Layer full(cpphots::create_pool_ptr<cpphots::ExponentialTimeSurface>(2, 24, 20, 0, 1, 50), new cpphots::KMeansClusterer(4));
+    EXPECT_THROW(cpphots::CorrelationLayer{full}, std::invalid_argument);
+
+}
@@ -1,8 +1,12 @@
 #include <random>
+#include <set>
+#include <memory>
+#include <sstream>
 
 #include <cpphots/types.h>
 #include <cpphots/clustering/kmeans.h>
 #include <cpphots/clustering/utils.h>
+#include <cpphots/load.h>
 
 #include <gtest/gtest.h>
 
@@ -40,6 +44,32 @@ TEST(TestKMeans, Train) {
 
 }
 
+TEST(TestKMeans, ToggleLearning) {
+
+    cpphots::KMeansClusterer clust(2);
+    clust.addCentroid(cpphots::TimeSurfaceType::Constant(1, 1, 20.0));
+    clust.addCentroid(cpphots::TimeSurfaceType::Constant(1, 1, 80.0));
+
+    // enabling and then disabling learning trains on the stored surfaces
+    EXPECT_FALSE(clust.toggleLearning(true));
+    for (size_t i = 0; i < 10; i++) {
+        clust.cluster(cpphots::TimeSurfaceType::Constant(1, 1, 25.0));
+        clust.cluster(cpphots::TimeSurfaceType::Constant(1, 1, 75.0));
+    }
+    EXPECT_TRUE(clust.toggleLearning(false));
+
+    auto centroids = clust.getCentroids();
+    EXPECT_NEAR(centroids[0](0, 0), 25.0, 1e-3);
+    EXPECT_NEAR(centroids[1](0, 0), 75.0, 1e-3);
+
+    // disabling it again does not train
+    EXPECT_FALSE(clust.toggleLearning(false));
+    centroids = clust.getCentroids();
+    EXPECT_NEAR(centroids[0](0, 0), 25.0, 1e-3);
+    EXPECT_NEAR(centroids[1](0, 0), 75.0, 1e-3);
+
+}
+
 TEST(TestKMeans, SaveLoad) {
 
     cpphots::KMeansClusterer clusterer1(20);
@@ -74,4 +104,274 @@ TEST(TestKMeans, SaveLoad) {
 
     EXPECT_EQ(clusterer1.getHistogram(), clusterer2.getHistogram());
 
-}
\ No newline at end of file
+}
+
+TEST(TestKMeans, LoadWithoutTolerance) {
+
+    // layout used before the tolerance was saved
+    std::istringstream istream("!KMEANSCLUSTERER\n2 10 2 1 2\n0 0\n1 1\n");
+    cpphots::KMeansClusterer clusterer;
+
+    istream >> clusterer;
+
+    ASSERT_TRUE(clusterer.hasCentroids());
+    EXPECT_EQ(clusterer.getNumClusters(), 2);
+    EXPECT_EQ(clusterer.cluster(cpphots::TimeSurfaceType::Constant(1, 2, 0.9)), 1);
+
+    std::istringstream bad("!KMEANSCLUSTERER\n2 10\n");
+    EXPECT_THROW(bad >> clusterer, std::runtime_error);
+
+}
+
+TEST(TestKMeans, Telemetry) {
+
+    std::vector<cpphots::TimeSurfaceType> data(400);
+    for (size_t i = 0; i < 400; i++) {
+        data[i] = (cpphots::TimeSurfaceType::Random(3, 3) + 1.f) / 2.f;
+    }
+
+    cpphots::KMeansClusterer clust(8, 100);
+    cpphots::ClustererUniformSeeding(clust, data);
+
+    std::vector<cpphots::KMeansIteration> received;
+    clust.setProgressCallback([&received] (const cpphots::KMeansIteration& it) { received.push_back(it); });
+
+    clust.train(data);
+
+    const auto& telemetry = clust.getTelemetry();
+    ASSERT_FALSE(telemetry.empty());
+    ASSERT_EQ(telemetry.size(), received.size());
+
+    for (size_t i = 0; i < telemetry.size(); i++) {
+        EXPECT_EQ(telemetry[i].iteration, i);
+        EXPECT_EQ(telemetry[i].inertia, received[i].inertia);
+        if (i > 0) {
+            EXPECT_LE(telemetry[i].inertia, telemetry[i-1].inertia * (1 + 1e-5));
+        }
+    }
+
+    // centroids do not move in the last iteration
+    EXPECT_NEAR(telemetry.back().shift, 0.0, 1e-6);
+
+}
+
+TEST(TestKMeans, Tolerance) {
+
+    std::vector<cpphots::TimeSurfaceType> data(400);
+    for (size_t i = 0; i < 400; i++) {
+        data[i] = (cpphots::TimeSurfaceType::Random(3, 3) + 1.f) / 2.f;
+    }
+
+    cpphots::KMeansClusterer clust_exact(8, 100);
+    cpphots::ClustererUniformSeeding(clust_exact, data);
+
+    cpphots::KMeansClusterer clust_tol(8, 100, 0.5);
+    for (const auto& c : clust_exact.getCentroids()) {
+        clust_tol.addCentroid(c);
+    }
+
+    clust_exact.train(data);
+    clust_tol.train(data);
+
+    const auto& telemetry = clust_tol.getTelemetry();
+    ASSERT_GE(telemetry.size(), 2);
+    EXPECT_LE(telemetry.size(), clust_exact.getTelemetry().size());
+
+    // training stops at the first iteration whose relative improvement is below tolerance
+    for (size_t i = 1; i < telemetry.size(); i++) {
+        bool converged = std::abs(telemetry[i-1].inertia - telemetry[i].inertia) < 0.5 * telemetry[i].inertia;
+        EXPECT_EQ(converged, i == telemetry.size() - 1);
+    }
+
+}
+
+TEST(TestKMeans, SparseHistogram) {
+
+    cpphots::KMeansClusterer clusterer(20);
+    cpphots::ClustererRandomSeeding(3, 3)(clusterer, {});
+
+    for (uint16_t i = 0; i < 10; i++) {
+        clusterer.cluster(cpphots::TimeSurfaceType::Random(3, 3) + 1.f /2.f);
+    }
+
+    auto hist = clusterer.getHistogram();
+    auto sparse = clusterer.getSparseHistogram();
+
+    ASSERT_FALSE(sparse.empty());
+    EXPECT_LE(sparse.size(), 10);
+
+    uint32_t ssum = 0;
+    for (size_t i = 0; i < sparse.size(); i++) {
+        EXPECT_GT(sparse[i].second, 0);
+        EXPECT_EQ(hist[sparse[i].first], sparse[i].second);
+        if (i > 0) {
+            EXPECT_LT(sparse[i-1].first, sparse[i].first);
+        }
+        ssum += sparse[i].second;
+    }
+    EXPECT_EQ(ssum, 10);
+
+    clusterer.reset();
+    EXPECT_TRUE(clusterer.getSparseHistogram().empty());
+    EXPECT_EQ(clusterer.getHistogram(), std::vector<uint32_t>(20, 0));
+
+}
+
+TEST(TestKMeans, MemoryUsage) {
+
+    cpphots::KMeansClusterer clusterer(4);
+    cpphots::ClustererRandomSeeding(3, 3)(clusterer, {});
+
+    auto mem = clusterer.memoryUsage();
+    EXPECT_EQ(mem.get("centroids"), cpphots::KMeansClusterer::estimateMemoryUsage(4, 3, 3).get("centroids"));
+    EXPECT_EQ(mem.get("learning"), 0);
+
+    clusterer.toggleLearning(true);
+    for (uint16_t i = 0; i < 50; i++) {
+        clusterer.cluster(cpphots::TimeSurfaceType::Random(3, 3));
+    }
+    EXPECT_GE(clusterer.memoryUsage().get("learning"), cpphots::KMeansClusterer::estimateMemoryUsage(4, 3, 3, 50).get("learning"));
+
+    clusterer.toggleLearning(false);
+    EXPECT_EQ(clusterer.memoryUsage().get("learning"), 0);
+
+}
+
+template <typename Distance>
+void checkDistance() {
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> noise(0.0, 0.01);
+
+    // four blobs pointing in different directions
+    std::vector<cpphots::TimeSurfaceType> data;
+    for (size_t i = 0; i < 400; i++) {
+        cpphots::TimeSurfaceType ts = cpphots::TimeSurfaceType::Constant(2, 2, 0.1);
+        ts(i % 4) = 1.0;
+        for (int j = 0; j < ts.size(); j++) {
+            ts(j) += noise(gen);
+        }
+        data.push_back(ts);
+    }
+
+    cpphots::BasicKMeansClusterer<Distance> clust(4, 100);
+    cpphots::BasicClustererPlusPlusSeeding<Distance>(clust, data);
+    clust.train(data);
+
+    std::vector<uint16_t> labels;
+    for (size_t i = 0; i < data.size(); i++) {
+        labels.push_back(clust.cluster(data[i]));
+        EXPECT_EQ(labels[i], labels[i % 4]);
+    }
+    std::set<uint16_t> distinct(labels.begin(), labels.end());
+    EXPECT_EQ(distinct.size(), 4);
+
+    // saved with the distance
+    std::stringstream stream;
+    stream << clust;
+    std::unique_ptr<cpphots::interfaces::Clusterer> loaded(cpphots::loadClustererFromStream(stream));
+    EXPECT_NE(dynamic_cast<cpphots::BasicKMeansClusterer<Distance>*>(loaded.get()), nullptr);
+
+}
+
+TEST(TestKMeans, Distances) {
+
+    cpphots::TimeSurfaceType a(1, 2), b(1, 2);
+    a << 1.0, 0.0;
+    b << 0.0, 2.0;
+
+    EXPECT_FLOAT_EQ(cpphots::distance::SquaredEuclidean::compute(a, b), 5.0);
+    EXPECT_FLOAT_EQ(cpphots::distance::Euclidean::compute(a, b), std::sqrt(5.0));
+    EXPECT_FLOAT_EQ(cpphots::distance::Manhattan::compute(a, b), 3.0);
+    EXPECT_FLOAT_EQ(cpphots::distance::Chebyshev::compute(a, b), 2.0);
+    EXPECT_FLOAT_EQ(cpphots::distance::Cosine::compute(a, b), 1.0);
+    EXPECT_FLOAT_EQ(cpphots::distance::Cosine::compute(b, 2 * b), 0.0);
+
+    checkDistance<cpphots::distance::SquaredEuclidean>();
+    checkDistance<cpphots::distance::Euclidean>();
+    checkDistance<cpphots::distance::Manhattan>();
+    checkDistance<cpphots::distance::Chebyshev>();
+    checkDistance<cpphots::distance::Cosine>();
+
+    EXPECT_EQ(cpphots::KMeansClusterer::getMetacommand(), "KMEANSCLUSTERER");
+    EXPECT_EQ(cpphots::BasicKMeansClusterer<cpphots::distance::Manhattan>::getMetacommand(), "KMEANSCLUSTERER_MANHATTAN");
+
+}
+
+template <typename Distance>
+void checkLabelCache(bool expect_hits) {
+
+    // a few recurring patterns with small variations, that do not change their quantisation
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> level(0, 3);
+    std::uniform_real_distribution<cpphots::TimeSurfaceScalarType> noise(-0.01, 0.01);
+    std::vector<cpphots::TimeSurfaceType> patterns(8, cpphots::TimeSurfaceType(3, 3));
+    for (auto& p : patterns) {
+        p = p.unaryExpr([&] (cpphots::TimeSurfaceScalarType) { return cpphots::TimeSurfaceScalarType((level(gen) + 0.5) / 4); });
+    }
+    std::vector<cpphots::TimeSurfaceType> data;
+    for (size_t i = 0; i < 2000; i++) {
+        cpphots::TimeSurfaceType s = patterns[i % patterns.size()].unaryExpr([&] (cpphots::TimeSurfaceScalarType v) { return v + noise(gen); });
+        data.push_back(s);
+    }
+
+    cpphots::BasicKMeansClusterer<Distance> exact(8, 20);
+    for (size_t i = 0; i < 8; i++) {
+        exact.addCentroid(patterns[i]);
+    }
+    exact.train(data);
+
+    // verified labels are always the same as the full search
+    auto cached = exact;
+    cached.enableLabelCache(2);
+    for (const auto& s : data) {
+        EXPECT_EQ(cached.cluster(s), exact.cluster(s));
+    }
+    EXPECT_EQ(cached.getHistogram(), exact.getHistogram());
+
+    const auto& stats = cached.getLabelCacheStats();
+    EXPECT_EQ(stats.lookups, data.size());
+    EXPECT_EQ(stats.hits + stats.rejected + stats.misses, stats.lookups);
+    EXPECT_EQ(stats.audits, 0);
+    if (expect_hits) {
+        EXPECT_GT(stats.hits, data.size() / 2);
+        EXPECT_LT(stats.distances, stats.lookups * 8);
+    } else {
+        EXPECT_EQ(stats.hits, 0);
+    }
+
+    // unverified labels, all audited
+    cached.enableLabelCache(2, 65536, false, 1);
+    cached.resetLabelCacheStats();
+    for (const auto& s : data) {
+        EXPECT_EQ(cached.cluster(s), exact.cluster(s));
+    }
+    EXPECT_EQ(stats.audits, stats.hits);
+    EXPECT_GT(stats.hits, 0);
+
+    // the cache is emptied when centroids change, and when full
+    cached.enableLabelCache(2, 4);
+    cached.train(data);
+    cached.resetLabelCacheStats();
+    for (const auto& s : data) {
+        cached.cluster(s);
+    }
+    EXPECT_GT(stats.flushes, 0);
+
+    cached.disableLabelCache();
+    cached.resetLabelCacheStats();
+    cached.cluster(data[0]);
+    EXPECT_EQ(stats.lookups, 0);
+
+    EXPECT_THROW(cached.enableLabelCache(0), std::invalid_argument);
+    EXPECT_THROW(cached.enableLabelCache(9), std::invalid_argument);
+
+}
+
+TEST(TestKMeans, LabelCache) {
+
+    checkLabelCache<cpphots::distance::SquaredEuclidean>(true);
+    checkLabelCache<cpphots::distance::Manhattan>(true);
+    checkLabelCache<cpphots::distance::Cosine>(false);
+
+}
@@ -316,6 +316,23 @@ TEST_F(TestLayerSeeding, AFKMC2) {
 
 }
 
+TEST_F(TestLayerSeeding, AFKMC2Seed) {
+
+    auto seeding = cpphots::ClustererAFKMC2Seeding(5, 42);
+
+    cpphots::layerSeedCentroids(seeding, layer, events);
+    ASSERT_TRUE(layer.hasCentroids());
+    auto centroids = layer.getCentroids();
+
+    layer.clearCentroids();
+    cpphots::layerSeedCentroids(seeding, layer, events);
+    ASSERT_EQ(layer.getCentroids().size(), centroids.size());
+    for (size_t i = 0; i < centroids.size(); i++) {
+        EXPECT_TRUE((layer.getCentroids()[i] == centroids[i]).all());
+    }
+
+}
+
 TEST_F(TestLayerSeeding, Random) {
 
     cpphots::layerSeedCentroids(cpphots::ClustererRandomSeeding(5, 5), layer, events);
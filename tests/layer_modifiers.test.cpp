@@ -184,4 +184,26 @@ TEST(TestModifiersLayer, SuperCell) {
     EXPECT_EQ(evt.x, 1);
     EXPECT_EQ(evt.y, 7);
 
-}
\ No newline at end of file
+}
+
+TEST(TestModifiersLayer, SuperCellAverageMemory) {
+
+    cpphots::SuperCellAverage sc(50, 50, 10);
+    size_t empty = sc.memoryUsage().get("supercell");
+
+    cpphots::Layer layer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 50, 50, 2, 2, 10000));
+    layer.createClusterer<MockClusterer>(10);
+    layer.createSuperCell<cpphots::SuperCellAverage>(50, 50, 10);
+
+    for (uint16_t y = 0; y < 50; y++) {
+        for (uint16_t x = 0; x < 50; x++) {
+            layer.process(y * 50 + x, x, y, 0, true);
+        }
+    }
+
+    auto mem = layer.memoryUsage();
+    EXPECT_GT(mem.get("supercell"), empty);
+    EXPECT_EQ(mem.get("supercell"), cpphots::SuperCellAverage::estimateMemoryUsage(50, 50, 10, 5, 5).get("supercell"));
+    EXPECT_EQ(mem.get("context"), 2 * layer.getSurface(0)->memoryUsage().get("context"));
+
+}
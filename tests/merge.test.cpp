@@ -0,0 +1,214 @@
+#include <random>
+
+#include <cpphots/merge.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/clustering/cosine.h>
+
+#include "commons.h"
+
+#include <gtest/gtest.h>
+
+
+class TestEventMerger : public ::testing::Test {
+
+protected:
+
+    void SetUp() override {
+
+        std::mt19937 gen(7);
+
+        for (size_t s = 0; s < 3; s++) {
+
+            RandomEventGenerator ev_gen(20, 20, 2, 10);
+            sorted.emplace_back(1000);
+            std::generate(sorted.back().begin(), sorted.back().end(), ev_gen);
+
+            // distinct timestamps, so that the order within a source is unique
+            for (size_t i = 0; i < sorted.back().size(); i++) {
+                sorted.back()[i].t += i;
+            }
+
+            // each event is moved later by less than the window
+            std::vector<std::pair<uint64_t, cpphots::event>> arrival;
+            std::uniform_int_distribution<uint64_t> delay(0, window - 1);
+            for (const auto& ev : sorted.back()) {
+                arrival.push_back({ev.t + delay(gen), ev});
+            }
+            std::stable_sort(arrival.begin(), arrival.end(), [] (const auto& a, const auto& b) { return a.first < b.first; });
+
+            shuffled.emplace_back();
+            for (const auto& a : arrival) {
+                shuffled.back().push_back(a.second);
+            }
+
+        }
+
+    }
+
+    // push packets of the sources in turn, consuming after each one
+    cpphots::Events mergeAll(cpphots::EventMerger& merger) {
+
+        cpphots::Events merged;
+        auto collect = [&merged] (const cpphots::event& ev) { merged.push_back(ev); };
+
+        for (size_t begin = 0; begin < 1000; begin += 50) {
+            for (size_t s = 0; s < shuffled.size(); s++) {
+                merger.push(s, cpphots::Events(shuffled[s].begin() + begin, shuffled[s].begin() + begin + 50));
+                merger.consume(collect);
+            }
+        }
+
+        for (size_t s = 0; s < shuffled.size(); s++) {
+            merger.closeSource(s);
+        }
+        merger.consume(collect);
+
+        return merged;
+
+    }
+
+    const uint64_t window = 30;
+    std::vector<cpphots::Events> sorted;
+    std::vector<cpphots::Events> shuffled;
+
+};
+
+TEST_F(TestEventMerger, Ordering) {
+
+    cpphots::EventMerger merger(window);
+    merger.addSource();
+    merger.addSource(20, 0, 0);
+    merger.addSource(0, 0, 2);
+
+    auto merged = mergeAll(merger);
+
+    EXPECT_EQ(merger.getBuffered(), 0);
+    auto stats = merger.getStats();
+    EXPECT_EQ(stats.received, 3000);
+    EXPECT_EQ(stats.emitted, 3000);
+    EXPECT_EQ(stats.late, 0);
+    EXPECT_EQ(stats.forced, 0);
+    EXPECT_LT(stats.max_buffered, 3000);
+
+    ASSERT_EQ(merged.size(), 3000);
+    EXPECT_TRUE(std::is_sorted(merged.begin(), merged.end(), [] (const auto& a, const auto& b) { return a.t < b.t; }));
+
+    // sources are tagged by their offsets
+    std::vector<cpphots::Events> split(3);
+    for (const auto& ev : merged) {
+        if (ev.x >= 20) {
+            split[1].push_back({ev.t, uint16_t(ev.x - 20), ev.y, ev.p});
+        } else if (ev.p >= 2) {
+            split[2].push_back({ev.t, ev.x, ev.y, uint16_t(ev.p - 2)});
+        } else {
+            split[0].push_back(ev);
+        }
+    }
+    for (size_t s = 0; s < 3; s++) {
+        ASSERT_EQ(split[s].size(), sorted[s].size());
+        for (size_t i = 0; i < sorted[s].size(); i++) {
+            EXPECT_EQ(split[s][i].t, sorted[s][i].t);
+        }
+    }
+
+}
+
+TEST_F(TestEventMerger, LateEvents) {
+
+    cpphots::EventMerger merger(10);
+    merger.addSource();
+
+    EXPECT_TRUE(merger.push(0, {100, 0, 0, 0}));
+    EXPECT_EQ(merger.getWatermark(), 90);
+    EXPECT_TRUE(merger.push(0, {50, 0, 0, 0}));
+
+    cpphots::event ev;
+    ASSERT_TRUE(merger.pop(ev));
+    EXPECT_EQ(ev.t, 50);
+    EXPECT_FALSE(merger.pop(ev));
+
+    EXPECT_FALSE(merger.push(0, {40, 0, 0, 0}));
+    EXPECT_TRUE(merger.push(0, {95, 0, 0, 0}));
+    EXPECT_EQ(merger.getStats().late, 1);
+    EXPECT_EQ(merger.getLateEvents(0), 1);
+
+    merger.flush();
+    ASSERT_TRUE(merger.pop(ev));
+    EXPECT_EQ(ev.t, 95);
+    ASSERT_TRUE(merger.pop(ev));
+    EXPECT_EQ(ev.t, 100);
+    EXPECT_FALSE(merger.pop(ev));
+
+}
+
+TEST_F(TestEventMerger, Watermark) {
+
+    cpphots::EventMerger merger(10);
+    merger.addSource();
+    merger.addSource();
+
+    // the silent source holds back the other
+    merger.push(0, {0, 0, 0, 0});
+    merger.push(0, {100, 0, 0, 0});
+    cpphots::event ev;
+    EXPECT_FALSE(merger.pop(ev));
+
+    merger.heartbeat(1, 50);
+    ASSERT_TRUE(merger.pop(ev));
+    EXPECT_EQ(ev.t, 0);
+    EXPECT_FALSE(merger.pop(ev));
+
+    merger.closeSource(1);
+    EXPECT_EQ(merger.getWatermark(), 90);
+    EXPECT_FALSE(merger.pop(ev));
+
+    merger.closeSource(0);
+    ASSERT_TRUE(merger.pop(ev));
+    EXPECT_EQ(ev.t, 100);
+
+}
+
+TEST_F(TestEventMerger, Capacity) {
+
+    cpphots::EventMerger merger(1000, 10);
+    merger.addSource();
+
+    for (uint64_t t = 1; t <= 100; t++) {
+        merger.push(0, {t, 0, 0, 0});
+        cpphots::event ev;
+        while (merger.pop(ev)) {}
+        EXPECT_LT(merger.getBuffered(), 10);
+    }
+
+    EXPECT_EQ(merger.getStats().forced, 91);
+    EXPECT_EQ(merger.getStats().late, 0);
+
+}
+
+TEST_F(TestEventMerger, Network) {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 20, 20, 1, 1, 1000),
+                        new cpphots::CosineClusterer(4));
+    cpphots::ClustererRandomSeeding(3, 3)(network[0], {});
+    network[0].toggleLearning(false);
+
+    cpphots::Network expected_network = network;
+    for (const auto& ev : sorted[0]) {
+        expected_network.process(ev, true);
+    }
+
+    cpphots::EventMerger merger(window);
+    merger.addSource();
+    size_t processed = 0;
+    for (size_t begin = 0; begin < 1000; begin += 100) {
+        merger.push(0, cpphots::Events(shuffled[0].begin() + begin, shuffled[0].begin() + begin + 100));
+        processed += merger.process(network, true);
+    }
+    merger.flush();
+    processed += merger.process(network, true);
+
+    EXPECT_EQ(processed, 1000);
+    EXPECT_EQ(network.back().getHistogram(), expected_network.back().getHistogram());
+
+}
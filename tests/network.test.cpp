@@ -94,4 +94,21 @@ TEST_F(TestNetwork, Subnetworks) {
 
     EXPECT_EQ(hist1, hist2);
 
-}
\ No newline at end of file
+}
+
+TEST_F(TestNetwork, MemoryUsage) {
+
+    auto mem = network.memoryUsage();
+
+    cpphots::MemoryUsage expected;
+    for (const auto& l : network) {
+        expected += l.memoryUsage();
+    }
+    EXPECT_EQ(mem.categories, expected.categories);
+    EXPECT_EQ(mem.total(), expected.total());
+
+    auto est = cpphots::TimeSurfacePool::estimateMemoryUsage<cpphots::LinearTimeSurface>(2, 50, 40, 2, 2, 100) +
+               cpphots::TimeSurfacePool::estimateMemoryUsage<cpphots::LinearTimeSurface>(4, 50, 40, 2, 2, 100);
+    EXPECT_EQ(mem.get("context"), est.get("context"));
+
+}
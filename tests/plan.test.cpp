@@ -0,0 +1,118 @@
+#include <sstream>
+#include <algorithm>
+
+#include <cpphots/plan.h>
+#include <cpphots/network.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/layer_modifiers.h>
+#include <cpphots/clustering/kmeans.h>
+#include <cpphots/clustering/cosine.h>
+#include <cpphots/run.h>
+
+#include "commons.h"
+
+#include <gtest/gtest.h>
+
+
+// the plan must produce the same events as the trained network
+static void checkEquivalence(cpphots::Network& network, const cpphots::Events& events) {
+
+    for (auto& layer : network) {
+        if (layer.canCluster()) {
+            layer.toggleLearning(false);
+        }
+    }
+
+    cpphots::ExecutionPlan plan = network.compile(events);
+    ASSERT_EQ(plan.getNetwork().getNumLayers(), network.getNumLayers());
+
+    for (bool skip_check : {false, true}) {
+        network.reset();
+        plan.reset();
+        size_t valid = 0;
+        for (const auto& ev : events) {
+            auto expected = network.process(ev, skip_check);
+            EXPECT_EQ(plan.process(ev, skip_check), expected);
+            valid += (expected != cpphots::invalid_event);
+        }
+        EXPECT_GT(valid, 0u);
+    }
+
+}
+
+TEST(TestExecutionPlan, LinearKMeans) {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 32, 24, 2, 2, 200),
+                        new cpphots::KMeansClusterer(4, 10));
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 32, 24, 1, 1, 400),
+                        new cpphots::BasicKMeansClusterer<cpphots::distance::Manhattan>(6, 10));
+
+    cpphots::Events events(5000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(32, 24, 2, 5, 3));
+    cpphots::train(network, events, cpphots::ClustererUniformSeeding, true);
+
+    checkEquivalence(network, events);
+
+    cpphots::ExecutionPlan plan(network);
+    const auto& decisions = plan.getDecisions();
+    ASSERT_EQ(decisions.size(), 4);
+
+    // generic, dynamic and fixed windows are timed for plain linear surfaces
+    EXPECT_EQ(decisions[0].layer, 0);
+    EXPECT_EQ(decisions[0].stage, "surface");
+    ASSERT_EQ(decisions[0].candidates.size(), 3);
+    EXPECT_EQ(decisions[0].candidates[2].first, "fixed-5x5");
+    EXPECT_EQ(decisions[2].candidates[2].first, "fixed-3x3");
+
+    EXPECT_EQ(decisions[1].stage, "clustering");
+    ASSERT_EQ(decisions[1].candidates.size(), 2);
+    EXPECT_TRUE(decisions[1].choice == "brute-force" || decisions[1].choice == "label-cache");
+
+    std::stringstream report;
+    report << plan;
+    EXPECT_NE(report.str().find("layer 1 clustering"), std::string::npos);
+
+    EXPECT_THROW(cpphots::ExecutionPlan(cpphots::Network()), std::invalid_argument);
+
+}
+
+TEST(TestExecutionPlan, GenericLayers) {
+
+    cpphots::TimeSurfaceType weights = cpphots::TimeSurfaceType::Constant(30, 30, 0.5);
+    weights.block(10, 10, 10, 10) = 1.0;
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::WeightedLinearTimeSurface>(2, 30, 30, 2, 2, 200, weights),
+                        new cpphots::CosineClusterer(4));
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 30, 30, 2, 2, 400),
+                        new cpphots::KMeansClusterer(3, 10),
+                        nullptr,
+                        new cpphots::SuperCell(30, 30, 5));
+
+    cpphots::Events events(5000);
+    std::generate(events.begin(), events.end(), RandomEventGenerator(30, 30, 2, 5, 5));
+    cpphots::train(network, events, cpphots::ClustererUniformSeeding, true);
+
+    checkEquivalence(network, events);
+
+    // weighted surfaces and supercells are processed by the layer
+    cpphots::ExecutionPlan plan = network.compile();
+    const auto& decisions = plan.getDecisions();
+    ASSERT_EQ(decisions.size(), 4);
+    EXPECT_EQ(decisions[0].choice, "generic");
+    EXPECT_EQ(decisions[0].candidates.size(), 1);
+    EXPECT_EQ(decisions[1].choice, "generic");
+    EXPECT_EQ(decisions[2].choice, "generic");
+
+}
+
+TEST(TestExecutionPlan, Untrained) {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 32, 24, 2, 2, 200),
+                        new cpphots::KMeansClusterer(4));
+
+    EXPECT_THROW(network.compile(), std::invalid_argument);
+
+}
@@ -0,0 +1,143 @@
+#include <cpphots/render.h>
+#include <cpphots/time_surface.h>
+
+#include "commons.h"
+
+#include <gtest/gtest.h>
+
+
+class TestFrameRenderer : public ::testing::Test {
+
+protected:
+
+    void SetUp() override {
+        pool = cpphots::create_pool<cpphots::LinearTimeSurface>(2, 50, 40, 2, 2, 100);
+    }
+
+    void expectSameFrames(const std::vector<cpphots::TimeSurfaceType>& frames, uint64_t t) {
+        auto expected = pool.sampleContexts(t);
+        ASSERT_EQ(frames.size(), expected.size());
+        for (size_t p = 0; p < expected.size(); p++) {
+            EXPECT_TRUE(frames[p].isApprox(expected[p]) || (frames[p] == expected[p]).all());
+        }
+    }
+
+    cpphots::TimeSurfacePool pool;
+
+};
+
+TEST_F(TestFrameRenderer, Frames) {
+
+    // tiles do not divide the sensor exactly
+    cpphots::FrameRenderer renderer(pool, 16, 3);
+    EXPECT_EQ(renderer.getNumTiles(), 4 * 3);
+
+    RandomEventGenerator ev_gen(50, 40, 2, 10);
+    uint64_t t = 0;
+    for (int f = 0; f < 10; f++) {
+        for (int i = 0; i < 50; i++) {
+            auto ev = ev_gen.generateEvent();
+            pool.update(ev);
+            t = ev.t;
+        }
+        expectSameFrames(renderer.render(pool, t), t);
+    }
+
+    EXPECT_THROW(renderer.render(cpphots::create_pool<cpphots::LinearTimeSurface>(2, 40, 40, 2, 2, 100), t), std::invalid_argument);
+
+}
+
+TEST_F(TestFrameRenderer, DirtyTiles) {
+
+    cpphots::FrameRenderer renderer(pool, 10, 2);
+    EXPECT_EQ(renderer.getNumTiles(), 5 * 4);
+
+    renderer.render(pool, 0);
+    EXPECT_EQ(renderer.getRenderedTiles(), 20);
+
+    // nothing happened, all tiles are decayed
+    renderer.render(pool, 10);
+    EXPECT_EQ(renderer.getRenderedTiles(), 0);
+
+    // only the tiles with events are recomputed
+    pool.update(1000, 5, 5, 0);
+    pool.update(1000, 45, 35, 1);
+    expectSameFrames(renderer.render(pool, 1000), 1000);
+    EXPECT_EQ(renderer.getRenderedTiles(), 2);
+
+    // decaying tiles are recomputed until they are decayed
+    expectSameFrames(renderer.render(pool, 1050), 1050);
+    EXPECT_EQ(renderer.getRenderedTiles(), 2);
+    expectSameFrames(renderer.render(pool, 1200), 1200);
+    EXPECT_EQ(renderer.getRenderedTiles(), 2);
+    expectSameFrames(renderer.render(pool, 1300), 1300);
+    EXPECT_EQ(renderer.getRenderedTiles(), 0);
+
+    // everything is recomputed on request, when changing output or going back in time
+    renderer.invalidate();
+    renderer.render(pool, 1300);
+    EXPECT_EQ(renderer.getRenderedTiles(), 20);
+    renderer.renderQuantized(pool, 1300);
+    EXPECT_EQ(renderer.getRenderedTiles(), 20);
+    renderer.renderQuantized(pool, 1050);
+    EXPECT_EQ(renderer.getRenderedTiles(), 20);
+
+}
+
+TEST_F(TestFrameRenderer, SparseContexts) {
+
+    pool.setSparseContexts();
+    cpphots::FrameRenderer renderer(pool, 10, 2);
+    renderer.render(pool, 0);
+
+    pool.update(1000, 5, 5, 0);
+    pool.update(1000, 45, 35, 1);
+    size_t memory = pool.memoryUsage().get("context");
+    expectSameFrames(renderer.render(pool, 1000), 1000);
+    EXPECT_EQ(renderer.getRenderedTiles(), 2);
+
+    // rendering does not build the full contexts
+    EXPECT_EQ(pool.memoryUsage().get("context"), memory);
+
+}
+
+TEST_F(TestFrameRenderer, Images) {
+
+    cpphots::FrameRenderer renderer(pool, 8, 1);
+
+    pool.update(1000, 3, 4, 0);
+    pool.update(1050, 20, 30, 1);
+    pool.update(1050, 21, 30, 0);
+
+    auto& gray = renderer.renderQuantized(pool, 1050);
+    ASSERT_EQ(gray.size(), 2);
+    ASSERT_EQ(gray[0].size(), 50 * 40);
+    EXPECT_EQ(gray[0][4 * 50 + 3], 128);
+    EXPECT_EQ(gray[0][30 * 50 + 21], 255);
+    EXPECT_EQ(gray[1][30 * 50 + 20], 255);
+    EXPECT_EQ(gray[1][30 * 50 + 21], 0);
+
+    renderer.setColors({{0, 0, 200}, {200, 100, 0}});
+    auto& rgb = renderer.renderColor(pool, 1050);
+    ASSERT_EQ(rgb.size(), 50 * 40 * 3);
+    EXPECT_EQ(rgb[(4 * 50 + 3) * 3 + 2], 100);
+    EXPECT_EQ(rgb[(30 * 50 + 20) * 3 + 0], 200);
+    EXPECT_EQ(rgb[(30 * 50 + 20) * 3 + 1], 100);
+    EXPECT_EQ(rgb[(30 * 50 + 20) * 3 + 2], 0);
+    EXPECT_EQ(rgb[0], 0);
+
+    EXPECT_THROW(renderer.setColors({{0, 0, 0}}), std::invalid_argument);
+
+}
+
+TEST_F(TestFrameRenderer, BlockSampling) {
+
+    cpphots::WeightedLinearTimeSurface wts(20, 10, 1, 1, 10, cpphots::TimeSurfaceType::Constant(10, 20, 0.5f));
+    wts.update(5, 3, 4);
+    wts.update(8, 12, 6);
+
+    cpphots::TimeSurfaceType block(4, 6);
+    wts.sampleContextBlock(10, 10, 3, 6, 4, block);
+    EXPECT_TRUE(block.isApprox(wts.sampleContext(10).block(3, 10, 4, 6)));
+
+}
@@ -1,5 +1,9 @@
+#include <random>
+
 #include <cpphots/run.h>
 #include <cpphots/time_surface.h>
+#include <cpphots/clustering/kmeans.h>
+#include <cpphots/clustering/cosine.h>
 
 #include "commons.h"
 
@@ -70,4 +74,214 @@ TEST_F(TestProcess, WithReset) {
 
     EXPECT_EQ(hsum, 200);
 
-}
\ No newline at end of file
+}
+
+TEST_F(TestProcess, LazyRanges) {
+
+    cpphots::Layer layer2;
+    layer2.addTSPool(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 50, 40, 2, 2, 100));
+    layer2.addClusterer(new MockClusterer(6));
+
+    // MockClusterer keeps its position across resets, use fresh copies for each run
+    cpphots::Layer l1 = layer, l2 = layer2;
+    auto expected = cpphots::process(l2, cpphots::process(l1, ev200, true, true), true, true);
+
+    // pull
+    l1 = layer;
+    l2 = layer2;
+    cpphots::Events pulled;
+    for (const auto& ev : cpphots::processView(l2, cpphots::processView(l1, ev200, true, true), true, true)) {
+        pulled.push_back(ev);
+    }
+    EXPECT_EQ(pulled, expected);
+
+    // push
+    l1 = layer;
+    l2 = layer2;
+    cpphots::Events pushed;
+    cpphots::processToSink(l1, ev200,
+                           cpphots::makeProcessingSink(l2, [&pushed] (const cpphots::event& ev) { pushed.push_back(ev); }, true),
+                           true, true);
+    EXPECT_EQ(pushed, expected);
+
+    // events are processed only when requested
+    layer.reset();
+    auto view = cpphots::processView(layer, ev200, false, true);
+    auto it = view.begin();
+    for (int i = 0; i < 9; i++) {
+        ++it;
+    }
+    EXPECT_EQ(sum_histogram(layer.getHistogram()), 10);
+
+    // surfaces
+    auto surfaces = cpphots::generateTS(layer, ev100, true, true);
+    size_t i = 0;
+    for (const auto& ts : cpphots::generateTSView(layer, ev100, true, true)) {
+        ASSERT_LT(i, surfaces.size());
+        EXPECT_TRUE(ts.isApprox(surfaces[i++]));
+    }
+    EXPECT_EQ(i, surfaces.size());
+
+}
+
+class CountingPool : public cpphots::TimeSurfacePool {
+
+public:
+
+    CountingPool(const cpphots::TimeSurfacePool& pool, size_t& counter)
+        :cpphots::TimeSurfacePool(pool), counter(counter) {}
+
+    CountingPool* clone() const override {
+        return new CountingPool(*this);
+    }
+
+    // valid events can be processed either with updateAndCompute or with update and computeIfValid
+    void update(uint64_t t, uint16_t x, uint16_t y, uint16_t p) override {
+        counter++;
+        cpphots::TimeSurfacePool::update(t, x, y, p);
+    }
+
+    void update(const cpphots::event& ev) override {
+        update(ev.t, ev.x, ev.y, ev.p);
+    }
+
+private:
+    size_t& counter;
+
+};
+
+TEST(TestTrain, SinglePassSurfaces) {
+
+    size_t counter = 0;
+
+    cpphots::Network network;
+    network.createLayer(new CountingPool(cpphots::create_pool<cpphots::LinearTimeSurface>(2, 50, 40, 2, 2, 100), counter),
+                        new cpphots::KMeansClusterer(4, 10));
+
+    RandomEventGenerator ev_gen(50, 40, 2, 10);
+    cpphots::Events events(1000);
+    std::generate(events.begin(), events.end(), [&ev_gen] () { return ev_gen.generateEvent();});
+
+    cpphots::train(network, events, cpphots::ClustererUniformSeeding, true);
+
+    EXPECT_TRUE(network[0].hasCentroids());
+
+    // one pass for seeding and training, one pass to generate the output events
+    EXPECT_EQ(counter, 2 * events.size());
+
+    counter = 0;
+    network[0].clearCentroids();
+    cpphots::train(network, std::vector<cpphots::Events>{events, events}, cpphots::ClustererUniformSeeding, true, true);
+
+    EXPECT_TRUE(network[0].hasCentroids());
+    EXPECT_EQ(counter, 4 * events.size());
+
+}
+
+TEST(TestTrain, KMeansProgress) {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 50, 40, 2, 2, 100),
+                        new cpphots::KMeansClusterer(4, 10));
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 50, 40, 2, 2, 100),
+                        new cpphots::KMeansClusterer(4, 10));
+
+    RandomEventGenerator ev_gen(50, 40, 2, 10);
+    cpphots::Events events(1000);
+    std::generate(events.begin(), events.end(), [&ev_gen] () { return ev_gen.generateEvent();});
+
+    std::vector<size_t> iterations(2, 0);
+    cpphots::train(network, std::vector<cpphots::Events>{events}, cpphots::ClustererUniformSeeding, true, true,
+                   [&iterations] (size_t l, const cpphots::KMeansIteration&) { iterations[l]++; });
+
+    EXPECT_GT(iterations[0], 0);
+    EXPECT_GT(iterations[1], 0);
+
+}
+
+TEST(TestAnytime, EarlyExit) {
+
+    // isolated events are assigned to the first centroid, events in dense regions to the second
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 20, 20, 1, 1, 1000),
+                        new cpphots::CosineClusterer(2));
+    cpphots::TimeSurfaceType isolated = cpphots::TimeSurfaceType::Zero(3, 3);
+    isolated(1, 1) = 1;
+    network[0].addCentroid(isolated);
+    network[0].addCentroid(cpphots::TimeSurfaceType::Ones(3, 3));
+    network[0].toggleLearning(false);
+
+    // two classes with different event rates
+    std::vector<cpphots::Events> recordings;
+    cpphots::NormalizedClassifier classifier(2);
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<uint16_t> coord(0, 4);
+    for (size_t c = 0; c < 2; c++) {
+        std::uniform_int_distribution<uint64_t> dt(0, c == 0 ? 2 : 4000);
+        uint64_t t = 0;
+        recordings.emplace_back();
+        for (size_t i = 0; i < 2000; i++) {
+            t += dt(gen);
+            recordings.back().push_back({t, coord(gen), coord(gen), uint16_t(i % 2)});
+        }
+        cpphots::process(network, recordings.back(), true, true);
+        classifier.setClassFeatures(c, network.back().getHistogram());
+    }
+
+    for (size_t c = 0; c < 2; c++) {
+
+        // the full recording is always classified if the margin cannot be reached
+        cpphots::AnytimeCriterion never;
+        never.margin = 2.0;
+        auto full = cpphots::classifyAnytime(network, recordings[c], classifier, never, true);
+        EXPECT_FALSE(full.early);
+        EXPECT_EQ(full.events_processed, recordings[c].size());
+        EXPECT_EQ(full.decision_time, full.end_time);
+        EXPECT_EQ(full.class_id, c);
+        EXPECT_EQ(full.checks, 20);
+
+        cpphots::AnytimeCriterion criterion;
+        criterion.margin = 0.1;
+        criterion.check_every = 50;
+        criterion.stable_checks = 2;
+        criterion.min_events = 200;
+        auto result = cpphots::classifyAnytime(network, recordings[c], classifier, criterion, true);
+        EXPECT_TRUE(result.early);
+        EXPECT_EQ(result.class_id, c);
+        EXPECT_GE(result.margin, criterion.margin);
+        EXPECT_GE(result.events_processed, criterion.min_events);
+        EXPECT_LT(result.events_processed, recordings[c].size());
+        EXPECT_EQ(result.events_processed % criterion.check_every, 0);
+        EXPECT_EQ(result.decision_time, recordings[c][result.events_processed - 1].t);
+
+        // the network is left in the state at decision time
+        EXPECT_EQ(classifier.classifyID(network.back().getSparseHistogram()), result.class_id);
+        auto hist = network.back().getHistogram();
+        EXPECT_EQ(std::accumulate(hist.begin(), hist.end(), size_t(0)), result.events_processed);
+
+    }
+
+    // no decision before the first output event, even if the classes alone give a large margin
+    cpphots::StandardClassifier standard(2);
+    standard.setClassFeatures(0, {10, 0});
+    standard.setClassFeatures(1, {0, 1000});
+    cpphots::Events delayed;
+    for (uint64_t i = 0; i < 300; i++) {
+        delayed.push_back({i * 2000, uint16_t(i % 5), uint16_t(i % 3), 0});
+    }
+    for (const auto& ev : recordings[0]) {
+        delayed.push_back({ev.t + 300 * 2000, ev.x, ev.y, ev.p});
+    }
+    cpphots::AnytimeCriterion eager;
+    eager.margin = 0.5;
+    eager.check_every = 50;
+    eager.stable_checks = 1;
+    auto result = cpphots::classifyAnytime(network, delayed, standard, eager);
+    EXPECT_GT(result.events_processed, 300);
+    EXPECT_LT(result.checks, result.events_processed / eager.check_every);
+
+    cpphots::AnytimeCriterion invalid;
+    invalid.check_every = 0;
+    EXPECT_THROW(cpphots::classifyAnytime(network, recordings[0], classifier, invalid), std::invalid_argument);
+
+}
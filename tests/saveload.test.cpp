@@ -1,4 +1,6 @@
 #include <sstream>
+#include <thread>
+#include <atomic>
 
 #include <cpphots/time_surface.h>
 #include <cpphots/layer.h>
@@ -7,6 +9,9 @@
 #include <cpphots/events_utils.h>
 #include <cpphots/clustering/cosine.h>
 #include <cpphots/layer_modifiers.h>
+#include <cpphots/snapshot.h>
+
+#include "commons.h"
 
 #include <gtest/gtest.h>
 
@@ -80,6 +85,26 @@ TEST(TestSaveLoad, SimpleWTSLoad) {
 
 }
 
+TEST(TestSaveLoad, SimpleETSLoad) {
+
+    cpphots::ExponentialTimeSurface ts1(16, 8, 2, 1, 500);
+
+    std::ostringstream outstream1;
+    outstream1 << ts1;
+
+    std::istringstream instream(outstream1.str());
+    auto ts2 = cpphots::loadTSFromStream(instream);
+    ASSERT_NE(dynamic_cast<cpphots::ExponentialTimeSurface*>(ts2), nullptr);
+
+    std::stringstream outstream2;
+    outstream2 << *ts2;
+
+    EXPECT_EQ(outstream1.str(), outstream2.str());
+
+    delete ts2;
+
+}
+
 TEST(TestSaveLoad, TSProcess) {
 
     // load data
@@ -344,4 +369,121 @@ TEST(TestSaveLoad, SuperCellAverage) {
         EXPECT_EQ(mod1.getCellSizes().second, mod2->getCellSizes().second);
     }
 
-}
\ No newline at end of file
+}
+
+TEST(TestSaveLoad, NetworkState) {
+
+    cpphots::Network net1;
+    net1.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 32, 32, 1, 1, 1000),
+                     new cpphots::CosineClusterer(8),
+                     nullptr,
+                     new cpphots::SuperCellAverage(32, 32, 4));
+    net1.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(8, 8, 8, 1, 1, 2000),
+                     new cpphots::CosineClusterer(4));
+
+    cpphots::ClustererRandomSeeding(3, 3)(net1[0], {});
+    cpphots::ClustererRandomSeeding(3, 3)(net1[1], {});
+
+    RandomEventGenerator gen(32, 32, 2, 10);
+    cpphots::Events evs(2000);
+    std::generate(evs.begin(), evs.end(), gen);
+
+    for (size_t i = 0; i < 1000; i++) {
+        net1.process(evs[i], true);
+    }
+
+    cpphots::SnapshotBuffer snapshot;
+    EXPECT_EQ(snapshot.getGeneration(), 0);
+    ASSERT_TRUE(snapshot.capture(net1));
+    EXPECT_EQ(snapshot.getGeneration(), 1);
+
+    // replacement network, with parameters only
+    std::stringstream params;
+    params << net1;
+    cpphots::Network net2;
+    params >> net2;
+
+    // go through a file-like stream as well
+    cpphots::interfaces::StateBuffer state;
+    EXPECT_EQ(snapshot.latest(state), 1);
+    std::stringstream binary;
+    state.writeTo(binary);
+    cpphots::interfaces::StateBuffer state2;
+    state2.readFrom(binary);
+    ASSERT_EQ(state.size(), state2.size());
+
+    net2.loadState(state2);
+
+    EXPECT_TRUE(net1[0].getSurface(1)->getFullContext().isApprox(net2[0].getSurface(1)->getFullContext()));
+    EXPECT_EQ(net1[1].getHistogram(), net2[1].getHistogram());
+
+    for (size_t i = 1000; i < 2000; i++) {
+        EXPECT_EQ(net1.process(evs[i], true), net2.process(evs[i], true));
+    }
+
+    EXPECT_EQ(net1[0].getHistogram(), net2[0].getHistogram());
+    EXPECT_EQ(net1[1].getHistogram(), net2[1].getHistogram());
+
+    // a network with a different structure cannot load the state
+    cpphots::Network net3;
+    net3.addLayer(net1[0]);
+    EXPECT_THROW(snapshot.restore(net3), std::runtime_error);
+
+}
+
+TEST(TestSaveLoad, ContextPublisher) {
+
+    auto pool = cpphots::create_pool<cpphots::LinearTimeSurface>(2, 16, 8, 0, 0, 1000);
+    cpphots::ContextPublisher publisher(pool);
+
+    const auto& empty = publisher.acquire();
+    EXPECT_EQ(empty.generation, 0);
+    EXPECT_FALSE(publisher.hasNew());
+
+    std::atomic<bool> done{false};
+
+    // every frame must contain the same timestamp everywhere
+    std::thread writer([&pool, &publisher, &done] () {
+        for (uint64_t t = 1; t <= 2000; t++) {
+            for (uint16_t p = 0; p < 2; p++) {
+                for (uint16_t y = 0; y < 8; y++) {
+                    for (uint16_t x = 0; x < 16; x++) {
+                        pool.update(t, x, y, p);
+                    }
+                }
+            }
+            publisher.publish(pool, t);
+        }
+        done = true;
+    });
+
+    uint64_t last_gen = 0;
+    size_t frames = 0;
+    while (!done || publisher.hasNew()) {
+        const auto& frame = publisher.acquire();
+        if (frame.generation == last_gen) {
+            continue;
+        }
+        EXPECT_GT(frame.generation, last_gen);
+        EXPECT_EQ(frame.generation, frame.t);
+        last_gen = frame.generation;
+        frames++;
+        for (size_t p = 0; p < 2; p++) {
+            EXPECT_TRUE((frame.pool->getSurface(p)->getContext() == frame.t).all());
+        }
+    }
+
+    writer.join();
+
+    EXPECT_GT(frames, 0);
+    EXPECT_EQ(last_gen, 2000);
+
+    // rate limited publication
+    cpphots::ContextPublisher limited(pool, 100);
+    EXPECT_TRUE(limited.publishIfDue(pool, 5000));
+    EXPECT_FALSE(limited.publishIfDue(pool, 5050));
+    EXPECT_TRUE(limited.publishIfDue(pool, 5100));
+    EXPECT_EQ(limited.acquire().generation, 2);
+    EXPECT_EQ(limited.acquire().t, 5100);
+
+}
@@ -0,0 +1,187 @@
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <cpphots/scheduler.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/clustering/cosine.h>
+#include <cpphots/clustering/kmeans.h>
+#include <cpphots/run.h>
+
+#include "commons.h"
+
+#include <gtest/gtest.h>
+
+
+class TestStreamScheduler : public ::testing::Test {
+
+protected:
+
+    void SetUp() override {
+
+        network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 20, 20, 1, 1, 1000),
+                            new cpphots::CosineClusterer(4));
+        network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 20, 20, 2, 2, 2000),
+                            new cpphots::CosineClusterer(8));
+
+        cpphots::ClustererRandomSeeding(3, 3)(network[0], {});
+        cpphots::ClustererRandomSeeding(5, 5)(network[1], {});
+        network[0].toggleLearning(false);
+        network[1].toggleLearning(false);
+
+        for (size_t s = 0; s < n_streams; s++) {
+            RandomEventGenerator gen(20, 20, 2, 10);
+            streams.emplace_back(300 + 20 * s);
+            std::generate(streams.back().begin(), streams.back().end(), gen);
+        }
+
+    }
+
+    // submit the first or second half of every stream, in interleaved batches
+    void submitHalf(cpphots::StreamScheduler& scheduler, bool second) {
+        for (size_t b = 0; b < 5; b++) {
+            for (size_t s = 0; s < n_streams; s++) {
+                size_t half = streams[s].size() / 2;
+                size_t begin = (second ? half : 0) + b * half / 5;
+                size_t end = (second ? half : 0) + (b == 4 ? half + (second ? streams[s].size() % 2 : 0) : (b + 1) * half / 5);
+                scheduler.submit(s, cpphots::Events(streams[s].begin() + begin, streams[s].begin() + end));
+            }
+        }
+    }
+
+    // each stream processed alone from a reset network
+    void checkResults() {
+        for (size_t s = 0; s < n_streams; s++) {
+            cpphots::Network net = network;
+            net.reset();
+            cpphots::Events expected;
+            for (const auto& ev : streams[s]) {
+                auto out = net.process(ev, true);
+                if (out != cpphots::invalid_event) {
+                    expected.push_back(out);
+                }
+            }
+            EXPECT_EQ(outputs[s], expected);
+            EXPECT_EQ(histograms[s], net.back().getHistogram());
+        }
+    }
+
+    cpphots::StreamScheduler::Callback collector() {
+        return [this] (cpphots::StreamScheduler::StreamID id, const cpphots::Events& out, bool batch_done, const cpphots::Network& net) {
+            std::lock_guard<std::mutex> lock(mutex);
+            outputs[id].insert(outputs[id].end(), out.begin(), out.end());
+            if (batch_done) {
+                histograms[id] = net.back().getHistogram();
+            }
+        };
+    }
+
+    const size_t n_streams = 40;
+    cpphots::Network network;
+    std::vector<cpphots::Events> streams;
+
+    std::mutex mutex;
+    std::map<uint64_t, cpphots::Events> outputs;
+    std::map<uint64_t, std::vector<uint32_t>> histograms;
+
+};
+
+TEST_F(TestStreamScheduler, Ordering) {
+
+    cpphots::StreamScheduler scheduler(network, collector(), 3, 17, true);
+    EXPECT_EQ(scheduler.getNumWorkers(), 3);
+
+    submitHalf(scheduler, false);
+    submitHalf(scheduler, true);
+    scheduler.flush();
+
+    EXPECT_EQ(scheduler.getNumStreams(), n_streams);
+
+    size_t total = 0;
+    for (const auto& s : streams) {
+        total += s.size();
+    }
+    auto stats = scheduler.getStats();
+    EXPECT_EQ(stats.events, total);
+    EXPECT_GE(stats.slices, total / 17);
+
+    checkResults();
+
+    // only one network per worker, whatever the number of streams
+    auto mem = scheduler.memoryUsage();
+    EXPECT_EQ(mem.get("centroids"), network.memoryUsage().get("centroids") * 3);
+    EXPECT_GT(mem.get("streams"), 0);
+    EXPECT_EQ(mem.get("queues"), 0);
+
+    scheduler.closeStream(0);
+    scheduler.closeStream(1);
+    scheduler.flush();
+    for (int i = 0; i < 100 && scheduler.getNumStreams() != n_streams - 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(scheduler.getNumStreams(), n_streams - 2);
+
+}
+
+TEST_F(TestStreamScheduler, KMeans) {
+
+    // offline clusterers are already frozen after training
+    network = cpphots::Network();
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 20, 20, 1, 1, 1000),
+                        new cpphots::KMeansClusterer(4, 10));
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 20, 20, 2, 2, 2000),
+                        new cpphots::KMeansClusterer(8, 10));
+    cpphots::train(network, streams, cpphots::ClustererUniformSeeding, true, true);
+
+    cpphots::StreamScheduler scheduler(network, collector(), 2, 32, true);
+
+    submitHalf(scheduler, false);
+    submitHalf(scheduler, true);
+    scheduler.flush();
+
+    checkResults();
+
+}
+
+TEST_F(TestStreamScheduler, Compression) {
+
+    cpphots::StreamScheduler scheduler(network, collector(), 2, 64, true);
+    scheduler.setIdlePolicy(std::chrono::milliseconds(1), std::chrono::milliseconds(0));
+
+    submitHalf(scheduler, false);
+    scheduler.flush();
+
+    for (int i = 0; i < 200 && scheduler.getStats().compressions < n_streams; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(scheduler.getStats().compressions, n_streams);
+
+    auto mem = scheduler.memoryUsage();
+    EXPECT_EQ(mem.get("streams"), 0);
+    EXPECT_GT(mem.get("compressed"), 0);
+
+    // processing continues from the compressed states
+    scheduler.setIdlePolicy(std::chrono::milliseconds(0), std::chrono::milliseconds(0));
+    submitHalf(scheduler, true);
+    scheduler.flush();
+
+    checkResults();
+
+}
+
+TEST_F(TestStreamScheduler, Eviction) {
+
+    cpphots::StreamScheduler scheduler(network, nullptr, 2, 64, true);
+    scheduler.setIdlePolicy(std::chrono::milliseconds(0), std::chrono::milliseconds(1));
+
+    submitHalf(scheduler, false);
+    scheduler.flush();
+
+    for (int i = 0; i < 200 && scheduler.getNumStreams() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(scheduler.getNumStreams(), 0);
+    EXPECT_EQ(scheduler.getStats().evictions, n_streams);
+    EXPECT_EQ(scheduler.memoryUsage().get("streams"), 0);
+
+}
@@ -0,0 +1,135 @@
+#include <thread>
+#include <string>
+
+#include <unistd.h>
+
+#include <cpphots/shm_ring.h>
+#include <cpphots/network.h>
+#include <cpphots/time_surface.h>
+
+#include "commons.h"
+
+#include <gtest/gtest.h>
+
+
+class TestShmRing : public ::testing::Test {
+
+protected:
+
+    void SetUp() override {
+        name = "/cpphots_test_" + std::to_string(getpid());
+        RandomEventGenerator gen(50, 40, 2, 10);
+        evs.resize(10000);
+        std::generate(evs.begin(), evs.end(), gen);
+    }
+
+    void TearDown() override {
+        cpphots_shm_unlink(name.c_str());
+    }
+
+    // push events in small batches, waiting for free space
+    std::thread startProducer(cpphots_shm_producer* producer) {
+        return std::thread([this, producer] () {
+            const auto* cevs = reinterpret_cast<const cpphots_event*>(evs.data());
+            for (size_t i = 0; i < evs.size(); i += 37) {
+                size_t n = std::min<size_t>(37, evs.size() - i);
+                EXPECT_EQ(cpphots_shm_producer_push(producer, cevs + i, n, -1), n);
+            }
+            cpphots_shm_producer_close(producer);
+        });
+    }
+
+    std::string name;
+    cpphots::Events evs;
+
+};
+
+TEST_F(TestShmRing, Transport) {
+
+    auto* producer = cpphots_shm_producer_create(name.c_str(), 100);
+    ASSERT_NE(producer, nullptr);
+
+    cpphots::ShmEventConsumer consumer(name);
+    EXPECT_EQ(consumer.getCapacity(), 128);
+
+    auto writer = startProducer(producer);
+
+    cpphots::Events received;
+    while (consumer.wait()) {
+        consumer.consume([&received] (const cpphots::event& ev) { received.push_back(ev); });
+    }
+
+    writer.join();
+
+    EXPECT_TRUE(consumer.isFinished());
+    EXPECT_EQ(received, evs);
+
+}
+
+TEST_F(TestShmRing, Network) {
+
+    cpphots::Network net1;
+    net1.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 50, 40, 2, 2, 100),
+                     new MockClusterer(4));
+    cpphots::Network net2 = net1;
+
+    for (const auto& ev : evs) {
+        net1.process(ev, true);
+    }
+
+    auto* producer = cpphots_shm_producer_create(name.c_str(), 256);
+    ASSERT_NE(producer, nullptr);
+    cpphots::ShmEventConsumer consumer(name);
+
+    auto writer = startProducer(producer);
+
+    size_t processed = 0;
+    while (consumer.wait()) {
+        processed += consumer.process(net2, true);
+    }
+
+    writer.join();
+
+    EXPECT_EQ(processed, evs.size());
+    EXPECT_EQ(net1.back().getHistogram(), net2.back().getHistogram());
+
+}
+
+TEST_F(TestShmRing, Timeouts) {
+
+    EXPECT_THROW(cpphots::ShmEventConsumer(name + "_missing"), std::runtime_error);
+
+    auto* producer = cpphots_shm_producer_create(name.c_str(), 16);
+    ASSERT_NE(producer, nullptr);
+    cpphots::ShmEventConsumer consumer(name);
+
+    EXPECT_FALSE(consumer.wait(0));
+    EXPECT_FALSE(consumer.wait(10));
+
+    const auto* cevs = reinterpret_cast<const cpphots_event*>(evs.data());
+    EXPECT_EQ(cpphots_shm_producer_push(producer, cevs, 20, 0), 16);
+    EXPECT_EQ(cpphots_shm_producer_push(producer, cevs + 16, 4, 10), 0);
+
+    EXPECT_TRUE(consumer.wait(0));
+    auto [ptr, n] = consumer.acquire(10);
+    ASSERT_EQ(n, 10);
+    EXPECT_EQ(ptr[0], evs[0]);
+    consumer.release(n);
+
+    EXPECT_EQ(cpphots_shm_producer_push(producer, cevs + 16, 4, 0), 4);
+
+    // events wrap around the end of the buffer
+    std::tie(ptr, n) = consumer.acquire();
+    EXPECT_EQ(n, 6);
+    consumer.release(n);
+    std::tie(ptr, n) = consumer.acquire();
+    ASSERT_EQ(n, 4);
+    EXPECT_EQ(ptr[3], evs[19]);
+    consumer.release(n);
+
+    EXPECT_FALSE(consumer.isFinished());
+    cpphots_shm_producer_close(producer);
+    EXPECT_TRUE(consumer.isFinished());
+    EXPECT_FALSE(consumer.wait());
+
+}
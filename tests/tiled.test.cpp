@@ -0,0 +1,181 @@
+#include <random>
+#include <sstream>
+#include <memory>
+
+#include <cpphots/types.h>
+#include <cpphots/clustering/tiled.h>
+#include <cpphots/clustering/kmeans.h>
+#include <cpphots/clustering/cosine.h>
+#include <cpphots/network.h>
+#include <cpphots/run.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/load.h>
+
+#include <gtest/gtest.h>
+
+
+// 2x2 tiles with 2 clusters each, centroids 10*t and 10*t+5 in tile t
+static cpphots::TiledClusterer createSeeded() {
+
+    cpphots::TiledClusterer clust(8, 6, 2, 2, cpphots::KMeansClusterer(2), 4);
+    for (int t = 0; t < 4; t++) {
+        clust.addCentroid(cpphots::TimeSurfaceType::Constant(1, 1, 10 * t));
+        clust.addCentroid(cpphots::TimeSurfaceType::Constant(1, 1, 10 * t + 5));
+    }
+
+    return clust;
+
+}
+
+TEST(TestTiledClusterer, Routing) {
+
+    cpphots::TiledClusterer clust = createSeeded();
+
+    EXPECT_EQ(clust.getNumTiles(), 4);
+    EXPECT_EQ(clust.getNumClusters(), 8);
+    EXPECT_TRUE(clust.hasCentroids());
+    EXPECT_THROW(clust.addCentroid(cpphots::TimeSurfaceType::Zero(1, 1)), std::runtime_error);
+
+    EXPECT_EQ(clust.getTile(0, 0), 0);
+    EXPECT_EQ(clust.getTile(4, 2), 1);
+    EXPECT_EQ(clust.getTile(3, 3), 2);
+    EXPECT_EQ(clust.getTile(7, 5), 3);
+    EXPECT_EQ(clust.getTileOffset(3), 6);
+
+    auto centroids = clust.getCentroids();
+    ASSERT_EQ(centroids.size(), 8);
+    EXPECT_EQ(centroids[3](0, 0), 15);
+
+    // the same surface is assigned to the clusters of the tile of its position
+    cpphots::TimeSurfaceType surface = cpphots::TimeSurfaceType::Constant(1, 1, 4);
+    clust.reset();
+    EXPECT_EQ(clust.cluster(surface, 1, 1), 1);
+    EXPECT_EQ(clust.cluster(surface, 6, 1), 2);
+    EXPECT_EQ(clust.cluster(surface, 6, 4), 6);
+    EXPECT_EQ(clust.cluster(surface, 6, 5), 6);
+
+    EXPECT_EQ(clust.getHistogram(), std::vector<uint32_t>({0, 1, 1, 0, 0, 0, 2, 0}));
+    EXPECT_EQ(clust.getSparseHistogram(), cpphots::SparseHistogram({{1, 1}, {2, 1}, {6, 2}}));
+
+    // positions are required
+    EXPECT_THROW(clust.cluster(surface), std::runtime_error);
+    EXPECT_THROW(clust.train({surface}), std::runtime_error);
+    EXPECT_THROW(clust.train({surface}, {}), std::invalid_argument);
+
+    // the position is taken into account also through the interface
+    cpphots::interfaces::Clusterer& iclust = clust;
+    EXPECT_EQ(iclust.cluster(surface, 6, 4), 6);
+
+    EXPECT_THROW(cpphots::TiledClusterer(8, 6, 0, 2, cpphots::KMeansClusterer(2)), std::invalid_argument);
+    EXPECT_THROW(cpphots::TiledClusterer(8, 6, 2, 7, cpphots::KMeansClusterer(2)), std::invalid_argument);
+
+}
+
+TEST(TestTiledClusterer, Train) {
+
+    cpphots::TiledClusterer clust = createSeeded();
+
+    // each tile sees values slightly different from its seeds
+    std::mt19937 gen(7);
+    std::normal_distribution<cpphots::TimeSurfaceScalarType> noise(0, 0.2);
+    std::vector<cpphots::TimeSurfaceType> tss;
+    std::vector<std::pair<uint16_t, uint16_t>> positions;
+    for (int i = 0; i < 400; i++) {
+        uint16_t x = (i % 2) * 4 + 1;
+        uint16_t y = ((i / 2) % 2) * 3 + 1;
+        int t = clust.getTile(x, y);
+        cpphots::TimeSurfaceScalarType value = 10 * t + ((i / 4) % 2) * 5;
+        tss.push_back(cpphots::TimeSurfaceType::Constant(1, 1, value + noise(gen)));
+        positions.push_back({x, y});
+    }
+
+    clust.train(tss, positions);
+
+    auto centroids = clust.getCentroids();
+    ASSERT_EQ(centroids.size(), 8);
+    for (int t = 0; t < 4; t++) {
+        cpphots::TimeSurfaceScalarType c1 = std::min(centroids[2*t](0, 0), centroids[2*t+1](0, 0));
+        cpphots::TimeSurfaceScalarType c2 = std::max(centroids[2*t](0, 0), centroids[2*t+1](0, 0));
+        EXPECT_NEAR(c1, 10 * t, 0.1);
+        EXPECT_NEAR(c2, 10 * t + 5, 0.1);
+    }
+
+    // single thread gives the same result
+    cpphots::TiledClusterer serial(8, 6, 2, 2, cpphots::KMeansClusterer(2), 1);
+    auto seeds = createSeeded().getCentroids();
+    for (const auto& c : seeds) {
+        serial.addCentroid(c);
+    }
+    serial.train(tss, positions);
+    auto serial_centroids = serial.getCentroids();
+    for (size_t i = 0; i < centroids.size(); i++) {
+        EXPECT_EQ(serial_centroids[i](0, 0), centroids[i](0, 0));
+    }
+
+}
+
+TEST(TestTiledClusterer, SaveLoad) {
+
+    cpphots::TiledClusterer clust(8, 6, 2, 3, cpphots::CosineClusterer(3));
+    cpphots::ClustererRandomSeeding(3, 3)(clust, {});
+    ASSERT_TRUE(clust.hasCentroids());
+
+    std::stringstream stream;
+    stream << clust;
+    std::unique_ptr<cpphots::interfaces::Clusterer> loaded(cpphots::loadClustererFromStream(stream));
+
+    ASSERT_NE(dynamic_cast<cpphots::TiledClusterer*>(loaded.get()), nullptr);
+    EXPECT_EQ(loaded->getNumClusters(), 18);
+    EXPECT_TRUE(loaded->isOnline());
+
+    clust.toggleLearning(false);
+    loaded->toggleLearning(false);
+    for (uint16_t x = 0; x < 8; x++) {
+        for (uint16_t y = 0; y < 6; y++) {
+            cpphots::TimeSurfaceType surface = cpphots::TimeSurfaceType::Random(3, 3) + 1;
+            EXPECT_EQ(clust.cluster(surface, x, y), loaded->cluster(surface, x, y));
+        }
+    }
+    EXPECT_EQ(clust.getHistogram(), loaded->getHistogram());
+
+    // state
+    cpphots::interfaces::StateBuffer state;
+    clust.saveState(state);
+    state.rewind();
+    cpphots::TiledClusterer restored(8, 6, 2, 3, cpphots::CosineClusterer(3));
+    restored.loadState(state);
+    EXPECT_EQ(restored.getHistogram(), clust.getHistogram());
+    EXPECT_EQ(restored.getCentroids().size(), 18);
+
+}
+
+TEST(TestTiledClusterer, Network) {
+
+    cpphots::Network network;
+    network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 16, 16, 1, 1, 1000),
+                        new cpphots::TiledClusterer(16, 16, 2, 2, cpphots::KMeansClusterer(3)));
+
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<uint16_t> coord(0, 15);
+    std::uniform_int_distribution<uint16_t> pol(0, 1);
+    std::uniform_int_distribution<uint64_t> dt(0, 10);
+    cpphots::Events events;
+    uint64_t t = 0;
+    for (size_t i = 0; i < 2000; i++) {
+        t += dt(gen);
+        events.push_back({t, coord(gen), coord(gen), pol(gen)});
+    }
+
+    cpphots::train(network, events, cpphots::ClustererUniformSeeding, true);
+    ASSERT_TRUE(network[0].hasCentroids());
+    EXPECT_EQ(network[0].getNumClusters(), 12);
+
+    // outputs are in the clusters of the tile of each event
+    const auto& clust = dynamic_cast<const cpphots::TiledClusterer&>(network[0].getClusterer());
+    network.reset();
+    for (const auto& ev : events) {
+        auto out = network.process(ev, true);
+        EXPECT_EQ(out.p / 3, clust.getTile(ev.x, ev.y));
+    }
+
+}
@@ -1,3 +1,6 @@
+#include <cmath>
+#include <random>
+
 #include <cpphots/time_surface.h>
 #include <cpphots/events_utils.h>
 
@@ -62,7 +65,110 @@ TEST(TestTimeSurface, Processing) {
 
 }
 
+TEST(TestTimeSurface, EarlyRejection) {
+
+    cpphots::Events events = cpphots::loadFromFile("tests/data/trcl0.es");
+
+    for (uint16_t R : {0, 1, 2, 4}) {
+
+        cpphots::LinearTimeSurface ts(32, 32, R, 2, 1000);
+        unsigned int rejected = 0;
+        for (size_t i = 0; i < events.size(); i++) {
+
+            const auto& ev = events[i];
+            ts.update(ev);
+            auto [surface, good] = ts.compute(ev);
+            auto [early_surface, early_good] = ts.computeIfValid(ev);
+
+            // same result as the full check
+            ASSERT_EQ(good, early_good);
+            if (good) {
+                EXPECT_TRUE(surface.isApprox(early_surface));
+            }
+
+            // the bound is never smaller than the number of active pixels
+            EXPECT_GE(ts.activityBound(ev.x, ev.y), static_cast<size_t>((surface > 0.).count()));
+            if (early_surface.size() == 0) {
+                rejected++;
+            }
+
+            // the bound is rebuilt from the saved state
+            if (i == events.size() / 2) {
+                cpphots::interfaces::StateBuffer state;
+                ts.saveState(state);
+                state.rewind();
+                ts.reset();
+                EXPECT_EQ(ts.activityBound(ev.x, ev.y), 0);
+                ts.loadState(state);
+                EXPECT_GE(ts.activityBound(ev.x, ev.y), static_cast<size_t>((surface > 0.).count()));
+            }
+
+        }
+
+        if (R > 0) {
+            EXPECT_GT(rejected, 0);
+        }
+
+    }
+
+}
+
+TEST(TestTimeSurface, LazyActivity) {
+
+    cpphots::Events events = cpphots::loadFromFile("tests/data/trcl0.es");
+
+    cpphots::LinearTimeSurface ts(32, 32, 2, 2, 1000);
+    auto empty = ts.memoryUsage().get("activity");
+
+    // updates are not tracked without validity checks
+    for (size_t i = 0; i < events.size() / 2; i++) {
+        ts.updateAndCompute(events[i]);
+    }
+    EXPECT_EQ(ts.memoryUsage().get("activity"), empty);
+
+    // the first check rebuilds the counters from the context
+    for (size_t i = events.size() / 2; i < events.size(); i++) {
+        const auto& ev = events[i];
+        ts.update(ev);
+        auto [surface, good] = ts.compute(ev);
+        EXPECT_GE(ts.activityBound(ev.x, ev.y), static_cast<size_t>((surface > 0.).count()));
+        EXPECT_EQ(ts.computeIfValid(ev).second, good);
+    }
+    EXPECT_GT(ts.memoryUsage().get("activity"), empty);
+
+}
+
 #ifdef CPPHOTS_ASSERTS
+TEST(TestExponentialTimeSurface, Processing) {
+
+    cpphots::ExponentialTimeSurface ts(10, 10, 1, 1, 100);
+    cpphots::LinearTimeSurface lts(10, 10, 1, 1, 100);
+
+    cpphots::Events events{{0, 5, 5, 0}, {50, 4, 5, 0}, {80, 5, 4, 0}, {90, 5, 5, 0}, {300, 5, 6, 0}};
+    for (const auto& ev : events) {
+
+        auto [surface, good] = ts.updateAndCompute(ev);
+        auto [lsurface, lgood] = lts.updateAndCompute(ev);
+
+        // same valid events as with the linear decay
+        EXPECT_EQ(good, lgood);
+        EXPECT_EQ(ts.isValid(ev.t, ev.x, ev.y), good);
+        EXPECT_EQ(ts.computeIfValid(ev).second, good);
+
+        EXPECT_FLOAT_EQ(surface(1, 1), 1.0);
+
+    }
+
+    auto [surface, good] = ts.compute(310, 5, 5);
+    EXPECT_FALSE(good);
+    EXPECT_FLOAT_EQ(surface(1, 1), std::exp(-2.2));
+    EXPECT_FLOAT_EQ(surface(2, 1), std::exp(-0.1));
+    EXPECT_FLOAT_EQ(surface(0, 0), std::exp(-4.1));
+
+    EXPECT_FLOAT_EQ(ts.sampleContext(310)(5, 5), std::exp(-2.2));
+
+}
+
 TEST(TestTimeSurface, WrongCoordinates) {
 
     cpphots::LinearTimeSurface ts(20, 10, 2, 2, 10);
@@ -356,4 +462,137 @@ TEST_F(TimeSurfacePoolClone, MoveAssignment) {
     EXPECT_EQ(orig_pool.getNumSurfaces(), 0);
     EXPECT_EQ(ts, orig_ts);
 
-}
\ No newline at end of file
+}
+
+TEST(TestTimeSurfacePool, MemoryUsage) {
+
+    auto pool = cpphots::create_pool<cpphots::LinearTimeSurface>(2, 32, 20, 2, 3, 1000);
+    auto mem = pool.memoryUsage();
+    EXPECT_EQ(mem.get("context"), 2 * 36 * 26 * sizeof(cpphots::TimeSurfaceScalarType));
+    EXPECT_EQ(mem.get("activity"), 2 * 7 * 3 * sizeof(uint32_t));
+    EXPECT_EQ(mem.total(), mem.get("context") + mem.get("activity"));
+
+    auto est = cpphots::TimeSurfacePool::estimateMemoryUsage<cpphots::LinearTimeSurface>(2, 32, 20, 2, 3, 1000);
+    EXPECT_EQ(est.categories, mem.categories);
+
+    cpphots::TimeSurfaceType weights = cpphots::TimeSurfaceType::Constant(20, 32, 0.5);
+    auto wpool = cpphots::create_pool<cpphots::WeightedLinearTimeSurface>(3, 32, 20, 2, 3, 1000, weights);
+    auto wmem = wpool.memoryUsage();
+    EXPECT_EQ(wmem.get("weights"), wmem.get("context"));
+
+    auto west = cpphots::TimeSurfacePool::estimateMemoryUsage<cpphots::WeightedLinearTimeSurface>(3, 32, 20, 2, 3, 1000, weights);
+    EXPECT_EQ(west.categories, wmem.categories);
+
+}
+
+template <typename TS>
+static void checkSparseContext(const TS& prototype) {
+
+    TS dense = prototype;
+    TS sparse = prototype;
+    sparse.setSparseContext();
+    ASSERT_TRUE(sparse.isSparseContext());
+    ASSERT_FALSE(dense.isSparseContext());
+
+    std::mt19937 gen(13);
+    std::uniform_int_distribution<uint16_t> xd(0, 63);
+    std::uniform_int_distribution<uint16_t> yd(0, 47);
+    std::uniform_int_distribution<uint64_t> dt(0, 4);
+
+    uint64_t t = 0;
+    for (size_t i = 0; i < 2000; i++) {
+
+        t += dt(gen);
+        uint16_t x = xd(gen), y = yd(gen);
+
+        auto [ds, dgood] = dense.updateAndCompute(t, x, y);
+        auto [ss, sgood] = sparse.updateAndCompute(t, x, y);
+        EXPECT_EQ(sgood, dgood);
+        EXPECT_TRUE((ss == ds).all());
+        EXPECT_EQ(sparse.computeIfValid(t, x, y).second, dense.computeIfValid(t, x, y).second);
+        EXPECT_EQ(sparse.getLastUpdate(x, y), t);
+
+    }
+
+    EXPECT_TRUE((sparse.getFullContext() == dense.getFullContext()).all());
+    EXPECT_TRUE((sparse.sampleContext(t) == dense.sampleContext(t)).all());
+
+    // state can be moved between storages
+    cpphots::interfaces::StateBuffer state;
+    sparse.saveState(state);
+    state.rewind();
+    TS restored = prototype;
+    restored.loadState(state);
+    EXPECT_TRUE((restored.getFullContext() == dense.getFullContext()).all());
+
+    sparse.setSparseContext(false);
+    EXPECT_TRUE((sparse.getFullContext() == dense.getFullContext()).all());
+
+}
+
+TEST(TestTimeSurface, SparseContext) {
+
+    checkSparseContext(cpphots::LinearTimeSurface(64, 48, 3, 2, 200));
+    checkSparseContext(cpphots::ExponentialTimeSurface(64, 48, 2, 2, 200));
+
+    // the in-place kernels read the same values
+    cpphots::LinearTimeSurface dense(64, 48, 3, 3, 200);
+    cpphots::LinearTimeSurface sparse = dense;
+    sparse.setSparseContext();
+    cpphots::TimeSurfaceType dout(7, 7), sout(7, 7);
+    for (uint16_t i = 0; i < 500; i++) {
+        uint16_t x = (i * 7) % 64, y = (i * 5) % 48;
+        dense.update(i, x, y);
+        sparse.update(i, x, y);
+        EXPECT_EQ(sparse.computeInto(i, x, y, sout), dense.computeInto(i, x, y, dout));
+        EXPECT_TRUE((sout == dout).all());
+        EXPECT_EQ(sparse.computeFixedInto<7>(i, x, y, sout), dense.computeFixedInto<7>(i, x, y, dout));
+        EXPECT_TRUE((sout == dout).all());
+    }
+
+    cpphots::TimeSurfaceType dblock(6, 10), sblock(6, 10);
+    dense.sampleContextBlock(500, 8, 4, 10, 6, dblock);
+    sparse.sampleContextBlock(500, 8, 4, 10, 6, sblock);
+    EXPECT_TRUE((sblock == dblock).all());
+
+}
+
+TEST(TestTimeSurface, SparseContextMemory) {
+
+    // events in a corner of a wide context, as after a SerializingLayer
+    auto pool = cpphots::create_pool<cpphots::LinearTimeSurface>(4, 20000, 1, 2, 0, 1000);
+    size_t dense_memory = pool.memoryUsage().get("context");
+
+    pool.setSparseContexts();
+    for (uint16_t i = 0; i < 100; i++) {
+        pool.update(i, i % 50, 0, i % 4);
+    }
+    size_t sparse_memory = pool.memoryUsage().get("context");
+    EXPECT_LT(sparse_memory * 5, dense_memory);
+
+    // the state is saved from the pages
+    cpphots::interfaces::StateBuffer state;
+    pool.saveState(state);
+    EXPECT_EQ(pool.memoryUsage().get("context"), sparse_memory);
+
+    // missing pages have never been updated
+    auto context = pool.getSurface(0)->getFullContext();
+    EXPECT_EQ(context(0, 10000), -1000);
+    EXPECT_EQ(context(0, 2 + 2), 52);
+
+    // the full context is released at the next update
+    EXPECT_GT(pool.memoryUsage().get("context"), sparse_memory);
+    pool.update(100, 0, 0, 0);
+    EXPECT_EQ(pool.memoryUsage().get("context"), sparse_memory);
+
+    // and the pages are restored from the state
+    state.rewind();
+    pool.loadState(state);
+    EXPECT_EQ(pool.getSurface(0)->getFullContext()(0, 2), 0);
+    EXPECT_EQ(pool.getSurface(0)->getFullContext()(0, 10000), -1000);
+    EXPECT_EQ(pool.getSurface(0)->getFullContext()(0, 2 + 2), 52);
+
+    pool.reset();
+    EXPECT_TRUE((pool.getSurface(1)->getFullContext() == -1000).all());
+
+}
@@ -0,0 +1,171 @@
+#include <sstream>
+#include <thread>
+#include <string>
+#include <set>
+#include <atomic>
+
+#include <cpphots/trace.h>
+#include <cpphots/network.h>
+#include <cpphots/time_surface.h>
+#include <cpphots/clustering/cosine.h>
+
+#include <gtest/gtest.h>
+
+#include "commons.h"
+
+
+size_t count_spans(const std::string& json, const std::string& name) {
+
+    std::string pattern = "\"name\":\"" + name + "\"";
+
+    size_t count = 0;
+    for (size_t pos = json.find(pattern); pos != std::string::npos; pos = json.find(pattern, pos + 1)) {
+        count++;
+    }
+
+    return count;
+
+}
+
+
+class TestTrace : public ::testing::Test {
+
+protected:
+
+    void SetUp() override {
+
+        network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(2, 32, 32, 1, 1, 100),
+                            new cpphots::CosineClusterer(4));
+        network.createLayer(cpphots::create_pool_ptr<cpphots::LinearTimeSurface>(4, 32, 32, 1, 1, 200),
+                            new cpphots::CosineClusterer(8));
+        cpphots::ClustererRandomSeeding(3, 3)(network[0], {});
+        cpphots::ClustererRandomSeeding(3, 3)(network[1], {});
+
+        RandomEventGenerator gen(32, 32, 2, 10);
+        evs.resize(1000);
+        std::generate(evs.begin(), evs.end(), gen);
+
+        cpphots::trace::clear();
+        cpphots::trace::setSampling(1);
+        cpphots::trace::enable();
+
+    }
+
+    void TearDown() override {
+        cpphots::trace::enable(false);
+        cpphots::trace::clear();
+    }
+
+    std::string dump() {
+        std::ostringstream out;
+        cpphots::trace::dump(out);
+        return out.str();
+    }
+
+    cpphots::Network network;
+    cpphots::Events evs;
+
+};
+
+TEST_F(TestTrace, Process) {
+
+    for (const auto& ev : evs) {
+        network.process(ev, true);
+    }
+
+    std::string json = dump();
+
+    EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+    EXPECT_EQ(count_spans(json, "Network::process"), 1000);
+    EXPECT_EQ(count_spans(json, "Network::layer"), 2000);
+    EXPECT_EQ(count_spans(json, "Layer::process"), 2000);
+    EXPECT_EQ(count_spans(json, "Layer::cluster"), 2000);
+    EXPECT_NE(json.find("\"args\":{\"arg\":1}"), std::string::npos);
+
+    cpphots::trace::clear();
+    EXPECT_EQ(cpphots::trace::getNumSpans(), 0);
+
+    cpphots::trace::enable(false);
+    network.process(evs[0], true);
+    EXPECT_EQ(cpphots::trace::getNumSpans(), 0);
+
+}
+
+TEST_F(TestTrace, Sampling) {
+
+    cpphots::trace::setSampling(10);
+
+    for (const auto& ev : evs) {
+        network.process(ev, true);
+    }
+
+    std::string json = dump();
+
+    // nested spans follow the sampling of the outer one
+    EXPECT_EQ(count_spans(json, "Network::process"), 100);
+    EXPECT_EQ(count_spans(json, "Layer::process"), 200);
+    EXPECT_EQ(count_spans(json, "Layer::cluster"), 200);
+
+    // spans that are not hot are always recorded
+    cpphots::trace::clear();
+    {
+        CPPHOTS_TRACE_SPAN("outer");
+        for (size_t i = 0; i < 10; i++) {
+            CPPHOTS_TRACE_SPAN("inner");
+        }
+    }
+    json = dump();
+    EXPECT_EQ(count_spans(json, "outer"), 1);
+    EXPECT_EQ(count_spans(json, "inner"), 10);
+
+}
+
+TEST_F(TestTrace, Threads) {
+
+    cpphots::trace::setBufferSize(16);
+
+    // both threads are alive while recording, otherwise the second one would reuse the buffer of the first
+    std::atomic<int> done{0};
+    auto worker = [&done] () {
+        for (size_t i = 0; i < 100; i++) {
+            CPPHOTS_TRACE_SPAN("worker");
+        }
+        done++;
+        while (done < 2) {
+            std::this_thread::yield();
+        }
+    };
+
+    std::thread t1(worker);
+    std::thread t2(worker);
+    t1.join();
+    t2.join();
+
+    cpphots::trace::setBufferSize(1 << 16);
+
+    // only the latest spans are kept in each buffer
+    std::string json = dump();
+    EXPECT_EQ(count_spans(json, "worker"), 32);
+
+}
+
+TEST_F(TestTrace, ExitedThreads) {
+
+    // threads created one after the other reuse the same buffer
+    for (size_t i = 0; i < 10; i++) {
+        std::thread t([] () {
+            CPPHOTS_TRACE_SPAN("worker");
+        });
+        t.join();
+    }
+
+    std::string json = dump();
+    EXPECT_EQ(count_spans(json, "worker"), 10);
+
+    std::set<std::string> tids;
+    for (size_t pos = json.find("\"tid\":"); pos != std::string::npos; pos = json.find("\"tid\":", pos + 1)) {
+        tids.insert(json.substr(pos, json.find(',', pos) - pos));
+    }
+    EXPECT_EQ(tids.size(), 1);
+
+}
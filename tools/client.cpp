@@ -0,0 +1,85 @@
+/**
+ * @file client.cpp
+ * @brief Minimal client for the inference server
+ *
+ * Sends event recordings to a running cpphots-server and prints the class IDs and histograms.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cpphots/events_utils.h>
+#include <cpphots/classification.h>
+
+#include "protocol.h"
+
+
+int main(int argc, char* argv[]) {
+
+    std::string socket_path = "/tmp/cpphots.sock";
+    unsigned int repeat = 1;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::stoul(argv[++i]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--socket PATH] [--repeat N] FILE.es [FILE.es ...]" << std::endl;
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("connect");
+        return 1;
+    }
+
+    for (const auto& file : files) {
+
+        cpphots::Events events = cpphots::loadFromFile(file);
+
+        protocol::Response response;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < repeat; r++) {
+            if (!protocol::writeRequest(fd, events) || !protocol::readResponse(fd, response)) {
+                std::cerr << "Connection closed by the server" << std::endl;
+                return 1;
+            }
+        }
+        std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+
+        if (response.status != protocol::STATUS_OK) {
+            std::cout << file << ": error: " << response.error << std::endl;
+            continue;
+        }
+
+        std::cout << file << ": class " << response.class_id << ", " << events.size() << " events, "
+                  << diff.count() * 1e3 / repeat << " ms" << std::endl;
+        cpphots::operator<<(std::cout, response.histogram) << std::endl;
+
+    }
+
+    close(fd);
+
+    return 0;
+
+}
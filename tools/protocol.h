@@ -0,0 +1,152 @@
+/**
+ * @file protocol.h
+ * @brief Wire protocol of the inference server
+ *
+ * All values are in host byte order, as the server only listens on a Unix domain socket.
+ *
+ * Request:
+ * - uint64_t: number of events N
+ * - N events, in the layout of cpphots::event (uint64_t t, uint16_t x, y, p; packed)
+ *
+ * Response:
+ * - int32_t: status, 0 on success
+ * - on success:
+ *   - int64_t: class ID, -1 if the server has no classifier
+ *   - uint64_t: number of bins B
+ *   - B uint32_t: histogram of the last layer
+ * - on error:
+ *   - uint64_t: length L of the message
+ *   - L chars: error message
+ *
+ * A client can send any number of requests on the same connection,
+ * each response is sent before the next request is read.
+ */
+#ifndef CPPHOTS_TOOLS_PROTOCOL_H
+#define CPPHOTS_TOOLS_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <cerrno>
+
+#include <cpphots/types.h>
+
+
+namespace protocol {
+
+const int32_t STATUS_OK = 0;
+const int32_t STATUS_ERROR = 1;
+
+// maximum number of events in a request
+const uint64_t MAX_EVENTS = uint64_t(1) << 28;
+
+struct Response {
+    int32_t status = STATUS_OK;
+    int64_t class_id = -1;
+    std::vector<uint32_t> histogram;
+    std::string error;
+};
+
+inline bool readAll(int fd, void* data, size_t size) {
+    char* ptr = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t r = read(fd, ptr, size);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return false;
+        }
+        ptr += r;
+        size -= r;
+    }
+    return true;
+}
+
+inline bool writeAll(int fd, const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t w = write(fd, ptr, size);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return false;
+        }
+        ptr += w;
+        size -= w;
+    }
+    return true;
+}
+
+template <typename T>
+bool readValue(int fd, T& value) {
+    return readAll(fd, &value, sizeof(T));
+}
+
+template <typename T>
+bool writeValue(int fd, const T& value) {
+    return writeAll(fd, &value, sizeof(T));
+}
+
+inline bool writeRequest(int fd, const cpphots::Events& events) {
+    return writeValue<uint64_t>(fd, events.size()) &&
+           writeAll(fd, events.data(), events.size() * sizeof(cpphots::event));
+}
+
+// returns false if the connection was closed or the request is malformed
+inline bool readRequest(int fd, cpphots::Events& events) {
+    uint64_t n;
+    if (!readValue(fd, n) || n > MAX_EVENTS) {
+        return false;
+    }
+    events.resize(n);
+    return readAll(fd, events.data(), n * sizeof(cpphots::event));
+}
+
+inline bool writeResponse(int fd, const Response& response) {
+
+    if (!writeValue(fd, response.status)) {
+        return false;
+    }
+
+    if (response.status != STATUS_OK) {
+        return writeValue<uint64_t>(fd, response.error.size()) &&
+               writeAll(fd, response.error.data(), response.error.size());
+    }
+
+    return writeValue(fd, response.class_id) &&
+           writeValue<uint64_t>(fd, response.histogram.size()) &&
+           writeAll(fd, response.histogram.data(), response.histogram.size() * sizeof(uint32_t));
+
+}
+
+inline bool readResponse(int fd, Response& response) {
+
+    if (!readValue(fd, response.status)) {
+        return false;
+    }
+
+    uint64_t n;
+
+    if (response.status != STATUS_OK) {
+        if (!readValue(fd, n)) {
+            return false;
+        }
+        response.error.resize(n);
+        return readAll(fd, response.error.data(), n);
+    }
+
+    if (!readValue(fd, response.class_id) || !readValue(fd, n)) {
+        return false;
+    }
+    response.histogram.resize(n);
+    return readAll(fd, response.histogram.data(), n * sizeof(uint32_t));
+
+}
+
+}
+
+#endif
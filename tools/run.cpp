@@ -0,0 +1,480 @@
+/**
+ * @file run.cpp
+ * @brief Batch processing of event recordings with a saved network
+ *
+ * Processes a list of EventStream recordings in parallel with a Network saved with toStream
+ * and writes the output events, the histograms of the last layer or the classifications.
+ *
+ * Output formats:
+ * - events: one file per recording in the output directory, either CSV (t,x,y,p)
+ *   or binary (array of packed cpphots::event). Subdirectories of input directories are
+ *   mirrored in the output directory, other recordings are written at its top level
+ * - histograms: one CSV line per recording (file,bins...) or, in binary, for each recording
+ *   uint64_t name length, name, uint64_t number of bins, uint32_t bins
+ * - classes: one CSV line per recording (file,class) or, in binary, for each recording
+ *   uint64_t name length, name, int64_t class
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+
+#include <cpphots/network.h>
+#include <cpphots/events_utils.h>
+#include <cpphots/classification.h>
+
+
+namespace fs = std::filesystem;
+
+enum class OutputType {
+    Events,
+    Histograms,
+    Classes
+};
+
+struct Options {
+    std::string network_file;
+    std::string classifier_file;
+    std::vector<std::string> inputs;
+    std::string output;
+    OutputType type = OutputType::Histograms;
+    bool binary = false;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    int layer_start = 0;
+    int layer_stop = 0;
+    bool skip_check = false;
+    bool timing = false;
+};
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " --network FILE [options] INPUT...\n"
+              << "INPUT can be an EventStream file, a directory (searched recursively for .es files)\n"
+              << "or @LIST, a text file with one path per line.\n"
+              << "Options:\n"
+              << "  --output-type TYPE     events, histograms (default) or classes\n"
+              << "  --format FORMAT        csv (default) or binary\n"
+              << "  --out PATH             output file (histograms, classes; default stdout for csv)\n"
+              << "                         or directory (events)\n"
+              << "  --classifier FILE      KNN classifier, required for classes\n"
+              << "  --layers START[:STOP]  use only layers [START, STOP), python-like indexes\n"
+              << "  --threads N            number of threads (default: number of cores)\n"
+              << "  --skip-check           consider all events as valid\n"
+              << "  --timing               report timing and throughput\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& opts) {
+
+    for (int i = 1; i < argc; i++) {
+
+        std::string arg(argv[i]);
+
+        if (arg == "--skip-check") {
+            opts.skip_check = true;
+            continue;
+        }
+        if (arg == "--timing") {
+            opts.timing = true;
+            continue;
+        }
+        if (arg.rfind("--", 0) != 0) {
+            opts.inputs.push_back(arg);
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string val(argv[++i]);
+
+        if (arg == "--network") {
+            opts.network_file = val;
+        } else if (arg == "--classifier") {
+            opts.classifier_file = val;
+        } else if (arg == "--out") {
+            opts.output = val;
+        } else if (arg == "--threads") {
+            opts.threads = std::max(1, std::stoi(val));
+        } else if (arg == "--output-type") {
+            if (val == "events") {
+                opts.type = OutputType::Events;
+            } else if (val == "histograms") {
+                opts.type = OutputType::Histograms;
+            } else if (val == "classes") {
+                opts.type = OutputType::Classes;
+            } else {
+                return false;
+            }
+        } else if (arg == "--format") {
+            if (val != "csv" && val != "binary") {
+                return false;
+            }
+            opts.binary = (val == "binary");
+        } else if (arg == "--layers") {
+            auto sep = val.find(':');
+            opts.layer_start = std::stoi(val.substr(0, sep));
+            if (sep != std::string::npos && sep + 1 < val.size()) {
+                opts.layer_stop = std::stoi(val.substr(sep + 1));
+            }
+        } else {
+            return false;
+        }
+
+    }
+
+    if (opts.network_file.empty() || opts.inputs.empty()) {
+        return false;
+    }
+
+    if (opts.type == OutputType::Classes && opts.classifier_file.empty()) {
+        std::cerr << "A classifier is required to output classes" << std::endl;
+        return false;
+    }
+
+    if (opts.output.empty() && (opts.type == OutputType::Events || opts.binary)) {
+        std::cerr << "An output path is required for events and binary outputs" << std::endl;
+        return false;
+    }
+
+    return true;
+
+}
+
+// names are the output paths of the recordings, without extension: relative to the input root
+// for files found in directories, the file name otherwise
+std::vector<std::string> collectFiles(const std::vector<std::string>& inputs, std::vector<fs::path>& names) {
+
+    std::vector<std::string> files;
+
+    for (const auto& input : inputs) {
+
+        if (input.size() > 1 && input[0] == '@') {
+            std::ifstream list(input.substr(1));
+            if (!list) {
+                throw std::runtime_error("Cannot open list " + input.substr(1));
+            }
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty()) {
+                    files.push_back(line);
+                    names.push_back(fs::path(line).stem());
+                }
+            }
+        } else if (fs::is_directory(input)) {
+            std::vector<std::string> dirfiles;
+            for (const auto& entry : fs::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".es") {
+                    dirfiles.push_back(entry.path().string());
+                }
+            }
+            std::sort(dirfiles.begin(), dirfiles.end());
+            for (const auto& file : dirfiles) {
+                files.push_back(file);
+                names.push_back(fs::path(file).lexically_relative(input).replace_extension());
+            }
+        } else {
+            files.push_back(input);
+            names.push_back(fs::path(input).stem());
+        }
+
+    }
+
+    return files;
+
+}
+
+
+struct Result {
+    std::vector<uint32_t> histogram;
+    int64_t class_id = -1;
+    size_t n_events = 0;
+    size_t n_dropped = 0;
+    double time = 0.0;
+    std::string error;
+};
+
+void writeEvents(const std::string& path, const cpphots::Events& events, bool binary) {
+
+    std::ofstream out(path, binary ? std::ios::binary : std::ios::out);
+
+    if (binary) {
+        out.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(cpphots::event));
+    } else {
+        for (const auto& ev : events) {
+            out << ev.t << "," << ev.x << "," << ev.y << "," << ev.p << "\n";
+        }
+    }
+
+    if (!out) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+
+}
+
+Result processFile(cpphots::Network& network, const std::string& file, const fs::path& name, const Options& opts,
+                   uint16_t width, uint16_t height, uint16_t polarities, const cpphots::KNNClassifier* classifier) {
+
+    Result res;
+
+    cpphots::Events events = cpphots::loadFromFile(file);
+    res.n_events = events.size();
+
+    bool keep = (opts.type == OutputType::Events);
+    cpphots::Events output;
+
+    auto start = std::chrono::steady_clock::now();
+
+    network.reset();
+    for (const auto& ev : events) {
+
+        // processing events out of range is undefined behaviour
+        if (ev.x >= width || ev.y >= height || ev.p >= polarities) {
+            res.n_dropped++;
+            continue;
+        }
+
+        auto out = network.process(ev, opts.skip_check);
+        if (keep && out != cpphots::invalid_event) {
+            output.push_back(out);
+        }
+
+    }
+
+    if (!keep) {
+        res.histogram = network.back().getHistogram();
+        if (classifier) {
+            res.class_id = classifier->classifyID(res.histogram);
+        }
+    }
+
+    std::chrono::duration<double> diff = std::chrono::steady_clock::now() - start;
+    res.time = diff.count();
+
+    if (keep) {
+        fs::path outpath = fs::path(opts.output) / name;
+        outpath += opts.binary ? ".bin" : ".csv";
+        writeEvents(outpath.string(), output, opts.binary);
+    }
+
+    return res;
+
+}
+
+void writeRecords(std::ostream& out, const std::vector<std::string>& files, const std::vector<Result>& results,
+                  const Options& opts) {
+
+    for (size_t i = 0; i < files.size(); i++) {
+
+        const Result& res = results[i];
+        if (!res.error.empty()) {
+            continue;
+        }
+
+        if (opts.binary) {
+            uint64_t len = files[i].size();
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(files[i].data(), len);
+            if (opts.type == OutputType::Histograms) {
+                uint64_t bins = res.histogram.size();
+                out.write(reinterpret_cast<const char*>(&bins), sizeof(bins));
+                out.write(reinterpret_cast<const char*>(res.histogram.data()), bins * sizeof(uint32_t));
+            } else {
+                out.write(reinterpret_cast<const char*>(&res.class_id), sizeof(res.class_id));
+            }
+        } else {
+            out << files[i];
+            if (opts.type == OutputType::Histograms) {
+                for (auto h : res.histogram) {
+                    out << "," << h;
+                }
+            } else {
+                out << "," << res.class_id;
+            }
+            out << "\n";
+        }
+
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+
+    Options opts;
+    try {
+        if (!parseOptions(argc, argv, opts)) {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // load network and classifier
+    cpphots::Network network;
+    {
+        std::ifstream in(opts.network_file);
+        if (!in) {
+            std::cerr << "Cannot open " << opts.network_file << std::endl;
+            return 1;
+        }
+        try {
+            in >> network;
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot load " << opts.network_file << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (opts.layer_start != 0 || opts.layer_stop != 0) {
+        // same normalization as Network::getSubnetwork
+        int n_layers = network.getNumLayers();
+        int start = opts.layer_start < 0 ? n_layers + opts.layer_start : opts.layer_start;
+        int stop = opts.layer_stop <= 0 ? n_layers + opts.layer_stop : opts.layer_stop;
+        if (start < 0 || start >= stop || stop > n_layers) {
+            std::cerr << "Invalid layers for a network with " << n_layers << " layers" << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+        network = network.getSubnetwork(start, stop);
+    }
+
+    if (network.getNumLayers() == 0) {
+        std::cerr << "The network has no layers" << std::endl;
+        return 1;
+    }
+
+    // histograms are taken from the last layer
+    if (opts.type != OutputType::Events && !network.back().canCluster()) {
+        std::cerr << "The last layer of the network has no clusterer" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<cpphots::KNNClassifier> classifier;
+    if (opts.type == OutputType::Classes) {
+        std::ifstream in(opts.classifier_file);
+        if (!in) {
+            std::cerr << "Cannot open " << opts.classifier_file << std::endl;
+            return 1;
+        }
+        classifier = std::make_unique<cpphots::KNNClassifier>();
+        try {
+            in >> *classifier;
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot load " << opts.classifier_file << ": " << e.what() << std::endl;
+            return 1;
+        }
+        if (classifier->getNumSamples() == 0) {
+            std::cerr << "The classifier has no samples" << std::endl;
+            return 1;
+        }
+        if (classifier->getNumFeatures() != network.back().getNumClusters()) {
+            std::cerr << "The classifier expects " << classifier->getNumFeatures() << " features, but the network has "
+                      << network.back().getNumClusters() << " clusters" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> files;
+    std::vector<fs::path> names;
+    try {
+        files = collectFiles(opts.inputs, names);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (opts.type == OutputType::Events) {
+        // outputs of different recordings must not overwrite each other
+        std::vector<fs::path> sorted = names;
+        std::sort(sorted.begin(), sorted.end());
+        auto dup = std::adjacent_find(sorted.begin(), sorted.end());
+        if (dup != sorted.end()) {
+            std::cerr << "Several recordings have the same output name " << dup->string() << std::endl;
+            return 1;
+        }
+        for (const auto& name : names) {
+            fs::create_directories((fs::path(opts.output) / name).parent_path());
+        }
+    }
+
+    auto [width, height] = network[0].getSize();
+    uint16_t polarities = network[0].getNumSurfaces();
+
+    // process files in parallel
+    std::vector<Result> results(files.size());
+    std::atomic<size_t> next{0};
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < std::min<size_t>(opts.threads, files.size()); t++) {
+        workers.emplace_back([&, w = width, h = height] () {
+            cpphots::Network net = network;
+            for (size_t i = next++; i < files.size(); i = next++) {
+                try {
+                    results[i] = processFile(net, files[i], names[i], opts, w, h, polarities, classifier.get());
+                } catch (const std::exception& e) {
+                    results[i].error = e.what();
+                }
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+    // report errors
+    int ret = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!results[i].error.empty()) {
+            std::cerr << files[i] << ": " << results[i].error << std::endl;
+            ret = 1;
+        }
+    }
+
+    // write histograms or classes
+    if (opts.type != OutputType::Events) {
+        if (opts.output.empty()) {
+            writeRecords(std::cout, files, results, opts);
+        } else {
+            std::ofstream out(opts.output, opts.binary ? std::ios::binary : std::ios::out);
+            if (!out) {
+                std::cerr << "Cannot write " << opts.output << std::endl;
+                return 1;
+            }
+            writeRecords(out, files, results, opts);
+        }
+    }
+
+    if (opts.timing) {
+
+        size_t n_events = 0;
+        size_t n_dropped = 0;
+        double proc_time = 0.0;
+        for (const auto& res : results) {
+            n_events += res.n_events;
+            n_dropped += res.n_dropped;
+            proc_time += res.time;
+        }
+
+        std::cerr << files.size() << " files, " << n_events << " events";
+        if (n_dropped > 0) {
+            std::cerr << " (" << n_dropped << " out of range, dropped)";
+        }
+        std::cerr << std::endl;
+        std::cerr << "wall time: " << wall.count() << " s, processing time: " << proc_time << " s on " << workers.size() << " threads" << std::endl;
+        std::cerr << "throughput: " << n_events / wall.count() / 1e6 << " Mev/s (" << n_events / proc_time / 1e6 << " Mev/s per thread)" << std::endl;
+
+    }
+
+    return ret;
+
+}
@@ -0,0 +1,527 @@
+/**
+ * @file server.cpp
+ * @brief Inference server for trained networks
+ *
+ * Loads a Network (and optionally a KNNClassifier) saved with their toStream methods
+ * and serves classification requests over a Unix domain socket (see protocol.h).
+ *
+ * Requests are processed by a pool of workers, each with its own copy of the network.
+ * Short requests waiting in the queue are processed together by the same worker,
+ * so that they are classified with a single batched call.
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cpphots/network.h>
+#include <cpphots/classification.h>
+
+#include "protocol.h"
+
+
+struct Options {
+    std::string network_file;
+    std::string classifier_file;
+    std::string socket_path = "/tmp/cpphots.sock";
+    unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t batch_size = 16;
+    size_t short_events = 10000;
+    unsigned int batch_wait_us = 0;
+    bool skip_check = false;
+};
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " --network FILE [options]\n"
+              << "Options:\n"
+              << "  --classifier FILE      KNN classifier used to classify histograms\n"
+              << "  --socket PATH          Unix socket path (default /tmp/cpphots.sock)\n"
+              << "  --workers N            number of worker threads (default: number of cores)\n"
+              << "  --batch-size N         maximum number of requests in a batch (default 16)\n"
+              << "  --short-events N       only requests with at most N events are batched (default 10000)\n"
+              << "  --batch-wait-us T      time to wait for a batch to fill up (default 0)\n"
+              << "  --skip-check           consider all events as valid\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& opts) {
+
+    for (int i = 1; i < argc; i++) {
+
+        std::string arg(argv[i]);
+
+        if (arg == "--skip-check") {
+            opts.skip_check = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string val(argv[++i]);
+
+        if (arg == "--network") {
+            opts.network_file = val;
+        } else if (arg == "--classifier") {
+            opts.classifier_file = val;
+        } else if (arg == "--socket") {
+            opts.socket_path = val;
+        } else if (arg == "--workers") {
+            opts.workers = std::max(1, std::stoi(val));
+        } else if (arg == "--batch-size") {
+            opts.batch_size = std::max(1, std::stoi(val));
+        } else if (arg == "--short-events") {
+            opts.short_events = std::stoul(val);
+        } else if (arg == "--batch-wait-us") {
+            opts.batch_wait_us = std::stoul(val);
+        } else {
+            return false;
+        }
+
+    }
+
+    return !opts.network_file.empty();
+
+}
+
+
+struct Job {
+    cpphots::Events events;
+    std::promise<protocol::Response> result;
+};
+
+using JobPtr = std::unique_ptr<Job>;
+
+protocol::Response errorResponse(const std::string& error) {
+    protocol::Response response;
+    response.status = protocol::STATUS_ERROR;
+    response.error = error;
+    return response;
+}
+
+class BatchQueue {
+
+public:
+
+    // jobs pushed after stop are answered immediately
+    void push(JobPtr job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!stopped) {
+                jobs.push_back(std::move(job));
+            }
+        }
+        if (job) {
+            job->result.set_value(errorResponse("The server is shutting down"));
+        } else {
+            cv.notify_one();
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        cv.notify_all();
+    }
+
+    // answer the jobs still in the queue with an error
+    void cancel(const std::string& error) {
+        std::deque<JobPtr> left;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            left.swap(jobs);
+        }
+        for (auto& job : left) {
+            job->result.set_value(errorResponse(error));
+        }
+    }
+
+    // long requests are returned alone, short ones are grouped up to max_batch
+    std::vector<JobPtr> popBatch(size_t max_batch, size_t short_events, std::chrono::microseconds wait) {
+
+        std::vector<JobPtr> batch;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return stopped || !jobs.empty(); });
+
+        if (jobs.empty()) {
+            return batch;
+        }
+
+        batch.push_back(std::move(jobs.front()));
+        jobs.pop_front();
+
+        if (batch[0]->events.size() > short_events) {
+            return batch;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + wait;
+        while (batch.size() < max_batch) {
+
+            if (jobs.empty() && !cv.wait_until(lock, deadline, [this] { return stopped || !jobs.empty(); })) {
+                break;
+            }
+
+            if (jobs.empty() || jobs.front()->events.size() > short_events) {
+                break;
+            }
+
+            batch.push_back(std::move(jobs.front()));
+            jobs.pop_front();
+
+        }
+
+        return batch;
+
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<JobPtr> jobs;
+    bool stopped = false;
+
+};
+
+
+struct Connection {
+    int fd = -1;
+    std::thread thread;
+    bool done = false;
+};
+
+class Server {
+
+public:
+
+    Server(const Options& opts, const cpphots::Network& network, std::unique_ptr<cpphots::KNNClassifier> classifier)
+        :opts(opts), network(network), classifier(std::move(classifier)) {
+
+        auto [w, h] = network[0].getSize();
+        width = w;
+        height = h;
+        polarities = network[0].getNumSurfaces();
+
+    }
+
+    void start() {
+        for (unsigned int i = 0; i < opts.workers; i++) {
+            workers.emplace_back(&Server::worker, this);
+        }
+    }
+
+    // connections must be closed before the workers, or their requests are never answered
+    void stop() {
+
+        std::list<Connection> closing;
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            for (auto& conn : connections) {
+                shutdown(conn.fd, SHUT_RDWR);
+            }
+            closing.swap(connections);
+        }
+        for (auto& conn : closing) {
+            conn.thread.join();
+            close(conn.fd);
+        }
+
+        queue.stop();
+        for (auto& w : workers) {
+            w.join();
+        }
+        queue.cancel("The server is shutting down");
+
+    }
+
+    void addConnection(int fd) {
+
+        std::lock_guard<std::mutex> lock(connections_mutex);
+
+        // release the connections closed by the clients
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (it->done) {
+                it->thread.join();
+                close(it->fd);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        connections.emplace_back();
+        connections.back().fd = fd;
+        connections.back().thread = std::thread(&Server::serveConnection, this, std::ref(connections.back()));
+
+    }
+
+    void serveConnection(Connection& conn) {
+
+        int fd = conn.fd;
+        cpphots::Events events;
+
+        while (protocol::readRequest(fd, events)) {
+
+            auto job = std::make_unique<Job>();
+            job->events = std::move(events);
+            auto result = job->result.get_future();
+            queue.push(std::move(job));
+
+            if (!protocol::writeResponse(fd, result.get())) {
+                break;
+            }
+
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        conn.done = true;
+
+    }
+
+    void printStats() const {
+        size_t nb = n_batches.load();
+        size_t nr = n_requests.load();
+        std::cerr << nr << " requests in " << nb << " batches";
+        if (nb > 0) {
+            std::cerr << " (" << double(nr) / nb << " requests per batch)";
+        }
+        std::cerr << std::endl;
+    }
+
+private:
+
+    std::string validate(const cpphots::Events& events) const {
+        for (const auto& ev : events) {
+            if (ev.x >= width || ev.y >= height || ev.p >= polarities) {
+                return "Event out of range: " + std::to_string(ev.x) + "," + std::to_string(ev.y) + "," + std::to_string(ev.p) +
+                       " for a network of size " + std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(polarities);
+            }
+        }
+        return "";
+    }
+
+    void worker() {
+
+        cpphots::Network net = network;
+
+        while (true) {
+
+            auto batch = queue.popBatch(opts.batch_size, opts.short_events, std::chrono::microseconds(opts.batch_wait_us));
+            if (batch.empty()) {
+                return;
+            }
+
+            std::vector<protocol::Response> responses(batch.size());
+            std::vector<cpphots::Features> feats;
+            std::vector<size_t> valid;
+
+            for (size_t i = 0; i < batch.size(); i++) {
+
+                std::string error = validate(batch[i]->events);
+                if (!error.empty()) {
+                    responses[i].status = protocol::STATUS_ERROR;
+                    responses[i].error = error;
+                    continue;
+                }
+
+                try {
+                    net.reset();
+                    for (const auto& ev : batch[i]->events) {
+                        net.process(ev, opts.skip_check);
+                    }
+                    responses[i].histogram = net.back().getHistogram();
+                } catch (const std::exception& e) {
+                    responses[i] = errorResponse(e.what());
+                    continue;
+                }
+
+                feats.push_back(responses[i].histogram);
+                valid.push_back(i);
+
+            }
+
+            if (classifier && !feats.empty()) {
+                try {
+                    auto ids = classifier->classifyID(feats, 1);
+                    for (size_t j = 0; j < valid.size(); j++) {
+                        responses[valid[j]].class_id = ids[j];
+                    }
+                } catch (const std::exception& e) {
+                    for (auto i : valid) {
+                        responses[i] = errorResponse(e.what());
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < batch.size(); i++) {
+                batch[i]->result.set_value(std::move(responses[i]));
+            }
+
+            n_batches++;
+            n_requests += batch.size();
+
+        }
+
+    }
+
+    const Options& opts;
+    const cpphots::Network& network;
+    std::unique_ptr<cpphots::KNNClassifier> classifier;
+    uint16_t width, height, polarities;
+
+    BatchQueue queue;
+    std::vector<std::thread> workers;
+
+    std::mutex connections_mutex;
+    std::list<Connection> connections;
+
+    std::atomic<size_t> n_batches{0};
+    std::atomic<size_t> n_requests{0};
+
+};
+
+
+std::atomic<bool> stop_requested{false};
+
+void handleSignal(int) {
+    stop_requested = true;
+}
+
+int main(int argc, char* argv[]) {
+
+    Options opts;
+    try {
+        if (!parseOptions(argc, argv, opts)) {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception&) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // load network and classifier
+    cpphots::Network network;
+    {
+        std::ifstream in(opts.network_file);
+        if (!in) {
+            std::cerr << "Cannot open " << opts.network_file << std::endl;
+            return 1;
+        }
+        try {
+            in >> network;
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot load " << opts.network_file << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (network.getNumLayers() == 0) {
+        std::cerr << "The network has no layers" << std::endl;
+        return 1;
+    }
+
+    // histograms are taken from the last layer
+    if (!network.back().canCluster()) {
+        std::cerr << "The last layer of the network has no clusterer" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<cpphots::KNNClassifier> classifier;
+    if (!opts.classifier_file.empty()) {
+        std::ifstream in(opts.classifier_file);
+        if (!in) {
+            std::cerr << "Cannot open " << opts.classifier_file << std::endl;
+            return 1;
+        }
+        classifier = std::make_unique<cpphots::KNNClassifier>();
+        try {
+            in >> *classifier;
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot load " << opts.classifier_file << ": " << e.what() << std::endl;
+            return 1;
+        }
+        if (classifier->getNumSamples() == 0) {
+            std::cerr << "The classifier has no samples" << std::endl;
+            return 1;
+        }
+        if (classifier->getNumFeatures() != network.back().getNumClusters()) {
+            std::cerr << "The classifier expects " << classifier->getNumFeatures() << " features, but the network has "
+                      << network.back().getNumClusters() << " clusters" << std::endl;
+            return 1;
+        }
+    }
+
+    // open socket
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::perror("socket");
+        return 1;
+    }
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (opts.socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long" << std::endl;
+        return 1;
+    }
+    std::strcpy(addr.sun_path, opts.socket_path.c_str());
+
+    unlink(opts.socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 64) < 0) {
+        std::perror("bind");
+        return 1;
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Server server(opts, network, std::move(classifier));
+    server.start();
+
+    std::cerr << "Listening on " << opts.socket_path << " with " << opts.workers << " workers" << std::endl;
+
+    while (!stop_requested) {
+
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        server.addConnection(fd);
+
+    }
+
+    close(listen_fd);
+    unlink(opts.socket_path.c_str());
+
+    server.stop();
+    server.printStats();
+
+    return 0;
+
+}